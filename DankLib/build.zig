@@ -43,7 +43,25 @@ pub fn build(b: *std.Build) void {
             "modules/engine/Engine.cpp",
             "modules/scene/Scene.cpp",
             "modules/scene/Camera.cpp",
+            "modules/animation/Skinning.cpp",
+            "modules/renderer/DrawLists.cpp",
+            "modules/renderer/meshes/MeshOptimizer.cpp",
+            "modules/renderer/meshes/MeshSimplifier.cpp",
+            "modules/renderer/paths/PathTessellator.cpp",
+            "modules/renderer/text/GlyphAtlas.cpp",
+            "modules/renderer/textures/AtlasPacker.cpp",
+            "modules/renderer/textures/MipChain.cpp",
+            "modules/renderer/textures/PixelBuffer.cpp",
+            "modules/renderer/textures/PixelConversion.cpp",
+            "modules/renderer/textures/QoiImage.cpp",
+            "modules/renderer/textures/TextureAtlas.cpp",
+            "modules/renderer/textures/TextureCompression.cpp",
+            "modules/renderer/textures/TextureLoader.cpp",
+            "modules/renderer/textures/TextureResidency.cpp",
+            "modules/renderer/textures/VirtualTexture.cpp",
+            "modules/renderer/textures/VirtualTextureFile.cpp",
             "modules/os/Thread.cpp",
+            "modules/os/JobSystem.cpp",
             "modules/input/Input.cpp",
             "os/apple/AppleOS.cpp",
             "os/apple/renderer/AppleRenderer.cpp",
@@ -76,6 +94,87 @@ pub fn build(b: *std.Build) void {
     libApple.linkFramework("MetalKit");
     libApple.linkFramework("ScreenCaptureKit");
 
+    // Offline tools, built for the host
+    const meshimport = b.addExecutable(.{
+        .name = "meshimport",
+        .target = b.host,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    meshimport.addIncludePath(b.path("src/"));
+    meshimport.linkLibCpp();
+    meshimport.addCSourceFiles(.{
+        .root = b.path("."),
+        .files = &.{
+            "tools/meshimport/main.cpp",
+            "src/modules/renderer/meshes/MeshOptimizer.cpp",
+            "src/modules/engine/Console.cpp",
+        },
+        .flags = &cflags,
+    });
+
+    const texcompress = b.addExecutable(.{
+        .name = "texcompress",
+        .target = b.host,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    texcompress.addIncludePath(b.path("src/"));
+    texcompress.linkLibCpp();
+    texcompress.addCSourceFiles(.{
+        .root = b.path("."),
+        .files = &.{
+            "tools/texcompress/main.cpp",
+            "src/modules/renderer/textures/MipChain.cpp",
+            "src/modules/renderer/textures/PixelConversion.cpp",
+            "src/modules/renderer/textures/TextureCompression.cpp",
+            "src/modules/os/JobSystem.cpp",
+            "src/modules/os/Thread.cpp",
+            "src/modules/engine/Console.cpp",
+        },
+        .flags = &cflags,
+    });
+
+    const qoiconvert = b.addExecutable(.{
+        .name = "qoiconvert",
+        .target = b.host,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    qoiconvert.addIncludePath(b.path("src/"));
+    qoiconvert.linkLibCpp();
+    qoiconvert.addCSourceFiles(.{
+        .root = b.path("."),
+        .files = &.{
+            "tools/qoiconvert/main.cpp",
+            "src/modules/renderer/textures/QoiImage.cpp",
+            "src/modules/os/JobSystem.cpp",
+            "src/modules/os/Thread.cpp",
+            "src/modules/engine/Console.cpp",
+        },
+        .flags = &cflags,
+    });
+
+    const vtbuild = b.addExecutable(.{
+        .name = "vtbuild",
+        .target = b.host,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    vtbuild.addIncludePath(b.path("src/"));
+    vtbuild.linkLibCpp();
+    vtbuild.addCSourceFiles(.{
+        .root = b.path("."),
+        .files = &.{
+            "tools/vtbuild/main.cpp",
+            "src/modules/renderer/textures/MipChain.cpp",
+            "src/modules/renderer/textures/PixelConversion.cpp",
+            "src/modules/renderer/textures/QoiImage.cpp",
+            "src/modules/renderer/textures/VirtualTextureFile.cpp",
+        },
+        .flags = &cflags,
+    });
+
     const HelperFunctions = struct {
         fn clearLibDir(_: *std.Build.Step, _: std.Progress.Node) anyerror!void {
             const cwd = std.fs.cwd();
@@ -149,6 +248,10 @@ pub fn build(b: *std.Build) void {
     // running `zig build`).
     b.installArtifact(lib);
     b.installArtifact(libApple);
+    b.installArtifact(meshimport);
+    b.installArtifact(texcompress);
+    b.installArtifact(qoiconvert);
+    b.installArtifact(vtbuild);
 
     zcc.createStep(b, "cdb", targets.toOwnedSlice() catch @panic("OOM"));
 }
@@ -22,6 +22,20 @@
 #include "libs/glm/gtx/quaternion.hpp"
 
 namespace dank {
+// Frames the CPU may be ahead of the GPU. Anything a frame reads stays
+// untouched until FRAMES_IN_FLIGHT more frames were submitted.
+const uint32_t FRAMES_IN_FLIGHT = 3;
+
 enum class ResourceState { Idle, Loading, Ready, Invalid };
-enum class PixelFormat { RGBA8Unorm = 0, BGRA32 = 1 };
+// Block compressed formats store 4x4 texel blocks, see TextureCompression
+enum class PixelFormat {
+  RGBA8Unorm = 0,
+  BGRA32 = 1,
+  BC1_RGBA = 2,
+  BC3_RGBA = 3,
+  BC7_RGBA = 4,
+  ASTC_4x4 = 5,
+  // Single channel, e.g. the distance fields of text::GlyphAtlas
+  R8Unorm = 6
+};
 } // namespace dank
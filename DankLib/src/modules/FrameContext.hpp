@@ -1,18 +1,66 @@
 #pragma once
 
 #include "modules/Foundation.hpp"
+#include "modules/animation/Skeleton.hpp"
+#include "modules/os/JobSystem.hpp"
 #include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/meshes/SpriteTable.hpp"
+#include "modules/renderer/meshes/TransientGeometry.hpp"
+#include "modules/renderer/paths/PathCache.hpp"
+#include "modules/renderer/text/GlyphAtlas.hpp"
 #include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureAtlas.hpp"
+#include "modules/renderer/textures/TextureResidency.hpp"
+#include "modules/renderer/textures/VirtualTexture.hpp"
 
 namespace dank {
+struct FrameStats {
+  uint32_t views = 0;
+  uint32_t visibleInstances = 0;
+  uint32_t drawCommands = 0;
+  uint32_t rebasedInstances = 0;
+  // Triangles submitted over all views, after LOD selection
+  uint32_t triangles = 0;
+  // LOD level changes, summed until the engine logs and resets them
+  uint32_t lodSwitches = 0;
+  // Milliseconds spent culling and building the per-view draw lists
+  double cullTime = 0;
+  // Milliseconds spent rebasing instances against the camera origin
+  double rebaseTime = 0;
+  uint32_t skinnedInstances = 0;
+  uint32_t skinnedVertices = 0;
+  // Milliseconds spent sampling clips and skinning, wall clock
+  double skinTime = 0;
+  // Transient geometry handed to the renderer this frame
+  uint32_t transientVertices = 0;
+  uint32_t transientIndices = 0;
+  // Pages of virtual textures drawn this frame
+  uint32_t virtualPages = 0;
+  // Glyphs of draw::Text drawn this frame, and the ones left out while
+  // they are rasterized
+  uint32_t textGlyphs = 0;
+  uint32_t missingGlyphs = 0;
+};
+
 struct FrameContext {
   bool paused{false};
   float deltaTime = 0;
   uint32_t framesPerSecond = 0;
   float absoluteTime = 0;
   uint32_t absoluteFrame = 0;
+  FrameStats stats{};
   entt::registry draw{};
   mesh::MeshLibrary meshLibrary{};
+  mesh::SpriteTable spriteTable{};
+  animation::SkeletonLibrary skeletons{};
+  path::PathCache paths{};
+  mesh::TransientGeometry transientGeometry{};
   texture::TextureLibrary textureLibrary{};
+  texture::TextureAtlas atlas{};
+  texture::TextureResidency residency{};
+  texture::VirtualTextures virtualTextures{};
+  text::GlyphAtlas glyphs{};
+  // Declared last so workers are joined before the libraries go away
+  JobSystem jobs{};
 };
 } // namespace dank
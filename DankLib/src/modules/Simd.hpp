@@ -0,0 +1,116 @@
+#pragma once
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DANK_SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DANK_SIMD_SSE2 1
+#endif
+
+namespace dank {
+namespace simd {
+
+// Four floats in one register: NEON on Apple silicon, SSE2 on x86_64 and a
+// plain struct elsewhere. Only what the CPU kernels need, loads and stores
+// of 16 byte aligned data go through load/store.
+#if DANK_SIMD_NEON
+typedef float32x4_t float4;
+
+inline float4 load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, float4 v) { vst1q_f32(p, v); }
+inline float4 splat(float x) { return vdupq_n_f32(x); }
+inline float4 set(float x, float y, float z, float w) {
+  float values[4] = {x, y, z, w};
+  return vld1q_f32(values);
+}
+inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+// a * b + c
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+// (x + z, y + w) in the low two lanes
+inline float4 addHalves(float4 v) {
+  float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vcombine_f32(sum, sum);
+}
+inline float lane0(float4 v) { return vgetq_lane_f32(v, 0); }
+inline float lane1(float4 v) { return vgetq_lane_f32(v, 1); }
+#elif DANK_SIMD_SSE2
+typedef __m128 float4;
+
+inline float4 load(const float *p) { return _mm_load_ps(p); }
+inline void store(float *p, float4 v) { _mm_store_ps(p, v); }
+inline float4 splat(float x) { return _mm_set1_ps(x); }
+inline float4 set(float x, float y, float z, float w) {
+  return _mm_setr_ps(x, y, z, w);
+}
+inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 madd(float4 a, float4 b, float4 c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+inline float4 addHalves(float4 v) {
+  return _mm_add_ps(v, _mm_movehl_ps(v, v));
+}
+inline float lane0(float4 v) { return _mm_cvtss_f32(v); }
+inline float lane1(float4 v) {
+  return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+#else
+struct float4 {
+  float v[4];
+};
+
+inline float4 load(const float *p) { return float4{{p[0], p[1], p[2], p[3]}}; }
+inline void store(float *p, float4 a) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = a.v[i];
+  }
+}
+inline float4 splat(float x) { return float4{{x, x, x, x}}; }
+inline float4 set(float x, float y, float z, float w) {
+  return float4{{x, y, z, w}};
+}
+inline float4 add(float4 a, float4 b) {
+  return float4{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+                 a.v[3] + b.v[3]}};
+}
+inline float4 sub(float4 a, float4 b) {
+  return float4{{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2],
+                 a.v[3] - b.v[3]}};
+}
+inline float4 mul(float4 a, float4 b) {
+  return float4{{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2],
+                 a.v[3] * b.v[3]}};
+}
+inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+inline float4 min(float4 a, float4 b) {
+  float4 r;
+  for (int i = 0; i < 4; i++) {
+    r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+  }
+  return r;
+}
+inline float4 max(float4 a, float4 b) {
+  float4 r;
+  for (int i = 0; i < 4; i++) {
+    r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+  }
+  return r;
+}
+inline float4 addHalves(float4 v) {
+  return float4{{v.v[0] + v.v[2], v.v[1] + v.v[3], v.v[0] + v.v[2],
+                 v.v[1] + v.v[3]}};
+}
+inline float lane0(float4 v) { return v.v[0]; }
+inline float lane1(float4 v) { return v.v[1]; }
+#endif
+
+} // namespace simd
+} // namespace dank
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+
+// Generational handle into a SlotMap. The generation changes every time a
+// slot is reused, so handles kept after remove() or clear() are detected as
+// stale instead of aliasing the new entry. A default handle is never valid.
+template <typename Tag> struct Handle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool isValid() const { return generation != 0; }
+  bool operator==(const Handle &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const Handle &other) const { return !(*this == other); }
+};
+
+// Values are stored densely for cache friendly iteration, handles resolve
+// through a slot table in O(1)
+template <typename T, typename Tag> class SlotMap {
+private:
+  struct Slot {
+    uint32_t dense = 0;
+    uint32_t generation = 1;
+  };
+
+  std::vector<T> values{};
+  std::vector<uint32_t> denseToSlot{};
+  std::vector<Slot> slots{};
+  std::vector<uint32_t> freeSlots{};
+
+public:
+  typedef Handle<Tag> HandleType;
+
+  HandleType insert(T value) {
+    uint32_t slotIndex;
+    if (!freeSlots.empty()) {
+      slotIndex = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      slotIndex = slots.size();
+      slots.push_back(Slot{});
+    }
+
+    Slot &slot = slots[slotIndex];
+    slot.dense = values.size();
+    values.push_back(std::move(value));
+    denseToSlot.push_back(slotIndex);
+    return HandleType{slotIndex, slot.generation};
+  }
+
+  bool contains(HandleType handle) const {
+    return handle.generation != 0 && handle.index < slots.size() &&
+           slots[handle.index].generation == handle.generation;
+  }
+
+  T *get(HandleType handle) {
+    return contains(handle) ? &values[slots[handle.index].dense] : nullptr;
+  }
+
+  const T *get(HandleType handle) const {
+    return contains(handle) ? &values[slots[handle.index].dense] : nullptr;
+  }
+
+  bool remove(HandleType handle) {
+    if (!contains(handle))
+      return false;
+
+    Slot &slot = slots[handle.index];
+    uint32_t dense = slot.dense;
+    uint32_t last = values.size() - 1;
+    if (dense != last) {
+      values[dense] = std::move(values[last]);
+      denseToSlot[dense] = denseToSlot[last];
+      slots[denseToSlot[dense]].dense = dense;
+    }
+    values.pop_back();
+    denseToSlot.pop_back();
+
+    retire(handle.index);
+    return true;
+  }
+
+  // Invalidates every handle, slots are reused with a new generation
+  void clear() {
+    for (const auto slotIndex : denseToSlot) {
+      retire(slotIndex);
+    }
+    values.clear();
+    denseToSlot.clear();
+  }
+
+  uint32_t size() const { return values.size(); }
+
+  // Dense iteration: 0 <= i < size()
+  T &valueAt(uint32_t i) { return values[i]; }
+  const T &valueAt(uint32_t i) const { return values[i]; }
+  HandleType handleAt(uint32_t i) const {
+    uint32_t slotIndex = denseToSlot[i];
+    return HandleType{slotIndex, slots[slotIndex].generation};
+  }
+
+  typename std::vector<T>::iterator begin() { return values.begin(); }
+  typename std::vector<T>::iterator end() { return values.end(); }
+  typename std::vector<T>::const_iterator begin() const {
+    return values.begin();
+  }
+  typename std::vector<T>::const_iterator end() const { return values.end(); }
+
+private:
+  void retire(uint32_t slotIndex) {
+    Slot &slot = slots[slotIndex];
+    slot.generation++;
+    // Skip 0 on wrap around, it marks invalid handles
+    if (slot.generation == 0) {
+      slot.generation = 1;
+    }
+    freeSlots.push_back(slotIndex);
+  }
+};
+
+} // namespace dank
@@ -0,0 +1,272 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dank {
+namespace animation {
+
+// Local transform of a bone relative to its parent
+struct BonePose {
+  glm::vec2 translation{0.0f};
+  // Radians, counter clockwise
+  float rotation = 0;
+  glm::vec2 scale{1.0f};
+};
+
+struct Bone {
+  std::string name{};
+  // Index of the parent, always lower than the bone's own, -1 for roots
+  int32_t parent = -1;
+  // Pose the skin vertices are bound in
+  BonePose setup{};
+};
+
+// 2D affine transform, the linear part as the columns (a, b) and (c, d),
+// laid out so the skinning kernel loads each half with one SIMD load
+struct alignas(16) BoneMatrix {
+  float linear[4] = {1, 0, 0, 1};
+  float translation[4] = {0, 0, 0, 0};
+
+  static BoneMatrix fromPose(const BonePose &pose) {
+    float c = std::cos(pose.rotation);
+    float s = std::sin(pose.rotation);
+    BoneMatrix m{};
+    m.linear[0] = c * pose.scale.x;
+    m.linear[1] = s * pose.scale.x;
+    m.linear[2] = -s * pose.scale.y;
+    m.linear[3] = c * pose.scale.y;
+    m.translation[0] = pose.translation.x;
+    m.translation[1] = pose.translation.y;
+    return m;
+  }
+
+  // this * other, other applied first
+  BoneMatrix operator*(const BoneMatrix &o) const {
+    const float *l = linear;
+    BoneMatrix m{};
+    m.linear[0] = l[0] * o.linear[0] + l[2] * o.linear[1];
+    m.linear[1] = l[1] * o.linear[0] + l[3] * o.linear[1];
+    m.linear[2] = l[0] * o.linear[2] + l[2] * o.linear[3];
+    m.linear[3] = l[1] * o.linear[2] + l[3] * o.linear[3];
+    m.translation[0] =
+        l[0] * o.translation[0] + l[2] * o.translation[1] + translation[0];
+    m.translation[1] =
+        l[1] * o.translation[0] + l[3] * o.translation[1] + translation[1];
+    return m;
+  }
+
+  BoneMatrix inverse() const {
+    const float *l = linear;
+    float det = l[0] * l[3] - l[2] * l[1];
+    float inv = det != 0 ? 1.0f / det : 0.0f;
+    BoneMatrix m{};
+    m.linear[0] = l[3] * inv;
+    m.linear[1] = -l[1] * inv;
+    m.linear[2] = -l[2] * inv;
+    m.linear[3] = l[0] * inv;
+    m.translation[0] =
+        -(m.linear[0] * translation[0] + m.linear[2] * translation[1]);
+    m.translation[1] =
+        -(m.linear[1] * translation[0] + m.linear[3] * translation[1]);
+    return m;
+  }
+};
+
+template <typename T> struct Keyframe {
+  float time;
+  T value;
+};
+
+// Keys sorted by time, a channel without keys keeps the setup pose
+struct BoneTrack {
+  uint32_t bone = 0;
+  std::vector<Keyframe<glm::vec2>> translations{};
+  std::vector<Keyframe<float>> rotations{};
+  std::vector<Keyframe<glm::vec2>> scales{};
+};
+
+struct AnimationClip {
+  std::string name{};
+  // Seconds
+  float duration = 1.0f;
+  bool loop = true;
+  std::vector<BoneTrack> tracks{};
+
+  // Overwrites the bones the clip animates, others keep their values
+  void sample(float time, std::vector<BonePose> &pose) const {
+    if (duration > 0) {
+      time = loop ? time - std::floor(time / duration) * duration
+                  : std::min(std::max(time, 0.0f), duration);
+    }
+    for (const auto &track : tracks) {
+      if (track.bone >= pose.size())
+        continue;
+      BonePose &bone = pose[track.bone];
+      if (!track.translations.empty()) {
+        bone.translation = sampleKeys(track.translations, time);
+      }
+      if (!track.rotations.empty()) {
+        bone.rotation = sampleRotation(track.rotations, time);
+      }
+      if (!track.scales.empty()) {
+        bone.scale = sampleKeys(track.scales, time);
+      }
+    }
+  }
+
+private:
+  // Index of the last key at or before time, and the blend to the next one
+  template <typename T>
+  static size_t findKey(const std::vector<Keyframe<T>> &keys, float time,
+                        float &blend) {
+    auto next = std::upper_bound(
+        keys.begin(), keys.end(), time,
+        [](float t, const Keyframe<T> &key) { return t < key.time; });
+    blend = 0;
+    if (next == keys.begin())
+      return 0;
+    size_t index = next - keys.begin() - 1;
+    if (next != keys.end()) {
+      float span = next->time - keys[index].time;
+      blend = span > 0 ? (time - keys[index].time) / span : 0.0f;
+    }
+    return index;
+  }
+
+  template <typename T>
+  static T sampleKeys(const std::vector<Keyframe<T>> &keys, float time) {
+    float blend;
+    size_t index = findKey(keys, time, blend);
+    if (blend <= 0)
+      return keys[index].value;
+    return glm::mix(keys[index].value, keys[index + 1].value, blend);
+  }
+
+  // Interpolates along the shorter way around
+  static float sampleRotation(const std::vector<Keyframe<float>> &keys,
+                              float time) {
+    float blend;
+    size_t index = findKey(keys, time, blend);
+    if (blend <= 0)
+      return keys[index].value;
+    float from = keys[index].value;
+    float delta = keys[index + 1].value - from;
+    delta -= glm::two_pi<float>() *
+             std::floor((delta + glm::pi<float>()) / glm::two_pi<float>());
+    return from + delta * blend;
+  }
+};
+
+// Vertex bound to up to four bones, unused influences have a zero weight.
+// Positions are in skeleton space in the setup pose.
+struct alignas(16) SkinVertex {
+  float weights[4] = {1, 0, 0, 0};
+  uint8_t bones[4] = {0, 0, 0, 0};
+  glm::vec2 position{0.0f};
+  glm::vec2 uv{0.0f};
+};
+
+struct SkeletonData {
+  std::vector<Bone> bones{};
+  std::vector<AnimationClip> clips{};
+  std::vector<SkinVertex> vertices{};
+  std::vector<uint32_t> indices{};
+};
+
+// A SkeletonData ready to be skinned. The setup pose geometry is added to
+// the MeshLibrary as well: it provides the indices every skinned instance
+// draws with, only the vertices come from the per frame region.
+struct Skeleton {
+  SkeletonData data{};
+  // Undoes the setup pose, world * inverseSetup gives the skinning matrix
+  std::vector<BoneMatrix> inverseSetup{};
+  mesh::MeshHandle setupMesh{};
+};
+
+struct SkeletonHandleTag;
+typedef Handle<SkeletonHandleTag> SkeletonHandle;
+
+class SkeletonLibrary {
+private:
+  SlotMap<Skeleton, SkeletonHandleTag> skeletons{};
+
+  // Parents before their children, and bones and indices in range, which
+  // computePalette and skinVertices rely on without checking
+  static bool validate(const SkeletonData &data) {
+    const auto &bones = data.bones;
+    for (uint32_t i = 0; i < bones.size(); i++) {
+      if (bones[i].parent < -1 || bones[i].parent >= int32_t(i))
+        return false;
+    }
+    for (const auto &vertex : data.vertices) {
+      for (uint32_t k = 0; k < 4; k++) {
+        if (vertex.bones[k] >= bones.size())
+          return false;
+      }
+    }
+    for (const auto index : data.indices) {
+      if (index >= data.vertices.size())
+        return false;
+    }
+    return true;
+  }
+
+public:
+  // An invalid handle when the data is malformed, see validate()
+  SkeletonHandle add(SkeletonData data, mesh::MeshLibrary &meshes) {
+    if (!validate(data)) {
+      console::warn("[SkeletonLibrary] invalid skeleton: %d bones, "
+                    "%d vertices",
+                    (int)data.bones.size(), (int)data.vertices.size());
+      return SkeletonHandle{};
+    }
+
+    Skeleton skeleton{};
+    skeleton.data = std::move(data);
+
+    const auto &bones = skeleton.data.bones;
+    std::vector<BoneMatrix> world(bones.size());
+    skeleton.inverseSetup.resize(bones.size());
+    for (uint32_t i = 0; i < bones.size(); i++) {
+      BoneMatrix local = BoneMatrix::fromPose(bones[i].setup);
+      world[i] = bones[i].parent >= 0 ? world[bones[i].parent] * local : local;
+      skeleton.inverseSetup[i] = world[i].inverse();
+    }
+
+    mesh::MeshData md{};
+    for (const auto &vertex : skeleton.data.vertices) {
+      md.vertices.push_back(mesh::VertexData{glm::vec3(vertex.position, 0.0f),
+                                             glm::vec3(0.0f, 0.0f, 1.0f),
+                                             vertex.uv});
+    }
+    md.indices = skeleton.data.indices;
+    skeleton.setupMesh = meshes.add(new mesh::DataMesh(std::move(md)));
+    return skeletons.insert(std::move(skeleton));
+  }
+
+  void remove(const SkeletonHandle handle, mesh::MeshLibrary &meshes) {
+    const Skeleton *skeleton = skeletons.get(handle);
+    if (skeleton == nullptr)
+      return;
+    meshes.remove(skeleton->setupMesh);
+    skeletons.remove(handle);
+  }
+
+  // Does not touch the MeshLibrary, meant to be called with its clear()
+  void clear() { skeletons.clear(); }
+
+  // nullptr when the handle is stale
+  const Skeleton *get(const SkeletonHandle handle) const {
+    return skeletons.get(handle);
+  }
+};
+
+} // namespace animation
+} // namespace dank
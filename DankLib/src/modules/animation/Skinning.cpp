@@ -0,0 +1,133 @@
+#include "modules/animation/Skinning.hpp"
+#include "modules/Simd.hpp"
+#include "modules/renderer/Renderer.hpp"
+#include <chrono>
+
+using namespace dank;
+
+void animation::computePalette(const Skeleton &skeleton,
+                               const std::vector<BonePose> &pose,
+                               std::vector<BoneMatrix> &world,
+                               std::vector<BoneMatrix> &palette) {
+  const auto &bones = skeleton.data.bones;
+  world.resize(bones.size());
+  palette.resize(bones.size());
+  for (uint32_t i = 0; i < bones.size(); i++) {
+    BoneMatrix local = BoneMatrix::fromPose(pose[i]);
+    world[i] = bones[i].parent >= 0 ? world[bones[i].parent] * local : local;
+    palette[i] = world[i] * skeleton.inverseSetup[i];
+  }
+}
+
+void animation::skinVertices(const SkinVertex *vertices, uint32_t count,
+                             const BoneMatrix *palette,
+                             mesh::VertexData *output, glm::vec2 &min,
+                             glm::vec2 &max) {
+  simd::float4 lower = simd::set(min.x, min.y, min.x, min.y);
+  simd::float4 upper = simd::set(max.x, max.y, max.x, max.y);
+
+  for (uint32_t i = 0; i < count; i++) {
+    const SkinVertex &vertex = vertices[i];
+
+    // Weighted sum of the bone matrices, unused influences add zero
+    simd::float4 linear = simd::splat(0.0f);
+    simd::float4 translation = simd::splat(0.0f);
+    for (uint32_t k = 0; k < 4; k++) {
+      const BoneMatrix &bone = palette[vertex.bones[k]];
+      simd::float4 weight = simd::splat(vertex.weights[k]);
+      linear = simd::madd(simd::load(bone.linear), weight, linear);
+      translation =
+          simd::madd(simd::load(bone.translation), weight, translation);
+    }
+
+    // (a x, b x, c y, d y), the halves summed give the linear part applied
+    simd::float4 xy = simd::set(vertex.position.x, vertex.position.x,
+                                vertex.position.y, vertex.position.y);
+    simd::float4 p =
+        simd::add(simd::addHalves(simd::mul(linear, xy)), translation);
+    lower = simd::min(lower, p);
+    upper = simd::max(upper, p);
+
+    mesh::VertexData &out = output[i];
+    out.position = glm::vec3(simd::lane0(p), simd::lane1(p), 0.0f);
+    out.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    out.uv = vertex.uv;
+  }
+
+  min = glm::vec2(simd::lane0(lower), simd::lane1(lower));
+  max = glm::vec2(simd::lane0(upper), simd::lane1(upper));
+}
+
+void animation::skinMeshes(FrameContext &ctx) {
+  auto start = std::chrono::steady_clock::now();
+
+  struct Task {
+    entt::entity entity;
+    const Skeleton *skeleton;
+    const draw::SkinnedMesh *skinned;
+    mesh::TransientSpan vertices;
+    glm::vec2 min;
+    glm::vec2 max;
+  };
+
+  // Ranges are reserved up front, the jobs only write into their own
+  std::vector<Task> tasks{};
+  uint32_t vertexCount = 0;
+  auto view = ctx.draw.view<draw::SkinnedMesh>();
+  for (auto [entity, skinned] : view.each()) {
+    const Skeleton *skeleton = ctx.skeletons.get(skinned.skeletonId);
+    if (skeleton == nullptr || skeleton->data.vertices.empty())
+      continue;
+    uint32_t count = skeleton->data.vertices.size();
+    tasks.push_back(Task{entity, skeleton, &skinned,
+                         ctx.transientGeometry.allocateVertices(count)});
+    vertexCount += count;
+  }
+
+  mesh::TransientGeometry &transient = ctx.transientGeometry;
+  auto skin = [&tasks, &transient](uint32_t begin, uint32_t end) {
+    std::vector<BonePose> pose{};
+    std::vector<BoneMatrix> world{};
+    std::vector<BoneMatrix> palette{};
+    for (uint32_t t = begin; t < end; t++) {
+      Task &task = tasks[t];
+      const Skeleton &skeleton = *task.skeleton;
+      const auto &data = skeleton.data;
+
+      pose.resize(data.bones.size());
+      for (uint32_t i = 0; i < data.bones.size(); i++) {
+        pose[i] = data.bones[i].setup;
+      }
+      if (task.skinned->clip < data.clips.size()) {
+        data.clips[task.skinned->clip].sample(task.skinned->time, pose);
+      }
+      computePalette(skeleton, pose, world, palette);
+
+      task.min = glm::vec2(std::numeric_limits<float>::max());
+      task.max = glm::vec2(std::numeric_limits<float>::lowest());
+      skinVertices(data.vertices.data(), data.vertices.size(),
+                   palette.data(), transient.vertexAt(task.vertices.first),
+                   task.min, task.max);
+    }
+  };
+  // A few characters per batch keeps the per batch overhead small
+  ctx.jobs.parallelFor(tasks.size(), 4, skin);
+
+  for (const auto &task : tasks) {
+    const draw::SkinnedMesh &skinned = *task.skinned;
+    glm::vec2 center = (task.min + task.max) * 0.5f;
+    ctx.draw.emplace_or_replace<draw::Mesh>(
+        task.entity, draw::Mesh{skinned.transform, skinned.color,
+                                task.skeleton->setupMesh, skinned.textureId});
+    ctx.draw.emplace_or_replace<draw::TransientGeometry>(
+        task.entity,
+        draw::TransientGeometry{task.vertices, {}, glm::vec3(center, 0.0f),
+                                glm::length(task.max - task.min) * 0.5f});
+  }
+
+  ctx.stats.skinnedInstances = tasks.size();
+  ctx.stats.skinnedVertices = vertexCount;
+  ctx.stats.skinTime = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+}
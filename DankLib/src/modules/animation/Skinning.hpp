@@ -0,0 +1,30 @@
+#pragma once
+#include "modules/FrameContext.hpp"
+#include "modules/animation/Skeleton.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace animation {
+
+// World matrix of every bone for a pose, parents before children, then
+// multiplied with the inverse setup pose into skinning matrices
+void computePalette(const Skeleton &skeleton,
+                    const std::vector<BonePose> &pose,
+                    std::vector<BoneMatrix> &world,
+                    std::vector<BoneMatrix> &palette);
+
+// Blends the four bone matrices of each vertex and transforms it, SIMD
+// across the matrix components. Writes VertexFormat::Standard vertices and
+// grows min and max by their positions.
+void skinVertices(const SkinVertex *vertices, uint32_t count,
+                  const BoneMatrix *palette, mesh::VertexData *output,
+                  glm::vec2 &min, glm::vec2 &max);
+
+// Samples and skins every draw::SkinnedMesh in ctx.draw, in parallel over
+// ctx.jobs, into ctx.transientGeometry. Each one gets a draw::Mesh of its
+// skeleton's setup mesh and a draw::TransientGeometry with its vertices.
+void skinMeshes(FrameContext &ctx);
+
+} // namespace animation
+} // namespace dank
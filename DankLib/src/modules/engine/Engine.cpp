@@ -1,13 +1,18 @@
 #include "Engine.hpp"
 #include "Console.hpp"
+#include "modules/animation/Skinning.hpp"
 #include "modules/input/Input.hpp"
 #include "modules/renderer/meshes/RectangleMesh.hpp"
 #include "modules/renderer/meshes/TriangleMesh.hpp"
 #include "modules/renderer/textures/DebugTexture.hpp"
+#include "modules/renderer/textures/PixelConversion.hpp"
+#include <algorithm>
 #include <chrono>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "libs/stb/stb_image.h"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "libs/stb/stb_truetype.h"
 
 using namespace dank;
 
@@ -20,6 +25,7 @@ double Engine::getTimeInMilliseconds() const {
 
 Engine::Engine() {
   scene = new Scene();
+  ctx.jobs.start();
   framePerSecondAccumulator.lastTime = getTimeInMilliseconds();
   console::log("Engine initialized");
 }
@@ -30,7 +36,7 @@ Engine::~Engine() {
 }
 
 void Engine::onViewResize(float viewWidth, float viewHeight) {
-  scene->camera.onViewResize(viewWidth, viewHeight);
+  scene->onViewResize(viewWidth, viewHeight);
 }
 
 void Engine::update() {
@@ -48,6 +54,90 @@ void Engine::update() {
     framePerSecondAccumulator.time = 0;
     framePerSecondAccumulator.frames = 0;
     console::log("[dank] fps: %d | %.2fms", ctx.framesPerSecond, deltaTime);
+    console::log("[dank] views: %d | instances: %d | draws: %d | cull: %.3fms "
+                 "| rebase: %d in %.3fms",
+                 ctx.stats.views, ctx.stats.visibleInstances,
+                 ctx.stats.drawCommands, ctx.stats.cullTime,
+                 ctx.stats.rebasedInstances, ctx.stats.rebaseTime);
+    console::log("[dank] triangles: %d | lod switches: %d",
+                 ctx.stats.triangles, ctx.stats.lodSwitches);
+    ctx.stats.lodSwitches = 0;
+    console::log("[dank] skinned: %d instances, %d vertices in %.3fms",
+                 ctx.stats.skinnedInstances, ctx.stats.skinnedVertices,
+                 ctx.stats.skinTime);
+    console::log("[dank] transient: %d vertices, %d indices",
+                 ctx.stats.transientVertices, ctx.stats.transientIndices);
+    auto &paths = ctx.paths;
+    console::log("[dank] paths: %d cached | %d hits | %d misses | "
+                 "%d tessellated in %.3fms",
+                 paths.size(), paths.hits, paths.misses, paths.tessellated,
+                 paths.tessellateTime);
+    paths.hits = 0;
+    paths.misses = 0;
+    paths.tessellated = 0;
+    paths.tessellateTime = 0;
+    auto &residency = ctx.residency;
+    console::log("[dank] textures: %.1f / %.1f MB | %d dropped | %d evicted "
+                 "| %d restored",
+                 residency.getResidentBytes() / 1048576.0,
+                 residency.budget / 1048576.0, residency.dropped,
+                 residency.evicted, residency.restored);
+    residency.dropped = 0;
+    residency.evicted = 0;
+    residency.restored = 0;
+    auto &virtualTextures = ctx.virtualTextures;
+    if (virtualTextures.getSlotCount() > 0) {
+      console::log("[dank] virtual textures: %d pages drawn | %d / %d "
+                   "resident | %d read | %d evicted | %d in flight",
+                   ctx.stats.virtualPages, virtualTextures.getResidentPages(),
+                   virtualTextures.getSlotCount(), virtualTextures.pagesRead,
+                   virtualTextures.evictions,
+                   virtualTextures.getReadsInFlight());
+      virtualTextures.pagesRead = 0;
+      virtualTextures.evictions = 0;
+    }
+    auto &glyphs = ctx.glyphs;
+    if (glyphs.getCellCount() > 0) {
+      console::log("[dank] glyphs: %d drawn | %d missing | %d / %d resident "
+                   "| %d rasterized | %d evicted | %d in flight",
+                   ctx.stats.textGlyphs, ctx.stats.missingGlyphs,
+                   glyphs.getResidentGlyphs(), glyphs.getCellCount(),
+                   glyphs.glyphsRasterized, glyphs.evictions,
+                   glyphs.getRastersInFlight());
+      glyphs.glyphsRasterized = 0;
+      glyphs.evictions = 0;
+    }
+    auto &loader = ctx.textureLibrary.loader;
+    uint64_t decodedPixels = loader.decodedPixels.exchange(0);
+    uint64_t decodeMicroseconds = loader.decodeMicroseconds.exchange(0);
+    if (decodedPixels > 0) {
+      console::log("[dank] decoded: %.2f MP in %.3fms | %.1f MP/s",
+                   decodedPixels / 1e6, decodeMicroseconds / 1e3,
+                   decodedPixels /
+                       double(std::max<uint64_t>(decodeMicroseconds, 1)));
+    }
+    uint64_t mipPixels = loader.mipPixels.exchange(0);
+    uint64_t mipMicroseconds = loader.mipMicroseconds.exchange(0);
+    if (mipPixels > 0) {
+      console::log("[dank] mipmapped: %.2f MP in %.3fms | %.1f MP/s",
+                   mipPixels / 1e6, mipMicroseconds / 1e3,
+                   mipPixels / double(std::max<uint64_t>(mipMicroseconds, 1)));
+    }
+    uint32_t cacheHits = loader.cacheHits.exchange(0);
+    uint32_t cacheMisses = loader.cacheMisses.exchange(0);
+    if (cacheHits + cacheMisses > 0) {
+      console::log("[dank] texture cache: %d hits | %d misses", cacheHits,
+                   cacheMisses);
+    }
+    uint64_t convertedBytes = texture::conversionStats.bytes.exchange(0);
+    uint64_t convertMicroseconds =
+        texture::conversionStats.microseconds.exchange(0);
+    if (convertedBytes > 0) {
+      console::log(
+          "[dank] pixels converted: %.2f MB in %.3fms | %.2f GB/s",
+          convertedBytes / 1e6, convertMicroseconds / 1e3,
+          convertedBytes / (std::max<uint64_t>(convertMicroseconds, 1) * 1e3));
+    }
   }
 
   // Update time
@@ -56,6 +146,19 @@ void Engine::update() {
   ctx.absoluteFrame++;
 
   dank::input.update(deltaTime);
-  
+
+  ctx.transientGeometry.reset();
   scene->update(ctx);
+  animation::skinMeshes(ctx);
+
+  // Swap in meshes optimized, LODs built and paths tessellated in the
+  // background, then defragment the mesh pages a few meshes at a time
+  ctx.meshLibrary.releaseRetired(ctx.absoluteFrame);
+  ctx.meshLibrary.applyOptimized();
+  ctx.paths.apply(ctx.meshLibrary);
+  ctx.atlas.update(ctx.textureLibrary);
+  ctx.virtualTextures.update(ctx.textureLibrary, ctx.jobs, ctx.absoluteFrame);
+  ctx.glyphs.update(ctx.textureLibrary, ctx.jobs, ctx.absoluteFrame);
+  ctx.meshLibrary.applyLods();
+  ctx.meshLibrary.compact(8);
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include "modules/Foundation.hpp"
+#include "modules/renderer/textures/PixelBuffer.hpp"
 #include <Security/Security.h>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 
 namespace dank {
@@ -10,14 +12,18 @@ struct CaptureSharableContent {
   uint8_t displayCount;
 };
 
+// Latest frame of the screen. The capture thread converts each frame into
+// a buffer of the pool and publishes it under mutex, the renderer copies
+// pixels under it and keeps the frame as long as it holds that copy.
 struct CaptureScreenOutput {
+  std::mutex mutex{};
   uint32_t frame = 0;
   uint32_t width = 0;
   uint32_t height = 0;
   uint32_t channels = 0;
   PixelFormat format;
-  size_t size = 0;
-  uint8_t *data = nullptr;
+  texture::PixelBuffer pixels{};
+  texture::PixelPool pool{};
 };
 
 struct AudioBuffer {
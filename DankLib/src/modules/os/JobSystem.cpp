@@ -0,0 +1,129 @@
+#include "modules/os/JobSystem.hpp"
+#include "modules/engine/Console.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace dank;
+
+void JobSystem::Worker::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(system->mutex);
+      system->wake.wait(lock, [this]() {
+        return system->stopping || !system->queue.empty();
+      });
+      if (system->queue.empty())
+        return;
+      job = std::move(system->queue.front());
+      system->queue.pop_front();
+    }
+    job();
+  }
+}
+
+void JobSystem::start(uint32_t workerCount) {
+  if (!workers.empty())
+    return;
+
+  if (workerCount == 0) {
+    workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+
+  stopping = false;
+  for (uint32_t i = 0; i < workerCount; i++) {
+    auto *worker = new Worker();
+    worker->system = this;
+    workers.push_back(worker);
+    worker->thread.start(worker);
+  }
+  console::log("[JobSystem] started %d workers", workerCount);
+}
+
+void JobSystem::stop() {
+  if (workers.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto *worker : workers) {
+    worker->thread.join();
+    delete worker;
+  }
+  workers.clear();
+}
+
+void JobSystem::submit(Job job) {
+  // Without workers, e.g. before start() or in tools, jobs run inline
+  if (workers.empty()) {
+    job();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(job));
+  }
+  wake.notify_one();
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize,
+                            const RangeJob &job) {
+  if (count == 0)
+    return;
+  batchSize = std::max(batchSize, 1u);
+  uint32_t batches = (count + batchSize - 1) / batchSize;
+  if (workers.empty() || batches == 1) {
+    job(0, count);
+    return;
+  }
+
+  // Batches are claimed from a shared counter, so the caller and however
+  // many helpers get to run split the work without one job per batch.
+  // Helpers that start after everything is claimed return without touching
+  // the job, which may be gone by then.
+  struct Batches {
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+    std::mutex mutex{};
+    std::condition_variable finished{};
+  };
+  auto state = std::make_shared<Batches>();
+  const RangeJob *range = &job;
+  auto run = [state, range, count, batchSize, batches]() {
+    uint32_t completed = 0;
+    while (true) {
+      uint32_t batch = state->next.fetch_add(1);
+      if (batch >= batches)
+        break;
+      uint32_t begin = batch * batchSize;
+      (*range)(begin, std::min(count, begin + batchSize));
+      completed++;
+    }
+    if (completed > 0 && state->done.fetch_add(completed) + completed ==
+                             batches) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->finished.notify_all();
+    }
+  };
+
+  uint32_t helpers = std::min<uint32_t>(workers.size(), batches - 1);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i < helpers; i++) {
+      queue.push_back(run);
+    }
+  }
+  wake.notify_all();
+
+  run();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock,
+                       [&state, batches]() { return state->done == batches; });
+}
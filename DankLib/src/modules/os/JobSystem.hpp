@@ -0,0 +1,53 @@
+#pragma once
+#include "modules/os/Thread.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace dank {
+
+typedef std::function<void()> Job;
+// Processes the items [begin, end) of a parallelFor
+typedef std::function<void(uint32_t begin, uint32_t end)> RangeJob;
+
+// Fixed pool of worker threads consuming a shared FIFO of jobs. Jobs must
+// not touch the FrameContext directly, they hand their results back to the
+// main thread which applies them during the next update.
+class JobSystem {
+private:
+  class Worker : public Runnable {
+  public:
+    JobSystem *system = nullptr;
+    Thread thread{};
+    void run() override;
+  };
+
+  std::vector<Worker *> workers{};
+  std::deque<Job> queue{};
+  std::mutex mutex{};
+  std::condition_variable wake{};
+  bool stopping = false;
+
+public:
+  ~JobSystem() { stop(); }
+
+  // workerCount 0 uses one worker per hardware thread minus the main one
+  void start(uint32_t workerCount = 0);
+  // Finishes the queued jobs and joins every worker
+  void stop();
+
+  void submit(Job job);
+
+  // Splits [0, count) into ranges of batchSize items and runs them on the
+  // workers and the calling thread, returning once all are done. Unlike
+  // submit() this is meant for work the current frame waits on, the job
+  // may touch whatever the caller owns as long as ranges do not overlap.
+  void parallelFor(uint32_t count, uint32_t batchSize, const RangeJob &job);
+
+  uint32_t getWorkerCount() const { return workers.size(); }
+};
+
+} // namespace dank
@@ -1,5 +1,6 @@
 #include "URI.hpp"
 #include "modules/os/Capture.hpp"
+#include <string>
 
 namespace dank {
 
@@ -8,6 +9,12 @@ public:
   virtual void getDataFromURI(URI &uri, ResourceData &output) = 0;
   virtual void getCaptureSharableContent(CaptureSharableContent &output) = 0;
   virtual void setCaptureConfig(CaptureConfig &config) = 0;
+  // Writable directory for data derived from resources, e.g. decoded
+  // textures, that may be deleted at any time. Empty when there is none.
+  virtual std::string getCacheDirectory() { return ""; }
+  // Path of a file URI on disk, for resources read in parts instead of
+  // loaded whole, e.g. virtual textures. Empty when it has none.
+  virtual std::string getFilePath(const URI &uri) { return ""; }
 };
 
 // Must be defined on the host application
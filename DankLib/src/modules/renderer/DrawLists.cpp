@@ -0,0 +1,395 @@
+#include "modules/renderer/DrawLists.hpp"
+#include <chrono>
+
+using namespace dank;
+
+namespace {
+
+struct ClipVertex {
+  glm::vec3 position;
+  glm::vec2 uv;
+};
+
+// Clips the quad of a virtual sprite against a view, false when nothing is
+// left of it, otherwise the bounds of the uvs of what is
+bool clipSprite(const Frustum &frustum, const glm::mat4 &transform,
+                glm::vec2 size, glm::vec2 &uvMin, glm::vec2 &uvMax) {
+  // A convex polygon gains at most one vertex per plane
+  ClipVertex polygon[10];
+  ClipVertex clipped[10];
+  const glm::vec2 corners[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
+  uint32_t count = 4;
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec2 local = (corners[i] - 0.5f) * size * glm::vec2(1.0f, -1.0f);
+    polygon[i] = ClipVertex{glm::vec3(transform * glm::vec4(local, 0, 1)),
+                            corners[i]};
+  }
+
+  for (const glm::vec4 &plane : frustum.planes) {
+    uint32_t clippedCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      const ClipVertex &a = polygon[i];
+      const ClipVertex &b = polygon[(i + 1) % count];
+      float da = glm::dot(glm::vec3(plane), a.position) + plane.w;
+      float db = glm::dot(glm::vec3(plane), b.position) + plane.w;
+      if (da >= 0) {
+        clipped[clippedCount++] = a;
+      }
+      if ((da >= 0) != (db >= 0)) {
+        float t = da / (da - db);
+        clipped[clippedCount++] =
+            ClipVertex{glm::mix(a.position, b.position, t),
+                       glm::mix(a.uv, b.uv, t)};
+      }
+    }
+    count = clippedCount;
+    if (count == 0)
+      return false;
+    std::copy(clipped, clipped + count, polygon);
+  }
+
+  uvMin = glm::vec2(1.0f);
+  uvMax = glm::vec2(0.0f);
+  for (uint32_t i = 0; i < count; i++) {
+    uvMin = glm::min(uvMin, polygon[i].uv);
+    uvMax = glm::max(uvMax, polygon[i].uv);
+  }
+  return true;
+}
+
+} // namespace
+
+void draw::DrawLists::build(FrameContext &ctx,
+                            const std::vector<Camera> &cameras) {
+  auto start = std::chrono::steady_clock::now();
+
+  instances.clear();
+  transforms.clear();
+  worldPositions.clear();
+  objectIds.clear();
+  bounds.clear();
+  views.clear();
+
+  for (uint32_t i = 0; i < cameras.size() && views.size() < MAX_VIEWS; i++) {
+    const Camera &camera = cameras[i];
+    if (!camera.enabled || camera.viewport[2] <= 0 || camera.viewport[3] <= 0)
+      continue;
+
+    if (views.empty()) {
+      renderOrigin = camera.origin;
+    }
+
+    ViewList list{};
+    list.camera = i;
+    list.renderTarget = camera.renderTarget;
+    list.originOffset = glm::vec3(renderOrigin - camera.origin);
+    list.frustum.update(camera.proj * camera.view *
+                        glm::translate(glm::mat4(1.0f), list.originOffset));
+    list.eye = camera.pos - list.originOffset;
+    list.pixelScale = camera.proj[1][1] * camera.viewport[3] * 0.5f;
+    list.perspective = camera.mode == ProjectionMode::Perspective;
+    views.push_back(std::move(list));
+  }
+
+  // Gather every mesh and sprite with its double precision base position,
+  // instances without a draw::WorldPosition are placed relative to the
+  // world origin
+  auto meshes = ctx.draw.view<Mesh>();
+  for (auto [entity, mesh] : meshes.each()) {
+    const auto *world = ctx.draw.try_get<WorldPosition>(entity);
+    const auto *transient = ctx.draw.try_get<TransientGeometry>(entity);
+    instances.push_back(Instance{mesh.meshId, mesh.textureId, mesh.color});
+    transforms.push_back(mesh.transform);
+    worldPositions.push_back(world != nullptr ? world->position
+                                              : glm::dvec3(0.0));
+    objectIds.push_back(mesh.objectId);
+    if (transient != nullptr) {
+      instances.back().transientVertices = transient->vertices.first;
+      instances.back().transientIndices = transient->indices;
+      bounds.push_back(
+          glm::vec4(transient->boundsCenter, transient->boundsRadius));
+    } else {
+      bounds.push_back(glm::vec4(-1.0f));
+    }
+  }
+
+  auto sprites = ctx.draw.view<Sprite>();
+  if (!sprites.empty()) {
+    mesh::MeshHandle quad = ctx.spriteTable.getQuad(ctx.meshLibrary);
+    for (auto [entity, sprite] : sprites.each()) {
+      const auto *frame = ctx.spriteTable.get(sprite.spriteId);
+      if (frame == nullptr)
+        continue;
+      const auto *world = ctx.draw.try_get<WorldPosition>(entity);
+      instances.push_back(Instance{quad, sprite.textureId, sprite.color,
+                                   glm::vec4(frame->uvOffset, frame->uvScale),
+                                   frame->size});
+      transforms.push_back(sprite.transform);
+      worldPositions.push_back(world != nullptr ? world->position
+                                                : glm::dvec3(0.0));
+      objectIds.push_back(0);
+      bounds.push_back(glm::vec4(-1.0f));
+    }
+  }
+
+  addVirtualSprites(ctx);
+  addTexts(ctx);
+
+  // Rebase against the render origin in double precision, narrowing to
+  // float only once the values are small
+  auto rebaseStart = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < transforms.size(); i++) {
+    glm::vec3 offset = glm::vec3(worldPositions[i] - renderOrigin);
+    transforms[i][3] += glm::vec4(offset, 0.0f);
+  }
+  ctx.stats.rebasedInstances = transforms.size();
+  ctx.stats.rebaseTime = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - rebaseStart)
+                             .count();
+
+  // Union of all frusta as a render space box, used to reject meshes that
+  // no camera can see before any per-view test
+  glm::vec3 unionMin{std::numeric_limits<float>::max()};
+  glm::vec3 unionMax{std::numeric_limits<float>::lowest()};
+  for (const auto &list : views) {
+    glm::vec3 min, max;
+    cameras[list.camera].getFrustumBounds(min, max);
+    unionMin = glm::min(unionMin, min - list.originOffset);
+    unionMax = glm::max(unionMax, max - list.originOffset);
+  }
+
+  // Visible instances are compacted in place
+  uint32_t instanceCount = 0;
+  uint32_t triangles = 0;
+  for (size_t i = 0; i < instances.size(); i++) {
+    const Instance &instance = instances[i];
+    const glm::mat4 &transform = transforms[i];
+    // Transient indices make the instance independent of any mesh
+    const auto descriptor = ctx.meshLibrary.get(instance.meshId);
+    bool ownIndices = instance.transientIndices.count > 0;
+    if (descriptor == nullptr && !ownIndices)
+      continue;
+
+    glm::vec4 sphere = bounds[i].w >= 0 || descriptor == nullptr
+                           ? bounds[i]
+                           : glm::vec4(descriptor->boundsCenter,
+                                       descriptor->boundsRadius);
+    glm::vec3 center = glm::vec3(
+        transform *
+        glm::vec4(glm::vec3(sphere) * glm::vec3(instance.size, 1.0f), 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                           glm::max(glm::length(glm::vec3(transform[1])),
+                                    glm::length(glm::vec3(transform[2]))));
+    float radius =
+        sphere.w * scale *
+        glm::max(glm::abs(instance.size.x), glm::abs(instance.size.y));
+    bool culled = radius > 0;
+
+    if (culled && views.size() > 1) {
+      glm::vec3 closest = glm::clamp(center, unionMin, unionMax);
+      glm::vec3 delta = closest - center;
+      if (glm::dot(delta, delta) > radius * radius)
+        continue;
+    }
+
+    uint32_t viewCount = 0;
+    float projectedRadius = 0;
+    for (auto &list : views) {
+      // A view never samples the target it is rendering into
+      if (list.renderTarget.isValid() &&
+          list.renderTarget == instance.textureId)
+        continue;
+      if (culled && !list.frustum.checkSphere(center, radius))
+        continue;
+      list.instances.push_back(instanceCount);
+      viewCount++;
+      if (radius > 0) {
+        float pixels = radius * list.pixelScale;
+        if (list.perspective) {
+          pixels /= glm::max(glm::distance(center, list.eye), 1e-4f);
+        }
+        projectedRadius = glm::max(projectedRadius, pixels);
+      }
+    }
+
+    if (viewCount > 0) {
+      instances[instanceCount] = instance;
+      transforms[instanceCount] = transform;
+      const mesh::MeshDescriptor *drawn = descriptor;
+      // Transient vertices are laid out for the mesh itself, not its levels
+      if (!ownIndices && descriptor->lodCount > 0 && projectedRadius > 0 &&
+          instance.transientVertices == NO_TRANSIENT_VERTICES) {
+        uint32_t level =
+            selectLod(ctx, *descriptor, projectedRadius, objectIds[i]);
+        if (level > 0) {
+          const auto lod = ctx.meshLibrary.get(descriptor->lods[level - 1]);
+          if (lod != nullptr) {
+            instances[instanceCount].meshId = descriptor->lods[level - 1];
+            drawn = lod;
+          }
+        }
+      }
+      uint32_t indexCount =
+          ownIndices ? instance.transientIndices.count : drawn->indexCount;
+      triangles += indexCount / 3 * viewCount;
+      instanceCount++;
+    }
+  }
+  instances.resize(instanceCount);
+  transforms.resize(instanceCount);
+
+  // Textures still loading that something on screen waits for go first,
+  // the ones drawn are kept resident
+  texture::TextureHandle previousTexture{};
+  for (const auto &instance : instances) {
+    if (instance.textureId == previousTexture)
+      continue;
+    previousTexture = instance.textureId;
+    ctx.textureLibrary.prioritize(instance.textureId,
+                                  texture::LoadPriority::Visible);
+    ctx.residency.markUsed(instance.textureId, ctx.absoluteFrame);
+  }
+  previousLodLevels.swap(lodLevels);
+  lodLevels.clear();
+
+  ctx.stats.views = views.size();
+  ctx.stats.visibleInstances = instances.size();
+  ctx.stats.triangles = triangles;
+  ctx.stats.cullTime = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+}
+
+uint32_t draw::DrawLists::selectLod(FrameContext &ctx,
+                                   const mesh::MeshDescriptor &descriptor,
+                                   float projectedRadius, uint32_t objectId) {
+  // Coarsest level whose error in pixels is at most limit
+  auto coarsest = [&](float limit) {
+    uint32_t level = 0;
+    while (level < descriptor.lodCount &&
+           descriptor.lodErrors[level] * projectedRadius <= limit) {
+      level++;
+    }
+    return level;
+  };
+
+  uint32_t level = coarsest(lodPixelError);
+  if (objectId == 0)
+    return level;
+
+  auto previous = previousLodLevels.find(objectId);
+  if (previous != previousLodLevels.end()) {
+    // The previous level stays while it is inside the band
+    level = glm::clamp(previous->second,
+                       coarsest(lodPixelError * (1.0f - lodHysteresis)),
+                       coarsest(lodPixelError * (1.0f + lodHysteresis)));
+    if (level != previous->second) {
+      ctx.stats.lodSwitches++;
+    }
+  }
+  lodLevels[objectId] = level;
+  return level;
+}
+
+void draw::DrawLists::addVirtualSprites(FrameContext &ctx) {
+  ctx.stats.virtualPages = 0;
+  auto sprites = ctx.draw.view<VirtualSprite>();
+  if (sprites.empty())
+    return;
+
+  auto &virtualTextures = ctx.virtualTextures;
+  mesh::MeshHandle quad = ctx.spriteTable.getQuad(ctx.meshLibrary);
+  // Room is left for the pages being read and the ancestors drawn meanwhile
+  uint32_t budget = virtualTextures.getSlotCount() * 3 / 4;
+  uint32_t pageCount = 0;
+  for (auto [entity, sprite] : sprites.each()) {
+    const auto *image = virtualTextures.get(sprite.imageId);
+    if (image == nullptr || image->state != ResourceState::Ready)
+      continue;
+    const auto *world = ctx.draw.try_get<WorldPosition>(entity);
+    glm::dvec3 position =
+        world != nullptr ? world->position : glm::dvec3(0.0);
+    // Pages are picked in render space, their instances are rebased with
+    // the others
+    glm::mat4 transform = sprite.transform;
+    transform[3] += glm::vec4(glm::vec3(position - renderOrigin), 0.0f);
+    glm::vec2 size = glm::vec2(image->width, image->height);
+
+    glm::vec2 visibleMin{1.0f};
+    glm::vec2 visibleMax{0.0f};
+    float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                           glm::length(glm::vec3(transform[1])));
+    glm::mat4 inverse = glm::inverse(transform);
+    virtualViews.clear();
+    for (const auto &list : views) {
+      glm::vec2 uvMin, uvMax;
+      if (!clipSprite(list.frustum, transform, size, uvMin, uvMax))
+        continue;
+      visibleMin = glm::min(visibleMin, uvMin);
+      visibleMax = glm::max(visibleMax, uvMax);
+      virtualViews.push_back(texture::VirtualView{
+          list.eye, glm::vec3(inverse * glm::vec4(list.eye, 1.0f)),
+          scale * list.pixelScale, list.perspective});
+    }
+    if (virtualViews.empty())
+      continue;
+
+    virtualPages.clear();
+    pageCount += virtualTextures.selectPages(
+        sprite.imageId, transform, visibleMin, visibleMax, virtualViews,
+        budget > pageCount ? budget - pageCount : 0, ctx.absoluteFrame,
+        virtualPages);
+    for (const auto &page : virtualPages) {
+      glm::vec2 offset = glm::vec2(page.imageRect);
+      glm::vec2 extent = glm::vec2(page.imageRect.z, page.imageRect.w);
+      // The unit quad has y up, the image y down
+      glm::vec2 center =
+          (offset + extent * 0.5f - 0.5f) * size * glm::vec2(1.0f, -1.0f);
+      instances.push_back(Instance{quad, virtualTextures.getCacheTexture(),
+                                   sprite.color, page.cacheRect,
+                                   extent * size});
+      transforms.push_back(sprite.transform *
+                           glm::translate(glm::mat4(1.0f),
+                                          glm::vec3(center, 0.0f)));
+      worldPositions.push_back(position);
+      objectIds.push_back(0);
+      bounds.push_back(glm::vec4(-1.0f));
+    }
+  }
+  ctx.stats.virtualPages = pageCount;
+}
+
+void draw::DrawLists::addTexts(FrameContext &ctx) {
+  ctx.stats.textGlyphs = 0;
+  ctx.stats.missingGlyphs = 0;
+  auto texts = ctx.draw.view<Text>();
+  if (texts.empty())
+    return;
+
+  mesh::MeshHandle quad = ctx.spriteTable.getQuad(ctx.meshLibrary);
+  texture::TextureHandle cacheTexture = ctx.glyphs.getCacheTexture();
+  for (auto [entity, text] : texts.each()) {
+    const auto *world = ctx.draw.try_get<WorldPosition>(entity);
+    glm::dvec3 position =
+        world != nullptr ? world->position : glm::dvec3(0.0);
+    placedGlyphs.clear();
+    ctx.stats.missingGlyphs +=
+        text::layoutText(ctx.glyphs, text.fontId, text.text,
+                         ctx.absoluteFrame, placedGlyphs);
+    for (const auto &glyph : placedGlyphs) {
+      glm::vec2 extent = glm::vec2(glyph.quad.z, glyph.quad.w);
+      glm::vec2 center = glm::vec2(glyph.quad) + extent * 0.5f;
+      instances.push_back(Instance{quad, cacheTexture, text.color,
+                                   glyph.cacheRect, extent * text.size});
+      instances.back().distanceField = true;
+      transforms.push_back(
+          text.transform *
+          glm::translate(glm::mat4(1.0f),
+                         glm::vec3(center * text.size, 0.0f)));
+      worldPositions.push_back(position);
+      objectIds.push_back(0);
+      bounds.push_back(glm::vec4(-1.0f));
+    }
+    ctx.stats.textGlyphs += placedGlyphs.size();
+  }
+}
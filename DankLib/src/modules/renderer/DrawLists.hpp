@@ -0,0 +1,103 @@
+#pragma once
+
+#include "modules/FrameContext.hpp"
+#include "modules/renderer/Renderer.hpp"
+#include "modules/scene/Camera.hpp"
+#include "modules/scene/Frustrum.h"
+#include <unordered_map>
+#include <vector>
+
+namespace dank {
+namespace draw {
+
+const uint32_t MAX_VIEWS = 8;
+// Instance::transientVertices of instances using their mesh's vertices
+const uint32_t NO_TRANSIENT_VERTICES = UINT32_MAX;
+
+// draw::Mesh or draw::Sprite resolved to what the renderer needs, sprites
+// point at the shared unit quad and carry their size and uv rectangle
+struct Instance {
+  mesh::MeshHandle meshId{};
+  texture::TextureHandle textureId{};
+  glm::vec4 color{1.0f};
+  glm::vec4 uvRect{0.0f, 0.0f, 1.0f, 1.0f};
+  glm::vec2 size{1.0f};
+  // Start of the instance's vertices in ctx.transientGeometry and its
+  // indices there, an empty index span draws the mesh's indices. See
+  // draw::TransientGeometry.
+  uint32_t transientVertices = NO_TRANSIENT_VERTICES;
+  mesh::TransientSpan transientIndices{};
+  // Samples the texture as a distance field, for glyphs of draw::Text
+  bool distanceField = false;
+};
+
+struct ViewList {
+  // Index of the camera passed to DrawLists::build
+  uint32_t camera = 0;
+  texture::TextureHandle renderTarget{};
+  // Translation from render space into the camera's own origin
+  glm::vec3 originOffset{0.0f};
+  Frustum frustum{};
+  // Camera position in render space and pixels per unit of radius at unit
+  // distance (perspective) or at any distance (orthographic), for LODs
+  glm::vec3 eye{0.0f};
+  float pixelScale = 0;
+  bool perspective = false;
+  // Indices into DrawLists::instances
+  std::vector<uint32_t> instances{};
+};
+
+// Culls ctx.draw once for all cameras. Every mesh is transformed and tested
+// against the union of the view frusta a single time, then distributed into
+// per-view lists that share the same visible instances.
+//
+// Meshes with LODs get the coarsest level whose error, projected with the
+// largest size the mesh has in any view, stays under lodPixelError pixels.
+// Objects with an id keep their previous level until the projected error
+// leaves a band of lodHysteresis around the limit, so they do not flicker
+// between levels at the boundary.
+//
+// Virtual sprites are clipped against the views and drawn with the pages
+// VirtualTextures::selectPages() picks for the visible part, the pages of
+// all virtual sprites fit in 3/4 of the page cache. Texts become a quad of
+// the glyph cache for each glyph text::layoutText() places.
+//
+// Transforms are camera-relative: they are rebased in one batched pass
+// against renderOrigin (the origin of the first view) before being narrowed
+// to float, so jitter does not grow with the distance to the world origin.
+class DrawLists {
+private:
+  std::vector<glm::dvec3> worldPositions{};
+  std::vector<uint32_t> objectIds{};
+  // Bounding sphere replacing the mesh's, a negative radius keeps it
+  std::vector<glm::vec4> bounds{};
+  // LOD level of every object id, this frame and the last
+  std::unordered_map<uint32_t, uint32_t> lodLevels{};
+  std::unordered_map<uint32_t, uint32_t> previousLodLevels{};
+
+  // Per sprite or text, kept for their capacity
+  std::vector<texture::VirtualView> virtualViews{};
+  std::vector<texture::VirtualPage> virtualPages{};
+  std::vector<text::PlacedGlyph> placedGlyphs{};
+
+  uint32_t selectLod(FrameContext &ctx, const mesh::MeshDescriptor &descriptor,
+                     float projectedRadius, uint32_t objectId);
+  void addVirtualSprites(FrameContext &ctx);
+  void addTexts(FrameContext &ctx);
+
+public:
+  // Largest allowed LOD error on screen, in pixels
+  float lodPixelError = 1.0f;
+  // Relative width of the band around lodPixelError
+  float lodHysteresis = 0.25f;
+  glm::dvec3 renderOrigin{0.0};
+  std::vector<Instance> instances{};
+  // Rebased transform of each instance
+  std::vector<glm::mat4> transforms{};
+  std::vector<ViewList> views{};
+
+  void build(FrameContext &ctx, const std::vector<Camera> &cameras);
+};
+
+} // namespace draw
+} // namespace dank
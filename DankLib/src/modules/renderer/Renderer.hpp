@@ -15,7 +15,17 @@ struct InstanceData {
   glm::vec4 color;
   uint32_t bufferIndex{0};
   uint32_t textureIndex{0};
-  glm::vec2 _pad;
+  // mesh::VertexFormat and dequantization scale of the mesh
+  uint32_t vertexFormat{0};
+  float positionScale{1.0f};
+  // Texture rectangle as offset (xy) and scale (zw) applied to the mesh uvs
+  glm::vec4 uvRect{0.0f, 0.0f, 1.0f, 1.0f};
+  // Scales the mesh positions, the sprite size for sprites
+  glm::vec2 size{1.0f};
+  // 1 when the texture's red channel is a signed distance field, see
+  // text::GlyphAtlas
+  float distanceField{0.0f};
+  float _pad{0.0f};
 };
 } // namespace instance
 
@@ -23,8 +33,74 @@ namespace draw {
 struct Mesh {
   glm::mat4 transform;
   glm::vec4 color;
-  uint32_t meshId{0};
-  uint32_t textureId{0};
+  mesh::MeshHandle meshId{};
+  texture::TextureHandle textureId{};
+  // Identifies the object across frames so its LOD level is kept inside
+  // the hysteresis band, 0 selects the level without any history
+  uint32_t objectId = 0;
+};
+
+// Entry of ctx.spriteTable drawn with the shared unit quad
+struct Sprite {
+  glm::mat4 transform;
+  glm::vec4 color;
+  mesh::SpriteHandle spriteId{};
+  texture::TextureHandle textureId{};
+};
+
+// Image of ctx.virtualTextures drawn with the shared unit quad, one texel
+// per unit. Only the pages the views need are drawn, each as its own quad
+// of the page cache at the level its size on screen asks for.
+struct VirtualSprite {
+  glm::mat4 transform;
+  glm::vec4 color;
+  texture::VirtualImageHandle imageId{};
+};
+
+// UTF-8 text drawn with glyphs of ctx.glyphs, a quad each. size is the em
+// in units of the transform, the origin is the pen on the first baseline
+// and '\n' starts a new line below. Glyphs still being rasterized are left
+// out until they are resident.
+struct Text {
+  glm::mat4 transform;
+  glm::vec4 color;
+  text::FontHandle fontId{};
+  std::string text{};
+  float size = 1.0f;
+};
+
+// Skeleton posed with a clip at a time, both owned by the caller. Turned
+// into a draw::Mesh with draw::TransientGeometry on the same entity by
+// animation::skinMeshes before the draw lists are built.
+struct SkinnedMesh {
+  glm::mat4 transform;
+  glm::vec4 color;
+  animation::SkeletonHandle skeletonId{};
+  texture::TextureHandle textureId{};
+  uint32_t clip = 0;
+  // Seconds
+  float time = 0;
+};
+
+// Optional, draws a draw::Mesh with spans of ctx.transientGeometry instead
+// of its mesh's geometry. Without an index span the indices of meshId are
+// used, so the vertices have to match its layout; with one, meshId may be
+// left invalid. The bounds replace the mesh's for culling, a zero radius
+// is never culled. Only valid for the frame the spans were allocated in.
+struct TransientGeometry {
+  mesh::TransientSpan vertices{};
+  mesh::TransientSpan indices{};
+  glm::vec3 boundsCenter{0.0f};
+  float boundsRadius = 0;
+};
+
+// Optional double precision position of a draw::Mesh, draw::Sprite,
+// draw::VirtualSprite or draw::Text. When present the mesh transform is
+// relative to it, and both are rebased against the camera origin before
+// being narrowed to float, so precision does not degrade far away from the
+// world origin.
+struct WorldPosition {
+  glm::dvec3 position{0.0};
 };
 
 } // namespace draw
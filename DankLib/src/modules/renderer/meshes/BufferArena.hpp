@@ -0,0 +1,183 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+
+struct BufferRange {
+  uint32_t offset = 0;
+  uint32_t count = 0;
+};
+
+// CPU shadow of a GPU buffer that only grows at the end, reuses released
+// ranges through a free list and records which ranges changed since the
+// last upload. Offsets and counts are in elements of T.
+//
+// A fixed capacity arena allocates its storage once and fails allocations
+// that do not fit instead of growing, so its GPU copy never moves.
+template <typename T> class BufferArena {
+private:
+  std::vector<T> data{};
+  uint32_t limit = UINT32_MAX;
+  // offset -> count, kept coalesced
+  std::map<uint32_t, uint32_t> freeRanges{};
+  std::vector<BufferRange> dirtyRanges{};
+  uint32_t top = 0;
+  uint32_t freeCount = 0;
+
+  static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+
+  void insertFree(BufferRange range) {
+    freeCount += range.count;
+    auto next = freeRanges.lower_bound(range.offset);
+    if (next != freeRanges.end() &&
+        range.offset + range.count == next->first) {
+      range.count += next->second;
+      next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == range.offset) {
+        prev->second += range.count;
+        return;
+      }
+    }
+    freeRanges[range.offset] = range.count;
+  }
+
+  // First fit below limit, splitting off the alignment padding and the rest
+  bool takeFree(uint32_t limit, uint32_t count, uint32_t alignment,
+                uint32_t &output) {
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+      if (it->first >= limit)
+        return false;
+      uint32_t start = it->first;
+      uint32_t end = it->first + it->second;
+      uint32_t aligned = alignUp(start, alignment);
+      if (aligned + count > end)
+        continue;
+
+      freeRanges.erase(it);
+      freeCount -= end - start;
+      if (aligned > start) {
+        insertFree({start, aligned - start});
+      }
+      if (aligned + count < end) {
+        insertFree({aligned + count, end - aligned - count});
+      }
+      output = aligned;
+      return true;
+    }
+    return false;
+  }
+
+public:
+  static const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+  BufferArena() = default;
+  explicit BufferArena(uint32_t capacity) : data(capacity), limit(capacity) {}
+
+  // alignment must be a power of two. Returns INVALID_OFFSET when a fixed
+  // capacity arena is full.
+  uint32_t allocate(uint32_t count, uint32_t alignment = 1) {
+    uint32_t offset;
+    if (takeFree(UINT32_MAX, count, alignment, offset))
+      return offset;
+
+    offset = alignUp(top, alignment);
+    if (static_cast<uint64_t>(offset) + count > limit)
+      return INVALID_OFFSET;
+    if (offset > top) {
+      // Keep the padding usable for smaller alignments
+      insertFree({top, offset - top});
+    }
+    top = offset + count;
+    if (top > data.size()) {
+      data.resize(std::min<size_t>(std::max<size_t>(top, data.size() * 2),
+                                   limit));
+    }
+    return offset;
+  }
+
+  void release(BufferRange range) {
+    if (range.count == 0)
+      return;
+
+    // Give the tail back instead of keeping a free range at the end
+    if (range.offset + range.count == top) {
+      top = range.offset;
+      if (!freeRanges.empty()) {
+        auto last = std::prev(freeRanges.end());
+        if (last->first + last->second == top) {
+          top = last->first;
+          freeCount -= last->second;
+          freeRanges.erase(last);
+        }
+      }
+      return;
+    }
+
+    insertFree(range);
+  }
+
+  void write(uint32_t offset, const T *source, uint32_t count) {
+    std::copy(source, source + count, data.begin() + offset);
+    markDirty({offset, count});
+  }
+
+  void move(BufferRange from, uint32_t to) {
+    std::copy(data.begin() + from.offset,
+              data.begin() + from.offset + from.count, data.begin() + to);
+    markDirty({to, from.count});
+  }
+
+  void markDirty(BufferRange range) {
+    if (!dirtyRanges.empty()) {
+      auto &last = dirtyRanges.back();
+      if (last.offset + last.count == range.offset) {
+        last.count += range.count;
+        return;
+      }
+    }
+    dirtyRanges.push_back(range);
+  }
+
+  void clear() {
+    freeRanges.clear();
+    dirtyRanges.clear();
+    top = 0;
+    freeCount = 0;
+  }
+
+  void clearDirty() { dirtyRanges.clear(); }
+
+  // Allocates from the first free range below offset that can hold count
+  // elements, used to move allocations down when compacting
+  bool allocateBelow(uint32_t offset, uint32_t count, uint32_t alignment,
+                     uint32_t &output) {
+    return takeFree(offset, count, alignment, output);
+  }
+
+  const T *getData() const { return data.data(); }
+  const std::vector<BufferRange> &getDirtyRanges() const {
+    return dirtyRanges;
+  }
+  // Elements in use up to the highest allocation, including free holes
+  uint32_t getSize() const { return top; }
+  uint32_t getCapacity() const { return data.size(); }
+  bool isEmpty() const { return top == 0; }
+  uint32_t getFreeCount() const { return freeCount; }
+
+  // Share of the used range that is lost to free holes
+  float getFragmentation() const {
+    return top > 0 ? static_cast<float>(freeCount) / top : 0.0f;
+  }
+};
+
+} // namespace mesh
+} // namespace dank
@@ -0,0 +1,45 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/os/OS.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/meshes/MeshFile.hpp"
+
+namespace dank {
+
+namespace mesh {
+
+// Mesh loaded from a binary mesh file, see MeshFile.hpp. The file already
+// holds VertexData and indices as MeshLibrary stores them, so loading costs
+// the read and a copy.
+class FileMesh : public Mesh {
+public:
+  URI uri;
+  FileMesh(URI uri) : Mesh(), uri(uri) {}
+
+  void getData(MeshData &output) override {
+    ResourceData resourceData{};
+    dank::os->getDataFromURI(uri, resourceData);
+
+    MeshFileHeader header{};
+    if (resourceData.size <= 0 ||
+        !readMeshFileHeader(resourceData.data, resourceData.size, header)) {
+      dank::console::warn("[FileMesh] invalid mesh file %s",
+                          uri.path.c_str());
+      if (resourceData.data != nullptr) {
+        free(resourceData.data);
+      }
+      return;
+    }
+
+    if (!readMeshFile(resourceData.data, header, output)) {
+      dank::console::warn("[FileMesh] index out of range in %s",
+                          uri.path.c_str());
+    }
+    free(resourceData.data);
+  }
+};
+
+} // namespace mesh
+
+} // namespace dank
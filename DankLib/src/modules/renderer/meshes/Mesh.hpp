@@ -1,104 +1,586 @@
 #pragma once
 #include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/os/JobSystem.hpp"
+#include "modules/renderer/meshes/BufferArena.hpp"
+#include "modules/renderer/meshes/MeshOptimizer.hpp"
+#include "modules/renderer/meshes/MeshSimplifier.hpp"
+#include "modules/renderer/meshes/VertexFormat.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
 
 namespace dank {
 namespace mesh {
 
-struct VertexData {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec2 uv;
-};
-
 struct MeshData {
+  // Storage layout the mesh would like, MeshLibrary falls back to a wider
+  // one when the vertices do not fit it
+  VertexFormat format = VertexFormat::Standard;
   std::vector<VertexData> vertices;
   std::vector<uint32_t> indices;
+  // Precomputed bounding sphere, e.g. stored in a mesh file, saves MeshLibrary
+  // a pass over the vertices
+  bool hasBounds = false;
+  glm::vec3 boundsCenter{0.0f};
+  float boundsRadius = 0;
 };
 
+// Width of a mesh's indices, values match MTL::IndexType
+enum class IndexType : uint32_t { UInt16 = 0, UInt32 = 1 };
+
+inline uint32_t getIndexSize(IndexType type) {
+  return type == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
 class Mesh {
 public:
   virtual void getData(MeshData &output) = 0;
   virtual ~Mesh() = default;
 };
 
+// Geometry computed at runtime, e.g. the levels made by generateLods
+class DataMesh : public Mesh {
+public:
+  MeshData data{};
+
+  explicit DataMesh(MeshData data) : data(std::move(data)) {}
+
+  void getData(MeshData &output) override { output = data; }
+};
+
+struct MeshHandleTag;
+typedef Handle<MeshHandleTag> MeshHandle;
+
+// Simplified levels a mesh can have on top of itself
+const uint32_t MAX_MESH_LODS = 4;
+
 struct MeshDescriptor {
   Mesh *mesh = nullptr;
+  // Page holding the vertices and indices, also the vertex buffer slot
   uint32_t bufferIndex = 0;
+  VertexFormat vertexFormat = VertexFormat::Standard;
+  uint32_t vertexStride = sizeof(VertexData);
+  // Dequantization scale of VertexFormat::Quantized positions
+  float positionScale = 1.0f;
+  // In bytes, a multiple of vertexStride
   uint32_t vertexOffset = 0;
   uint32_t vertexCount = 0;
+  IndexType indexType = IndexType::UInt32;
+  // In bytes, a multiple of 4
   uint32_t indexOffset = 0;
   uint32_t indexCount = 0;
+  // Bounding sphere in model space, a zero radius disables culling
+  glm::vec3 boundsCenter{0.0f};
+  float boundsRadius = 0;
+  // Simplified levels, coarsest last, each a mesh of its own owned by this
+  // one. Errors are relative to boundsRadius, see MeshLibrary::generateLods.
+  uint32_t lodCount = 0;
+  MeshHandle lods[MAX_MESH_LODS]{};
+  float lodErrors[MAX_MESH_LODS]{};
 };
 
-struct MeshLibraryData {
-  std::vector<VertexData> vbo{};
-  std::vector<uint32_t> ibo{};
+// Vertex buffer array in VertexShaderArguments has 16 slots, the last one
+// holds the per frame vertices, see TransientGeometry.hpp
+const uint32_t MAX_MESH_PAGES = 15;
 
-  uint32_t vertexDataSize = 0;
-  uint32_t indexDataSize = 0;
+// Fixed capacity vertex and index storage, one GPU buffer each. A mesh
+// always lives in a single page.
+struct MeshPage {
+  BufferArena<uint8_t> vertices;
+  BufferArena<uint8_t> indices;
 };
 
+// Owns every mesh and packs their geometry into fixed size pages. New
+// meshes go to the first page with room, a full library opens a new page
+// instead of growing one, so existing geometry is never copied and the
+// total size is not bound by a single buffer. Adding or removing a mesh only
+// touches its own ranges, which are reported as dirty so the renderer
+// uploads just the changed bytes.
 class MeshLibrary {
 private:
-  std::map<uint32_t, MeshDescriptor> descriptors{};
-  uint32_t nextId = 1;
+  struct PendingOptimization {
+    MeshHandle handle{};
+    MeshData data{};
+    OptimizeReport report{};
+  };
+
+  struct PendingLods {
+    MeshHandle handle{};
+    std::vector<MeshData> levels{};
+    std::vector<float> errors{};
+    double milliseconds = 0;
+  };
+
+  // Ranges of a mesh that was removed, replaced or moved, see
+  // releaseRetired()
+  struct RetiredRanges {
+    uint32_t bufferIndex = 0;
+    BufferRange vertices{};
+    BufferRange indices{};
+    uint32_t frame = 0;
+  };
+
+  // Shared with the jobs so they can finish after the library is gone
+  struct FinishedJobs {
+    std::mutex mutex{};
+    std::vector<std::shared_ptr<PendingOptimization>> optimized{};
+    std::vector<std::shared_ptr<PendingLods>> lods{};
+  };
+
+  SlotMap<MeshDescriptor, MeshHandleTag> descriptors{};
+  std::vector<MeshPage> pages{};
+  std::vector<uint8_t> encoded{};
+  std::vector<uint16_t> encoded16{};
+  std::shared_ptr<FinishedJobs> finished = std::make_shared<FinishedJobs>();
+  std::vector<RetiredRanges> retired{};
+  uint32_t frame = 0;
+  // Counts ranges taken from and given back to the arenas, compact() skips
+  // its pass while it is where the last pass that moved nothing left it
+  uint32_t arenaChanges = 0;
+  uint32_t idleArenaChanges = UINT32_MAX;
 
 public:
+  // Share of free holes above which compact() starts moving meshes
+  float compactionThreshold = 0.25f;
+  // Capacity of new pages in bytes, meshes larger than a page get a page of
+  // their own sized to fit
+  uint32_t vertexPageSize = 8 * 1024 * 1024;
+  uint32_t indexPageSize = 4 * 1024 * 1024;
   size_t lastModified = 0;
+  // Bumped by clear(), the pages of the next meshes start over while frames
+  // in flight may still draw from the old ones
+  uint32_t clearCount = 0;
 
-  ~MeshLibrary() {
-    for (auto &entry : descriptors) {
-      delete entry.second.mesh;
-    }
-  }
+  ~MeshLibrary() { clear(); }
 
-  uint32_t add(Mesh *mesh) {
+  MeshHandle add(Mesh *mesh) {
     MeshDescriptor descriptor{};
     descriptor.mesh = mesh;
-    descriptors[nextId] = descriptor;
-    nextId++;
+
+    MeshData md{};
+    mesh->getData(md);
+    if (!store(descriptor, md)) {
+      console::warn("[MeshLibrary] out of pages, mesh with %d vertices "
+                    "dropped",
+                    static_cast<int>(md.vertices.size()));
+      delete mesh;
+      return MeshHandle{};
+    }
+
+    lastModified++;
+    return descriptors.insert(descriptor);
+  }
+
+  // Optimizes the mesh on a worker thread, the result replaces its geometry
+  // in applyOptimized() and the handle stays the same
+  void optimize(const MeshHandle handle, JobSystem &jobs,
+                OptimizeOptions options = {}) {
+    const MeshDescriptor *descriptor = descriptors.get(handle);
+    if (descriptor == nullptr)
+      return;
+
+    auto pending = std::make_shared<PendingOptimization>();
+    pending->handle = handle;
+    descriptor->mesh->getData(pending->data);
+
+    std::shared_ptr<FinishedJobs> results = finished;
+    jobs.submit([pending, options, results]() {
+      pending->report = optimizeMesh(pending->data, options);
+      std::lock_guard<std::mutex> lock(results->mutex);
+      results->optimized.push_back(pending);
+    });
+  }
+
+  // Simplifies the mesh into up to options.levels coarser levels on a
+  // worker thread, each one a fraction of the triangles of the one before.
+  // They are added in applyLods() and replace any levels the mesh had.
+  void generateLods(const MeshHandle handle, JobSystem &jobs,
+                    LodOptions options = {}) {
+    const MeshDescriptor *descriptor = descriptors.get(handle);
+    if (descriptor == nullptr)
+      return;
+
+    auto pending = std::make_shared<PendingLods>();
+    pending->handle = handle;
+    auto base = std::make_shared<MeshData>();
+    descriptor->mesh->getData(*base);
+
+    std::shared_ptr<FinishedJobs> results = finished;
+    jobs.submit([pending, base, options, results]() {
+      auto start = std::chrono::steady_clock::now();
+      uint32_t levels = std::min(options.levels, MAX_MESH_LODS);
+      size_t previousCount = base->indices.size();
+      for (uint32_t level = 0; level < levels; level++) {
+        // Always simplified from the full mesh so the error is measured
+        // against it and does not pile up from level to level
+        MeshData data = *base;
+        uint32_t target = previousCount * options.reduction;
+        float error = simplifyMesh(data, target, options.maxError);
+        // Stuck on the error bound or the topology
+        if (data.indices.empty() ||
+            data.indices.size() > previousCount * 0.9f)
+          break;
+        if (options.optimize) {
+          OptimizeOptions optimizeOptions{};
+          optimizeOptions.overdraw = false;
+          optimizeMesh(data, optimizeOptions);
+        }
+        previousCount = data.indices.size();
+        pending->levels.push_back(std::move(data));
+        pending->errors.push_back(error);
+      }
+      pending->milliseconds = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+      std::lock_guard<std::mutex> lock(results->mutex);
+      results->lods.push_back(pending);
+    });
+  }
+
+  // Called once per frame on the main thread
+  void applyOptimized() {
+    std::vector<std::shared_ptr<PendingOptimization>> done{};
+    {
+      std::lock_guard<std::mutex> lock(finished->mutex);
+      done.swap(finished->optimized);
+    }
+
+    for (const auto &pending : done) {
+      MeshDescriptor *descriptor = descriptors.get(pending->handle);
+      if (descriptor == nullptr)
+        continue;
+      // Stored next to the old geometry first so a failure keeps the mesh
+      MeshDescriptor optimizedDescriptor = *descriptor;
+      if (!store(optimizedDescriptor, pending->data))
+        continue;
+      releaseRanges(*descriptor);
+      *descriptor = optimizedDescriptor;
+      lastModified++;
+
+      const OptimizeReport &report = pending->report;
+      console::log("[MeshLibrary] optimized mesh %d in %.2fms | ACMR %.3f -> "
+                   "%.3f | ATVR %.3f -> %.3f",
+                   pending->handle.index, report.milliseconds,
+                   report.acmrBefore, report.acmrAfter, report.atvrBefore,
+                   report.atvrAfter);
+    }
+  }
+
+  // Called once per frame on the main thread
+  void applyLods() {
+    std::vector<std::shared_ptr<PendingLods>> done{};
+    {
+      std::lock_guard<std::mutex> lock(finished->mutex);
+      done.swap(finished->lods);
+    }
+
+    for (const auto &pending : done) {
+      if (descriptors.get(pending->handle) == nullptr)
+        continue;
+      removeLods(pending->handle);
+
+      MeshHandle lods[MAX_MESH_LODS]{};
+      uint32_t lodCount = 0;
+      for (auto &data : pending->levels) {
+        MeshHandle lod = add(new DataMesh(std::move(data)));
+        if (!lod.isValid())
+          break;
+        lods[lodCount++] = lod;
+      }
+
+      // Looked up again, adding may have moved the descriptors
+      MeshDescriptor *descriptor = descriptors.get(pending->handle);
+      descriptor->lodCount = lodCount;
+      for (uint32_t i = 0; i < lodCount; i++) {
+        descriptor->lods[i] = lods[i];
+        descriptor->lodErrors[i] = pending->errors[i];
+        const MeshDescriptor *level = descriptors.get(lods[i]);
+        console::log("[MeshLibrary] mesh %d lod %d: %d triangles, error %.4f",
+                     pending->handle.index, i + 1, level->indexCount / 3,
+                     pending->errors[i]);
+      }
+      console::log("[MeshLibrary] mesh %d: %d lods in %.2fms",
+                   pending->handle.index, lodCount, pending->milliseconds);
+    }
+  }
+
+  void remove(const MeshHandle handle) {
+    const MeshDescriptor *descriptor = descriptors.get(handle);
+    if (descriptor == nullptr)
+      return;
+    if (descriptor->lodCount > 0) {
+      removeLods(handle);
+      descriptor = descriptors.get(handle);
+    }
+    releaseRanges(*descriptor);
+    delete descriptor->mesh;
+    descriptors.remove(handle);
     lastModified++;
-    return nextId - 1;
   }
 
+  // Handles given out before a clear are detected as stale afterwards
   void clear() {
-    nextId = 1;
+    for (auto &descriptor : descriptors) {
+      delete descriptor.mesh;
+    }
     descriptors.clear();
+    pages.clear();
+    retired.clear();
+    clearCount++;
+    lastModified++;
+  }
+
+  // Called once per frame on the main thread. The renderer copies dirty
+  // ranges straight into the page buffers, so ranges given up by a mesh
+  // only go back to the arenas once the frames in flight that may still
+  // draw it have finished.
+  void releaseRetired(uint32_t currentFrame) {
+    frame = currentFrame;
+    size_t kept = 0;
+    for (const auto &ranges : retired) {
+      if (ranges.frame + FRAMES_IN_FLIGHT > frame) {
+        retired[kept++] = ranges;
+        continue;
+      }
+      MeshPage &page = pages[ranges.bufferIndex];
+      page.vertices.release(ranges.vertices);
+      page.indices.release(ranges.indices);
+      arenaChanges++;
+    }
+    retired.resize(kept);
+  }
+
+  // nullptr when the handle is stale
+  const MeshDescriptor *get(const MeshHandle handle) const {
+    return descriptors.get(handle);
+  };
+
+  uint32_t getPageCount() const { return pages.size(); }
+  const MeshPage &getPage(uint32_t index) const { return pages[index]; }
+
+  // Called once the renderer uploaded every dirty range
+  void clearDirty() {
+    for (auto &page : pages) {
+      page.vertices.clearDirty();
+      page.indices.clearDirty();
+    }
+  }
+
+  // Incremental defragmentation, moves at most maxMoves meshes per call
+  // into free holes below them so the arenas can shrink back from the top.
+  // Meant to run every frame with a small budget.
+  void compact(uint32_t maxMoves) {
+    if (arenaChanges == idleArenaChanges)
+      return;
+    uint32_t moves = 0;
+    for (uint32_t p = 0; p < pages.size() && moves < maxMoves; p++) {
+      MeshPage &page = pages[p];
+      if (page.vertices.getFragmentation() >= compactionThreshold) {
+        moves += compactArena(
+            page.vertices, p, &MeshDescriptor::vertexOffset,
+            &RetiredRanges::vertices,
+            [](const MeshDescriptor &d) {
+              return RangeLayout{d.vertexCount * d.vertexStride,
+                                 d.vertexStride};
+            },
+            maxMoves - moves);
+      }
+      if (page.indices.getFragmentation() >= compactionThreshold) {
+        moves += compactArena(
+            page.indices, p, &MeshDescriptor::indexOffset,
+            &RetiredRanges::indices,
+            [](const MeshDescriptor &d) {
+              return RangeLayout{getIndexBytes(d), 4};
+            },
+            maxMoves - moves);
+      }
+    }
+    if (moves > 0) {
+      lastModified++;
+    } else {
+      idleArenaChanges = arenaChanges;
+    }
+  }
+
+private:
+  void removeLods(const MeshHandle handle) {
+    MeshDescriptor *descriptor = descriptors.get(handle);
+    MeshHandle lods[MAX_MESH_LODS]{};
+    uint32_t lodCount = descriptor->lodCount;
+    std::copy(descriptor->lods, descriptor->lods + lodCount, lods);
+    descriptor->lodCount = 0;
+    for (uint32_t i = 0; i < lodCount; i++) {
+      remove(lods[i]);
+    }
+  }
+
+  // Encodes md into the first page with room for both its vertices and
+  // indices, opening a new page if needed. False when all pages are taken.
+  bool store(MeshDescriptor &descriptor, const MeshData &md) {
+    descriptor.vertexFormat = selectVertexFormat(md.format, md.vertices);
+    descriptor.vertexStride = getVertexStride(descriptor.vertexFormat);
+    if (descriptor.vertexFormat == VertexFormat::Quantized) {
+      descriptor.positionScale = getPositionScale(md.vertices);
+    }
+    encodeVertices(md.vertices, descriptor.vertexFormat,
+                   descriptor.positionScale, encoded);
+
+    descriptor.vertexCount = md.vertices.size();
+
+    // Indices stay local to the mesh, the renderer draws with the vertex
+    // offset as base vertex so meshes can move without being rewritten.
+    // That also means any mesh with at most 65536 vertices can use 16 bit
+    // indices, wherever it lands in the vertex arena.
+    descriptor.indexType = descriptor.vertexCount <= 65536
+                               ? IndexType::UInt16
+                               : IndexType::UInt32;
+    descriptor.indexCount = md.indices.size();
+    encodeIndices(md.indices, descriptor.indexType, encoded16);
+    uint32_t indexBytes = getIndexBytes(descriptor);
+
+    if (!allocate(descriptor, encoded.size(), indexBytes))
+      return false;
+
+    MeshPage &page = pages[descriptor.bufferIndex];
+    page.vertices.write(descriptor.vertexOffset, encoded.data(),
+                        encoded.size());
+    if (descriptor.indexType == IndexType::UInt16) {
+      page.indices.write(descriptor.indexOffset,
+                    reinterpret_cast<const uint8_t *>(encoded16.data()),
+                    indexBytes);
+    } else {
+      page.indices.write(descriptor.indexOffset,
+                         reinterpret_cast<const uint8_t *>(md.indices.data()),
+                         indexBytes);
+    }
+
+    if (md.hasBounds) {
+      descriptor.boundsCenter = md.boundsCenter;
+      descriptor.boundsRadius = md.boundsRadius;
+    } else if (!md.vertices.empty()) {
+      glm::vec3 min{std::numeric_limits<float>::max()};
+      glm::vec3 max{std::numeric_limits<float>::lowest()};
+      for (const auto &vertex : md.vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+      }
+      descriptor.boundsCenter = (min + max) * 0.5f;
+      descriptor.boundsRadius = glm::length(max - min) * 0.5f;
+    }
+    return true;
   }
 
-  const MeshDescriptor *get(const uint32_t id) const {
-    return &descriptors.at(id);
+  bool allocate(MeshDescriptor &descriptor, uint32_t vertexBytes,
+                uint32_t indexBytes) {
+    // Vertex ranges are aligned to their stride so the offset can be given
+    // to the draw as base vertex
+    for (uint32_t p = 0; p < pages.size(); p++) {
+      if (tryAllocate(p, descriptor, vertexBytes, indexBytes))
+        return true;
+    }
+
+    if (pages.size() >= MAX_MESH_PAGES)
+      return false;
+    pages.push_back(MeshPage{
+        BufferArena<uint8_t>(
+            std::max(vertexPageSize, vertexBytes + descriptor.vertexStride)),
+        BufferArena<uint8_t>(std::max(indexPageSize, indexBytes + 4))});
+    return tryAllocate(pages.size() - 1, descriptor, vertexBytes, indexBytes);
+  }
+
+  bool tryAllocate(uint32_t pageIndex, MeshDescriptor &descriptor,
+                   uint32_t vertexBytes, uint32_t indexBytes) {
+    MeshPage &page = pages[pageIndex];
+    uint32_t vertexOffset =
+        page.vertices.allocate(vertexBytes, descriptor.vertexStride);
+    if (vertexOffset == BufferArena<uint8_t>::INVALID_OFFSET)
+      return false;
+    uint32_t indexOffset = page.indices.allocate(indexBytes, 4);
+    if (indexOffset == BufferArena<uint8_t>::INVALID_OFFSET) {
+      page.vertices.release({vertexOffset, vertexBytes});
+      return false;
+    }
+    descriptor.bufferIndex = pageIndex;
+    descriptor.vertexOffset = vertexOffset;
+    descriptor.indexOffset = indexOffset;
+    arenaChanges++;
+    return true;
+  }
+
+  // Frames in flight may still draw from the ranges, see releaseRetired()
+  void releaseRanges(const MeshDescriptor &descriptor) {
+    retired.push_back(RetiredRanges{
+        descriptor.bufferIndex,
+        {descriptor.vertexOffset,
+         descriptor.vertexCount * descriptor.vertexStride},
+        {descriptor.indexOffset, getIndexBytes(descriptor)},
+        frame});
+  }
+
+  static uint32_t getIndexBytes(const MeshDescriptor &descriptor) {
+    return descriptor.indexCount * getIndexSize(descriptor.indexType);
+  }
+
+  static void encodeIndices(const std::vector<uint32_t> &input,
+                            IndexType type, std::vector<uint16_t> &output) {
+    output.clear();
+    if (type != IndexType::UInt16)
+      return;
+    output.reserve(input.size());
+    for (const auto index : input) {
+      output.push_back(static_cast<uint16_t>(index));
+    }
+  }
+
+  struct RangeLayout {
+    uint32_t size;
+    uint32_t alignment;
   };
 
-  void getData(MeshLibraryData &output) {
-    for (auto &entry : descriptors) {
-      MeshDescriptor *descriptor = &entry.second;
-
-      MeshData md{};
-      descriptor->mesh->getData(md);
-      
-      descriptor->bufferIndex = 0; // TODO: support multiple buffers
-
-      descriptor->vertexOffset = output.vbo.size();
-      descriptor->vertexCount = md.vertices.size();
-      descriptor->indexOffset = output.ibo.size();
-      descriptor->indexCount = md.indices.size();
-
-      // offset the indices based on the previous number of vertices
-      // for example:
-      // add triangle mesh (3 vertices), indices 0, 1, 2
-      // add rectangle mesh, indices offset by 3 (vertices) 3,4,5,5,6,3
-      size_t vertexOffset = output.vbo.size();
-      for (const auto index : md.indices) {
-        output.ibo.push_back(vertexOffset + index);
+  // layout returns the size and alignment of a descriptor's range, the
+  // ranges moved away from are retired as retiredRange
+  template <typename T, typename Layout>
+  uint32_t compactArena(BufferArena<T> &arena, uint32_t bufferIndex,
+                        uint32_t MeshDescriptor::*offset,
+                        BufferRange RetiredRanges::*retiredRange,
+                        Layout layout, uint32_t maxMoves) {
+    // Highest ranges first, they are the ones keeping the arena large
+    std::vector<MeshDescriptor *> sorted{};
+    for (auto &descriptor : descriptors) {
+      if (descriptor.bufferIndex == bufferIndex &&
+          layout(descriptor).size > 0) {
+        sorted.push_back(&descriptor);
       }
-      output.vbo.insert(output.vbo.end(), md.vertices.begin(),
-                        md.vertices.end());
     }
+    std::sort(sorted.begin(), sorted.end(),
+              [offset](const MeshDescriptor *a, const MeshDescriptor *b) {
+                return a->*offset > b->*offset;
+              });
 
-    output.vertexDataSize = output.vbo.size() * sizeof(VertexData);
-    output.indexDataSize = output.ibo.size() * sizeof(uint32_t);
+    uint32_t moves = 0;
+    for (auto *descriptor : sorted) {
+      if (moves >= maxMoves)
+        break;
+      RangeLayout range = layout(*descriptor);
+      BufferRange from{descriptor->*offset, range.size};
+      uint32_t target;
+      if (!arena.allocateBelow(from.offset, from.count, range.alignment,
+                               target))
+        continue;
+      arena.move(from, target);
+      RetiredRanges ranges{bufferIndex, {}, {}, frame};
+      ranges.*retiredRange = from;
+      retired.push_back(ranges);
+      descriptor->*offset = target;
+      arenaChanges++;
+      moves++;
+    }
+    return moves;
   }
 };
 
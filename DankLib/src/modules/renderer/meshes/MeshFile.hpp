@@ -0,0 +1,123 @@
+#pragma once
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+
+// Flat binary mesh, laid out so loading is two memcpy and no parsing:
+//
+//   MeshFileHeader
+//   VertexData[vertexCount]  at vertexOffset
+//   uint32_t[indexCount]     at indexOffset
+//
+// Offsets are in bytes from the start of the file and 16 byte aligned.
+// Everything is little endian. Written by tools/meshimport.
+const uint32_t MESH_FILE_MAGIC = 0x48534d44; // "DMSH"
+const uint32_t MESH_FILE_VERSION = 1;
+
+struct MeshFileHeader {
+  uint32_t magic = MESH_FILE_MAGIC;
+  uint32_t version = MESH_FILE_VERSION;
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t indexOffset = 0;
+  float boundsCenter[3] = {0, 0, 0};
+  float boundsRadius = 0;
+  uint32_t reserved[2] = {0, 0};
+};
+
+static_assert(sizeof(MeshFileHeader) == 48, "MeshFileHeader layout changed");
+static_assert(sizeof(VertexData) == 32, "VertexData layout changed");
+
+// Copies the header out of data and checks the ranges fit in size
+inline bool readMeshFileHeader(const void *data, size_t size,
+                               MeshFileHeader &header) {
+  if (data == nullptr || size < sizeof(MeshFileHeader))
+    return false;
+  memcpy(&header, data, sizeof(MeshFileHeader));
+  if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION)
+    return false;
+
+  uint64_t vertexEnd = static_cast<uint64_t>(header.vertexOffset) +
+                       static_cast<uint64_t>(header.vertexCount) *
+                           sizeof(VertexData);
+  uint64_t indexEnd = static_cast<uint64_t>(header.indexOffset) +
+                      static_cast<uint64_t>(header.indexCount) *
+                          sizeof(uint32_t);
+  return header.vertexOffset >= sizeof(MeshFileHeader) &&
+         header.indexOffset >= sizeof(MeshFileHeader) && vertexEnd <= size &&
+         indexEnd <= size && header.indexCount % 3 == 0;
+}
+
+// Copies the vertices and indices out of data, false and output left empty
+// when an index is out of range of the vertices
+inline bool readMeshFile(const void *data, const MeshFileHeader &header,
+                         MeshData &output) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  output.format = VertexFormat::Standard;
+  output.vertices.resize(header.vertexCount);
+  output.indices.resize(header.indexCount);
+  if (header.vertexCount > 0) {
+    memcpy(output.vertices.data(), bytes + header.vertexOffset,
+           header.vertexCount * sizeof(VertexData));
+  }
+  if (header.indexCount > 0) {
+    memcpy(output.indices.data(), bytes + header.indexOffset,
+           header.indexCount * sizeof(uint32_t));
+  }
+  for (const auto index : output.indices) {
+    if (index >= header.vertexCount) {
+      output.vertices.clear();
+      output.indices.clear();
+      return false;
+    }
+  }
+  output.hasBounds = true;
+  output.boundsCenter = glm::vec3(header.boundsCenter[0],
+                                  header.boundsCenter[1],
+                                  header.boundsCenter[2]);
+  output.boundsRadius = header.boundsRadius;
+  return true;
+}
+
+inline void writeMeshFile(const MeshData &input, std::vector<uint8_t> &output) {
+  MeshFileHeader header{};
+  header.vertexCount = input.vertices.size();
+  header.indexCount = input.indices.size();
+  header.vertexOffset = sizeof(MeshFileHeader);
+  header.indexOffset =
+      (header.vertexOffset + header.vertexCount * sizeof(VertexData) + 15) &
+      ~15u;
+
+  if (!input.vertices.empty()) {
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : input.vertices) {
+      min = glm::min(min, vertex.position);
+      max = glm::max(max, vertex.position);
+    }
+    glm::vec3 center = (min + max) * 0.5f;
+    header.boundsCenter[0] = center.x;
+    header.boundsCenter[1] = center.y;
+    header.boundsCenter[2] = center.z;
+    header.boundsRadius = glm::length(max - min) * 0.5f;
+  }
+
+  output.assign(header.indexOffset + header.indexCount * sizeof(uint32_t), 0);
+  memcpy(output.data(), &header, sizeof(MeshFileHeader));
+  if (header.vertexCount > 0) {
+    memcpy(output.data() + header.vertexOffset, input.vertices.data(),
+           header.vertexCount * sizeof(VertexData));
+  }
+  if (header.indexCount > 0) {
+    memcpy(output.data() + header.indexOffset, input.indices.data(),
+           header.indexCount * sizeof(uint32_t));
+  }
+}
+
+} // namespace mesh
+} // namespace dank
@@ -0,0 +1,326 @@
+#include "modules/renderer/meshes/MeshOptimizer.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+using namespace dank;
+
+namespace {
+
+// Triangles using each vertex, as offsets into a flat list
+struct Adjacency {
+  std::vector<uint32_t> offsets{};
+  std::vector<uint32_t> triangles{};
+
+  Adjacency(const std::vector<uint32_t> &indices, uint32_t vertexCount) {
+    offsets.assign(vertexCount + 1, 0);
+    for (const auto index : indices) {
+      offsets[index + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    triangles.resize(indices.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < indices.size(); i++) {
+      triangles[cursor[indices[i]]++] = i / 3;
+    }
+  }
+};
+
+// Cache misses of triangles [first, last) starting from an empty cache
+uint32_t countMisses(const std::vector<uint32_t> &indices, uint32_t first,
+                     uint32_t last, uint32_t cacheSize,
+                     std::vector<uint32_t> &timestamps, uint32_t &time) {
+  uint32_t misses = 0;
+  // Bumping the time past the cache size empties it
+  time += cacheSize + 1;
+  for (uint32_t t = first; t < last; t++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      if (time - timestamps[v] > cacheSize) {
+        timestamps[v] = time++;
+        misses++;
+      }
+    }
+  }
+  return misses;
+}
+
+} // namespace
+
+void mesh::analyzeVertexCache(const std::vector<uint32_t> &indices,
+                              uint32_t vertexCount, uint32_t cacheSize,
+                              float &acmr, float &atvr) {
+  acmr = 0;
+  atvr = 0;
+  if (indices.size() < 3)
+    return;
+
+  std::deque<uint32_t> cache{};
+  std::vector<bool> cached(vertexCount, false);
+  std::vector<bool> used(vertexCount, false);
+  uint32_t misses = 0;
+  uint32_t unique = 0;
+
+  for (const auto v : indices) {
+    if (!used[v]) {
+      used[v] = true;
+      unique++;
+    }
+    if (cached[v])
+      continue;
+    misses++;
+    cache.push_back(v);
+    cached[v] = true;
+    if (cache.size() > cacheSize) {
+      cached[cache.front()] = false;
+      cache.pop_front();
+    }
+  }
+
+  acmr = static_cast<float>(misses) / (indices.size() / 3);
+  atvr = static_cast<float>(misses) / unique;
+}
+
+void mesh::optimizeVertexCache(std::vector<uint32_t> &indices,
+                               uint32_t vertexCount, uint32_t cacheSize,
+                               std::vector<uint32_t> *clusters) {
+  uint32_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  Adjacency adjacency(indices, vertexCount);
+  std::vector<uint32_t> live(vertexCount, 0);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  }
+  std::vector<uint32_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnd{};
+  std::vector<uint32_t> candidates{};
+  std::vector<uint32_t> output{};
+  output.reserve(indices.size());
+
+  if (clusters != nullptr) {
+    clusters->assign(1, 0);
+  }
+
+  uint32_t time = cacheSize + 1;
+  uint32_t cursor = 0;
+  int64_t fanning = 0;
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    // Emit every remaining triangle around the fanning vertex
+    uint32_t begin = adjacency.offsets[fanning];
+    uint32_t end = adjacency.offsets[fanning + 1];
+    for (uint32_t a = begin; a < end; a++) {
+      uint32_t t = adjacency.triangles[a];
+      if (emitted[t])
+        continue;
+      emitted[t] = true;
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time++;
+        }
+      }
+    }
+
+    // Next fanning vertex: the candidate that is still in the cache and
+    // will stay there while its remaining triangles are emitted
+    int64_t best = -1;
+    int64_t bestPriority = -1;
+    for (const auto v : candidates) {
+      if (live[v] == 0)
+        continue;
+      int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+        priority = time - cacheTime[v];
+      }
+      if (priority > bestPriority) {
+        best = v;
+        bestPriority = priority;
+      }
+    }
+
+    if (best < 0) {
+      // Dead end: go back to a recently emitted vertex, else the next one
+      // in input order
+      while (!deadEnd.empty()) {
+        uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (live[v] > 0) {
+          best = v;
+          break;
+        }
+      }
+      while (best < 0 && cursor < vertexCount) {
+        if (live[cursor] > 0) {
+          best = cursor;
+        }
+        cursor++;
+      }
+      if (best >= 0 && clusters != nullptr &&
+          output.size() / 3 != clusters->back()) {
+        clusters->push_back(output.size() / 3);
+      }
+    }
+
+    fanning = best;
+  }
+
+  indices.swap(output);
+}
+
+void mesh::optimizeOverdraw(std::vector<uint32_t> &indices,
+                            const std::vector<VertexData> &vertices,
+                            std::vector<uint32_t> clusters, uint32_t cacheSize,
+                            float threshold) {
+  uint32_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+  if (clusters.empty()) {
+    clusters.push_back(0);
+  }
+
+  // Soft boundaries: split a cluster wherever the ACMR since the last split
+  // is within threshold of the whole cluster, so the cache barely notices
+  std::vector<uint32_t> timestamps(vertices.size(), 0);
+  uint32_t time = 0;
+  std::vector<uint32_t> boundaries{};
+  for (size_t c = 0; c < clusters.size(); c++) {
+    uint32_t first = clusters[c];
+    uint32_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+    float clusterACMR =
+        static_cast<float>(
+            countMisses(indices, first, last, cacheSize, timestamps, time)) /
+        (last - first);
+
+    boundaries.push_back(first);
+    uint32_t start = first;
+    uint32_t misses = 0;
+    time += cacheSize + 1;
+    for (uint32_t t = first; t < last; t++) {
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        if (time - timestamps[v] > cacheSize) {
+          timestamps[v] = time++;
+          misses++;
+        }
+      }
+      uint32_t count = t + 1 - start;
+      if (t + 1 < last && count >= 8 &&
+          static_cast<float>(misses) / count <= clusterACMR * threshold) {
+        boundaries.push_back(t + 1);
+        start = t + 1;
+        misses = 0;
+        time += cacheSize + 1;
+      }
+    }
+  }
+
+  glm::vec3 meshCenter{0.0f};
+  for (const auto &vertex : vertices) {
+    meshCenter += vertex.position;
+  }
+  meshCenter /= static_cast<float>(glm::max<size_t>(vertices.size(), 1));
+
+  // Clusters facing away from the mesh center occlude the inner ones, draw
+  // them first
+  struct Cluster {
+    uint32_t first;
+    uint32_t last;
+    float sortKey;
+  };
+  std::vector<Cluster> sorted{};
+  for (size_t b = 0; b < boundaries.size(); b++) {
+    uint32_t first = boundaries[b];
+    uint32_t last =
+        b + 1 < boundaries.size() ? boundaries[b + 1] : triangleCount;
+    glm::vec3 center{0.0f};
+    glm::vec3 normal{0.0f};
+    float area = 0;
+    for (uint32_t t = first; t < last; t++) {
+      const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+      const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      float a = glm::length(n);
+      center += (p0 + p1 + p2) * (a / 3.0f);
+      normal += n;
+      area += a;
+    }
+    if (area > 0) {
+      center /= area;
+    }
+    float length = glm::length(normal);
+    if (length > 0) {
+      normal /= length;
+    }
+    sorted.push_back({first, last, glm::dot(center - meshCenter, normal)});
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.sortKey > b.sortKey;
+                   });
+
+  std::vector<uint32_t> output{};
+  output.reserve(indices.size());
+  for (const auto &cluster : sorted) {
+    output.insert(output.end(), indices.begin() + cluster.first * 3,
+                  indices.begin() + cluster.last * 3);
+  }
+  indices.swap(output);
+}
+
+void mesh::optimizeVertexFetch(std::vector<uint32_t> &indices,
+                               std::vector<VertexData> &vertices) {
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<VertexData> output{};
+  output.reserve(vertices.size());
+
+  for (auto &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = output.size();
+      output.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(output);
+}
+
+mesh::OptimizeReport mesh::optimizeMesh(MeshData &data,
+                                        const OptimizeOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  OptimizeReport report{};
+  uint32_t vertexCount = data.vertices.size();
+
+  analyzeVertexCache(data.indices, vertexCount, options.cacheSize,
+                     report.acmrBefore, report.atvrBefore);
+
+  std::vector<uint32_t> clusters{};
+  optimizeVertexCache(data.indices, vertexCount, options.cacheSize,
+                      &clusters);
+  if (options.overdraw) {
+    optimizeOverdraw(data.indices, data.vertices, clusters, options.cacheSize,
+                     options.overdrawThreshold);
+  }
+  if (options.vertexFetch) {
+    optimizeVertexFetch(data.indices, data.vertices);
+  }
+
+  analyzeVertexCache(data.indices, data.vertices.size(), options.cacheSize,
+                     report.acmrAfter, report.atvrAfter);
+  report.milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  return report;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "modules/renderer/meshes/VertexFormat.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+
+struct MeshData;
+
+struct OptimizeOptions {
+  // Size of the simulated post-transform FIFO cache
+  uint32_t cacheSize = 16;
+  // Reorders clusters of triangles so outer, front facing parts come first
+  bool overdraw = true;
+  // How much worse the ACMR of a cluster may get to allow splitting it
+  float overdrawThreshold = 1.05f;
+  // Renumbers vertices in order of first use and drops unused ones
+  bool vertexFetch = true;
+};
+
+struct OptimizeReport {
+  // Average cache miss ratio: transformed vertices per triangle, 0.5 to 3
+  float acmrBefore = 0;
+  float acmrAfter = 0;
+  // Average transform to vertex ratio: transformed per unique vertex, >= 1
+  float atvrBefore = 0;
+  float atvrAfter = 0;
+  double milliseconds = 0;
+};
+
+// Simulates a FIFO cache of cacheSize entries over a triangle list
+void analyzeVertexCache(const std::vector<uint32_t> &indices,
+                        uint32_t vertexCount, uint32_t cacheSize, float &acmr,
+                        float &atvr);
+
+// Tipsify (Sander et al. 2007): reorders triangles for the vertex cache.
+// Writes the first triangle of every cluster it ended on a dead end.
+void optimizeVertexCache(std::vector<uint32_t> &indices, uint32_t vertexCount,
+                         uint32_t cacheSize,
+                         std::vector<uint32_t> *clusters = nullptr);
+
+// Splits the clusters further where the cache stays efficient, then sorts
+// them by how much they are likely to occlude the rest of the mesh
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<VertexData> &vertices,
+                      std::vector<uint32_t> clusters, uint32_t cacheSize,
+                      float threshold);
+
+// Renumbers vertices in order of first use so fetches walk memory forward
+void optimizeVertexFetch(std::vector<uint32_t> &indices,
+                         std::vector<VertexData> &vertices);
+
+// Runs the passes enabled in options, in order: vertex cache, overdraw,
+// vertex fetch. Cheap enough for import time, meant for a background job
+// at runtime.
+OptimizeReport optimizeMesh(MeshData &data, const OptimizeOptions &options);
+
+} // namespace mesh
+} // namespace dank
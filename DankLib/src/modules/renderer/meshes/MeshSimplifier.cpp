@@ -0,0 +1,410 @@
+#include "modules/renderer/meshes/MeshSimplifier.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/meshes/MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+using namespace dank;
+
+namespace {
+
+// Open borders weigh more than faces so they barely move
+const double BORDER_WEIGHT = 10.0;
+
+// Symmetric 4x4 matrix of summed squared plane distances, divided by the
+// summed weight when evaluated so the error is an average squared distance
+struct Quadric {
+  double a2 = 0, b2 = 0, c2 = 0, d2 = 0;
+  double ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+  double w = 0;
+
+  void addPlane(const glm::dvec3 &n, double d, double weight) {
+    a2 += n.x * n.x * weight;
+    b2 += n.y * n.y * weight;
+    c2 += n.z * n.z * weight;
+    d2 += d * d * weight;
+    ab += n.x * n.y * weight;
+    ac += n.x * n.z * weight;
+    ad += n.x * d * weight;
+    bc += n.y * n.z * weight;
+    bd += n.y * d * weight;
+    cd += n.z * d * weight;
+    w += weight;
+  }
+
+  void add(const Quadric &o) {
+    a2 += o.a2;
+    b2 += o.b2;
+    c2 += o.c2;
+    d2 += o.d2;
+    ab += o.ab;
+    ac += o.ac;
+    ad += o.ad;
+    bc += o.bc;
+    bd += o.bd;
+    cd += o.cd;
+    w += o.w;
+  }
+
+  double evaluate(const glm::dvec3 &p) const {
+    if (w <= 0)
+      return 0;
+    double e = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z +
+               2 * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z) +
+               2 * (ad * p.x + bd * p.y + cd * p.z) + d2;
+    return std::max(e, 0.0) / w;
+  }
+};
+
+struct Collapse {
+  double cost;
+  uint32_t from;
+  uint32_t to;
+  uint32_t fromVersion;
+  uint32_t toVersion;
+
+  bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+struct PositionKey {
+  float x, y, z;
+
+  bool operator==(const PositionKey &o) const {
+    return memcmp(this, &o, sizeof(PositionKey)) == 0;
+  }
+};
+
+struct PositionKeyHash {
+  size_t operator()(const PositionKey &key) const {
+    uint32_t bits[3];
+    memcpy(bits, &key, sizeof(bits));
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+           (bits[2] * 83492791u);
+  }
+};
+
+class Simplifier {
+private:
+  std::vector<uint32_t> &indices;
+  // Vertex to welded position
+  std::vector<uint32_t> positionOf{};
+  std::vector<glm::dvec3> positions{};
+  std::vector<Quadric> quadrics{};
+  std::vector<std::vector<uint32_t>> positionTriangles{};
+  std::vector<uint32_t> versions{};
+  std::vector<bool> alive{};
+  std::vector<bool> removed{};
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+      queue{};
+  // Scratch for canCollapse
+  std::vector<std::pair<uint32_t, uint32_t>> remap{};
+  std::vector<uint32_t> neighbours{};
+  std::vector<uint32_t> otherNeighbours{};
+
+  uint32_t pos(uint32_t triangle, uint32_t corner) const {
+    return positionOf[indices[triangle * 3 + corner]];
+  }
+
+  bool contains(uint32_t triangle, uint32_t position) const {
+    return pos(triangle, 0) == position || pos(triangle, 1) == position ||
+           pos(triangle, 2) == position;
+  }
+
+  glm::dvec3 normal(uint32_t triangle, uint32_t moved,
+                    const glm::dvec3 &to) const {
+    glm::dvec3 p[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t position = pos(triangle, k);
+      p[k] = position == moved ? to : positions[position];
+    }
+    return glm::cross(p[1] - p[0], p[2] - p[0]);
+  }
+
+  void push(uint32_t from, uint32_t to) {
+    Quadric q = quadrics[from];
+    q.add(quadrics[to]);
+    queue.push(Collapse{q.evaluate(positions[to]), from, to, versions[from],
+                        versions[to]});
+  }
+
+  // Sorted positions sharing a triangle with position
+  void collectNeighbours(uint32_t position, std::vector<uint32_t> &output) {
+    output.clear();
+    for (const auto t : positionTriangles[position]) {
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t p = pos(t, k);
+        if (p != position) {
+          output.push_back(p);
+        }
+      }
+    }
+    std::sort(output.begin(), output.end());
+    output.erase(std::unique(output.begin(), output.end()), output.end());
+  }
+
+  // Fills remap with the vertex every vertex of from turns into, and checks
+  // the collapse neither flips a triangle nor pinches the surface
+  bool canCollapse(uint32_t from, uint32_t to) {
+    remap.clear();
+    uint32_t shared = 0;
+    for (const auto t : positionTriangles[from]) {
+      if (!contains(t, to))
+        continue;
+      shared++;
+      uint32_t vertex = 0, target = 0;
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        if (positionOf[v] == from)
+          vertex = v;
+        if (positionOf[v] == to)
+          target = v;
+      }
+      bool found = false;
+      for (auto &entry : remap) {
+        if (entry.first != vertex)
+          continue;
+        // A vertex meeting two different vertices of the target means a
+        // seam that would be torn open
+        if (entry.second != target)
+          return false;
+        found = true;
+      }
+      if (!found) {
+        remap.emplace_back(vertex, target);
+      }
+    }
+    if (shared == 0)
+      return false;
+
+    // Every vertex at this position needs a counterpart on the target
+    for (const auto t : positionTriangles[from]) {
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        if (positionOf[v] != from)
+          continue;
+        bool found = false;
+        for (const auto &entry : remap) {
+          found = found || entry.first == v;
+        }
+        if (!found)
+          return false;
+      }
+    }
+
+    // Link condition: the two positions may only share the neighbours of
+    // the triangles between them
+    collectNeighbours(from, neighbours);
+    collectNeighbours(to, otherNeighbours);
+    uint32_t common = 0;
+    for (auto i = neighbours.begin(), j = otherNeighbours.begin();
+         i != neighbours.end() && j != otherNeighbours.end();) {
+      if (*i < *j) {
+        i++;
+      } else if (*j < *i) {
+        j++;
+      } else {
+        common++;
+        i++;
+        j++;
+      }
+    }
+    if (common > shared)
+      return false;
+
+    for (const auto t : positionTriangles[from]) {
+      if (contains(t, to))
+        continue;
+      glm::dvec3 before = normal(t, from, positions[from]);
+      glm::dvec3 after = normal(t, from, positions[to]);
+      if (glm::dot(before, after) <= 0)
+        return false;
+    }
+    return true;
+  }
+
+  void collapse(uint32_t from, uint32_t to, uint32_t &triangleCount) {
+    for (const auto t : positionTriangles[from]) {
+      if (contains(t, to)) {
+        removed[t] = true;
+        triangleCount--;
+        for (uint32_t k = 0; k < 3; k++) {
+          uint32_t p = pos(t, k);
+          if (p == from)
+            continue;
+          auto &list = positionTriangles[p];
+          list.erase(std::find(list.begin(), list.end(), t));
+        }
+        continue;
+      }
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t &v = indices[t * 3 + k];
+        if (positionOf[v] != from)
+          continue;
+        for (const auto &entry : remap) {
+          if (entry.first == v) {
+            v = entry.second;
+            break;
+          }
+        }
+      }
+      positionTriangles[to].push_back(t);
+    }
+    positionTriangles[from].clear();
+    quadrics[to].add(quadrics[from]);
+    alive[from] = false;
+    versions[to]++;
+
+    collectNeighbours(to, neighbours);
+    for (const auto n : neighbours) {
+      push(to, n);
+      push(n, to);
+    }
+  }
+
+public:
+  explicit Simplifier(std::vector<uint32_t> &indices) : indices(indices) {}
+
+  double run(const std::vector<mesh::VertexData> &vertices,
+             uint32_t targetIndexCount, double targetError) {
+    // Positions are normalized to the bounding sphere so errors are
+    // relative to the mesh size
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (const auto &vertex : vertices) {
+      min = glm::min(min, vertex.position);
+      max = glm::max(max, vertex.position);
+    }
+    glm::dvec3 center = glm::dvec3(min + max) * 0.5;
+    double radius = glm::length(glm::dvec3(max - min)) * 0.5;
+    double invRadius = radius > 0 ? 1.0 / radius : 1.0;
+
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded{};
+    positionOf.resize(vertices.size());
+    for (uint32_t v = 0; v < vertices.size(); v++) {
+      const glm::vec3 &p = vertices[v].position;
+      auto result = welded.emplace(PositionKey{p.x, p.y, p.z},
+                                   static_cast<uint32_t>(positions.size()));
+      if (result.second) {
+        positions.push_back((glm::dvec3(p) - center) * invRadius);
+      }
+      positionOf[v] = result.first->second;
+    }
+
+    uint32_t positionCount = positions.size();
+    quadrics.assign(positionCount, Quadric{});
+    positionTriangles.assign(positionCount, {});
+    versions.assign(positionCount, 0);
+    alive.assign(positionCount, true);
+
+    uint32_t triangleCount = indices.size() / 3;
+    removed.assign(triangleCount, false);
+
+    // Face planes weighted by area, edges counted to find open borders
+    std::unordered_map<uint64_t, uint32_t> edges{};
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      uint32_t a = pos(t, 0), b = pos(t, 1), c = pos(t, 2);
+      if (a == b || b == c || c == a) {
+        removed[t] = true;
+        continue;
+      }
+      glm::dvec3 n = glm::cross(positions[b] - positions[a],
+                                positions[c] - positions[a]);
+      double length = glm::length(n);
+      if (length > 0) {
+        n /= length;
+        double d = -glm::dot(n, positions[a]);
+        for (uint32_t k = 0; k < 3; k++) {
+          quadrics[pos(t, k)].addPlane(n, d, length * 0.5);
+        }
+      }
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t p = pos(t, k);
+        positionTriangles[p].push_back(t);
+        uint32_t q = pos(t, (k + 1) % 3);
+        uint64_t key = (static_cast<uint64_t>(std::min(p, q)) << 32) |
+                       std::max(p, q);
+        edges[key]++;
+      }
+    }
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      if (removed[t])
+        continue;
+      glm::dvec3 n = normal(t, UINT32_MAX, glm::dvec3(0.0));
+      for (uint32_t k = 0; k < 3; k++) {
+        uint32_t p = pos(t, k), q = pos(t, (k + 1) % 3);
+        uint64_t key = (static_cast<uint64_t>(std::min(p, q)) << 32) |
+                       std::max(p, q);
+        if (edges[key] != 1)
+          continue;
+        // Plane through the border edge, perpendicular to the face
+        glm::dvec3 edge = positions[q] - positions[p];
+        glm::dvec3 side = glm::cross(edge, n);
+        double length = glm::length(side);
+        if (length <= 0)
+          continue;
+        side /= length;
+        double d = -glm::dot(side, positions[p]);
+        double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+        quadrics[p].addPlane(side, d, weight);
+        quadrics[q].addPlane(side, d, weight);
+      }
+    }
+
+    for (const auto &edge : edges) {
+      uint32_t p = static_cast<uint32_t>(edge.first >> 32);
+      uint32_t q = static_cast<uint32_t>(edge.first & 0xffffffffu);
+      push(p, q);
+      push(q, p);
+    }
+
+    uint32_t remaining = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      remaining += removed[t] ? 0 : 1;
+    }
+
+    double maxCost = targetError * targetError;
+    double error = 0;
+    while (!queue.empty() && remaining * 3 > targetIndexCount) {
+      Collapse c = queue.top();
+      queue.pop();
+      if (!alive[c.from] || !alive[c.to] || versions[c.from] != c.fromVersion ||
+          versions[c.to] != c.toVersion)
+        continue;
+      if (c.cost > maxCost)
+        break;
+      if (!canCollapse(c.from, c.to))
+        continue;
+      collapse(c.from, c.to, remaining);
+      error = std::max(error, c.cost);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      if (removed[t])
+        continue;
+      for (uint32_t k = 0; k < 3; k++) {
+        indices[count * 3 + k] = indices[t * 3 + k];
+      }
+      count++;
+    }
+    indices.resize(count * 3);
+    return std::sqrt(error);
+  }
+};
+
+} // namespace
+
+float mesh::simplifyMesh(MeshData &data, uint32_t targetIndexCount,
+                         float targetError) {
+  if (data.indices.size() <= targetIndexCount || data.vertices.empty())
+    return 0;
+
+  Simplifier simplifier{data.indices};
+  double error =
+      simplifier.run(data.vertices, targetIndexCount, targetError);
+  optimizeVertexFetch(data.indices, data.vertices);
+  return static_cast<float>(error);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace dank {
+namespace mesh {
+
+struct MeshData;
+
+struct LodOptions {
+  // Levels generated on top of the mesh itself, at most MAX_MESH_LODS
+  uint32_t levels = 4;
+  // Index count of each level relative to the one before
+  float reduction = 0.25f;
+  // No level is generated past this error, relative to the bounding radius
+  float maxError = 0.1f;
+  // Runs the vertex cache and vertex fetch passes on every level
+  bool optimize = true;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert 1997). Vertices
+// only ever move onto a neighbour (half edge collapse), so uvs and normals
+// are kept as they are and nothing needs interpolating. Vertices sharing a
+// position collapse together, which keeps uv seams closed, and open borders
+// are held in place by extra planes along them.
+//
+// Removes triangles until the index count is at or below targetIndexCount,
+// or the next collapse would move the surface by more than targetError,
+// given relative to the mesh's bounding radius. Unused vertices are dropped.
+// Returns the error of the simplified mesh, relative to the radius as well.
+float simplifyMesh(MeshData &data, uint32_t targetIndexCount,
+                   float targetError);
+
+} // namespace mesh
+} // namespace dank
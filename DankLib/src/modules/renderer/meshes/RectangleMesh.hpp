@@ -10,6 +10,7 @@ class Rectangle : public Mesh {
 public:
 
   void getData(MeshData &output) override {
+    output.format = VertexFormat::Sprite;
     output.vertices.push_back(VertexData{
         {-1.0f, -1.0f, 0.0f}, // vertices
         {0.0f, 0.0f, 1.0f},   // normals
@@ -0,0 +1,45 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+
+namespace dank {
+
+namespace mesh {
+
+// Unit UV sphere, rings from pole to pole and segments around the y axis
+class Sphere : public Mesh {
+public:
+  uint32_t rings;
+  uint32_t segments;
+
+  Sphere(uint32_t rings = 64, uint32_t segments = 128)
+      : rings(rings), segments(segments) {}
+
+  void getData(MeshData &output) override {
+    output.format = VertexFormat::Quantized;
+    for (uint32_t r = 0; r <= rings; r++) {
+      float v = r / (float)rings;
+      float theta = v * glm::pi<float>();
+      for (uint32_t s = 0; s <= segments; s++) {
+        float u = s / (float)segments;
+        float phi = u * glm::two_pi<float>();
+        glm::vec3 normal{glm::sin(theta) * glm::cos(phi), glm::cos(theta),
+                         glm::sin(theta) * glm::sin(phi)};
+        output.vertices.push_back(VertexData{normal, normal, {u, v}});
+      }
+    }
+
+    for (uint32_t r = 0; r < rings; r++) {
+      for (uint32_t s = 0; s < segments; s++) {
+        uint32_t a = r * (segments + 1) + s;
+        uint32_t b = a + segments + 1;
+        output.indices.insert(output.indices.end(),
+                              {a, a + 1, b, b, a + 1, b + 1});
+      }
+    }
+  }
+};
+
+} // namespace mesh
+
+} // namespace dank
@@ -30,6 +30,7 @@ public:
       : Mesh(), textureSize(textureSize), region(region) {}
 
   void getData(MeshData &output) override {
+    output.format = VertexFormat::Sprite;
     float x0 = region.x / textureSize.width;
     float y0 = region.y / textureSize.height;
     float x1 = x0 + (region.width / textureSize.width);
@@ -0,0 +1,84 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/meshes/SpriteMesh.hpp"
+
+namespace dank {
+
+namespace mesh {
+
+// Quad of size 1 centered on the origin, with uvs covering the whole
+// texture. Every sprite in a SpriteTable is drawn with it.
+class UnitQuad : public Mesh {
+public:
+  void getData(MeshData &output) override {
+    output.format = VertexFormat::Sprite;
+    output.vertices.push_back(
+        VertexData{{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}});
+    output.vertices.push_back(
+        VertexData{{0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}});
+    output.vertices.push_back(
+        VertexData{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}});
+    output.vertices.push_back(
+        VertexData{{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}});
+
+    output.indices = {0, 1, 2, 2, 3, 0};
+  }
+};
+
+// Size and texture rectangle the unit quad is stretched to
+struct SpriteFrame {
+  glm::vec2 size{1.0f};
+  glm::vec2 uvOffset{0.0f};
+  glm::vec2 uvScale{1.0f};
+};
+
+struct SpriteHandleTag {};
+typedef Handle<SpriteHandleTag> SpriteHandle;
+
+// Sprites are entries in this table instead of meshes of their own: adding
+// one never touches the MeshLibrary, and since they all share the same quad
+// consecutive sprites are drawn as a single instanced draw.
+class SpriteTable {
+private:
+  SlotMap<SpriteFrame, SpriteHandleTag> frames{};
+  MeshHandle quad{};
+
+public:
+  SpriteHandle add(SpriteFrame frame) { return frames.insert(frame); }
+
+  SpriteHandle add(TextureSize textureSize, TextureRegion region) {
+    SpriteFrame frame{};
+    frame.size = glm::vec2(region.width, region.height) * region.scale;
+    frame.uvOffset = glm::vec2(region.x / textureSize.width,
+                               region.y / textureSize.height);
+    frame.uvScale = glm::vec2(region.width / textureSize.width,
+                              region.height / textureSize.height);
+    return frames.insert(frame);
+  }
+
+  void remove(const SpriteHandle handle) { frames.remove(handle); }
+
+  void clear() { frames.clear(); }
+
+  // nullptr when the handle is stale
+  const SpriteFrame *get(const SpriteHandle handle) const {
+    return frames.get(handle);
+  }
+
+  uint32_t size() const { return frames.size(); }
+
+  // Adds the unit quad to the library the first time, and again after the
+  // library was cleared
+  MeshHandle getQuad(MeshLibrary &meshLibrary) {
+    if (meshLibrary.get(quad) == nullptr) {
+      quad = meshLibrary.add(new UnitQuad());
+    }
+    return quad;
+  }
+};
+
+} // namespace mesh
+
+} // namespace dank
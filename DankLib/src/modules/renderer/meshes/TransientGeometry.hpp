@@ -0,0 +1,91 @@
+#pragma once
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+
+// Vertex buffer slot of the transient vertices, right after the mesh pages
+const uint32_t TRANSIENT_VERTEX_SLOT = MAX_MESH_PAGES;
+
+// Range of the current frame's transient vertices or indices
+struct TransientSpan {
+  uint32_t first = 0;
+  uint32_t count = 0;
+};
+
+// Geometry that only lives for one frame: debug lines, text, trails,
+// skinned characters. Going through MeshLibrary would bump lastModified
+// and re-encode pages every frame, here an allocation is a bump of the
+// frame's cursor and filling it a memcpy. The renderer copies the used
+// ranges into one of several GPU buffers it cycles through, so frames still
+// in flight keep reading theirs.
+//
+// Vertices are VertexFormat::Standard, indices are 32 bit and relative to
+// the vertex span they are drawn with. Emptied by the engine at the start
+// of every update, spans are invalid after that. Allocating is not thread
+// safe: reserve spans first, then fill them from jobs.
+class TransientGeometry {
+private:
+  std::vector<VertexData> vertices{};
+  std::vector<uint32_t> indices{};
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+
+  // Storage only ever grows, after the first frames allocating is a bump
+  template <typename T>
+  static TransientSpan bump(std::vector<T> &storage, uint32_t &size,
+                            uint32_t count) {
+    TransientSpan span{size, count};
+    size += count;
+    if (storage.size() < size) {
+      storage.resize(std::max<size_t>(size, storage.size() * 2));
+    }
+    return span;
+  }
+
+public:
+  TransientSpan allocateVertices(uint32_t count) {
+    return bump(vertices, vertexCount, count);
+  }
+
+  TransientSpan allocateIndices(uint32_t count) {
+    return bump(indices, indexCount, count);
+  }
+
+  TransientSpan addVertices(const VertexData *data, uint32_t count) {
+    TransientSpan span = allocateVertices(count);
+    if (count > 0) {
+      memcpy(vertices.data() + span.first, data, count * sizeof(VertexData));
+    }
+    return span;
+  }
+
+  TransientSpan addIndices(const uint32_t *data, uint32_t count) {
+    TransientSpan span = allocateIndices(count);
+    if (count > 0) {
+      memcpy(indices.data() + span.first, data, count * sizeof(uint32_t));
+    }
+    return span;
+  }
+
+  // Valid until the next allocation
+  VertexData *vertexAt(uint32_t first) { return vertices.data() + first; }
+  uint32_t *indexAt(uint32_t first) { return indices.data() + first; }
+
+  const VertexData *getVertexData() const { return vertices.data(); }
+  const uint32_t *getIndexData() const { return indices.data(); }
+  uint32_t getVertexCount() const { return vertexCount; }
+  uint32_t getIndexCount() const { return indexCount; }
+
+  void reset() {
+    vertexCount = 0;
+    indexCount = 0;
+  }
+};
+
+} // namespace mesh
+} // namespace dank
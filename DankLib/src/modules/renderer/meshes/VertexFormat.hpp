@@ -0,0 +1,225 @@
+#pragma once
+#include "libs/glm/gtc/packing.hpp"
+#include "modules/Foundation.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+
+// Layouts a mesh can be stored in, decoded in StaticMesh.metal
+enum class VertexFormat : uint32_t {
+  // float3 position, float3 normal, float2 uv (32 bytes)
+  Standard = 0,
+  // half2 position, unorm16x2 uv, normal is always (0, 0, 1) (8 bytes)
+  Sprite = 1,
+  // snorm16x3 position scaled by MeshDescriptor::positionScale, octahedral
+  // snorm16x2 normal, unorm16x2 uv (16 bytes)
+  Quantized = 2
+};
+
+struct VertexData {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+};
+
+struct SpriteVertex {
+  uint16_t position[2];
+  uint16_t uv[2];
+};
+
+struct QuantizedVertex {
+  uint16_t position[3];
+  uint16_t _pad;
+  uint16_t normal[2];
+  uint16_t uv[2];
+};
+
+inline uint32_t getVertexStride(VertexFormat format) {
+  switch (format) {
+  case VertexFormat::Sprite:
+    return sizeof(SpriteVertex);
+  case VertexFormat::Quantized:
+    return sizeof(QuantizedVertex);
+  case VertexFormat::Standard:
+  default:
+    return sizeof(VertexData);
+  }
+}
+
+// Worst case absolute errors after a round trip, per component. Half a
+// quantization step plus headroom for float rounding in the encoder.
+namespace quantization {
+// unorm16 uv
+const float UV_ERROR = 1.0f / 65535.0f;
+// snorm16 position, multiplied by the mesh position scale
+const float POSITION_ERROR = 1.0f / 32767.0f;
+// Octahedral snorm16 normal, in radians
+const float NORMAL_ERROR = 0.001f;
+// half position, relative to the magnitude of the value
+const float HALF_RELATIVE_ERROR = 1.0f / 2048.0f;
+// Largest absolute position error a Sprite mesh is kept with, in its units
+// (pixels for sprites). Halfs stay under it below a magnitude of 512.
+const float SPRITE_POSITION_ERROR = 0.125f;
+} // namespace quantization
+
+inline glm::vec2 encodeOctahedral(glm::vec3 n) {
+  n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+  glm::vec2 e = glm::vec2(n.x, n.y);
+  if (n.z < 0.0f) {
+    e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+        glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return e;
+}
+
+inline glm::vec3 decodeOctahedral(glm::vec2 e) {
+  glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+  float t = glm::clamp(-n.z, 0.0f, 1.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+// Largest absolute position component, snorm16 positions are divided by it
+inline float getPositionScale(const std::vector<VertexData> &input) {
+  float scale = 0.0f;
+  for (const auto &v : input) {
+    scale = glm::max(scale, glm::max(glm::abs(v.position.x),
+                                     glm::max(glm::abs(v.position.y),
+                                              glm::abs(v.position.z))));
+  }
+  return scale > 0.0f ? scale : 1.0f;
+}
+
+inline void encodeVertices(const std::vector<VertexData> &input,
+                           VertexFormat format, float positionScale,
+                           std::vector<uint8_t> &output) {
+  uint32_t stride = getVertexStride(format);
+  output.resize(input.size() * stride);
+
+  // Same layout, a single copy
+  if (format == VertexFormat::Standard) {
+    if (!input.empty()) {
+      memcpy(output.data(), input.data(), output.size());
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < input.size(); i++) {
+    const VertexData &v = input[i];
+    uint8_t *target = output.data() + i * stride;
+
+    switch (format) {
+    case VertexFormat::Sprite: {
+      SpriteVertex sv{};
+      sv.position[0] = glm::packHalf1x16(v.position.x);
+      sv.position[1] = glm::packHalf1x16(v.position.y);
+      sv.uv[0] = glm::packUnorm1x16(v.uv.x);
+      sv.uv[1] = glm::packUnorm1x16(v.uv.y);
+      memcpy(target, &sv, sizeof(SpriteVertex));
+    } break;
+    case VertexFormat::Quantized: {
+      QuantizedVertex qv{};
+      glm::vec3 p = v.position / positionScale;
+      qv.position[0] = glm::packSnorm1x16(p.x);
+      qv.position[1] = glm::packSnorm1x16(p.y);
+      qv.position[2] = glm::packSnorm1x16(p.z);
+      glm::vec2 n = encodeOctahedral(v.normal);
+      qv.normal[0] = glm::packSnorm1x16(n.x);
+      qv.normal[1] = glm::packSnorm1x16(n.y);
+      qv.uv[0] = glm::packUnorm1x16(v.uv.x);
+      qv.uv[1] = glm::packUnorm1x16(v.uv.y);
+      memcpy(target, &qv, sizeof(QuantizedVertex));
+    } break;
+    default:
+      break;
+    }
+  }
+}
+
+// CPU reference of the decode in StaticMesh.metal
+inline VertexData decodeVertex(const uint8_t *source, VertexFormat format,
+                               float positionScale) {
+  VertexData v{};
+  switch (format) {
+  case VertexFormat::Standard:
+    memcpy(&v, source, sizeof(VertexData));
+    break;
+  case VertexFormat::Sprite: {
+    SpriteVertex sv;
+    memcpy(&sv, source, sizeof(SpriteVertex));
+    v.position = glm::vec3(glm::unpackHalf1x16(sv.position[0]),
+                           glm::unpackHalf1x16(sv.position[1]), 0.0f);
+    v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    v.uv = glm::vec2(glm::unpackUnorm1x16(sv.uv[0]),
+                     glm::unpackUnorm1x16(sv.uv[1]));
+  } break;
+  case VertexFormat::Quantized: {
+    QuantizedVertex qv;
+    memcpy(&qv, source, sizeof(QuantizedVertex));
+    v.position = glm::vec3(glm::unpackSnorm1x16(qv.position[0]),
+                           glm::unpackSnorm1x16(qv.position[1]),
+                           glm::unpackSnorm1x16(qv.position[2])) *
+                 positionScale;
+    v.normal = decodeOctahedral(glm::vec2(glm::unpackSnorm1x16(qv.normal[0]),
+                                          glm::unpackSnorm1x16(qv.normal[1])));
+    v.uv = glm::vec2(glm::unpackUnorm1x16(qv.uv[0]),
+                     glm::unpackUnorm1x16(qv.uv[1]));
+  } break;
+  }
+  return v;
+}
+
+// Largest difference of a position component after a round trip through
+// format, with decodeVertex
+inline float getPositionError(const std::vector<VertexData> &input,
+                              VertexFormat format, float positionScale) {
+  std::vector<uint8_t> encoded{};
+  encodeVertices(input, format, positionScale, encoded);
+  uint32_t stride = getVertexStride(format);
+  float error = 0.0f;
+  for (size_t i = 0; i < input.size(); i++) {
+    VertexData v =
+        decodeVertex(encoded.data() + i * stride, format, positionScale);
+    glm::vec3 delta = glm::abs(v.position - input[i].position);
+    error = glm::max(error, glm::max(delta.x, glm::max(delta.y, delta.z)));
+  }
+  return error;
+}
+
+// Picks the most compact format able to hold the vertices, starting from
+// the one the mesh asked for
+inline VertexFormat selectVertexFormat(VertexFormat requested,
+                                       const std::vector<VertexData> &input) {
+  if (requested == VertexFormat::Standard)
+    return requested;
+
+  bool uvInRange = true;
+  bool flat = true;
+  for (const auto &v : input) {
+    uvInRange = uvInRange && v.uv.x >= 0.0f && v.uv.x <= 1.0f &&
+                v.uv.y >= 0.0f && v.uv.y <= 1.0f;
+    flat = flat && v.position.z == 0.0f && v.normal == glm::vec3(0, 0, 1);
+  }
+  if (!uvInRange)
+    return VertexFormat::Standard;
+  if (requested != VertexFormat::Sprite)
+    return requested;
+  if (flat && getPositionError(input, VertexFormat::Sprite, 1.0f) <=
+                  quantization::SPRITE_POSITION_ERROR)
+    return VertexFormat::Sprite;
+
+  // Halfs lose precision with the magnitude, large meshes go to the next
+  // format that round trips within the same bound
+  float error = getPositionError(input, VertexFormat::Quantized,
+                                 getPositionScale(input));
+  return error <= quantization::SPRITE_POSITION_ERROR
+             ? VertexFormat::Quantized
+             : VertexFormat::Standard;
+}
+
+} // namespace mesh
+} // namespace dank
@@ -0,0 +1,158 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dank {
+namespace path {
+
+enum class PathVerb : uint8_t { Move, Line, Quad, Cubic, Close };
+
+// Resolution independent outline made of subpaths, each started by a
+// Move. Curves are kept as control points and only flattened when the
+// path is tessellated, at the tolerance asked for.
+class Path {
+private:
+  std::vector<PathVerb> verbs{};
+  std::vector<glm::vec2> points{};
+
+  // Drawing without a Move starts a subpath at the origin
+  void ensureStarted() {
+    if (verbs.empty() || verbs.back() == PathVerb::Close) {
+      glm::vec2 start = points.empty() ? glm::vec2(0.0f) : lastMove();
+      moveTo(start.x, start.y);
+    }
+  }
+
+  glm::vec2 lastMove() const {
+    size_t point = points.size();
+    for (size_t i = verbs.size(); i-- > 0;) {
+      point -= pointCount(verbs[i]);
+      if (verbs[i] == PathVerb::Move)
+        return points[point];
+    }
+    return glm::vec2(0.0f);
+  }
+
+public:
+  // Points each verb consumes
+  static uint32_t pointCount(PathVerb verb) {
+    switch (verb) {
+    case PathVerb::Move:
+    case PathVerb::Line:
+      return 1;
+    case PathVerb::Quad:
+      return 2;
+    case PathVerb::Cubic:
+      return 3;
+    case PathVerb::Close:
+      return 0;
+    }
+    return 0;
+  }
+
+  Path &moveTo(float x, float y) {
+    verbs.push_back(PathVerb::Move);
+    points.push_back({x, y});
+    return *this;
+  }
+
+  Path &lineTo(float x, float y) {
+    ensureStarted();
+    verbs.push_back(PathVerb::Line);
+    points.push_back({x, y});
+    return *this;
+  }
+
+  Path &quadTo(float cx, float cy, float x, float y) {
+    ensureStarted();
+    verbs.push_back(PathVerb::Quad);
+    points.insert(points.end(), {{cx, cy}, {x, y}});
+    return *this;
+  }
+
+  Path &cubicTo(float c1x, float c1y, float c2x, float c2y, float x,
+                float y) {
+    ensureStarted();
+    verbs.push_back(PathVerb::Cubic);
+    points.insert(points.end(), {{c1x, c1y}, {c2x, c2y}, {x, y}});
+    return *this;
+  }
+
+  // Connects back to the subpath's start, strokes join there instead of
+  // ending with caps
+  Path &close() {
+    if (!verbs.empty() && verbs.back() != PathVerb::Close) {
+      verbs.push_back(PathVerb::Close);
+    }
+    return *this;
+  }
+
+  Path &rect(float x, float y, float width, float height) {
+    return moveTo(x, y)
+        .lineTo(x + width, y)
+        .lineTo(x + width, y + height)
+        .lineTo(x, y + height)
+        .close();
+  }
+
+  // Corners are quarter ellipses approximated by cubics
+  Path &roundedRect(float x, float y, float width, float height,
+                    float radius) {
+    radius = glm::min(radius, glm::min(width, height) * 0.5f);
+    if (radius <= 0)
+      return rect(x, y, width, height);
+    const float k = 0.5522847f * radius;
+    float r = x + width;
+    float b = y + height;
+    return moveTo(x + radius, y)
+        .lineTo(r - radius, y)
+        .cubicTo(r - radius + k, y, r, y + radius - k, r, y + radius)
+        .lineTo(r, b - radius)
+        .cubicTo(r, b - radius + k, r - radius + k, b, r - radius, b)
+        .lineTo(x + radius, b)
+        .cubicTo(x + radius - k, b, x, b - radius + k, x, b - radius)
+        .lineTo(x, y + radius)
+        .cubicTo(x, y + radius - k, x + radius - k, y, x + radius, y)
+        .close();
+  }
+
+  Path &ellipse(float cx, float cy, float rx, float ry) {
+    const float kx = 0.5522847f * rx;
+    const float ky = 0.5522847f * ry;
+    return moveTo(cx + rx, cy)
+        .cubicTo(cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry)
+        .cubicTo(cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy)
+        .cubicTo(cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry)
+        .cubicTo(cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy)
+        .close();
+  }
+
+  void clear() {
+    verbs.clear();
+    points.clear();
+  }
+
+  bool empty() const { return verbs.empty(); }
+  const std::vector<PathVerb> &getVerbs() const { return verbs; }
+  const std::vector<glm::vec2> &getPoints() const { return points; }
+
+  // FNV-1a over the verbs and the bits of the points, identifies the
+  // shape in the tessellation cache
+  uint64_t hash() const {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void *data, size_t size) {
+      const uint8_t *bytes = static_cast<const uint8_t *>(data);
+      for (size_t i = 0; i < size; i++) {
+        h = (h ^ bytes[i]) * 1099511628211ull;
+      }
+    };
+    mix(verbs.data(), verbs.size() * sizeof(PathVerb));
+    mix(points.data(), points.size() * sizeof(glm::vec2));
+    return h;
+  }
+};
+
+} // namespace path
+} // namespace dank
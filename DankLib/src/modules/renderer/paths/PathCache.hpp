@@ -0,0 +1,167 @@
+#pragma once
+#include "modules/os/JobSystem.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/paths/Path.hpp"
+#include "modules/renderer/paths/PathTessellator.hpp"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace dank {
+namespace path {
+
+// Meshes of tessellated paths, keyed by the path's hash, how it is drawn
+// and the tolerance. A path asked for again with the same key gets the same
+// mesh without being flattened or triangulated again, so shapes can be
+// rebuilt every frame and only cost a hash. New keys are tessellated on the
+// JobSystem and added to the MeshLibrary in apply(), until then fill() and
+// stroke() return an invalid handle.
+//
+// Keys are 64 bit hashes, a collision would draw the other shape. Meshes
+// unused for maxUnusedFrames are removed again. Clear it together with the
+// MeshLibrary, like the SkeletonLibrary.
+class PathCache {
+private:
+  struct Entry {
+    mesh::MeshHandle mesh{};
+    bool pending = true;
+    uint32_t lastUsed = 0;
+  };
+
+  struct Tessellated {
+    uint64_t key = 0;
+    mesh::MeshData data{};
+    double milliseconds = 0;
+  };
+
+  struct FinishedJobs {
+    std::mutex mutex{};
+    std::vector<std::shared_ptr<Tessellated>> meshes{};
+  };
+
+  std::unordered_map<uint64_t, Entry> entries{};
+  std::shared_ptr<FinishedJobs> finished = std::make_shared<FinishedJobs>();
+  uint32_t frame = 0;
+
+  static uint64_t mixKey(uint64_t key, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+      key = (key ^ bytes[i]) * 1099511628211ull;
+    }
+    return key;
+  }
+
+  template <typename Tessellate>
+  mesh::MeshHandle request(uint64_t key, JobSystem &jobs,
+                           Tessellate tessellate) {
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+      found->second.lastUsed = frame;
+      hits++;
+      return found->second.mesh;
+    }
+    entries[key] = Entry{{}, true, frame};
+    misses++;
+
+    auto pending = std::make_shared<Tessellated>();
+    pending->key = key;
+    std::shared_ptr<FinishedJobs> results = finished;
+    jobs.submit([pending, tessellate, results]() {
+      auto start = std::chrono::steady_clock::now();
+      tessellate(pending->data);
+      pending->milliseconds =
+          std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+      std::lock_guard<std::mutex> lock(results->mutex);
+      results->meshes.push_back(pending);
+    });
+    return mesh::MeshHandle{};
+  }
+
+public:
+  // Frames a mesh may go without being asked for before it is removed
+  uint32_t maxUnusedFrames = 600;
+  // Lookups that found their key and that did not, paths tessellated and
+  // their milliseconds on the workers, summed until the engine logs and
+  // resets them
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+  uint32_t tessellated = 0;
+  double tessellateTime = 0;
+
+  // tolerance is the largest distance in path units between a curve and
+  // its segments, a quarter of a pixel at the scale the path is drawn with
+  // is invisible
+  mesh::MeshHandle fill(const Path &path, JobSystem &jobs,
+                        FillRule rule = FillRule::NonZero,
+                        float tolerance = 0.25f) {
+    uint8_t mode = 0;
+    uint64_t key = path.hash();
+    key = mixKey(key, &mode, sizeof(mode));
+    key = mixKey(key, &rule, sizeof(rule));
+    key = mixKey(key, &tolerance, sizeof(tolerance));
+    return request(key, jobs, [path, rule, tolerance](mesh::MeshData &data) {
+      fillPath(path, rule, tolerance, data);
+    });
+  }
+
+  mesh::MeshHandle stroke(const Path &path, const StrokeStyle &style,
+                          JobSystem &jobs, float tolerance = 0.25f) {
+    uint8_t mode = 1;
+    uint64_t key = path.hash();
+    key = mixKey(key, &mode, sizeof(mode));
+    key = mixKey(key, &style.width, sizeof(style.width));
+    key = mixKey(key, &style.join, sizeof(style.join));
+    key = mixKey(key, &style.cap, sizeof(style.cap));
+    key = mixKey(key, &style.miterLimit, sizeof(style.miterLimit));
+    key = mixKey(key, &tolerance, sizeof(tolerance));
+    return request(key, jobs, [path, style, tolerance](mesh::MeshData &data) {
+      strokePath(path, style, tolerance, data);
+    });
+  }
+
+  // Adds the meshes tessellated since the last call and removes the ones
+  // not asked for in a while. Called once per update on the main thread.
+  void apply(mesh::MeshLibrary &meshes) {
+    std::vector<std::shared_ptr<Tessellated>> done{};
+    {
+      std::lock_guard<std::mutex> lock(finished->mutex);
+      done.swap(finished->meshes);
+    }
+
+    for (const auto &result : done) {
+      // Keys dropped by clear() while the job was running
+      auto found = entries.find(result->key);
+      if (found == entries.end() || !found->second.pending)
+        continue;
+      found->second.pending = false;
+      found->second.mesh =
+          meshes.add(new mesh::DataMesh(std::move(result->data)));
+      tessellated++;
+      tessellateTime += result->milliseconds;
+    }
+
+    frame++;
+    for (auto it = entries.begin(); it != entries.end();) {
+      const Entry &entry = it->second;
+      if (!entry.pending && frame - entry.lastUsed > maxUnusedFrames) {
+        meshes.remove(entry.mesh);
+        it = entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Does not touch the MeshLibrary, meant to be called with its clear()
+  void clear() { entries.clear(); }
+
+  uint32_t size() const { return entries.size(); }
+};
+
+} // namespace path
+} // namespace dank
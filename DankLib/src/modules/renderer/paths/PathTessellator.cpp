@@ -0,0 +1,441 @@
+#include "modules/renderer/paths/PathTessellator.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include "modules/renderer/paths/Path.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+using namespace dank;
+
+namespace {
+
+const uint32_t MAX_CURVE_SEGMENTS = 1024;
+
+void addPoint(path::Polyline &polyline, glm::vec2 point) {
+  if (polyline.points.empty() || polyline.points.back() != point) {
+    polyline.points.push_back(point);
+  }
+}
+
+// Uniform steps keep the chord error under tolerance when their count is
+// derived from the curve's second derivative: |B''| h^2 / 8
+uint32_t curveSegments(float secondDerivative, float tolerance) {
+  float n = std::ceil(std::sqrt(secondDerivative / (8.0f * tolerance)));
+  return glm::clamp<uint32_t>(n, 1, MAX_CURVE_SEGMENTS);
+}
+
+// Planar geometry written as Standard vertices, uvs span the bounds of the
+// output so a texture is stretched over the whole shape
+class Builder {
+public:
+  mesh::MeshData &output;
+
+  explicit Builder(mesh::MeshData &output) : output(output) {
+    output.format = mesh::VertexFormat::Standard;
+  }
+
+  uint32_t vertex(glm::vec2 position) {
+    output.vertices.push_back(mesh::VertexData{
+        glm::vec3(position, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), {0, 0}});
+    return output.vertices.size() - 1;
+  }
+
+  void triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    uint32_t first = vertex(a);
+    vertex(b);
+    vertex(c);
+    output.indices.insert(output.indices.end(),
+                          {first, first + 1, first + 2});
+  }
+
+  void quad(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d) {
+    uint32_t first = vertex(a);
+    vertex(b);
+    vertex(c);
+    vertex(d);
+    output.indices.insert(output.indices.end(), {first, first + 1, first + 2,
+                                                 first, first + 2, first + 3});
+  }
+
+  // Triangles around center from offset, turning by angle radians
+  void fan(glm::vec2 center, glm::vec2 offset, float angle, float tolerance) {
+    float radius = glm::length(offset);
+    if (radius <= 0)
+      return;
+    float step =
+        2.0f * std::acos(glm::clamp(1.0f - tolerance / radius, -1.0f, 1.0f));
+    uint32_t steps = glm::clamp<uint32_t>(
+        std::ceil(std::abs(angle) / std::max(step, 1e-3f)), 1,
+        MAX_CURVE_SEGMENTS);
+    uint32_t centerIndex = vertex(center);
+    uint32_t previous = vertex(center + offset);
+    for (uint32_t i = 1; i <= steps; i++) {
+      float a = angle * i / steps;
+      float c = std::cos(a);
+      float s = std::sin(a);
+      glm::vec2 rotated{offset.x * c - offset.y * s,
+                        offset.x * s + offset.y * c};
+      uint32_t next = vertex(center + rotated);
+      output.indices.insert(output.indices.end(),
+                            {centerIndex, previous, next});
+      previous = next;
+    }
+  }
+
+  void finish() {
+    if (output.vertices.empty())
+      return;
+    glm::vec2 min{std::numeric_limits<float>::max()};
+    glm::vec2 max{std::numeric_limits<float>::lowest()};
+    for (const auto &v : output.vertices) {
+      min = glm::min(min, glm::vec2(v.position));
+      max = glm::max(max, glm::vec2(v.position));
+    }
+    glm::vec2 size = glm::max(max - min, glm::vec2(1e-6f));
+    for (auto &v : output.vertices) {
+      v.uv = (glm::vec2(v.position) - min) / size;
+    }
+  }
+};
+
+struct Edge {
+  glm::vec2 top;
+  glm::vec2 bottom;
+  // +1 going down, -1 going up
+  int32_t winding;
+
+  float xAt(float y) const {
+    return top.x + (y - top.y) * (bottom.x - top.x) / (bottom.y - top.y);
+  }
+};
+
+// y where two edges cross strictly inside both, false when they do not
+bool crossing(const Edge &a, const Edge &b, float &y) {
+  glm::vec2 r = a.bottom - a.top;
+  glm::vec2 s = b.bottom - b.top;
+  float denominator = r.x * s.y - r.y * s.x;
+  if (std::abs(denominator) < 1e-12f)
+    return false;
+  glm::vec2 delta = b.top - a.top;
+  float t = (delta.x * s.y - delta.y * s.x) / denominator;
+  float u = (delta.x * r.y - delta.y * r.x) / denominator;
+  if (t <= 0 || t >= 1 || u <= 0 || u >= 1)
+    return false;
+  y = a.top.y + t * r.y;
+  return true;
+}
+
+void fillPolylines(const std::vector<path::Polyline> &polylines,
+                   path::FillRule rule, Builder &builder) {
+  std::vector<Edge> edges{};
+  for (const auto &polyline : polylines) {
+    const auto &points = polyline.points;
+    if (points.size() < 3)
+      continue;
+    for (size_t i = 0; i < points.size(); i++) {
+      glm::vec2 a = points[i];
+      glm::vec2 b = points[(i + 1) % points.size()];
+      if (a.y == b.y)
+        continue;
+      edges.push_back(a.y < b.y ? Edge{a, b, 1} : Edge{b, a, -1});
+    }
+  }
+  if (edges.empty())
+    return;
+  std::sort(edges.begin(), edges.end(),
+            [](const Edge &a, const Edge &b) { return a.top.y < b.top.y; });
+
+  // Band boundaries: every endpoint and every crossing, so no two edges
+  // swap places inside a band
+  std::vector<float> ys{};
+  for (size_t i = 0; i < edges.size(); i++) {
+    ys.push_back(edges[i].top.y);
+    ys.push_back(edges[i].bottom.y);
+    for (size_t j = i + 1;
+         j < edges.size() && edges[j].top.y < edges[i].bottom.y; j++) {
+      float y;
+      if (crossing(edges[i], edges[j], y)) {
+        ys.push_back(y);
+      }
+    }
+  }
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+  // Trapezoid corners are shared between neighbouring bands
+  std::unordered_map<uint64_t, uint32_t> welded{};
+  auto vertex = [&](float x, float y) {
+    uint32_t bx, by;
+    memcpy(&bx, &x, sizeof(float));
+    memcpy(&by, &y, sizeof(float));
+    uint32_t index = builder.output.vertices.size();
+    auto inserted = welded.emplace((uint64_t(bx) << 32) | by, index);
+    if (inserted.second) {
+      builder.vertex({x, y});
+    }
+    return inserted.first->second;
+  };
+
+  struct Crossing {
+    float x0;
+    float x1;
+    int32_t winding;
+  };
+  std::vector<const Edge *> active{};
+  std::vector<Crossing> crossings{};
+  size_t next = 0;
+  for (size_t band = 0; band + 1 < ys.size(); band++) {
+    float y0 = ys[band];
+    float y1 = ys[band + 1];
+    active.erase(std::remove_if(active.begin(), active.end(),
+                                [y0](const Edge *edge) {
+                                  return edge->bottom.y <= y0;
+                                }),
+                 active.end());
+    while (next < edges.size() && edges[next].top.y <= y0) {
+      if (edges[next].bottom.y > y0) {
+        active.push_back(&edges[next]);
+      }
+      next++;
+    }
+
+    crossings.clear();
+    for (const Edge *edge : active) {
+      crossings.push_back(
+          Crossing{edge->xAt(y0), edge->xAt(y1), edge->winding});
+    }
+    std::sort(crossings.begin(), crossings.end(),
+              [](const Crossing &a, const Crossing &b) {
+                return a.x0 + a.x1 < b.x0 + b.x1;
+              });
+
+    int32_t winding = 0;
+    const Crossing *left = nullptr;
+    for (const auto &crossing : crossings) {
+      bool wasInside = rule == path::FillRule::NonZero ? winding != 0
+                                                       : (winding & 1) != 0;
+      winding += crossing.winding;
+      bool inside = rule == path::FillRule::NonZero ? winding != 0
+                                                    : (winding & 1) != 0;
+      if (!wasInside && inside) {
+        left = &crossing;
+      } else if (wasInside && !inside && left != nullptr) {
+        uint32_t a = vertex(left->x0, y0);
+        uint32_t b = vertex(crossing.x0, y0);
+        uint32_t c = vertex(crossing.x1, y1);
+        uint32_t d = vertex(left->x1, y1);
+        auto &indices = builder.output.indices;
+        // One side of the trapezoid may have collapsed into a point
+        if (a != b) {
+          indices.insert(indices.end(), {a, b, c});
+        }
+        if (c != d) {
+          indices.insert(indices.end(), {a, c, d});
+        }
+        left = nullptr;
+      }
+    }
+  }
+}
+
+void strokeCap(Builder &builder, glm::vec2 point, glm::vec2 direction,
+               const path::StrokeStyle &style, float tolerance) {
+  float halfWidth = style.width * 0.5f;
+  glm::vec2 normal = glm::vec2(-direction.y, direction.x) * halfWidth;
+  glm::vec2 extent = direction * halfWidth;
+  switch (style.cap) {
+  case path::LineCap::Butt:
+    break;
+  case path::LineCap::Square:
+    builder.quad(point + normal, point - normal, point - normal + extent,
+                 point + normal + extent);
+    break;
+  case path::LineCap::Round:
+    builder.fan(point, -normal, glm::pi<float>(), tolerance);
+    break;
+  }
+}
+
+// Fills the wedge on the outer side of the turn from d0 to d1
+void strokeJoin(Builder &builder, glm::vec2 point, glm::vec2 d0,
+                glm::vec2 d1, const path::StrokeStyle &style,
+                float tolerance) {
+  float cross = d0.x * d1.y - d0.y * d1.x;
+  float dot = glm::dot(d0, d1);
+  if (std::abs(cross) < 1e-6f && dot > 0)
+    return;
+
+  float halfWidth = style.width * 0.5f;
+  // Turning left the outer side is on the right
+  float side = cross > 0 ? -1.0f : 1.0f;
+  glm::vec2 n0 = glm::vec2(-d0.y, d0.x) * side;
+  glm::vec2 n1 = glm::vec2(-d1.y, d1.x) * side;
+  glm::vec2 o0 = n0 * halfWidth;
+  glm::vec2 o1 = n1 * halfWidth;
+
+  path::LineJoin join = style.join;
+  glm::vec2 miter{0.0f};
+  if (join == path::LineJoin::Miter) {
+    glm::vec2 sum = n0 + n1;
+    float length = glm::length(sum);
+    float cosHalf = length * 0.5f;
+    if (length < 1e-6f || 1.0f / cosHalf > style.miterLimit) {
+      join = path::LineJoin::Bevel;
+    } else {
+      miter = sum / length * (halfWidth / cosHalf);
+    }
+  }
+
+  switch (join) {
+  case path::LineJoin::Miter:
+    builder.quad(point, point + o0, point + miter, point + o1);
+    break;
+  case path::LineJoin::Bevel:
+    builder.triangle(point, point + o0, point + o1);
+    break;
+  case path::LineJoin::Round: {
+    float angle = std::acos(glm::clamp(glm::dot(n0, n1), -1.0f, 1.0f));
+    builder.fan(point, o0, o0.x * o1.y - o0.y * o1.x >= 0 ? angle : -angle,
+                tolerance);
+    break;
+  }
+  }
+}
+
+void strokePolyline(Builder &builder, const path::Polyline &polyline,
+                    const path::StrokeStyle &style, float tolerance) {
+  const auto &points = polyline.points;
+  float halfWidth = style.width * 0.5f;
+
+  // A subpath without length still gets its caps, facing along x
+  if (points.size() == 1) {
+    strokeCap(builder, points[0], {1, 0}, style, tolerance);
+    strokeCap(builder, points[0], {-1, 0}, style, tolerance);
+    return;
+  }
+
+  size_t count = points.size();
+  size_t segments = polyline.closed ? count : count - 1;
+  auto direction = [&](size_t segment) {
+    return glm::normalize(points[(segment + 1) % count] - points[segment]);
+  };
+
+  for (size_t i = 0; i < segments; i++) {
+    glm::vec2 a = points[i];
+    glm::vec2 b = points[(i + 1) % count];
+    glm::vec2 d = direction(i);
+    glm::vec2 n = glm::vec2(-d.y, d.x) * halfWidth;
+    builder.quad(a + n, a - n, b - n, b + n);
+    if (i + 1 < segments || polyline.closed) {
+      strokeJoin(builder, b, d, direction((i + 1) % segments), style,
+                 tolerance);
+    }
+  }
+
+  if (!polyline.closed) {
+    strokeCap(builder, points[0], -direction(0), style, tolerance);
+    strokeCap(builder, points[count - 1], direction(segments - 1), style,
+              tolerance);
+  }
+}
+
+} // namespace
+
+void path::flattenPath(const Path &path, float tolerance,
+                       std::vector<Polyline> &output) {
+  tolerance = std::max(tolerance, 1e-4f);
+  const auto &verbs = path.getVerbs();
+  const auto &points = path.getPoints();
+
+  Polyline current{};
+  // Subpaths that are only a Move draw nothing
+  bool drawn = false;
+  auto finish = [&]() {
+    if (drawn && !current.points.empty()) {
+      output.push_back(std::move(current));
+    }
+    current = Polyline{};
+    drawn = false;
+  };
+
+  size_t p = 0;
+  for (PathVerb verb : verbs) {
+    switch (verb) {
+    case PathVerb::Move:
+      finish();
+      addPoint(current, points[p]);
+      break;
+    case PathVerb::Line:
+      addPoint(current, points[p]);
+      drawn = true;
+      break;
+    case PathVerb::Quad: {
+      glm::vec2 p0 = current.points.back();
+      glm::vec2 c = points[p];
+      glm::vec2 p1 = points[p + 1];
+      // B'' = 2 (p0 - 2c + p1)
+      uint32_t n = curveSegments(2.0f * glm::length(p0 - 2.0f * c + p1),
+                                 tolerance);
+      for (uint32_t i = 1; i <= n; i++) {
+        float t = i / float(n);
+        float u = 1.0f - t;
+        addPoint(current, u * u * p0 + 2.0f * u * t * c + t * t * p1);
+      }
+      drawn = true;
+      break;
+    }
+    case PathVerb::Cubic: {
+      glm::vec2 p0 = current.points.back();
+      glm::vec2 c0 = points[p];
+      glm::vec2 c1 = points[p + 1];
+      glm::vec2 p1 = points[p + 2];
+      // |B''| <= 6 max(|p0 - 2c0 + c1|, |c0 - 2c1 + p1|)
+      float bound = 6.0f * std::max(glm::length(p0 - 2.0f * c0 + c1),
+                                    glm::length(c0 - 2.0f * c1 + p1));
+      uint32_t n = curveSegments(bound, tolerance);
+      for (uint32_t i = 1; i <= n; i++) {
+        float t = i / float(n);
+        float u = 1.0f - t;
+        addPoint(current, u * u * u * p0 + 3.0f * u * u * t * c0 +
+                              3.0f * u * t * t * c1 + t * t * t * p1);
+      }
+      drawn = true;
+      break;
+    }
+    case PathVerb::Close:
+      current.closed = true;
+      if (current.points.size() > 1 &&
+          current.points.back() == current.points.front()) {
+        current.points.pop_back();
+      }
+      finish();
+      break;
+    }
+    p += Path::pointCount(verb);
+  }
+  finish();
+}
+
+void path::fillPath(const Path &path, FillRule rule, float tolerance,
+                    mesh::MeshData &output) {
+  std::vector<Polyline> polylines{};
+  flattenPath(path, tolerance, polylines);
+  Builder builder(output);
+  fillPolylines(polylines, rule, builder);
+  builder.finish();
+}
+
+void path::strokePath(const Path &path, const StrokeStyle &style,
+                      float tolerance, mesh::MeshData &output) {
+  std::vector<Polyline> polylines{};
+  flattenPath(path, tolerance, polylines);
+  Builder builder(output);
+  if (style.width > 0) {
+    for (const auto &polyline : polylines) {
+      strokePolyline(builder, polyline, style, std::max(tolerance, 1e-4f));
+    }
+  }
+  builder.finish();
+}
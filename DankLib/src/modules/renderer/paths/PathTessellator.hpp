@@ -0,0 +1,52 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace mesh {
+struct MeshData;
+}
+
+namespace path {
+
+class Path;
+
+enum class FillRule : uint8_t { NonZero, EvenOdd };
+enum class LineJoin : uint8_t { Miter, Round, Bevel };
+enum class LineCap : uint8_t { Butt, Round, Square };
+
+struct StrokeStyle {
+  float width = 1.0f;
+  LineJoin join = LineJoin::Miter;
+  LineCap cap = LineCap::Butt;
+  // Miters longer than this many half widths fall back to a bevel
+  float miterLimit = 4.0f;
+};
+
+// Subpath flattened into line segments
+struct Polyline {
+  std::vector<glm::vec2> points{};
+  bool closed = false;
+};
+
+// Replaces curves with segments deviating at most tolerance from them, in
+// path units. Consecutive duplicate points are dropped.
+void flattenPath(const Path &path, float tolerance,
+                 std::vector<Polyline> &output);
+
+// Triangulates the inside of the path by the fill rule, open subpaths are
+// closed implicitly. The area is cut into trapezoids between the y of every
+// vertex and edge crossing, so self intersecting and nested contours need
+// no special casing.
+void fillPath(const Path &path, FillRule rule, float tolerance,
+              mesh::MeshData &output);
+
+// Outline of width around every subpath, with joins between segments and
+// caps at the ends of open subpaths. Segments, joins and caps are separate
+// triangles that may overlap.
+void strokePath(const Path &path, const StrokeStyle &style, float tolerance,
+                mesh::MeshData &output);
+
+} // namespace path
+} // namespace dank
@@ -0,0 +1,413 @@
+#include "modules/renderer/text/GlyphAtlas.hpp"
+#include "libs/stb/stb_truetype.h"
+#include "modules/engine/Console.hpp"
+#include "modules/os/OS.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace dank;
+
+// Font file parsed by stb_truetype, shared with the jobs rasterizing its
+// glyphs so the font can go away while they run. Only read once Ready.
+struct text::GlyphAtlas::Source {
+  URI uri{};
+  ResourceData resource{0, nullptr};
+  stbtt_fontinfo info{};
+  // Ems per font unit
+  float emScale = 0;
+  // Written by the job, then published by storing state with release
+  std::atomic<ResourceState> state{ResourceState::Loading};
+
+  ~Source() { free(resource.data); }
+};
+
+struct text::GlyphAtlas::Raster {
+  std::shared_ptr<Source> source{};
+  uint64_t key = 0;
+  int index = 0;
+  float glyphSize = 0;
+  int room = 0;
+  int spread = 0;
+  // Distance field of width x height texels, empty for glyphs without an
+  // outline. x, y is its top left corner from the pen, y down.
+  texture::PixelBuffer texels{};
+  int width = 0;
+  int height = 0;
+  int x = 0;
+  int y = 0;
+  float pixelsPerEm = 0;
+  std::atomic<bool> cancelled{false};
+  std::atomic<ResourceState> state{ResourceState::Loading};
+};
+
+namespace {
+
+// Font handles index 2^32 fonts at most, codepoints stop at U+10FFFF
+uint64_t getGlyphKey(text::FontHandle font, uint32_t codepoint) {
+  return uint64_t(font.index) << 32 | codepoint;
+}
+
+} // namespace
+
+uint32_t text::nextCodepoint(const std::string &text, size_t &offset) {
+  const uint32_t REPLACEMENT = 0xFFFD;
+  auto byte = [&](size_t i) { return static_cast<uint8_t>(text[i]); };
+  uint8_t lead = byte(offset++);
+  if (lead < 0x80)
+    return lead;
+
+  uint32_t length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+  if (length == 0 || lead > 0xF4 || offset + length > text.size())
+    return REPLACEMENT;
+  uint32_t codepoint = lead & (0x3F >> length);
+  for (uint32_t i = 0; i < length; i++) {
+    uint8_t next = byte(offset + i);
+    if ((next & 0xC0) != 0x80)
+      return REPLACEMENT;
+    codepoint = codepoint << 6 | (next & 0x3F);
+  }
+  offset += length;
+
+  // Overlong forms and surrogates are not characters
+  const uint32_t smallest[4] = {0, 0x80, 0x800, 0x10000};
+  if (codepoint < smallest[length] || codepoint > 0x10FFFF ||
+      (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+    return REPLACEMENT;
+  return codepoint;
+}
+
+text::FontHandle text::GlyphAtlas::add(const URI &uri) {
+  Entry entry{};
+  entry.uri = uri;
+  return fonts.insert(entry);
+}
+
+void text::GlyphAtlas::update(texture::TextureLibrary &library,
+                              JobSystem &jobs, uint32_t frame) {
+  // The cache went away with a TextureLibrary::clear
+  auto *cache = static_cast<GlyphCache *>(library.get(cacheTexture));
+  if (cache == nullptr) {
+    cellsPerRow = std::max(cacheSize / std::max(cellSize, 1u), 1u);
+    cache = new GlyphCache(cellsPerRow * cellSize);
+    cacheTexture = library.add(cache);
+    cells.clear();
+  }
+  if (cells.empty()) {
+    resetCells();
+  }
+
+  updateSources(jobs);
+  applyRasters(*cache, frame);
+
+  // Glyphs left out are asked for again by the next frames still missing
+  // them
+  for (uint64_t key : wanted) {
+    auto found = glyphs.find(key);
+    if (found == glyphs.end())
+      continue;
+    GlyphEntry &glyph = found->second;
+    Entry *font = fonts.get(glyph.font);
+    if (font == nullptr || rasters.size() >= maxRastersInFlight) {
+      glyph.requested = false;
+      continue;
+    }
+    auto raster = std::make_shared<Raster>();
+    raster->source = font->source;
+    raster->key = key;
+    raster->index = glyph.index;
+    raster->glyphSize = glyphSize;
+    raster->spread = spread;
+    raster->room = int(cellSize) - 2 * int(spread);
+    rasters.push_back(raster);
+    jobs.submit([raster]() {
+      if (!raster->cancelled) {
+        rasterize(*raster);
+      }
+      raster->state.store(raster->cancelled ? ResourceState::Invalid
+                                            : ResourceState::Ready,
+                          std::memory_order_release);
+    });
+  }
+  wanted.clear();
+}
+
+void text::GlyphAtlas::updateSources(JobSystem &jobs) {
+  for (uint32_t i = 0; i < fonts.size(); i++) {
+    Entry &entry = fonts.valueAt(i);
+    if (entry.state != ResourceState::Loading)
+      continue;
+
+    if (entry.source == nullptr) {
+      auto source = std::make_shared<Source>();
+      source->uri = entry.uri;
+      entry.source = source;
+      jobs.submit([source]() {
+        if (dank::os != nullptr) {
+          dank::os->getDataFromURI(source->uri, source->resource);
+        }
+        const auto *bytes =
+            static_cast<const unsigned char *>(source->resource.data);
+        int offset = bytes != nullptr && source->resource.size > 0
+                         ? stbtt_GetFontOffsetForIndex(bytes, 0)
+                         : -1;
+        bool parsed =
+            offset >= 0 && stbtt_InitFont(&source->info, bytes, offset) != 0;
+        if (parsed) {
+          source->emScale = stbtt_ScaleForMappingEmToPixels(&source->info, 1);
+        }
+        source->state.store(parsed ? ResourceState::Ready
+                                   : ResourceState::Invalid,
+                            std::memory_order_release);
+      });
+      continue;
+    }
+
+    Source &source = *entry.source;
+    ResourceState state = source.state.load(std::memory_order_acquire);
+    if (state == ResourceState::Loading)
+      continue;
+    if (state == ResourceState::Invalid) {
+      console::warn("[GlyphAtlas] could not read font %s",
+                    entry.uri.path.c_str());
+      entry.state = ResourceState::Invalid;
+      entry.source = nullptr;
+      continue;
+    }
+
+    int ascent = 0, descent = 0, lineGap = 0;
+    stbtt_GetFontVMetrics(&source.info, &ascent, &descent, &lineGap);
+    entry.ascent = ascent * source.emScale;
+    entry.descent = descent * source.emScale;
+    entry.lineGap = lineGap * source.emScale;
+    entry.state = ResourceState::Ready;
+    console::log("[GlyphAtlas] %s: %d glyphs", entry.uri.path.c_str(),
+                 source.info.numGlyphs);
+  }
+}
+
+void text::GlyphAtlas::applyRasters(GlyphCache &cache, uint32_t frame) {
+  bool modified = false;
+  for (size_t i = 0; i < rasters.size();) {
+    Raster &raster = *rasters[i];
+    ResourceState state = raster.state.load(std::memory_order_acquire);
+    if (state == ResourceState::Loading) {
+      i++;
+      continue;
+    }
+
+    auto found = glyphs.find(raster.key);
+    GlyphEntry *glyph = found != glyphs.end() ? &found->second : nullptr;
+    if (glyph != nullptr) {
+      glyph->requested = false;
+    }
+    if (glyph != nullptr && state == ResourceState::Ready &&
+        glyph->cell == 0) {
+      if (!raster.texels) {
+        glyph->blank = true;
+        glyph->glyph = Glyph{};
+      } else {
+        // A free cell, otherwise the least recently used one no frame in
+        // flight draws. With none the glyph is asked for again.
+        uint32_t chosen = UINT32_MAX;
+        uint32_t oldest = UINT32_MAX;
+        for (uint32_t c = 0; c < cells.size(); c++) {
+          const Cell &cell = cells[c];
+          if (!cell.used) {
+            chosen = c;
+            break;
+          }
+          if (cell.lastUsed + FRAMES_IN_FLIGHT < frame &&
+              cell.lastUsed < oldest) {
+            chosen = c;
+            oldest = cell.lastUsed;
+          }
+        }
+
+        if (chosen != UINT32_MAX) {
+          Cell &cell = cells[chosen];
+          if (cell.used) {
+            auto previous = glyphs.find(cell.key);
+            if (previous != glyphs.end()) {
+              previous->second.cell = 0;
+            }
+            evictions++;
+          } else {
+            residentGlyphs++;
+          }
+          cell = Cell{raster.key, frame, true};
+          glyph->cell = chosen + 1;
+
+          uint32_t x = chosen % cellsPerRow * cellSize;
+          uint32_t y = chosen / cellsPerRow * cellSize;
+          uint32_t width = std::min(uint32_t(raster.width), cellSize);
+          uint32_t height = std::min(uint32_t(raster.height), cellSize);
+          for (uint32_t row = 0; row < cellSize; row++) {
+            uint8_t *target =
+                cache.pixels.data() + size_t(y + row) * cache.size + x;
+            memset(target, 0, cellSize);
+            if (row < height) {
+              memcpy(target, raster.texels.data() + row * raster.width,
+                     width);
+            }
+          }
+          cache.updates.push_back(
+              texture::TextureUpdate{x, y, cellSize, cellSize});
+
+          float ems = 1.0f / raster.pixelsPerEm;
+          glyph->glyph.quad =
+              glm::vec4(raster.x, -raster.y - int(height), width, height) *
+              ems;
+          glyph->glyph.cacheRect =
+              glm::vec4(x, y, width, height) / float(cache.size);
+          modified = true;
+          glyphsRasterized++;
+        }
+      }
+    }
+    rasters[i] = std::move(rasters.back());
+    rasters.pop_back();
+  }
+  if (modified) {
+    cache.lastModified++;
+  }
+}
+
+text::GlyphAtlas::GlyphEntry *text::GlyphAtlas::find(FontHandle font,
+                                                     uint32_t codepoint) {
+  Entry *entry = fonts.get(font);
+  if (entry == nullptr || entry->state != ResourceState::Ready)
+    return nullptr;
+  uint64_t key = getGlyphKey(font, codepoint);
+  auto found = glyphs.find(key);
+  if (found != glyphs.end())
+    return &found->second;
+
+  const stbtt_fontinfo &info = entry->source->info;
+  GlyphEntry glyph{};
+  glyph.font = font;
+  glyph.index = stbtt_FindGlyphIndex(&info, int(codepoint));
+  int advance = 0, bearing = 0;
+  stbtt_GetGlyphHMetrics(&info, glyph.index, &advance, &bearing);
+  glyph.advance = advance * entry->source->emScale;
+  return &glyphs.emplace(key, glyph).first->second;
+}
+
+float text::GlyphAtlas::getAdvance(FontHandle font, uint32_t codepoint,
+                                   uint32_t next) {
+  GlyphEntry *glyph = find(font, codepoint);
+  if (glyph == nullptr)
+    return 0;
+  float advance = glyph->advance;
+  GlyphEntry *following = next != 0 ? find(font, next) : nullptr;
+  if (following != nullptr) {
+    const Source &source = *fonts.get(font)->source;
+    advance += stbtt_GetGlyphKernAdvance(&source.info, glyph->index,
+                                         following->index) *
+               source.emScale;
+  }
+  return advance;
+}
+
+bool text::GlyphAtlas::resolve(FontHandle font, uint32_t codepoint,
+                               uint32_t frame, Glyph &output) {
+  GlyphEntry *glyph = find(font, codepoint);
+  if (glyph == nullptr || cells.empty())
+    return false;
+  if (glyph->blank || glyph->cell > 0) {
+    if (glyph->cell > 0) {
+      cells[glyph->cell - 1].lastUsed = frame;
+    }
+    output = glyph->glyph;
+    return true;
+  }
+  if (!glyph->requested) {
+    glyph->requested = true;
+    wanted.push_back(getGlyphKey(font, codepoint));
+  }
+  return false;
+}
+
+uint32_t text::layoutText(GlyphAtlas &glyphs, FontHandle font,
+                          const std::string &text, uint32_t frame,
+                          std::vector<PlacedGlyph> &output) {
+  const Font *metrics = glyphs.get(font);
+  if (metrics == nullptr || metrics->state != ResourceState::Ready)
+    return 0;
+  float lineHeight = metrics->ascent - metrics->descent + metrics->lineGap;
+
+  // One codepoint ahead for the kerning
+  uint32_t missing = 0;
+  size_t offset = 0;
+  uint32_t next = offset < text.size() ? nextCodepoint(text, offset) : 0;
+  glm::vec2 pen{0.0f};
+  while (next != 0) {
+    uint32_t codepoint = next;
+    next = offset < text.size() ? nextCodepoint(text, offset) : 0;
+    if (codepoint == '\n') {
+      pen = glm::vec2(0.0f, pen.y - lineHeight);
+      continue;
+    }
+
+    Glyph glyph{};
+    if (!glyphs.resolve(font, codepoint, frame, glyph)) {
+      missing++;
+    } else if (glyph.quad.z > 0 && glyph.quad.w > 0) {
+      output.push_back(PlacedGlyph{
+          glm::vec4(pen + glm::vec2(glyph.quad), glyph.quad.z, glyph.quad.w),
+          glyph.cacheRect});
+    }
+    pen.x += glyphs.getAdvance(font, codepoint, next != '\n' ? next : 0);
+  }
+  return missing;
+}
+
+void text::GlyphAtlas::resetCells() {
+  cells.assign(cellsPerRow * cellsPerRow, Cell{});
+  residentGlyphs = 0;
+  for (auto &[key, glyph] : glyphs) {
+    glyph.cell = 0;
+  }
+}
+
+void text::GlyphAtlas::clear() {
+  for (auto &raster : rasters) {
+    raster->cancelled = true;
+  }
+  rasters.clear();
+  wanted.clear();
+  glyphs.clear();
+  fonts.clear();
+  cells.clear();
+  residentGlyphs = 0;
+}
+
+void text::GlyphAtlas::rasterize(Raster &raster) {
+  const stbtt_fontinfo &info = raster.source->info;
+  float scale = raster.source->emScale * raster.glyphSize;
+  // Bitmap boxes round outwards, so a box scaled down to the room may still
+  // be a texel too large
+  for (int attempt = 0; attempt < 4 && raster.room > 0; attempt++) {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    stbtt_GetGlyphBitmapBox(&info, raster.index, scale, scale, &x0, &y0, &x1,
+                            &y1);
+    int extent = std::max(x1 - x0, y1 - y0);
+    if (extent <= raster.room)
+      break;
+    scale *= float(raster.room) / float(extent + 1);
+  }
+
+  int width = 0, height = 0, x = 0, y = 0;
+  unsigned char *field = stbtt_GetGlyphSDF(
+      &info, scale, raster.index, raster.spread, text::GLYPH_EDGE_VALUE,
+      float(text::GLYPH_EDGE_VALUE) / float(std::max(raster.spread, 1)),
+      &width, &height, &x, &y);
+  raster.texels = texture::PixelBuffer(
+      field, size_t(width) * height,
+      [](uint8_t *bytes) { stbtt_FreeSDF(bytes, nullptr); });
+  raster.width = width;
+  raster.height = height;
+  raster.x = x;
+  raster.y = y;
+  raster.pixelsPerEm = scale / raster.source->emScale;
+}
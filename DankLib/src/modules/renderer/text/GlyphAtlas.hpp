@@ -0,0 +1,209 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/os/JobSystem.hpp"
+#include "modules/os/URI.hpp"
+#include "modules/renderer/textures/Texture.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dank {
+namespace text {
+
+// Value of the distance fields on the outline, inside is brighter. Must
+// match GLYPH_EDGE in the shaders.
+const uint8_t GLYPH_EDGE_VALUE = 128;
+
+// R8 texture holding the distance fields of the resident glyphs, a grid of
+// cells. Glyphs are copied into the CPU pixels as they are rasterized, and
+// only the cells written since the last upload are listed for the renderer.
+class GlyphCache : public texture::Texture {
+public:
+  uint32_t size;
+  texture::PixelBuffer pixels;
+  std::vector<texture::TextureUpdate> updates{};
+  uint32_t lastModified = 1;
+
+  explicit GlyphCache(uint32_t size)
+      : size(size),
+        pixels(texture::PixelBuffer::allocate(size_t(size) * size, true)) {}
+
+  texture::TextureType getType() override {
+    return texture::TextureType::Color;
+  }
+
+  // A new texture is always uploaded whole, so nothing is lost with it
+  bool isReloadable() override { return true; }
+  void reload() override { lastModified++; }
+
+  void fetchData(texture::TextureData &output) override {
+    output.state = ResourceState::Ready;
+    output.lastModified = lastModified;
+    output.width = size;
+    output.height = size;
+    output.channels = 1;
+    output.format = PixelFormat::R8Unorm;
+    output.pixels = pixels;
+    output.updates = updates.data();
+    output.updateCount = updates.size();
+  }
+
+  void releaseData(texture::TextureData &output) override { updates.clear(); }
+};
+
+struct FontTag;
+typedef Handle<FontTag> FontHandle;
+
+// Vertical metrics of a font in ems, Loading until its file is parsed.
+// descent is negative, lines are ascent - descent + lineGap apart.
+struct Font {
+  ResourceState state = ResourceState::Loading;
+  float ascent = 0;
+  float descent = 0;
+  float lineGap = 0;
+};
+
+// Where a glyph is drawn from: its quad around the pen on the baseline in
+// ems, y up, and the matching part of the cache, normalized with y down,
+// both as offset (xy) and size (zw). Glyphs without an outline, e.g. the
+// space, have an empty quad.
+struct Glyph {
+  glm::vec4 quad{0.0f};
+  glm::vec4 cacheRect{0.0f};
+};
+
+// Decodes the UTF-8 character at offset and moves offset past it, invalid
+// bytes decode to U+FFFD one at a time
+uint32_t nextCodepoint(const std::string &text, size_t &offset);
+
+// Signed distance field glyphs of TrueType fonts (stb_truetype), rasterized
+// on demand on the JobSystem into a single cache texture shared by every
+// font and size. Fields are rasterized once at glyphSize pixels per em and
+// drawn at any size, the shader keeps the edge about a pixel wide wherever
+// they are magnified or minified. Glyphs larger than a cell are rasterized
+// smaller to fit.
+//
+// layoutText() places the glyphs of a string with getAdvance() and asks for
+// them with resolve(), which marks them used and requests the missing ones.
+// update() rasterizes those into the least recently used cells no frame in
+// flight draws anymore; a glyph not resident yet is left out of the frame.
+//
+// The cache texture is owned by the TextureLibrary, clear both together
+// like the TextureAtlas.
+class GlyphAtlas {
+private:
+  struct Source;
+  struct Raster;
+
+  struct Entry : Font {
+    URI uri{};
+    std::shared_ptr<Source> source{};
+  };
+
+  struct GlyphEntry {
+    FontHandle font{};
+    int index = 0;
+    // Horizontal advance in ems
+    float advance = 0;
+    Glyph glyph{};
+    // Cell + 1, 0 when not resident
+    uint32_t cell = 0;
+    // Being rasterized, or asked for this frame
+    bool requested = false;
+    // Nothing to draw, resident without a cell
+    bool blank = false;
+  };
+
+  struct Cell {
+    uint64_t key = 0;
+    uint32_t lastUsed = 0;
+    bool used = false;
+  };
+
+  SlotMap<Entry, FontTag> fonts{};
+  std::unordered_map<uint64_t, GlyphEntry> glyphs{};
+  texture::TextureHandle cacheTexture{};
+  std::vector<Cell> cells{};
+  uint32_t cellsPerRow = 0;
+  std::vector<uint64_t> wanted{};
+  std::vector<std::shared_ptr<Raster>> rasters{};
+  uint32_t residentGlyphs = 0;
+
+  // Field of a glyph at the largest scale up to glyphSize pixels per em
+  // that fits a cell, on a job
+  static void rasterize(Raster &raster);
+  void updateSources(JobSystem &jobs);
+  void applyRasters(GlyphCache &cache, uint32_t frame);
+  GlyphEntry *find(FontHandle font, uint32_t codepoint);
+  void resetCells();
+
+public:
+  // Texels across the cache texture, rounded down to whole cells when the
+  // cache is created
+  uint32_t cacheSize = 1024;
+  // Texels across a cell, the room of a glyph and its spread
+  uint32_t cellSize = 48;
+  // Pixels per em the distance fields are rasterized at
+  float glyphSize = 32.0f;
+  // Texels of distance kept on both sides of the outline
+  uint32_t spread = 4;
+  // Glyphs rasterized on the JobSystem at the same time
+  uint32_t maxRastersInFlight = 32;
+
+  // Glyphs rasterized and cells taken from other glyphs, summed until the
+  // engine logs and resets them
+  uint32_t glyphsRasterized = 0;
+  uint32_t evictions = 0;
+
+  ~GlyphAtlas() { clear(); }
+
+  // The font is Loading until update() parsed its file on the JobSystem.
+  // TrueType collections use their first font.
+  FontHandle add(const URI &uri);
+
+  // Applies the glyphs rasterized and the fonts parsed since the last
+  // call, then rasterizes the glyphs resolve() asked for. Once per update.
+  void update(texture::TextureLibrary &library, JobSystem &jobs,
+              uint32_t frame);
+
+  // Pen advance in ems from codepoint to next, kerning included when next
+  // is not 0. 0 while the font is not Ready.
+  float getAdvance(FontHandle font, uint32_t codepoint, uint32_t next);
+
+  // Resident glyph of codepoint, false when it is not yet and it was asked
+  // for. Fonts without the codepoint draw their missing glyph.
+  bool resolve(FontHandle font, uint32_t codepoint, uint32_t frame,
+               Glyph &output);
+
+  // nullptr when the handle is stale
+  const Font *get(FontHandle handle) const { return fonts.get(handle); }
+
+  texture::TextureHandle getCacheTexture() const { return cacheTexture; }
+  uint32_t getCellCount() const { return cells.size(); }
+  uint32_t getResidentGlyphs() const { return residentGlyphs; }
+  uint32_t getRastersInFlight() const { return rasters.size(); }
+
+  // Does not touch the TextureLibrary, meant to be called with its clear()
+  void clear();
+};
+
+// Glyph of a laid out string: its quad in ems from the origin, y up, and the
+// part of the cache it is drawn from, as offset (xy) and size (zw)
+struct PlacedGlyph {
+  glm::vec4 quad;
+  glm::vec4 cacheRect;
+};
+
+// Lays out text in ems from the origin on the first baseline, each line
+// below the previous one, and appends the glyphs with an outline that are
+// resident to output. Returns how many were not, they are asked for.
+// Nothing is laid out until the font is Ready.
+uint32_t layoutText(GlyphAtlas &glyphs, FontHandle font,
+                    const std::string &text, uint32_t frame,
+                    std::vector<PlacedGlyph> &output);
+
+} // namespace text
+} // namespace dank
@@ -0,0 +1,116 @@
+#include "modules/renderer/textures/AtlasPacker.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace dank;
+
+static bool contains(const texture::AtlasRect &a, const texture::AtlasRect &b) {
+  return b.x >= a.x && b.y >= a.y && b.x + b.width <= a.x + a.width &&
+         b.y + b.height <= a.y + a.height;
+}
+
+void texture::AtlasPacker::reset(uint32_t width, uint32_t height) {
+  this->width = width;
+  this->height = height;
+  freeRects.clear();
+  if (width > 0 && height > 0) {
+    freeRects.push_back(AtlasRect{0, 0, width, height});
+  }
+  usedArea = 0;
+}
+
+bool texture::AtlasPacker::insert(uint32_t width, uint32_t height,
+                                  AtlasRect &output) {
+  if (width == 0 || height == 0)
+    return false;
+
+  // The free rectangle leaving the smallest leftover on its shorter side,
+  // ties broken by the longer side
+  uint32_t bestShort = std::numeric_limits<uint32_t>::max();
+  uint32_t bestLong = std::numeric_limits<uint32_t>::max();
+  bool found = false;
+  for (const auto &rect : freeRects) {
+    if (rect.width < width || rect.height < height)
+      continue;
+    uint32_t leftoverX = rect.width - width;
+    uint32_t leftoverY = rect.height - height;
+    uint32_t shortSide = std::min(leftoverX, leftoverY);
+    uint32_t longSide = std::max(leftoverX, leftoverY);
+    if (shortSide < bestShort ||
+        (shortSide == bestShort && longSide < bestLong)) {
+      output = AtlasRect{rect.x, rect.y, width, height};
+      bestShort = shortSide;
+      bestLong = longSide;
+      found = true;
+    }
+  }
+  if (!found)
+    return false;
+
+  split(output);
+  prune();
+  usedArea += uint64_t(width) * height;
+  return true;
+}
+
+// Every free rectangle overlapping the used one is replaced by up to four
+// maximal rectangles around it
+void texture::AtlasPacker::split(const AtlasRect &used) {
+  size_t count = freeRects.size();
+  for (size_t i = 0; i < count;) {
+    AtlasRect rect = freeRects[i];
+    if (used.x >= rect.x + rect.width || used.x + used.width <= rect.x ||
+        used.y >= rect.y + rect.height || used.y + used.height <= rect.y) {
+      i++;
+      continue;
+    }
+
+    if (used.x > rect.x) {
+      freeRects.push_back(
+          AtlasRect{rect.x, rect.y, used.x - rect.x, rect.height});
+    }
+    if (used.x + used.width < rect.x + rect.width) {
+      uint32_t x = used.x + used.width;
+      freeRects.push_back(
+          AtlasRect{x, rect.y, rect.x + rect.width - x, rect.height});
+    }
+    if (used.y > rect.y) {
+      freeRects.push_back(
+          AtlasRect{rect.x, rect.y, rect.width, used.y - rect.y});
+    }
+    if (used.y + used.height < rect.y + rect.height) {
+      uint32_t y = used.y + used.height;
+      freeRects.push_back(
+          AtlasRect{rect.x, y, rect.width, rect.y + rect.height - y});
+    }
+
+    // Swap in the last unvisited rectangle, new ones stay at the end
+    freeRects[i] = freeRects[count - 1];
+    freeRects[count - 1] = freeRects.back();
+    freeRects.pop_back();
+    count--;
+  }
+}
+
+// Drops free rectangles contained in another one
+void texture::AtlasPacker::prune() {
+  for (size_t i = 0; i < freeRects.size(); i++) {
+    for (size_t j = i + 1; j < freeRects.size();) {
+      if (contains(freeRects[j], freeRects[i])) {
+        freeRects.erase(freeRects.begin() + i);
+        i--;
+        break;
+      }
+      if (contains(freeRects[i], freeRects[j])) {
+        freeRects.erase(freeRects.begin() + j);
+      } else {
+        j++;
+      }
+    }
+  }
+}
+
+float texture::AtlasPacker::getOccupancy() const {
+  uint64_t area = uint64_t(width) * height;
+  return area > 0 ? float(double(usedArea) / double(area)) : 0.0f;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+struct AtlasRect {
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+// MaxRects bin packer (Jylänki 2010, best short side fit) for one page.
+// Keeps every maximal free rectangle, so a new rectangle can go anywhere it
+// fits instead of only along a skyline.
+class AtlasPacker {
+private:
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<AtlasRect> freeRects{};
+  uint64_t usedArea = 0;
+
+  void split(const AtlasRect &used);
+  void prune();
+
+public:
+  AtlasPacker(uint32_t width = 0, uint32_t height = 0) {
+    reset(width, height);
+  }
+
+  void reset(uint32_t width, uint32_t height);
+
+  // Places a width x height rectangle, false when the page has no room
+  bool insert(uint32_t width, uint32_t height, AtlasRect &output);
+
+  // Share of the page covered by rectangles, 0 to 1
+  float getOccupancy() const;
+};
+
+} // namespace texture
+} // namespace dank
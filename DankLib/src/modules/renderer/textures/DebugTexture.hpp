@@ -3,45 +3,46 @@
 #include "modules/Foundation.hpp"
 #include "modules/renderer/textures/Texture.hpp"
 #include <cstdint>
-#include <cstdlib>
 
 namespace dank {
 namespace texture {
+// Checkerboard drawn in place of missing textures. Its pixels are made
+// once and shared with every fetch.
 class DebugTexture : public Texture {
+private:
+  PixelBuffer pixels{};
+
 public:
   static const uint32_t ID = 1;
+  static const uint32_t SIZE = 128;
   TextureType getType() override { return TextureType::Color; }
 
   void fetchData(TextureData &output) override {
-    if (output.lastModified > 0) {
-      output.state = ResourceState::Ready;
-      return;
+    if (!pixels) {
+      pixels = PixelBuffer::allocate(SIZE * SIZE * 4);
+      uint8_t *data = pixels.data();
+      for (size_t y = 0; y < SIZE && data != nullptr; ++y) {
+        for (size_t x = 0; x < SIZE; ++x) {
+          bool isWhite = (x ^ y) & 0b1000000;
+          uint8_t c = isWhite ? 0xFF : 0xA;
+
+          size_t i = y * SIZE + x;
+
+          data[i * 4 + 0] = c;
+          data[i * 4 + 1] = c;
+          data[i * 4 + 2] = c;
+          data[i * 4 + 3] = 0xFF;
+        }
+      }
     }
 
-    const uint32_t tw = 128;
-    const uint32_t th = 128;
-
-    output.width = tw;
-    output.height = th;
+    output.width = SIZE;
+    output.height = SIZE;
     output.channels = 4;
     output.format = PixelFormat::RGBA8Unorm;
-    output.lastModified++;
+    output.lastModified = 1;
     output.state = ResourceState::Ready;
-
-    output.data = (uint8_t *) malloc(tw * th * output.channels);
-    for (size_t y = 0; y < th; ++y) {
-      for (size_t x = 0; x < tw; ++x) {
-        bool isWhite = (x ^ y) & 0b1000000;
-        uint8_t c = isWhite ? 0xFF : 0xA;
-
-        size_t i = y * tw + x;
-
-        output.data[i * output.channels + 0] = c;
-        output.data[i * output.channels + 1] = c;
-        output.data[i * output.channels + 2] = c;
-        output.data[i * output.channels + 3] = 0xFF;
-      }
-    }
+    output.pixels = pixels;
   }
 };
 } // namespace texture
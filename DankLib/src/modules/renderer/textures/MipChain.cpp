@@ -0,0 +1,136 @@
+#include "modules/renderer/textures/MipChain.hpp"
+#include "modules/Simd.hpp"
+#include "modules/renderer/textures/PixelConversion.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace dank;
+
+namespace {
+
+// One row of RGBA8 into linear, premultiplied floats
+void decodeRow(const uint8_t *row, uint32_t width, bool srgb,
+               float *output) {
+  texture::decodeTexels(row, width, srgb, output);
+  for (uint32_t x = 0; x < width; x++) {
+    float alpha = output[x * 4 + 3];
+    simd::float4 color = simd::load(output + x * 4);
+    simd::store(output + x * 4,
+                simd::mul(color, simd::set(alpha, alpha, alpha, 1.0f)));
+  }
+}
+
+// Floats back to straight RGBA8, premultiplied again in their encoding
+// when asked for. Goes through a chunk on the stack so the level stays
+// untouched for the next one.
+void writeTexels(const float *input, uint32_t count,
+                 const texture::MipOptions &options, uint8_t *output) {
+  const uint32_t CHUNK = 64;
+  alignas(16) float chunk[CHUNK * 4];
+  for (uint32_t first = 0; first < count; first += CHUNK) {
+    uint32_t n = std::min(CHUNK, count - first);
+    for (uint32_t i = 0; i < n; i++) {
+      simd::float4 color = simd::load(input + (first + i) * 4);
+      float alpha = input[(first + i) * 4 + 3];
+      float unpremultiply = alpha > 0 ? 1.0f / alpha : 0.0f;
+      simd::store(chunk + i * 4,
+                  simd::mul(color, simd::set(unpremultiply, unpremultiply,
+                                             unpremultiply, 1.0f)));
+    }
+    uint8_t *out = output + first * 4;
+    texture::encodeTexels(chunk, n, options.srgb, out);
+    if (options.premultiplied) {
+      texture::premultiplyAlpha(out, n, out);
+    }
+  }
+}
+
+// Averages 2x2 texels of two rows into one row of half the width
+void boxRows(const float *row0, const float *row1, uint32_t width,
+             uint32_t halfWidth, float *output) {
+  const simd::float4 quarter = simd::splat(0.25f);
+  for (uint32_t x = 0; x < halfWidth; x++) {
+    uint32_t x0 = std::min(x * 2, width - 1) * 4;
+    uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+    simd::float4 top = simd::add(simd::load(row0 + x0), simd::load(row0 + x1));
+    simd::float4 bottom =
+        simd::add(simd::load(row1 + x0), simd::load(row1 + x1));
+    simd::store(output + x * 4, simd::mul(simd::add(top, bottom), quarter));
+  }
+}
+
+} // namespace
+
+uint32_t texture::getMipCount(uint32_t width, uint32_t height) {
+  uint32_t count = 1;
+  uint32_t size = std::max(width, height);
+  while (size > 1 && count < MAX_TEXTURE_LEVELS) {
+    size /= 2;
+    count++;
+  }
+  return count;
+}
+
+uint8_t *texture::generateMipChain(const uint8_t *rgba, uint32_t width,
+                                   uint32_t height, const MipOptions &options,
+                                   TextureLevel *levels,
+                                   uint32_t &levelCount) {
+  levelCount = getMipCount(width, height);
+  uint32_t offset = 0;
+  for (uint32_t i = 0, w = width, h = height; i < levelCount; i++) {
+    levels[i] = TextureLevel{offset, w * h * 4, w, h};
+    offset += levels[i].size;
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+  }
+  uint8_t *chain = static_cast<uint8_t *>(malloc(offset));
+  if (chain == nullptr)
+    return nullptr;
+
+  // The first level only changes when it is written premultiplied
+  if (options.premultiplied) {
+    premultiplyAlpha(rgba, uint32_t(width) * height, chain);
+  } else {
+    memcpy(chain, rgba, levels[0].size);
+  }
+  if (levelCount == 1)
+    return chain;
+
+  // The second level is filtered from the decoded rows of the first, the
+  // others from the floats of the level before
+  std::vector<float> rows(width * 8);
+  float *row0 = rows.data();
+  float *row1 = rows.data() + width * 4;
+  std::vector<float> current(levels[1].width * levels[1].height * 4);
+  std::vector<float> next{};
+  for (uint32_t y = 0; y < levels[1].height; y++) {
+    decodeRow(rgba + std::min(y * 2, height - 1) * width * 4, width,
+              options.srgb, row0);
+    decodeRow(rgba + std::min(y * 2 + 1, height - 1) * width * 4, width,
+              options.srgb, row1);
+    boxRows(row0, row1, width, levels[1].width,
+            current.data() + y * levels[1].width * 4);
+  }
+  writeTexels(current.data(), levels[1].width * levels[1].height, options,
+              chain + levels[1].offset);
+
+  for (uint32_t i = 2; i < levelCount; i++) {
+    const TextureLevel &source = levels[i - 1];
+    const TextureLevel &level = levels[i];
+    next.resize(level.width * level.height * 4);
+    for (uint32_t y = 0; y < level.height; y++) {
+      uint32_t y0 = std::min(y * 2, source.height - 1);
+      uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+      boxRows(current.data() + y0 * source.width * 4,
+              current.data() + y1 * source.width * 4, source.width,
+              level.width,
+              next.data() + y * level.width * 4);
+    }
+    writeTexels(next.data(), level.width * level.height, options,
+                chain + level.offset);
+    current.swap(next);
+  }
+  return chain;
+}
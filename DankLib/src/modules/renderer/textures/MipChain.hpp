@@ -0,0 +1,32 @@
+#pragma once
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include <cstdint>
+
+namespace dank {
+namespace texture {
+
+struct MipOptions {
+  // Texels are sRGB encoded and averaged in linear light, so thin bright
+  // features do not darken as they shrink. Off for data such as normals.
+  bool srgb = true;
+  // Writes every level, the first one included, with color multiplied by
+  // alpha in its encoding, what blending into an unorm target expects. The
+  // chain is always filtered premultiplied in linear light so transparent
+  // texels never bleed their color, this only chooses the output.
+  bool premultiplied = true;
+};
+
+// Levels down to 1x1, capped at MAX_TEXTURE_LEVELS
+uint32_t getMipCount(uint32_t width, uint32_t height);
+
+// Full mip chain of tightly packed RGBA8 rows, each level the 2x2 box
+// filtered half of the one before, odd edges dropping their last texel.
+// Levels are filtered in floats four channels at a time with simd::float4
+// and stored back to back, largest first. Returns the chain allocated with
+// malloc, levels and levelCount describe it; nullptr when out of memory.
+uint8_t *generateMipChain(const uint8_t *rgba, uint32_t width,
+                          uint32_t height, const MipOptions &options,
+                          TextureLevel *levels, uint32_t &levelCount);
+
+} // namespace texture
+} // namespace dank
@@ -0,0 +1,61 @@
+#include "modules/renderer/textures/PixelBuffer.hpp"
+#include <cstdlib>
+#include <sys/mman.h>
+
+using namespace dank;
+
+texture::PixelBuffer texture::PixelBuffer::allocate(size_t size,
+                                                    bool zeroed) {
+  return adopt(zeroed ? calloc(size, 1) : malloc(size), size);
+}
+
+texture::PixelBuffer texture::PixelBuffer::adopt(void *data, size_t size) {
+  return PixelBuffer(static_cast<uint8_t *>(data), size,
+                     [](uint8_t *bytes) { free(bytes); });
+}
+
+texture::PixelBuffer texture::PixelBuffer::map(void *data, size_t size) {
+  return PixelBuffer(static_cast<uint8_t *>(data), size,
+                     [size](uint8_t *bytes) { munmap(bytes, size); });
+}
+
+texture::PixelPool::Shared::~Shared() {
+  for (uint8_t *bytes : available) {
+    free(bytes);
+  }
+}
+
+texture::PixelBuffer texture::PixelPool::acquire(size_t size) {
+  uint8_t *bytes = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    if (shared->size != size) {
+      for (uint8_t *stale : shared->available) {
+        free(stale);
+      }
+      shared->available.clear();
+      shared->size = size;
+    }
+    if (!shared->available.empty()) {
+      bytes = shared->available.back();
+      shared->available.pop_back();
+    }
+  }
+  if (bytes == nullptr) {
+    bytes = static_cast<uint8_t *>(malloc(size));
+  }
+
+  // The deleter keeps the pool's state alive until the last buffer is back
+  std::shared_ptr<Shared> pool = shared;
+  uint32_t limit = capacity;
+  return PixelBuffer(bytes, size, [pool, size, limit](uint8_t *returned) {
+    {
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      if (pool->size == size && pool->available.size() < limit) {
+        pool->available.push_back(returned);
+        return;
+      }
+    }
+    free(returned);
+  });
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// Reference counted bytes of pixels shared between the threads that
+// produce them (loader workers, capture, jobs), the textures holding them
+// and the renderer uploading them. Copies share the bytes, the last one
+// gone releases them with the deleter they were created with: free for
+// malloc'd memory such as stb_image's, munmap for mapped files, or a
+// PixelPool taking them back.
+//
+// Views share the ownership of a range of another buffer, e.g. a level of
+// a mip chain, so they stay valid as long as they are held.
+class PixelBuffer {
+private:
+  // Points at the first byte of the view, owns the whole allocation
+  std::shared_ptr<uint8_t> bytes{};
+  size_t byteCount = 0;
+
+public:
+  PixelBuffer() = default;
+
+  // Takes over data, released with deleter(data) by the last reference
+  template <typename Deleter>
+  PixelBuffer(uint8_t *data, size_t size, Deleter deleter) {
+    if (data != nullptr) {
+      bytes = std::shared_ptr<uint8_t>(data, deleter);
+      byteCount = size;
+    }
+  }
+
+  // malloc'd, or calloc'd when zeroed, empty when out of memory
+  static PixelBuffer allocate(size_t size, bool zeroed = false);
+  // Takes over memory from malloc, e.g. stb_image's or ResourceData's
+  static PixelBuffer adopt(void *data, size_t size);
+  // Takes over a mapping of a whole file
+  static PixelBuffer map(void *data, size_t size);
+
+  // size bytes from offset, clamped to the buffer
+  PixelBuffer view(size_t offset, size_t size) const {
+    PixelBuffer output{};
+    if (bytes != nullptr && offset < byteCount) {
+      output.bytes = std::shared_ptr<uint8_t>(bytes, bytes.get() + offset);
+      output.byteCount = std::min(size, byteCount - offset);
+    }
+    return output;
+  }
+
+  uint8_t *data() const { return bytes.get(); }
+  size_t size() const { return byteCount; }
+  bool empty() const { return bytes == nullptr; }
+  explicit operator bool() const { return bytes != nullptr; }
+  // References to the allocation, views included
+  long getUseCount() const { return bytes.use_count(); }
+
+  void reset() {
+    bytes.reset();
+    byteCount = 0;
+  }
+};
+
+// Recycles buffers of a single size, e.g. captured frames or pages of a
+// virtual texture, so steady streams of them stop allocating. Buffers come
+// back when their last reference goes, even after the pool itself.
+class PixelPool {
+private:
+  struct Shared {
+    std::mutex mutex{};
+    size_t size = 0;
+    std::vector<uint8_t *> available{};
+    ~Shared();
+  };
+  std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+
+public:
+  // Buffers kept for reuse, the others are freed as they come back
+  uint32_t capacity = 8;
+
+  // Asking for another size than before frees the buffers kept
+  PixelBuffer acquire(size_t size);
+};
+
+} // namespace texture
+} // namespace dank
@@ -0,0 +1,211 @@
+#include "modules/renderer/textures/PixelConversion.hpp"
+#include "modules/Simd.hpp"
+#include <cmath>
+#include <cstring>
+
+using namespace dank;
+
+texture::ConversionStats texture::conversionStats{};
+
+namespace {
+
+const uint32_t SRGB_TABLE_SIZE = 1 << 14;
+
+// sRGB to linear for every byte, linear to sRGB through a table indexed by
+// the linear value, fine enough that the darkest steps survive
+struct SrgbTables {
+  float toLinear[256];
+  uint8_t toSrgb[SRGB_TABLE_SIZE];
+
+  SrgbTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      float c = i / 255.0f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f
+                                  : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (uint32_t i = 0; i < SRGB_TABLE_SIZE; i++) {
+      float l = i / float(SRGB_TABLE_SIZE - 1);
+      float c = l <= 0.0031308f ? l * 12.92f
+                                : 1.055f * std::pow(l, 1 / 2.4f) - 0.055f;
+      toSrgb[i] = uint8_t(c * 255.0f + 0.5f);
+    }
+  }
+};
+
+const SrgbTables &getSrgbTables() {
+  static const SrgbTables tables{};
+  return tables;
+}
+
+// a * b / 255 rounded, exact for every pair of bytes
+inline uint8_t multiplyUnorm(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 128;
+  return uint8_t((t + (t >> 8)) >> 8);
+}
+
+#if DANK_SIMD_NEON
+// Same rounding on eight products at once
+inline uint8x8_t divide255(uint16x8_t t) {
+  return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+#elif DANK_SIMD_SSE2
+// Four texels, each color channel times the alpha of its texel
+inline __m128i premultiplyHalf(__m128i texels) {
+  __m128i alpha = _mm_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i t = _mm_add_epi16(_mm_mullo_epi16(texels, alpha),
+                            _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+} // namespace
+
+void texture::swizzleRedBlue(const uint8_t *input, size_t count,
+                             uint8_t *output) {
+  size_t i = 0;
+#if DANK_SIMD_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t texels = vld4q_u8(input + i * 4);
+    uint8x16_t red = texels.val[0];
+    texels.val[0] = texels.val[2];
+    texels.val[2] = red;
+    vst4q_u8(output + i * 4, texels);
+  }
+#elif DANK_SIMD_SSE2
+  // SSE2 has no byte shuffle, red and blue are the even bytes of each
+  // texel and trade places by shifting them 16 bits
+  const __m128i greenAlpha = _mm_set1_epi32(int32_t(0xFF00FF00));
+  const __m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+  for (; i + 4 <= count; i += 4) {
+    __m128i texels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i * 4));
+    __m128i rb = _mm_and_si128(texels, redBlue);
+    rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 4),
+                     _mm_or_si128(_mm_and_si128(texels, greenAlpha), rb));
+  }
+#endif
+  for (; i < count; i++) {
+    const uint8_t *in = input + i * 4;
+    uint8_t *out = output + i * 4;
+    uint8_t red = in[0];
+    out[0] = in[2];
+    out[1] = in[1];
+    out[2] = red;
+    out[3] = in[3];
+  }
+}
+
+void texture::premultiplyAlpha(const uint8_t *input, size_t count,
+                               uint8_t *output) {
+  size_t i = 0;
+#if DANK_SIMD_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x4_t texels = vld4q_u8(input + i * 4);
+    uint8x8_t alphaLow = vget_low_u8(texels.val[3]);
+    uint8x8_t alphaHigh = vget_high_u8(texels.val[3]);
+    for (int c = 0; c < 3; c++) {
+      uint8x8_t low = divide255(vmull_u8(vget_low_u8(texels.val[c]), alphaLow));
+      uint8x8_t high =
+          divide255(vmull_u8(vget_high_u8(texels.val[c]), alphaHigh));
+      texels.val[c] = vcombine_u8(low, high);
+    }
+    vst4q_u8(output + i * 4, texels);
+  }
+#elif DANK_SIMD_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alphaMask = _mm_set1_epi32(int32_t(0xFF000000));
+  for (; i + 4 <= count; i += 4) {
+    __m128i texels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i * 4));
+    __m128i low = premultiplyHalf(_mm_unpacklo_epi8(texels, zero));
+    __m128i high = premultiplyHalf(_mm_unpackhi_epi8(texels, zero));
+    // Alpha was multiplied by itself, put the original back
+    __m128i color = _mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 4),
+                     _mm_or_si128(color, _mm_and_si128(texels, alphaMask)));
+  }
+#endif
+  for (; i < count; i++) {
+    const uint8_t *in = input + i * 4;
+    uint8_t *out = output + i * 4;
+    uint8_t alpha = in[3];
+    out[0] = multiplyUnorm(in[0], alpha);
+    out[1] = multiplyUnorm(in[1], alpha);
+    out[2] = multiplyUnorm(in[2], alpha);
+    out[3] = alpha;
+  }
+}
+
+void texture::expandRgbToRgba(const uint8_t *input, size_t count,
+                              uint8_t *output) {
+  size_t i = 0;
+#if DANK_SIMD_NEON
+  for (; i + 16 <= count; i += 16) {
+    uint8x16x3_t rgb = vld3q_u8(input + i * 3);
+    uint8x16x4_t texels;
+    texels.val[0] = rgb.val[0];
+    texels.val[1] = rgb.val[1];
+    texels.val[2] = rgb.val[2];
+    texels.val[3] = vdupq_n_u8(255);
+    vst4q_u8(output + i * 4, texels);
+  }
+#else
+  // Whole words, each one reading the red of the next pixel where alpha
+  // goes; the last pixel would read past the input
+  for (; i + 1 < count; i++) {
+    uint32_t texel;
+    memcpy(&texel, input + i * 3, 4);
+    texel |= 0xFF000000;
+    memcpy(output + i * 4, &texel, 4);
+  }
+#endif
+  for (; i < count; i++) {
+    const uint8_t *in = input + i * 3;
+    uint8_t *out = output + i * 4;
+    out[0] = in[0];
+    out[1] = in[1];
+    out[2] = in[2];
+    out[3] = 255;
+  }
+}
+
+void texture::decodeTexels(const uint8_t *input, size_t count, bool srgb,
+                           float *output) {
+  const SrgbTables &tables = getSrgbTables();
+  const float scale = 1 / 255.0f;
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t *texel = input + i * 4;
+    simd::float4 color =
+        srgb ? simd::set(tables.toLinear[texel[0]], tables.toLinear[texel[1]],
+                         tables.toLinear[texel[2]], texel[3] * scale)
+             : simd::mul(simd::set(texel[0], texel[1], texel[2], texel[3]),
+                         simd::splat(scale));
+    simd::store(output + i * 4, color);
+  }
+}
+
+void texture::encodeTexels(const float *input, size_t count, bool srgb,
+                           uint8_t *output) {
+  const SrgbTables &tables = getSrgbTables();
+  const simd::float4 zero = simd::splat(0.0f);
+  const simd::float4 one = simd::splat(1.0f);
+  const simd::float4 half = simd::splat(0.5f);
+  // Color to table indices or bytes, alpha always to bytes
+  const float colorScale = srgb ? float(SRGB_TABLE_SIZE - 1) : 255.0f;
+  const simd::float4 scale =
+      simd::set(colorScale, colorScale, colorScale, 255.0f);
+  alignas(16) float texel[4];
+  for (size_t i = 0; i < count; i++) {
+    simd::float4 color = simd::min(simd::max(simd::load(input + i * 4), zero),
+                                   one);
+    simd::store(texel, simd::madd(color, scale, half));
+    uint8_t *out = output + i * 4;
+    for (int c = 0; c < 3; c++) {
+      uint32_t value = uint32_t(texel[c]);
+      out[c] = srgb ? tables.toSrgb[value] : uint8_t(value);
+    }
+    out[3] = uint8_t(texel[3]);
+  }
+}
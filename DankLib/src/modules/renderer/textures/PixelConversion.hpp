@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace dank {
+namespace texture {
+
+// Kernels converting rows of pixels between the layouts images and capture
+// frames arrive in and the premultiplied RGBA8 the renderer samples. Counts
+// are in pixels. Byte kernels run 16 pixels at a time on NEON and 4 with
+// SSE2 on x86_64, plain loops take the rest and other targets.
+
+// BGRA8 to RGBA8 and back, red and blue trade places. In place is fine.
+void swizzleRedBlue(const uint8_t *input, size_t count, uint8_t *output);
+
+// Straight RGBA8 to premultiplied, color times alpha / 255 rounded to the
+// nearest like the blending hardware. In place is fine.
+void premultiplyAlpha(const uint8_t *input, size_t count, uint8_t *output);
+
+// Tightly packed RGB8, e.g. from JPEGs, to opaque RGBA8. The output must not
+// overlap the input.
+void expandRgbToRgba(const uint8_t *input, size_t count, uint8_t *output);
+
+// RGBA8 to four floats a pixel, color decoded from sRGB to linear when
+// srgb is set, alpha always linear. Output is 16 byte aligned.
+void decodeTexels(const uint8_t *input, size_t count, bool srgb,
+                  float *output);
+
+// Four floats a pixel back to RGBA8, clamped to 0..1 and color encoded to
+// sRGB when srgb is set. Input is 16 byte aligned.
+void encodeTexels(const float *input, size_t count, bool srgb,
+                  uint8_t *output);
+
+// Bytes converted by the callers of the kernels and the time it took,
+// summed across threads until the engine logs and resets them
+struct ConversionStats {
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> microseconds{0};
+};
+
+extern ConversionStats conversionStats;
+
+} // namespace texture
+} // namespace dank
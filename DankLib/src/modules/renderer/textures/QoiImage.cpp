@@ -0,0 +1,193 @@
+#include "modules/renderer/textures/QoiImage.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace dank;
+
+namespace {
+
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xc0;
+const uint8_t QOI_OP_RGB = 0xfe;
+const uint8_t QOI_OP_RGBA = 0xff;
+const uint8_t QOI_MASK = 0xc0;
+const uint8_t QOI_END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Texels are kept as one little endian word, red in the lowest byte, so
+// they are compared and written whole
+inline uint32_t pack(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+  return (r & 0xff) | (g & 0xff) << 8 | (b & 0xff) << 16 | a << 24;
+}
+
+inline uint32_t hash(uint32_t texel) {
+  uint32_t r = texel & 0xff;
+  uint32_t g = (texel >> 8) & 0xff;
+  uint32_t b = (texel >> 16) & 0xff;
+  uint32_t a = texel >> 24;
+  return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+inline uint32_t readBigEndian(const uint8_t *bytes) {
+  return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 |
+         uint32_t(bytes[2]) << 8 | bytes[3];
+}
+
+inline void writeBigEndian(uint32_t value, std::vector<uint8_t> &output) {
+  output.push_back(value >> 24);
+  output.push_back(value >> 16);
+  output.push_back(value >> 8);
+  output.push_back(value);
+}
+
+} // namespace
+
+bool texture::isQoiImage(const void *data, size_t size) {
+  return data != nullptr && size >= QOI_HEADER_SIZE &&
+         memcmp(data, "qoif", 4) == 0;
+}
+
+bool texture::readQoiHeader(const void *data, size_t size,
+                            QoiHeader &header) {
+  if (!isQoiImage(data, size) || size < QOI_HEADER_SIZE + sizeof(QOI_END))
+    return false;
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  header.width = readBigEndian(bytes + 4);
+  header.height = readBigEndian(bytes + 8);
+  header.channels = bytes[12];
+  header.colorspace = bytes[13];
+  return header.width > 0 && header.height > 0 &&
+         header.height < QOI_MAX_PIXELS / header.width &&
+         (header.channels == 3 || header.channels == 4) &&
+         header.colorspace <= 1;
+}
+
+bool texture::decodeQoi(const void *data, size_t size,
+                        const QoiHeader &header, uint8_t *output) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  // Every chunk has to end before the end marker
+  const uint8_t *p = bytes + QOI_HEADER_SIZE;
+  const uint8_t *end = bytes + size - sizeof(QOI_END);
+  uint32_t index[64] = {};
+  uint32_t texel = pack(0, 0, 0, 255);
+  uint8_t *out = output;
+  uint8_t *last = output + size_t(header.width) * header.height * 4;
+
+  while (out < last) {
+    if (p >= end)
+      return false;
+    uint8_t tag = *p++;
+    if (tag == QOI_OP_RGB) {
+      if (end - p < 3)
+        return false;
+      texel = pack(p[0], p[1], p[2], texel >> 24);
+      p += 3;
+    } else if (tag == QOI_OP_RGBA) {
+      if (end - p < 4)
+        return false;
+      texel = pack(p[0], p[1], p[2], p[3]);
+      p += 4;
+    } else if ((tag & QOI_MASK) == QOI_OP_INDEX) {
+      // Already in the index, written without hashing it again
+      texel = index[tag];
+      memcpy(out, &texel, 4);
+      out += 4;
+      continue;
+    } else if ((tag & QOI_MASK) == QOI_OP_DIFF) {
+      uint32_t r = (texel & 0xff) + ((tag >> 4) & 3) - 2;
+      uint32_t g = ((texel >> 8) & 0xff) + ((tag >> 2) & 3) - 2;
+      uint32_t b = ((texel >> 16) & 0xff) + (tag & 3) - 2;
+      texel = pack(r, g, b, texel >> 24);
+    } else if ((tag & QOI_MASK) == QOI_OP_LUMA) {
+      if (p >= end)
+        return false;
+      uint8_t redBlue = *p++;
+      uint32_t dg = (tag & 0x3f) - 32;
+      uint32_t r = (texel & 0xff) + dg - 8 + ((redBlue >> 4) & 0x0f);
+      uint32_t g = ((texel >> 8) & 0xff) + dg;
+      uint32_t b = ((texel >> 16) & 0xff) + dg - 8 + (redBlue & 0x0f);
+      texel = pack(r, g, b, texel >> 24);
+    } else {
+      // A run repeats the previous texel 1 to 62 times
+      size_t run = (tag & 0x3f) + 1;
+      run = std::min<size_t>(run, (last - out) / 4);
+      for (size_t i = 0; i < run; i++) {
+        memcpy(out + i * 4, &texel, 4);
+      }
+      out += run * 4;
+      index[hash(texel)] = texel;
+      continue;
+    }
+    index[hash(texel)] = texel;
+    memcpy(out, &texel, 4);
+    out += 4;
+  }
+  return true;
+}
+
+void texture::encodeQoi(const uint8_t *rgba, uint32_t width, uint32_t height,
+                        uint8_t channels, std::vector<uint8_t> &output) {
+  size_t count = size_t(width) * height;
+  output.clear();
+  // Worst case, every texel an RGBA chunk
+  output.reserve(QOI_HEADER_SIZE + count * 5 + sizeof(QOI_END));
+  output.insert(output.end(), {'q', 'o', 'i', 'f'});
+  writeBigEndian(width, output);
+  writeBigEndian(height, output);
+  output.push_back(channels);
+  output.push_back(0);
+
+  uint32_t index[64] = {};
+  uint32_t previous = pack(0, 0, 0, 255);
+  uint32_t run = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t texel;
+    memcpy(&texel, rgba + i * 4, 4);
+    if (texel == previous) {
+      run++;
+      if (run == 62 || i + 1 == count) {
+        output.push_back(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      output.push_back(QOI_OP_RUN | (run - 1));
+      run = 0;
+    }
+
+    uint32_t position = hash(texel);
+    if (index[position] == texel) {
+      output.push_back(QOI_OP_INDEX | position);
+    } else {
+      index[position] = texel;
+      if ((texel >> 24) == (previous >> 24)) {
+        int8_t dr = int8_t((texel & 0xff) - (previous & 0xff));
+        int8_t dg = int8_t(((texel >> 8) & 0xff) - ((previous >> 8) & 0xff));
+        int8_t db =
+            int8_t(((texel >> 16) & 0xff) - ((previous >> 16) & 0xff));
+        int8_t drg = dr - dg;
+        int8_t dbg = db - dg;
+        if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+          output.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+                           (db + 2));
+        } else if (drg > -9 && drg < 8 && dg > -33 && dg < 32 && dbg > -9 &&
+                   dbg < 8) {
+          output.push_back(QOI_OP_LUMA | (dg + 32));
+          output.push_back((drg + 8) << 4 | (dbg + 8));
+        } else {
+          output.insert(output.end(), {QOI_OP_RGB, uint8_t(texel),
+                                       uint8_t(texel >> 8),
+                                       uint8_t(texel >> 16)});
+        }
+      } else {
+        output.insert(output.end(),
+                      {QOI_OP_RGBA, uint8_t(texel), uint8_t(texel >> 8),
+                       uint8_t(texel >> 16), uint8_t(texel >> 24)});
+      }
+    }
+    previous = texel;
+  }
+  output.insert(output.end(), QOI_END, QOI_END + sizeof(QOI_END));
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// The "Quite OK Image" format, lossless like PNG but decoded in a single
+// pass without inflate, several times faster. Pixels are run length, index
+// and small delta coded against the previous one:
+//
+//   header: "qoif", width, height (big endian), channels, colorspace
+//   chunks: one tag byte each, with up to four bytes of payload
+//   end:    seven zero bytes and a one
+//
+// See https://qoiformat.org/qoi-specification.pdf. Images are straight
+// alpha, the TextureLoader premultiplies them like any other.
+const uint32_t QOI_HEADER_SIZE = 14;
+// Same limit as the reference implementation, keeps RGBA8 sizes in 32 bits
+const uint32_t QOI_MAX_PIXELS = 400000000;
+
+struct QoiHeader {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // 3 when the image has no alpha, informative only
+  uint8_t channels = 4;
+  // 0 sRGB with linear alpha, 1 all linear, informative only
+  uint8_t colorspace = 0;
+};
+
+bool isQoiImage(const void *data, size_t size);
+
+// Checks the magic, size and channels of the header
+bool readQoiHeader(const void *data, size_t size, QoiHeader &header);
+
+// Decodes the image described by header into output, width * height RGBA8
+// texels the caller allocated, e.g. the buffer handed to the renderer.
+// False when the data ends early, output is then partly written.
+bool decodeQoi(const void *data, size_t size, const QoiHeader &header,
+               uint8_t *output);
+
+// Encodes tightly packed RGBA8, channels only goes into the header
+void encodeQoi(const uint8_t *rgba, uint32_t width, uint32_t height,
+               uint8_t channels, std::vector<uint8_t> &output);
+
+} // namespace texture
+} // namespace dank
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "modules/Foundation.hpp"
+#include "modules/renderer/textures/Texture.hpp"
+
+namespace dank {
+namespace texture {
+// GPU-only texture that cameras can render into (Camera::renderTarget) and
+// meshes can sample, e.g. for minimaps or picture-in-picture
+class RenderTarget : public Texture {
+public:
+  uint32_t width;
+  uint32_t height;
+
+  RenderTarget(uint32_t width, uint32_t height)
+      : width(width), height(height) {}
+
+  TextureType getType() override { return TextureType::RenderTarget; }
+
+  void fetchData(TextureData &output) override {
+    output.state = ResourceState::Ready;
+    output.lastModified = 1;
+    output.width = width;
+    output.height = height;
+    output.channels = 4;
+    output.format = PixelFormat::RGBA8Unorm;
+    output.pixels.reset();
+  }
+};
+} // namespace texture
+} // namespace dank
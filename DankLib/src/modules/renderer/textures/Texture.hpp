@@ -1,68 +1,145 @@
 #pragma once
 #include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/renderer/textures/PixelBuffer.hpp"
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include "modules/renderer/textures/TextureLoader.hpp"
 #include <cstdint>
 
 namespace dank {
 namespace texture {
 
-struct TextureData {
-  ResourceState state{ResourceState::Idle};
-  uint32_t lastModified;
+// Texture slots a renderer binds, indexed by TextureHandle::index. Matches
+// the texture array in FragmentShaderArguments.
+const uint32_t MAX_TEXTURES = 32;
 
+// Region of a texture's single level changed since its last upload
+struct TextureUpdate {
+  uint32_t x;
+  uint32_t y;
   uint32_t width;
   uint32_t height;
-  uint32_t channels;
-  uint8_t *data = nullptr;
+};
+
+struct TextureData {
+  ResourceState state{ResourceState::Idle};
+  uint32_t lastModified = 0;
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t channels = 0;
+  // Shared with the texture producing them, the renderer holds its copy
+  // until the upload is done so the texture may drop or replace its own
+  PixelBuffer pixels{};
   PixelFormat format{PixelFormat::RGBA8Unorm};
+  // 0 for a single level of width x height texels in pixels, otherwise the
+  // mip chain laid out in pixels, largest first
+  uint32_t levelCount = 0;
+  TextureLevel levels[MAX_TEXTURE_LEVELS];
+  // Regions to upload when the renderer already has the texture, none
+  // uploads all of it. Owned by the texture until releaseData.
+  const TextureUpdate *updates = nullptr;
+  uint32_t updateCount = 0;
 
-  TextureData &operator=(const TextureData &other) {
-    if (this == &other)
-      return *this;
-    state = other.state;
-    lastModified = other.lastModified;
-    width = other.width;
-    height = other.height;
-    channels = other.channels;
-    format = other.format;
-    data = other.data;
-    return *this;
+  // Texels of a level, the whole image without a mip chain
+  PixelBuffer getLevel(uint32_t level) const {
+    if (levelCount == 0) {
+      return level == 0 ? pixels : PixelBuffer{};
+    }
+    if (level >= levelCount) {
+      return PixelBuffer{};
+    }
+    return pixels.view(levels[level].offset, levels[level].size);
+  }
+
+  // First to last texel of a region of a single uncompressed level, its
+  // rows are getRowBytes(format, width) apart
+  PixelBuffer getRegion(const TextureUpdate &region) const {
+    size_t rowBytes = getRowBytes(format, width);
+    size_t texelBytes = getTexelBytes(format);
+    size_t offset = region.y * rowBytes + region.x * texelBytes;
+    size_t size = (region.height - 1) * rowBytes + region.width * texelBytes;
+    return region.width > 0 && region.height > 0 ? pixels.view(offset, size)
+                                                 : PixelBuffer{};
   }
 };
 
-enum class TextureType { Color };
+enum class TextureType { Color, RenderTarget };
 
 class Texture {
 public:
   virtual TextureType getType() = 0;
   virtual void fetchData(TextureData &output) = 0;
   virtual void releaseData(TextureData &output) {};
+  // Called by TextureLibrary::add, textures loading from URIs keep the
+  // loader to queue themselves on their first fetchData
+  virtual void attach(TextureLoader &loader) {}
+  // Raises the priority of a load that has not started yet
+  virtual void prioritize(LoadPriority priority) {}
+  // Textures able to produce their data again after the renderer evicted
+  // them, see TextureResidency. reload() makes fetchData report it again
+  // with a new lastModified, possibly some frames later.
+  virtual bool isReloadable() { return false; }
+  virtual void reload() {}
   virtual ~Texture() = default;
 };
 
+struct TextureHandleTag;
+typedef Handle<TextureHandleTag> TextureHandle;
+
 class TextureLibrary {
 private:
-  uint32_t nextId = 1;
+  SlotMap<Texture *, TextureHandleTag> textures{};
 
 public:
-  std::map<uint32_t, Texture *> textures{};
+  // Shared by every texture of the library, joined after they are deleted
+  TextureLoader loader{};
 
   ~TextureLibrary() { clear(); }
 
+  // Handles given out before a clear are detected as stale afterwards.
+  // Loads still queued are cancelled, textures cancel the ones in progress
+  // when they are deleted.
   void clear() {
-    for (auto &entry : textures) {
-      delete entry.second;
+    loader.cancelAll();
+    for (auto *texture : textures) {
+      delete texture;
     }
-    nextId = 1;
     textures.clear();
   }
 
-  uint32_t add(Texture *texture) {
-    nextId++;
-    textures[nextId - 1] = texture;
-    return nextId - 1;
+  // Textures past MAX_TEXTURES slots are kept but never drawn, which is
+  // warned about here rather than left to look like a missing sprite
+  TextureHandle add(Texture *texture) {
+    texture->attach(loader);
+    TextureHandle handle = textures.insert(texture);
+    if (handle.index >= MAX_TEXTURES) {
+      console::warn("[TextureLibrary] texture %u is past the %u texture "
+                    "slots and will not be drawn",
+                    handle.index, MAX_TEXTURES);
+    }
+    return handle;
+  }
+
+  // For textures about to be drawn or asked for explicitly, stale handles
+  // are ignored
+  void prioritize(const TextureHandle handle, LoadPriority priority) {
+    Texture *texture = get(handle);
+    if (texture != nullptr) {
+      texture->prioritize(priority);
+    }
   }
 
-  const Texture *get(const uint32_t id) const { return textures.at(id); };
+  // nullptr when the handle is stale
+  Texture *get(const TextureHandle handle) const {
+    auto *texture = textures.get(handle);
+    return texture != nullptr ? *texture : nullptr;
+  };
+
+  uint32_t size() const { return textures.size(); }
+  Texture *textureAt(uint32_t i) const { return textures.valueAt(i); }
+  TextureHandle handleAt(uint32_t i) const { return textures.handleAt(i); }
 };
 
 } // namespace texture
@@ -1,73 +1,108 @@
 #pragma once
 
-#include "libs/stb/stb_image.h"
 #include "modules/Foundation.hpp"
 #include "modules/engine/Console.hpp"
-#include "modules/os/OS.hpp"
-#include "modules/os/Thread.h"
+#include "modules/os/URI.hpp"
 #include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureLoader.hpp"
+#include <memory>
 
 namespace dank {
 namespace texture {
 
-class Texture2D : public Texture, Runnable {
+// Image file decoded on the TextureLoader's workers, or a compressed
+// texture file passed through as read. fetchData only ever runs on the
+// render thread, it queues the load the first time and takes the pixels
+// over once the request is published.
+class Texture2D : public Texture {
 private:
   TextureData cache;
-  Thread *thread = nullptr;
+  TextureLoader *loader = nullptr;
+  std::shared_ptr<LoadRequest> request{};
+  LoadPriority priority = LoadPriority::Normal;
 
 public:
   URI uri;
-  Texture2D(URI uri) : uri(uri) { cache.state = ResourceState::Idle; }
+  Texture2D(URI uri, LoadPriority priority = LoadPriority::Normal)
+      : priority(priority), uri(uri) {
+    cache.state = ResourceState::Idle;
+    cache.lastModified = 0;
+  }
+
+  ~Texture2D() {
+    if (request != nullptr) {
+      request->cancelled = true;
+    }
+  }
 
   TextureType getType() override { return TextureType::Color; }
 
-  void fetchData(TextureData &output) override {
-    if (cache.state == ResourceState::Idle) {
-      cache.state = ResourceState::Loading;
-      thread = new Thread();
-      thread->start(this);
+  void attach(TextureLoader &loader) override { this->loader = &loader; }
+
+  void prioritize(LoadPriority value) override {
+    if (value > priority) {
+      priority = value;
+    }
+    if (request != nullptr) {
+      request->raise(value);
     }
-    output = cache;
   }
 
-  void releaseData(TextureData &output) override {
-    if (cache.data != nullptr) {
-      free(cache.data);
-      cache.data = nullptr;
+  bool isReloadable() override { return true; }
+
+  // The pixels were released after their upload, they are read from the
+  // URI again while the texture stays Ready
+  void reload() override {
+    if (cache.state == ResourceState::Ready && request == nullptr &&
+        loader != nullptr) {
+      request = loader->load(uri, LoadPriority::Visible);
     }
   }
-  
-  void run() override {
-    dank::console::log("[URITextureSource] run()");
-    ResourceData resourceData;
-    dank::os->getDataFromURI(uri, resourceData);
 
-    if (resourceData.size <= 0) {
-      dank::console::log("[URITextureSource] ResourceState::Invalid");
-      cache.state = ResourceState::Invalid;
-      return;
+  void fetchData(TextureData &output) override {
+    if (cache.state == ResourceState::Idle) {
+      if (loader == nullptr) {
+        console::warn("[Texture2D] not added to a TextureLibrary");
+        cache.state = ResourceState::Invalid;
+      } else {
+        cache.state = ResourceState::Loading;
+        request = loader->load(uri, priority);
+      }
     }
 
-    int width, height, source_channels;
-    cache.data = stbi_load_from_memory(
-        (stbi_uc *)(resourceData.data), static_cast<int>(resourceData.size),
-        &width, &height, &source_channels, STBI_rgb_alpha);
-    free(resourceData.data);
-
-    cache.width = width;
-    cache.height = height;
-    cache.channels = 4; // RGBA / STBI_rgb_alpha
-    cache.format = PixelFormat::RGBA8Unorm;
-    cache.state = ResourceState::Ready;
-    cache.lastModified++;
-
-    dank::console::log("[URITextureSource] ResourceState::Ready");
-
-    if (thread != nullptr) {
-      delete thread;
-      thread = nullptr;
+    if (request != nullptr) {
+      ResourceState state = request->state.load(std::memory_order_acquire);
+      if (state == ResourceState::Ready) {
+        cache.pixels = std::move(request->pixels);
+        cache.width = request->width;
+        cache.height = request->height;
+        cache.channels = 4; // RGBA / STBI_rgb_alpha
+        // Texture files stay block compressed down to the renderer
+        cache.format = request->format;
+        cache.levelCount = request->levelCount;
+        for (uint32_t i = 0; i < cache.levelCount; i++) {
+          cache.levels[i] = request->levels[i];
+        }
+        cache.state = ResourceState::Ready;
+        cache.lastModified++;
+        request.reset();
+      } else if (state == ResourceState::Invalid) {
+        // A failed reload leaves the texture Ready and evicted, the
+        // TextureResidency asks for it again
+        if (cache.state != ResourceState::Ready) {
+          cache.state = ResourceState::Invalid;
+        } else {
+          console::warn("[Texture2D] could not reload %s",
+                        uri.path.c_str());
+        }
+        request.reset();
+      }
     }
+    output = cache;
   }
+
+  // The renderer's copy in output lives until its upload is done
+  void releaseData(TextureData &output) override { cache.pixels.reset(); }
 };
 } // namespace texture
-} // namespace dank
\ No newline at end of file
+} // namespace dank
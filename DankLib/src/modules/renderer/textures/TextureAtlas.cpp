@@ -0,0 +1,152 @@
+#include "modules/renderer/textures/TextureAtlas.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/renderer/textures/PixelConversion.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace dank;
+
+texture::AtlasImageHandle texture::TextureAtlas::add(const uint8_t *rgba,
+                                                     uint32_t width,
+                                                     uint32_t height,
+                                                     TextureLibrary &library) {
+  AtlasImageHandle handle = entries.insert(AtlasEntry{});
+  place(*entries.get(handle), rgba, width, height, false, library);
+  return handle;
+}
+
+texture::AtlasImageHandle texture::TextureAtlas::add(const URI &uri,
+                                                     TextureLibrary &library,
+                                                     LoadPriority priority) {
+  AtlasImageHandle handle = entries.insert(AtlasEntry{});
+  // Pages are not mipmapped, only the image itself is copied
+  pending.push_back(
+      PendingFile{handle, library.loader.load(uri, priority, false)});
+  return handle;
+}
+
+void texture::TextureAtlas::update(TextureLibrary &library) {
+  for (size_t i = 0; i < pending.size();) {
+    PendingFile &file = pending[i];
+    ResourceState state = file.request->state.load(std::memory_order_acquire);
+    if (state == ResourceState::Loading) {
+      i++;
+      continue;
+    }
+
+    AtlasEntry *entry = entries.get(file.image);
+    if (entry != nullptr) {
+      if (state == ResourceState::Ready &&
+          file.request->format != PixelFormat::RGBA8Unorm) {
+        console::warn("[TextureAtlas] %s is compressed, atlas pages are RGBA8",
+                      file.request->uri.path.c_str());
+        entry->state = ResourceState::Invalid;
+      } else if (state == ResourceState::Ready) {
+        // Images from the loader's cache sit after the file header
+        const uint8_t *rgba = file.request->pixels.data();
+        if (file.request->levelCount > 0) {
+          rgba += file.request->levels[0].offset;
+        }
+        // The loader premultiplied them already
+        place(*entry, rgba, file.request->width, file.request->height, true,
+              library);
+      } else {
+        entry->state = ResourceState::Invalid;
+      }
+    }
+    pending[i] = std::move(pending.back());
+    pending.pop_back();
+  }
+}
+
+void texture::TextureAtlas::place(AtlasEntry &entry, const uint8_t *rgba,
+                                  uint32_t width, uint32_t height,
+                                  bool premultiplied,
+                                  TextureLibrary &library) {
+  uint32_t paddedWidth = width + padding * 2;
+  uint32_t paddedHeight = height + padding * 2;
+  if (rgba == nullptr || width == 0 || height == 0) {
+    entry.state = ResourceState::Invalid;
+    return;
+  }
+
+  // Pages whose texture went away with a TextureLibrary::clear are skipped
+  AtlasRect rect{};
+  AtlasPage *page = nullptr;
+  for (auto &candidate : pages) {
+    auto *texture = static_cast<AtlasPage *>(library.get(candidate.texture));
+    if (texture != nullptr &&
+        candidate.packer.insert(paddedWidth, paddedHeight, rect)) {
+      page = texture;
+      entry.texture = candidate.texture;
+      break;
+    }
+  }
+
+  if (page == nullptr) {
+    uint32_t pageWidth = std::max(pageSize, paddedWidth);
+    uint32_t pageHeight = std::max(pageSize, paddedHeight);
+    page = new AtlasPage(pageWidth, pageHeight);
+    Page added{library.add(page), AtlasPacker(pageWidth, pageHeight)};
+    added.packer.insert(paddedWidth, paddedHeight, rect);
+    entry.texture = added.texture;
+    pages.push_back(std::move(added));
+    dank::console::log("[TextureAtlas] page %d: %dx%d", (int)pages.size(),
+                       pageWidth, pageHeight);
+  }
+
+  // Rows of the image, then the padding filled from its border
+  uint32_t stride = page->width * 4;
+  uint8_t *origin = page->pixels.data() + (rect.y + padding) * stride +
+                    (rect.x + padding) * 4;
+  if (premultiplied) {
+    for (uint32_t y = 0; y < height; y++) {
+      memcpy(origin + y * stride, rgba + y * width * 4, width * 4);
+    }
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t y = 0; y < height; y++) {
+      premultiplyAlpha(rgba + y * width * 4, width, origin + y * stride);
+    }
+    conversionStats.bytes += size_t(width) * height * 4;
+    conversionStats.microseconds +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+  }
+  if (extrude && padding > 0) {
+    uint8_t *corner = page->pixels.data() + rect.y * stride + rect.x * 4;
+    for (uint32_t y = 0; y < paddedHeight; y++) {
+      uint32_t sourceY = std::min(std::max(y, padding), padding + height - 1);
+      uint8_t *row = corner + y * stride;
+      const uint8_t *source = corner + sourceY * stride;
+      if (y != sourceY) {
+        memcpy(row + padding * 4, source + padding * 4, width * 4);
+      }
+      for (uint32_t x = 0; x < padding; x++) {
+        memcpy(row + x * 4, source + padding * 4, 4);
+        memcpy(row + (padding + width + x) * 4,
+               source + (padding + width - 1) * 4, 4);
+      }
+    }
+  }
+  page->updates.push_back(
+      TextureUpdate{rect.x, rect.y, paddedWidth, paddedHeight});
+  page->lastModified++;
+
+  entry.state = ResourceState::Ready;
+  entry.pageSize = mesh::TextureSize{page->width, page->height};
+  entry.region = mesh::TextureRegion{float(rect.x + padding),
+                                     float(rect.y + padding), float(width),
+                                     float(height)};
+}
+
+void texture::TextureAtlas::clear() {
+  for (auto &file : pending) {
+    file.request->cancelled = true;
+  }
+  pending.clear();
+  pages.clear();
+  entries.clear();
+}
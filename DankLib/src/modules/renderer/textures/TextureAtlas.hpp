@@ -0,0 +1,146 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/os/URI.hpp"
+#include "modules/renderer/meshes/SpriteMesh.hpp"
+#include "modules/renderer/textures/AtlasPacker.hpp"
+#include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureLoader.hpp"
+#include <memory>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// RGBA8 page of a TextureAtlas. The pixels stay on the CPU so later images
+// can be added, each listed for the renderer with its padding so only those
+// regions are uploaded again, like the GlyphCache.
+class AtlasPage : public Texture {
+public:
+  uint32_t width;
+  uint32_t height;
+  PixelBuffer pixels;
+  std::vector<TextureUpdate> updates{};
+  uint32_t lastModified = 1;
+
+  AtlasPage(uint32_t width, uint32_t height)
+      : width(width), height(height),
+        pixels(PixelBuffer::allocate(size_t(width) * height * 4, true)) {}
+
+  TextureType getType() override { return TextureType::Color; }
+
+  bool isReloadable() override { return true; }
+  void reload() override { lastModified++; }
+
+  void fetchData(TextureData &output) override {
+    output.state = ResourceState::Ready;
+    output.lastModified = lastModified;
+    output.width = width;
+    output.height = height;
+    output.channels = 4;
+    output.format = PixelFormat::RGBA8Unorm;
+    output.pixels = pixels;
+    output.updates = updates.data();
+    output.updateCount = updates.size();
+  }
+
+  void releaseData(TextureData &output) override { updates.clear(); }
+};
+
+struct AtlasImageTag;
+typedef Handle<AtlasImageTag> AtlasImageHandle;
+
+// Where an image ended up: its page and its pixels there, padding excluded.
+// pageSize and region go straight into SpriteTable::add.
+struct AtlasEntry {
+  ResourceState state = ResourceState::Loading;
+  TextureHandle texture{};
+  mesh::TextureSize pageSize{0, 0};
+  mesh::TextureRegion region{0, 0, 0, 0};
+};
+
+// Packs many small images into a few shared pages, each a single texture
+// slot, so hundreds of sprites fit in the renderer's MAX_TEXTURES and
+// consecutive ones still batch into one draw. Images are placed with
+// AtlasPacker, new pages are opened when the current ones are full and
+// images larger than a page get one of their own.
+//
+// Every image is surrounded by padding pixels. With extrude on they repeat
+// the image's border, so filtering and mip sampling at the edges never pick
+// up a neighbour.
+//
+// Pages are owned by the TextureLibrary, clear both together like the
+// MeshLibrary and the SkeletonLibrary.
+class TextureAtlas {
+private:
+  struct Page {
+    TextureHandle texture{};
+    AtlasPacker packer{};
+  };
+
+  struct PendingFile {
+    AtlasImageHandle image{};
+    std::shared_ptr<LoadRequest> request{};
+  };
+
+  SlotMap<AtlasEntry, AtlasImageTag> entries{};
+  std::vector<Page> pages{};
+  std::vector<PendingFile> pending{};
+
+  // Premultiplies rows with straight alpha as they are copied
+  void place(AtlasEntry &entry, const uint8_t *rgba, uint32_t width,
+             uint32_t height, bool premultiplied, TextureLibrary &library);
+
+public:
+  // Size of new pages, images that do not fit get a page of their size
+  uint32_t pageSize = 2048;
+  // Pixels kept free around every image
+  uint32_t padding = 2;
+  // Fills the padding with the image's border pixels instead of leaving it
+  // transparent
+  bool extrude = true;
+
+  ~TextureAtlas() { clear(); }
+
+  // Copies rgba, tightly packed RGBA8 rows with straight alpha, into a page
+  // right away. Pages are premultiplied like every texture, the rows are
+  // converted while copied.
+  AtlasImageHandle add(const uint8_t *rgba, uint32_t width, uint32_t height,
+                       TextureLibrary &library);
+
+  // Decodes the file on the library's TextureLoader, the entry is Loading
+  // until update() packs it
+  AtlasImageHandle add(const URI &uri, TextureLibrary &library,
+                       LoadPriority priority = LoadPriority::Normal);
+
+  // Packs the files decoded since the last call, once per update
+  void update(TextureLibrary &library);
+
+  // nullptr when the handle is stale
+  const AtlasEntry *get(const AtlasImageHandle handle) const {
+    return entries.get(handle);
+  }
+
+  // Moves a region given in the pixels of the original image, e.g. a frame
+  // of a sprite sheet, into its page
+  mesh::TextureRegion remap(const AtlasImageHandle handle,
+                            mesh::TextureRegion region) const {
+    const AtlasEntry *entry = entries.get(handle);
+    if (entry != nullptr) {
+      region.x += entry->region.x;
+      region.y += entry->region.y;
+    }
+    return region;
+  }
+
+  // Does not touch the TextureLibrary, meant to be called with its clear()
+  void clear();
+
+  uint32_t getPageCount() const { return pages.size(); }
+  float getOccupancy(uint32_t page) const {
+    return pages[page].packer.getOccupancy();
+  }
+};
+
+} // namespace texture
+} // namespace dank
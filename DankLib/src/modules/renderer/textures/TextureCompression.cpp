@@ -0,0 +1,536 @@
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace dank;
+
+namespace {
+
+typedef float Texels[16][4];
+
+// The 4x4 block at (blockX, blockY), clamped to the image
+void gatherBlock(const uint8_t *rgba, uint32_t width, uint32_t height,
+                 uint32_t blockX, uint32_t blockY, Texels &texels) {
+  for (uint32_t y = 0; y < 4; y++) {
+    uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+    for (uint32_t x = 0; x < 4; x++) {
+      uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+      const uint8_t *texel = rgba + (sourceY * width + sourceX) * 4;
+      for (int c = 0; c < 4; c++) {
+        texels[y * 4 + x][c] = texel[c];
+      }
+    }
+  }
+}
+
+// Ends of the segment along the principal axis of the first channels of
+// count colors, found by power iteration on their covariance
+void fitLine(const Texels &colors, int count, int channels, float start[4],
+             float end[4]) {
+  float mean[4] = {0, 0, 0, 0};
+  for (int i = 0; i < count; i++) {
+    for (int c = 0; c < channels; c++) {
+      mean[c] += colors[i][c];
+    }
+  }
+  for (int c = 0; c < channels; c++) {
+    mean[c] /= float(count);
+  }
+
+  float covariance[4][4] = {};
+  for (int i = 0; i < count; i++) {
+    for (int a = 0; a < channels; a++) {
+      for (int b = 0; b < channels; b++) {
+        covariance[a][b] +=
+            (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+      }
+    }
+  }
+
+  float axis[4] = {1, 1, 1, 1};
+  float length = 0;
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {0, 0, 0, 0};
+    for (int a = 0; a < channels; a++) {
+      for (int b = 0; b < channels; b++) {
+        next[a] += covariance[a][b] * axis[b];
+      }
+    }
+    length = 0;
+    for (int c = 0; c < channels; c++) {
+      length = std::max(length, std::fabs(next[c]));
+    }
+    if (length < 1e-6f)
+      break;
+    for (int c = 0; c < channels; c++) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  // Flat blocks collapse to their mean
+  float tMin = 0, tMax = 0;
+  if (length >= 1e-6f) {
+    float norm = 0;
+    for (int c = 0; c < channels; c++) {
+      norm += axis[c] * axis[c];
+    }
+    norm = std::sqrt(norm);
+    for (int c = 0; c < channels; c++) {
+      axis[c] /= norm;
+    }
+    tMin = 1e9f;
+    tMax = -1e9f;
+    for (int i = 0; i < count; i++) {
+      float t = 0;
+      for (int c = 0; c < channels; c++) {
+        t += (colors[i][c] - mean[c]) * axis[c];
+      }
+      tMin = std::min(tMin, t);
+      tMax = std::max(tMax, t);
+    }
+  }
+  for (int c = 0; c < channels; c++) {
+    start[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+    end[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+  }
+}
+
+// Least squares ends for colors interpolated with the given weights, 0 at
+// start and 1 at end. False when every color has the same weight.
+bool refineLine(const Texels &colors, const float weights[16], int count,
+                int channels, float start[4], float end[4]) {
+  float aa = 0, ab = 0, bb = 0;
+  float ax[4] = {0, 0, 0, 0};
+  float bx[4] = {0, 0, 0, 0};
+  for (int i = 0; i < count; i++) {
+    float b = weights[i];
+    float a = 1.0f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < channels; c++) {
+      ax[c] += a * colors[i][c];
+      bx[c] += b * colors[i][c];
+    }
+  }
+  float determinant = aa * bb - ab * ab;
+  if (std::fabs(determinant) < 1e-6f)
+    return false;
+  for (int c = 0; c < channels; c++) {
+    float s = (bb * ax[c] - ab * bx[c]) / determinant;
+    float e = (aa * bx[c] - ab * ax[c]) / determinant;
+    start[c] = std::min(std::max(s, 0.0f), 255.0f);
+    end[c] = std::min(std::max(e, 0.0f), 255.0f);
+  }
+  return true;
+}
+
+float distance(const float *a, const int *b, int channels) {
+  float sum = 0;
+  for (int c = 0; c < channels; c++) {
+    float d = a[c] - float(b[c]);
+    sum += d * d;
+  }
+  return sum;
+}
+
+// Nearest of count palette entries, ties go to the lower index
+int nearest(const float *color, const int palette[][4], int count,
+            int channels, float &error) {
+  int best = 0;
+  error = distance(color, palette[0], channels);
+  for (int i = 1; i < count; i++) {
+    float d = distance(color, palette[i], channels);
+    if (d < error) {
+      error = d;
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Writes values LSB first, the bit order of BC7 and of ASTC's header
+class BitWriter {
+private:
+  uint8_t *bytes;
+  uint32_t position = 0;
+
+public:
+  explicit BitWriter(uint8_t *bytes) : bytes(bytes) {}
+
+  void write(uint32_t value, uint32_t bits) {
+    for (uint32_t i = 0; i < bits; i++, position++) {
+      if ((value >> i) & 1) {
+        bytes[position / 8] |= uint8_t(1u << (position % 8));
+      }
+    }
+  }
+};
+
+// BC1
+
+uint16_t to565(const float color[4]) {
+  uint32_t r = uint32_t(color[0] * 31.0f / 255.0f + 0.5f);
+  uint32_t g = uint32_t(color[1] * 63.0f / 255.0f + 0.5f);
+  uint32_t b = uint32_t(color[2] * 31.0f / 255.0f + 0.5f);
+  return uint16_t(r << 11 | g << 5 | b);
+}
+
+void from565(uint16_t value, int output[4]) {
+  int r = (value >> 11) & 31;
+  int g = (value >> 5) & 63;
+  int b = value & 31;
+  output[0] = r << 3 | r >> 2;
+  output[1] = g << 2 | g >> 4;
+  output[2] = b << 3 | b >> 2;
+  output[3] = 255;
+}
+
+struct Bc1Block {
+  uint16_t color0 = 0;
+  uint16_t color1 = 0;
+  uint32_t indices = 0;
+  float error = 0;
+};
+
+// Indices of the opaque colors for the two ends in the given mode. Four
+// color blocks need color0 > color1, three color ones color0 <= color1,
+// the ends are swapped to match and weights returned along them.
+Bc1Block evaluateBc1(const Texels &colors, const int *map, int count,
+                     uint16_t color0, uint16_t color1, bool threeColor,
+                     float weights[16]) {
+  if (threeColor ? color0 > color1 : color0 < color1) {
+    std::swap(color0, color1);
+  }
+  int palette[4][4];
+  from565(color0, palette[0]);
+  from565(color1, palette[1]);
+  static const float fourWeights[4] = {0, 1, 1 / 3.0f, 2 / 3.0f};
+  static const float threeWeights[3] = {0, 1, 0.5f};
+  for (int c = 0; c < 3; c++) {
+    int a = palette[0][c], b = palette[1][c];
+    if (threeColor) {
+      palette[2][c] = (a + b) / 2;
+    } else {
+      palette[2][c] = (2 * a + b) / 3;
+      palette[3][c] = (a + 2 * b) / 3;
+    }
+  }
+
+  Bc1Block block{color0, color1, 0, 0};
+  // Transparent texels keep index 3
+  if (threeColor) {
+    block.indices = 0xffffffff;
+  }
+  for (int i = 0; i < count; i++) {
+    float error;
+    int index = nearest(colors[i], palette, threeColor ? 3 : 4, 3, error);
+    block.indices &= ~(3u << (map[i] * 2));
+    block.indices |= uint32_t(index) << (map[i] * 2);
+    block.error += error;
+    weights[i] = threeColor ? threeWeights[index] : fourWeights[index];
+  }
+  return block;
+}
+
+// 8 bytes: two RGB565 ends, then 2 bit indices. Texels with alpha below
+// 128 are made transparent when allowed, BC3 colors always use 4 colors.
+void encodeBc1(const Texels &texels, bool transparency, uint8_t *output) {
+  Texels colors;
+  int map[16];
+  int count = 0;
+  for (int i = 0; i < 16; i++) {
+    if (transparency && texels[i][3] < 128.0f)
+      continue;
+    memcpy(colors[count], texels[i], sizeof(float) * 4);
+    map[count++] = i;
+  }
+  bool threeColor = count < 16;
+
+  Bc1Block best{0, 0, 0xffffffff, 0};
+  if (count > 0) {
+    float start[4], end[4], weights[16];
+    fitLine(colors, count, 3, start, end);
+    best = evaluateBc1(colors, map, count, to565(start), to565(end),
+                       threeColor, weights);
+
+    float color0[4], color1[4];
+    if (refineLine(colors, weights, count, 3, color0, color1)) {
+      Bc1Block refined = evaluateBc1(colors, map, count, to565(color0),
+                                     to565(color1), threeColor, weights);
+      if (refined.error < best.error) {
+        best = refined;
+      }
+    }
+  }
+
+  output[0] = best.color0 & 0xff;
+  output[1] = best.color0 >> 8;
+  output[2] = best.color1 & 0xff;
+  output[3] = best.color1 >> 8;
+  for (int i = 0; i < 4; i++) {
+    output[4 + i] = (best.indices >> (i * 8)) & 0xff;
+  }
+}
+
+// BC3
+
+// 8 bytes of alpha: the ends, max first for 8 interpolated values, then
+// 3 bit indices
+void encodeBc3Alpha(const Texels &texels, uint8_t *output) {
+  float low = 255, high = 0;
+  for (int i = 0; i < 16; i++) {
+    low = std::min(low, texels[i][3]);
+    high = std::max(high, texels[i][3]);
+  }
+  int alpha0 = int(high + 0.5f);
+  int alpha1 = int(low + 0.5f);
+
+  int palette[8][4] = {};
+  palette[0][0] = alpha0;
+  palette[1][0] = alpha1;
+  for (int i = 2; i < 8; i++) {
+    palette[i][0] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+  }
+
+  memset(output, 0, 8);
+  output[0] = uint8_t(alpha0);
+  output[1] = uint8_t(alpha1);
+  uint64_t indices = 0;
+  if (alpha0 != alpha1) {
+    for (int i = 0; i < 16; i++) {
+      float error;
+      int index = nearest(&texels[i][3], palette, 8, 1, error);
+      indices |= uint64_t(index) << (i * 3);
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    output[2 + i] = (indices >> (i * 8)) & 0xff;
+  }
+}
+
+void encodeBc3(const Texels &texels, uint8_t *output) {
+  encodeBc3Alpha(texels, output);
+  encodeBc1(texels, false, output + 8);
+}
+
+// BC7
+
+const int BC7_WEIGHTS[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                             34, 38, 43, 47, 51, 55, 60, 64};
+
+// 7 bit RGBA end and the shared lowest bit closest to color
+void quantizeBc7(const float color[4], int ends[4], int &pBit) {
+  float bestError = 1e30f;
+  for (int p = 0; p < 2; p++) {
+    int quantized[4];
+    float error = 0;
+    for (int c = 0; c < 4; c++) {
+      int q = int((color[c] - p) / 2.0f + 0.5f);
+      q = std::min(std::max(q, 0), 127);
+      quantized[c] = q;
+      float d = float(q << 1 | p) - color[c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      pBit = p;
+      memcpy(ends, quantized, sizeof(quantized));
+    }
+  }
+}
+
+struct Bc7Block {
+  int ends[2][4] = {};
+  int pBits[2] = {0, 0};
+  int indices[16] = {};
+  float error = 0;
+};
+
+Bc7Block evaluateBc7(const Texels &texels, const float start[4],
+                     const float end[4], float weights[16]) {
+  Bc7Block block{};
+  quantizeBc7(start, block.ends[0], block.pBits[0]);
+  quantizeBc7(end, block.ends[1], block.pBits[1]);
+
+  int palette[16][4];
+  for (int c = 0; c < 4; c++) {
+    int a = block.ends[0][c] << 1 | block.pBits[0];
+    int b = block.ends[1][c] << 1 | block.pBits[1];
+    for (int i = 0; i < 16; i++) {
+      palette[i][c] =
+          ((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32) >> 6;
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    float error;
+    block.indices[i] = nearest(texels[i], palette, 16, 4, error);
+    block.error += error;
+    weights[i] = BC7_WEIGHTS[block.indices[i]] / 64.0f;
+  }
+  return block;
+}
+
+// Mode 6: one subset, 7 bit RGBA ends each with a shared lowest bit and
+// 4 bit indices. The first index drops its top bit, so the ends are
+// swapped whenever it is set.
+void encodeBc7(const Texels &texels, uint8_t *output) {
+  float start[4], end[4], weights[16];
+  fitLine(texels, 16, 4, start, end);
+  Bc7Block best = evaluateBc7(texels, start, end, weights);
+  if (refineLine(texels, weights, 16, 4, start, end)) {
+    Bc7Block refined = evaluateBc7(texels, start, end, weights);
+    if (refined.error < best.error) {
+      best = refined;
+    }
+  }
+
+  if (best.indices[0] >= 8) {
+    for (int c = 0; c < 4; c++) {
+      std::swap(best.ends[0][c], best.ends[1][c]);
+    }
+    std::swap(best.pBits[0], best.pBits[1]);
+    for (int i = 0; i < 16; i++) {
+      best.indices[i] = 15 - best.indices[i];
+    }
+  }
+
+  memset(output, 0, 16);
+  BitWriter bits(output);
+  bits.write(1u << 6, 7);
+  for (int c = 0; c < 4; c++) {
+    bits.write(best.ends[0][c], 7);
+    bits.write(best.ends[1][c], 7);
+  }
+  bits.write(best.pBits[0], 1);
+  bits.write(best.pBits[1], 1);
+  bits.write(best.indices[0], 3);
+  for (int i = 1; i < 16; i++) {
+    bits.write(best.indices[i], 4);
+  }
+}
+
+// ASTC 4x4
+
+const int ASTC_WEIGHTS[4] = {0, 21, 43, 64};
+
+struct AstcBlock {
+  int ends[2][4] = {};
+  int weights[16] = {};
+  float error = 0;
+};
+
+AstcBlock evaluateAstc(const Texels &texels, const float start[4],
+                       const float end[4], float weights[16]) {
+  AstcBlock block{};
+  for (int c = 0; c < 4; c++) {
+    block.ends[0][c] = int(start[c] + 0.5f);
+    block.ends[1][c] = int(end[c] + 0.5f);
+  }
+
+  // Ends are expanded to 16 bits, interpolated and truncated back
+  int palette[4][4];
+  for (int c = 0; c < 4; c++) {
+    int a = block.ends[0][c] * 257;
+    int b = block.ends[1][c] * 257;
+    for (int i = 0; i < 4; i++) {
+      int w = ASTC_WEIGHTS[i];
+      palette[i][c] = ((a * (64 - w) + b * w + 32) >> 6) >> 8;
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    float error;
+    block.weights[i] = nearest(texels[i], palette, 4, 4, error);
+    block.error += error;
+    weights[i] = ASTC_WEIGHTS[block.weights[i]] / 64.0f;
+  }
+  return block;
+}
+
+// Block mode 0x042: a 4x4 grid of 2 bit weights, one plane. One partition
+// with endpoint mode 12 (LDR RGBA direct), whose 8 values take 64 of the
+// remaining 79 bits at 8 bits each. Weights fill the block from its top
+// bit down, each bit reversed.
+void encodeAstc(const Texels &texels, uint8_t *output) {
+  float start[4], end[4], weights[16];
+  fitLine(texels, 16, 4, start, end);
+  AstcBlock best = evaluateAstc(texels, start, end, weights);
+  if (refineLine(texels, weights, 16, 4, start, end)) {
+    AstcBlock refined = evaluateAstc(texels, start, end, weights);
+    if (refined.error < best.error) {
+      best = refined;
+    }
+  }
+
+  // A second end darker than the first means blue contraction to the
+  // decoder, swapping the ends avoids it
+  int sum0 = best.ends[0][0] + best.ends[0][1] + best.ends[0][2];
+  int sum1 = best.ends[1][0] + best.ends[1][1] + best.ends[1][2];
+  if (sum1 < sum0) {
+    for (int c = 0; c < 4; c++) {
+      std::swap(best.ends[0][c], best.ends[1][c]);
+    }
+    for (int i = 0; i < 16; i++) {
+      best.weights[i] = 3 - best.weights[i];
+    }
+  }
+
+  memset(output, 0, 16);
+  BitWriter bits(output);
+  bits.write(0x042, 11);
+  bits.write(0, 2);  // partitions - 1
+  bits.write(12, 4); // endpoint mode
+  for (int c = 0; c < 4; c++) {
+    bits.write(best.ends[0][c], 8);
+    bits.write(best.ends[1][c], 8);
+  }
+  for (int i = 0; i < 16; i++) {
+    for (int bit = 0; bit < 2; bit++) {
+      if ((best.weights[i] >> bit) & 1) {
+        int position = 127 - i * 2 - bit;
+        output[position / 8] |= uint8_t(1u << (position % 8));
+      }
+    }
+  }
+}
+
+} // namespace
+
+void texture::compressImage(const uint8_t *rgba, uint32_t width,
+                            uint32_t height, PixelFormat format,
+                            std::vector<uint8_t> &output, JobSystem &jobs) {
+  uint32_t blockBytes = getBlockBytes(format);
+  output.assign(getLevelSize(format, width, height), 0);
+  if (blockBytes == 0 || width == 0 || height == 0)
+    return;
+
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  uint8_t *blocks = output.data();
+  jobs.parallelFor(blocksY, 4, [&](uint32_t begin, uint32_t end) {
+    Texels texels;
+    for (uint32_t y = begin; y < end; y++) {
+      for (uint32_t x = 0; x < blocksX; x++) {
+        gatherBlock(rgba, width, height, x, y, texels);
+        uint8_t *block = blocks + (y * blocksX + x) * blockBytes;
+        switch (format) {
+        case PixelFormat::BC1_RGBA:
+          encodeBc1(texels, true, block);
+          break;
+        case PixelFormat::BC3_RGBA:
+          encodeBc3(texels, block);
+          break;
+        case PixelFormat::BC7_RGBA:
+          encodeBc7(texels, block);
+          break;
+        case PixelFormat::ASTC_4x4:
+          encodeAstc(texels, block);
+          break;
+        default:
+          break;
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/os/JobSystem.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+const uint32_t MAX_TEXTURE_LEVELS = 16;
+
+// One mip level of a texture's data, offset and size in bytes
+struct TextureLevel {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+// Bytes per 4x4 block, 0 for uncompressed formats
+inline uint32_t getBlockBytes(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::BC1_RGBA:
+    return 8;
+  case PixelFormat::BC3_RGBA:
+  case PixelFormat::BC7_RGBA:
+  case PixelFormat::ASTC_4x4:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+inline bool isCompressed(PixelFormat format) {
+  return getBlockBytes(format) > 0;
+}
+
+// Bytes per texel of uncompressed formats
+inline uint32_t getTexelBytes(PixelFormat format) {
+  return format == PixelFormat::R8Unorm ? 1 : 4;
+}
+
+// Bytes of one row of blocks, or of pixels for uncompressed formats
+inline uint32_t getRowBytes(PixelFormat format, uint32_t width) {
+  uint32_t blockBytes = getBlockBytes(format);
+  return blockBytes > 0 ? (width + 3) / 4 * blockBytes
+                        : width * getTexelBytes(format);
+}
+
+// Bytes of a width x height level, partial blocks at the edges included
+inline uint32_t getLevelSize(PixelFormat format, uint32_t width,
+                             uint32_t height) {
+  uint32_t rows = isCompressed(format) ? (height + 3) / 4 : height;
+  return getRowBytes(format, width) * rows;
+}
+
+// Encodes tightly packed RGBA8 rows into 4x4 blocks of format, row after
+// row of blocks, resizing output to getLevelSize. Blocks are independent,
+// rows of them are spread over the jobs' workers. Texels past the right or
+// bottom edge repeat the last column or row.
+//
+// Every format fits a line through the block's colors (principal axis of
+// the texels, refined once by least squares against the chosen weights)
+// and quantizes its ends:
+//   BC1       RGB565 ends, 4 colors, or 3 and transparent with alpha < 128
+//   BC3       BC1 colors and 8 interpolated alpha values
+//   BC7       mode 6 only, RGBA 7 bit ends with a shared bit, 16 weights
+//   ASTC 4x4  one partition, LDR RGBA direct 8 bit ends, 4 weights
+// Good enough for color and UI textures at a fraction of the cost of
+// searching partitions; normal maps want a dedicated encoder.
+void compressImage(const uint8_t *rgba, uint32_t width, uint32_t height,
+                   PixelFormat format, std::vector<uint8_t> &output,
+                   JobSystem &jobs);
+
+} // namespace texture
+} // namespace dank
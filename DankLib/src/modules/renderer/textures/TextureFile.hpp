@@ -0,0 +1,122 @@
+#pragma once
+#include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// Mip chain, block compressed or RGBA8 as cached by the TextureLoader,
+// laid out so the file buffer is handed to the renderer as it is:
+//
+//   TextureFileHeader
+//   TextureLevel[levelCount]
+//   blocks of every level, largest first, each at its level's offset
+//
+// Offsets are in bytes from the start of the file and 16 byte aligned.
+// Everything is little endian. Written by tools/texcompress and the
+// TextureLoader's cache.
+const uint32_t TEXTURE_FILE_MAGIC = 0x58455444; // "DTEX"
+const uint32_t TEXTURE_FILE_VERSION = 1;
+
+struct TextureFileHeader {
+  uint32_t magic = TEXTURE_FILE_MAGIC;
+  uint32_t version = TEXTURE_FILE_VERSION;
+  uint32_t format = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t levelCount = 0;
+  uint32_t reserved[2] = {0, 0};
+};
+
+static_assert(sizeof(TextureFileHeader) == 32,
+              "TextureFileHeader layout changed");
+static_assert(sizeof(TextureLevel) == 16, "TextureLevel layout changed");
+
+inline bool isTextureFile(const void *data, size_t size) {
+  uint32_t magic = 0;
+  if (data == nullptr || size < sizeof(magic))
+    return false;
+  memcpy(&magic, data, sizeof(magic));
+  return magic == TEXTURE_FILE_MAGIC;
+}
+
+// Copies the header and the level table out of data and checks every level
+// is a mip of the one before that fits in size
+inline bool readTextureFileHeader(const void *data, size_t size,
+                                  TextureFileHeader &header,
+                                  TextureLevel *levels) {
+  if (!isTextureFile(data, size) || size < sizeof(TextureFileHeader))
+    return false;
+  memcpy(&header, data, sizeof(TextureFileHeader));
+  PixelFormat format = static_cast<PixelFormat>(header.format);
+  if (header.version != TEXTURE_FILE_VERSION ||
+      (format != PixelFormat::RGBA8Unorm && !isCompressed(format)) ||
+      header.levelCount == 0 || header.levelCount > MAX_TEXTURE_LEVELS ||
+      header.width == 0 || header.height == 0)
+    return false;
+
+  size_t tableEnd =
+      sizeof(TextureFileHeader) + header.levelCount * sizeof(TextureLevel);
+  if (tableEnd > size)
+    return false;
+  memcpy(levels, static_cast<const uint8_t *>(data) + sizeof(header),
+         header.levelCount * sizeof(TextureLevel));
+
+  uint32_t width = header.width;
+  uint32_t height = header.height;
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+    const TextureLevel &level = levels[i];
+    uint64_t end = uint64_t(level.offset) + level.size;
+    if (level.width != width || level.height != height ||
+        level.size != getLevelSize(format, width, height) ||
+        level.offset < tableEnd || end > size)
+      return false;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+  return true;
+}
+
+// levels holds the blocks of each mip, largest first, as compressImage
+// wrote them, or their RGBA8 rows
+inline void writeTextureFile(PixelFormat format, uint32_t width,
+                             uint32_t height,
+                             const std::vector<std::vector<uint8_t>> &levels,
+                             std::vector<uint8_t> &output) {
+  TextureFileHeader header{};
+  header.format = static_cast<uint32_t>(format);
+  header.width = width;
+  header.height = height;
+  header.levelCount = levels.size();
+
+  std::vector<TextureLevel> table(levels.size());
+  uint32_t offset = (sizeof(TextureFileHeader) +
+                     levels.size() * sizeof(TextureLevel) + 15) &
+                    ~15u;
+  for (size_t i = 0; i < levels.size(); i++) {
+    table[i] = TextureLevel{offset, uint32_t(levels[i].size()), width, height};
+    offset = (offset + levels[i].size() + 15) & ~15u;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+
+  output.assign(offset, 0);
+  memcpy(output.data(), &header, sizeof(TextureFileHeader));
+  if (!table.empty()) {
+    memcpy(output.data() + sizeof(TextureFileHeader), table.data(),
+           table.size() * sizeof(TextureLevel));
+  }
+  for (size_t i = 0; i < levels.size(); i++) {
+    if (!levels[i].empty()) {
+      memcpy(output.data() + table[i].offset, levels[i].data(),
+             levels[i].size());
+    }
+  }
+}
+
+} // namespace texture
+} // namespace dank
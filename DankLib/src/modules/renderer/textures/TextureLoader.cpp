@@ -0,0 +1,403 @@
+#include "modules/renderer/textures/TextureLoader.hpp"
+#include "libs/stb/stb_image.h"
+#include "modules/engine/Console.hpp"
+#include "modules/os/OS.hpp"
+#include "modules/renderer/textures/PixelConversion.hpp"
+#include "modules/renderer/textures/QoiImage.hpp"
+#include "modules/renderer/textures/TextureFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dank;
+
+void texture::TextureLoader::Worker::run() {
+  while (true) {
+    std::shared_ptr<LoadRequest> request = loader->next();
+    if (request == nullptr)
+      return;
+    loader->process(*request);
+  }
+}
+
+void texture::TextureLoader::start() {
+  if (!workers.empty())
+    return;
+  stopping = false;
+  if (useCache && cacheDirectory.empty() && dank::os != nullptr) {
+    cacheDirectory = dank::os->getCacheDirectory();
+  }
+  for (uint32_t i = 0; i < std::max(workerCount, 1u); i++) {
+    auto *worker = new Worker();
+    worker->loader = this;
+    workers.push_back(worker);
+    worker->thread.start(worker);
+  }
+  console::log("[TextureLoader] started %d workers", (int)workers.size());
+}
+
+void texture::TextureLoader::stop() {
+  cancelAll();
+  if (workers.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto *worker : workers) {
+    worker->thread.join();
+    delete worker;
+  }
+  workers.clear();
+}
+
+std::shared_ptr<texture::LoadRequest>
+texture::TextureLoader::load(const URI &uri, LoadPriority priority,
+                             bool mipmaps) {
+  auto request = std::make_shared<LoadRequest>();
+  request->uri = uri;
+  request->mipmaps = mipmaps;
+  request->priority = static_cast<uint8_t>(priority);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    start();
+    request->sequence = nextSequence++;
+    queue.push_back(request);
+  }
+  wake.notify_one();
+  return request;
+}
+
+void texture::TextureLoader::cancelAll() {
+  std::vector<std::shared_ptr<LoadRequest>> dropped{};
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropped.swap(queue);
+  }
+  for (const auto &request : dropped) {
+    request->cancelled = true;
+    request->state.store(ResourceState::Invalid, std::memory_order_release);
+  }
+}
+
+uint32_t texture::TextureLoader::getQueuedCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+std::shared_ptr<texture::LoadRequest> texture::TextureLoader::next() {
+  std::unique_lock<std::mutex> lock(mutex);
+  wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+  if (queue.empty())
+    return nullptr;
+
+  size_t best = 0;
+  for (size_t i = 1; i < queue.size(); i++) {
+    uint8_t priority = queue[i]->priority.load();
+    uint8_t bestPriority = queue[best]->priority.load();
+    if (priority > bestPriority ||
+        (priority == bestPriority &&
+         queue[i]->sequence < queue[best]->sequence)) {
+      best = i;
+    }
+  }
+  std::shared_ptr<LoadRequest> request = std::move(queue[best]);
+  queue[best] = std::move(queue.back());
+  queue.pop_back();
+  return request;
+}
+
+void texture::TextureLoader::process(LoadRequest &request) {
+  auto fail = [&request]() {
+    request.state.store(ResourceState::Invalid, std::memory_order_release);
+  };
+  if (request.cancelled)
+    return fail();
+
+  URI uri = request.uri;
+  ResourceData resource{0, nullptr};
+  dank::os->getDataFromURI(uri, resource);
+  if (resource.size <= 0 || resource.data == nullptr) {
+    console::warn("[TextureLoader] could not read %s", uri.path.c_str());
+    return fail();
+  }
+  if (request.cancelled) {
+    free(resource.data);
+    return fail();
+  }
+
+  // Compressed blocks go to the renderer as they are in the file
+  if (isTextureFile(resource.data, resource.size)) {
+    TextureFileHeader header{};
+    if (!readTextureFileHeader(resource.data, resource.size, header,
+                               request.levels)) {
+      console::warn("[TextureLoader] invalid texture file %s",
+                    uri.path.c_str());
+      free(resource.data);
+      return fail();
+    }
+    request.width = header.width;
+    request.height = header.height;
+    request.format = static_cast<PixelFormat>(header.format);
+    request.levelCount = header.levelCount;
+    request.pixels = PixelBuffer::adopt(resource.data, resource.size);
+    request.state.store(ResourceState::Ready, std::memory_order_release);
+    return;
+  }
+
+  std::string cachePath = getCachePath(resource, request);
+  if (!cachePath.empty()) {
+    if (mapCached(cachePath, request)) {
+      free(resource.data);
+      cacheHits++;
+      request.state.store(ResourceState::Ready, std::memory_order_release);
+      return;
+    }
+    cacheMisses++;
+  }
+
+  auto decodeStart = std::chrono::steady_clock::now();
+  int width = 0, height = 0, channels;
+  bool rgb = false;
+  PixelBuffer pixels{};
+  const char *error = "invalid QOI image";
+  if (isQoiImage(resource.data, resource.size)) {
+    // Decoded right into the buffer that becomes the request's pixels
+    QoiHeader header{};
+    if (readQoiHeader(resource.data, resource.size, header)) {
+      width = header.width;
+      height = header.height;
+      pixels = PixelBuffer::allocate(size_t(width) * height * 4);
+      if (pixels &&
+          !decodeQoi(resource.data, resource.size, header, pixels.data())) {
+        pixels.reset();
+      }
+    }
+  } else {
+    // RGB images are decoded as they are and expanded by the kernel, stb's
+    // own conversion goes a byte at a time
+    const stbi_uc *encoded = static_cast<stbi_uc *>(resource.data);
+    int encodedSize = static_cast<int>(resource.size);
+    rgb = stbi_info_from_memory(encoded, encodedSize, &width, &height,
+                                &channels) &&
+          channels == 3;
+    stbi_uc *decoded =
+        stbi_load_from_memory(encoded, encodedSize, &width, &height,
+                              &channels, rgb ? STBI_rgb : STBI_rgb_alpha);
+    error = stbi_failure_reason();
+    pixels = PixelBuffer(decoded, size_t(width) * height * (rgb ? 3 : 4),
+                         stbi_image_free);
+  }
+  free(resource.data);
+  if (!pixels) {
+    console::warn("[TextureLoader] could not decode %s: %s", uri.path.c_str(),
+                  error);
+    return fail();
+  }
+  decodedPixels += uint64_t(width) * height;
+  decodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - decodeStart)
+                            .count();
+
+  size_t count = size_t(width) * height;
+  if (rgb || (!request.mipmaps && mipOptions.premultiplied)) {
+    auto start = std::chrono::steady_clock::now();
+    if (rgb) {
+      // Assigning frees stb's RGB rows
+      PixelBuffer rgba = PixelBuffer::allocate(count * 4);
+      if (!rgba) {
+        console::warn("[TextureLoader] out of memory for %s",
+                      uri.path.c_str());
+        return fail();
+      }
+      expandRgbToRgba(pixels.data(), count, rgba.data());
+      pixels = std::move(rgba);
+    } else {
+      // RGB is opaque and mip chains come out premultiplied already
+      premultiplyAlpha(pixels.data(), count, pixels.data());
+    }
+    conversionStats.bytes += count * 4;
+    conversionStats.microseconds +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+  }
+
+  if (request.mipmaps && !request.cancelled) {
+    auto start = std::chrono::steady_clock::now();
+    uint8_t *chain = generateMipChain(pixels.data(), width, height,
+                                      mipOptions, request.levels,
+                                      request.levelCount);
+    if (chain == nullptr) {
+      console::warn("[TextureLoader] out of memory for %s", uri.path.c_str());
+      return fail();
+    }
+    size_t chainSize = request.levels[request.levelCount - 1].offset +
+                       request.levels[request.levelCount - 1].size;
+    pixels = PixelBuffer::adopt(chain, chainSize);
+    mipPixels += uint64_t(width) * height;
+    mipMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  }
+
+  // Cancelled requests keep their pixels until the last reference goes
+  request.width = width;
+  request.height = height;
+  request.pixels = std::move(pixels);
+  if (!cachePath.empty() && !request.cancelled) {
+    size_t written = writeCached(cachePath, request);
+    if (written > 0) {
+      trimCache(cachePath, written);
+    }
+  }
+  request.state.store(ResourceState::Ready, std::memory_order_release);
+}
+
+// FNV-1a of the file, so renamed or moved images still hit, then the
+// cache version and the options changing what is cached
+std::string
+texture::TextureLoader::getCachePath(const ResourceData &resource,
+                                     const LoadRequest &request) const {
+  if (!useCache || cacheDirectory.empty())
+    return "";
+  uint64_t hash = 14695981039346656037ull;
+  const uint8_t *bytes = static_cast<const uint8_t *>(resource.data);
+  for (size_t i = 0; i < resource.size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "/texture-%016llx-v%u-%d%d%d.dtex",
+           static_cast<unsigned long long>(hash), TEXTURE_CACHE_VERSION,
+           request.mipmaps ? 1 : 0,
+           mipOptions.srgb ? 1 : 0, mipOptions.premultiplied ? 1 : 0);
+  return cacheDirectory + name;
+}
+
+bool texture::TextureLoader::mapCached(const std::string &path,
+                                       LoadRequest &request) {
+  int file = open(path.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+  struct stat info {};
+  void *mapped = MAP_FAILED;
+  if (fstat(file, &info) == 0 && info.st_size > 0) {
+    mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  }
+  // The modification time orders the files for trimCache()
+  futimens(file, nullptr);
+  close(file);
+  if (mapped == MAP_FAILED)
+    return false;
+
+  // Truncated or stale files are decoded again and overwritten
+  size_t size = info.st_size;
+  TextureFileHeader header{};
+  if (!readTextureFileHeader(mapped, size, header, request.levels) ||
+      header.format != static_cast<uint32_t>(PixelFormat::RGBA8Unorm)) {
+    munmap(mapped, size);
+    return false;
+  }
+  request.width = header.width;
+  request.height = header.height;
+  request.format = PixelFormat::RGBA8Unorm;
+  request.levelCount = header.levelCount;
+  request.pixels = PixelBuffer::map(mapped, size);
+  return true;
+}
+
+// Written next to the cache file and renamed over it, so other workers or
+// a later launch never map half of it
+size_t texture::TextureLoader::writeCached(const std::string &path,
+                                           const LoadRequest &request) {
+  std::vector<std::vector<uint8_t>> levels{};
+  if (request.levelCount == 0) {
+    const uint8_t *level = request.pixels.data();
+    levels.emplace_back(level, level + request.pixels.size());
+  }
+  for (uint32_t i = 0; i < request.levelCount; i++) {
+    const uint8_t *level = request.pixels.data() + request.levels[i].offset;
+    levels.emplace_back(level, level + request.levels[i].size);
+  }
+  std::vector<uint8_t> bytes{};
+  writeTextureFile(PixelFormat::RGBA8Unorm, request.width, request.height,
+                   levels, bytes);
+
+  std::string temporary = path + "." + std::to_string(request.sequence);
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr)
+    return 0;
+  bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+    console::warn("[TextureLoader] could not cache %s", path.c_str());
+    remove(temporary.c_str());
+    return 0;
+  }
+  return bytes.size();
+}
+
+// Listed once, then counted as the workers write, and listed again to
+// delete the oldest files whenever the count goes over the limit. Files of
+// other versions are counted and deleted like the others.
+void texture::TextureLoader::trimCache(const std::string &written,
+                                       size_t added) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  if (cacheBytes != UINT64_MAX) {
+    cacheBytes += added;
+    if (cacheBytes <= maxCacheBytes)
+      return;
+  }
+
+  struct CacheFile {
+    std::string path;
+    uint64_t size;
+    time_t used;
+  };
+  std::vector<CacheFile> files{};
+  uint64_t total = 0;
+  DIR *directory = opendir(cacheDirectory.c_str());
+  if (directory == nullptr)
+    return;
+  while (dirent *entry = readdir(directory)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, 8, "texture-") != 0 || name.size() < 13 ||
+        name.compare(name.size() - 5, 5, ".dtex") != 0)
+      continue;
+    std::string path = cacheDirectory + "/" + name;
+    struct stat info {};
+    if (stat(path.c_str(), &info) != 0)
+      continue;
+    files.push_back(CacheFile{path, uint64_t(info.st_size), info.st_mtime});
+    total += info.st_size;
+  }
+  closedir(directory);
+
+  if (total > maxCacheBytes) {
+    std::sort(files.begin(), files.end(),
+              [](const CacheFile &a, const CacheFile &b) {
+                return a.used < b.used;
+              });
+    uint32_t removed = 0;
+    uint64_t freed = 0;
+    for (size_t i = 0; i < files.size() && total > maxCacheBytes / 4 * 3;
+         i++) {
+      if (files[i].path == written || remove(files[i].path.c_str()) != 0)
+        continue;
+      total -= files[i].size;
+      freed += files[i].size;
+      removed++;
+    }
+    console::log("[TextureLoader] trimmed cache: %u files, %.1fMB", removed,
+                 freed / (1024.0 * 1024.0));
+  }
+  cacheBytes = total;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/os/Thread.h"
+#include "modules/os/URI.hpp"
+#include "modules/renderer/textures/MipChain.hpp"
+#include "modules/renderer/textures/PixelBuffer.hpp"
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// Part of the name of every file in the loader's cache. Bump it whenever
+// decoding, mipmapping or premultiplying changes what would be cached, the
+// old files are then never hit again and trimmed away.
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+// Higher values are loaded first, equal ones in the order they were asked
+enum class LoadPriority : uint8_t { Background, Normal, Visible };
+
+// Pixels of one URI, shared between the loader and the texture that asked
+// for them so neither has to outlive the other. The worker fills width,
+// height and pixels, then publishes them by storing state with release;
+// readers only touch them after seeing Ready with acquire.
+//
+// Images, QOI (QoiImage.hpp) or anything stb_image reads, are decoded to
+// RGBA8, premultiplied unless mipOptions says otherwise and with their mip
+// chain after them when asked for. Texture files (TextureFile.hpp) are kept
+// as read and images found in the loader's cache are mapped, pixels is
+// then the whole file and levels point into it.
+struct LoadRequest {
+  URI uri{};
+  std::atomic<uint8_t> priority{0};
+  std::atomic<bool> cancelled{false};
+  std::atomic<ResourceState> state{ResourceState::Loading};
+  bool mipmaps = true;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  PixelFormat format = PixelFormat::RGBA8Unorm;
+  // 0 for a single RGBA8 level
+  uint32_t levelCount = 0;
+  TextureLevel levels[MAX_TEXTURE_LEVELS];
+  // Freed or unmapped once the request and whoever took a copy let go
+  PixelBuffer pixels{};
+  // Orders requests of the same priority
+  uint64_t sequence = 0;
+
+  // Priorities only ever go up, a queued request is picked up in its new
+  // place
+  void raise(LoadPriority value) {
+    uint8_t p = static_cast<uint8_t>(value);
+    uint8_t current = priority.load();
+    while (current < p && !priority.compare_exchange_weak(current, p)) {
+    }
+  }
+};
+
+// Fixed pool of workers reading and decoding images, highest priority
+// first. Textures hold on to their LoadRequest and poll its state from the
+// render thread, nothing is called back. Workers start with the first
+// load, so tools that never load images spawn no threads.
+class TextureLoader {
+private:
+  class Worker : public Runnable {
+  public:
+    TextureLoader *loader = nullptr;
+    Thread thread{};
+    void run() override;
+  };
+
+  std::vector<Worker *> workers{};
+  std::vector<std::shared_ptr<LoadRequest>> queue{};
+  std::mutex mutex{};
+  std::condition_variable wake{};
+  bool stopping = false;
+  uint64_t nextSequence = 0;
+  // Bytes of the files in the cache directory, UINT64_MAX until the first
+  // write lists them
+  std::mutex cacheMutex{};
+  uint64_t cacheBytes = UINT64_MAX;
+
+  void start();
+  // Highest priority, oldest first, nullptr when stopping with an empty
+  // queue. Priorities may change while queued, so the queue is scanned
+  // instead of kept as a heap; it is short and loads take milliseconds.
+  std::shared_ptr<LoadRequest> next();
+  void process(LoadRequest &request);
+  std::string getCachePath(const ResourceData &resource,
+                           const LoadRequest &request) const;
+  static bool mapCached(const std::string &path, LoadRequest &request);
+  // Bytes written, 0 when it failed
+  static size_t writeCached(const std::string &path,
+                            const LoadRequest &request);
+  void trimCache(const std::string &written, size_t added);
+
+public:
+  // Read and decode workers, applied when the first load starts them
+  uint32_t workerCount = 2;
+  // How images are mipmapped and premultiplied, read by the workers so set
+  // before loading
+  MipOptions mipOptions{};
+  // Decoded images are kept there as texture files named by the hash of
+  // their contents and options, hits are mapped instead of decoded. Taken
+  // from the OS when the workers start, empty disables the cache.
+  bool useCache = true;
+  std::string cacheDirectory{};
+  // Once the cache files grow past it, the least recently written or mapped
+  // ones are deleted until they take 3/4 of it
+  uint64_t maxCacheBytes = 512ull << 20;
+
+  // Pixels decoded and mipmapped and the time spent, summed over the
+  // workers for the once a second stats
+  std::atomic<uint64_t> decodedPixels{0};
+  std::atomic<uint64_t> decodeMicroseconds{0};
+  std::atomic<uint64_t> mipPixels{0};
+  std::atomic<uint64_t> mipMicroseconds{0};
+  std::atomic<uint32_t> cacheHits{0};
+  std::atomic<uint32_t> cacheMisses{0};
+
+  ~TextureLoader() { stop(); }
+
+  // Without mipmaps the pixels are the decoded image alone, e.g. for images
+  // copied into an atlas page
+  std::shared_ptr<LoadRequest> load(const URI &uri, LoadPriority priority,
+                                    bool mipmaps = true);
+
+  // Drops every queued request, they end up Invalid. Requests already
+  // being decoded are cancelled by their textures going away.
+  void cancelAll();
+
+  // Cancels what is queued and joins the workers
+  void stop();
+
+  uint32_t getQueuedCount();
+};
+
+} // namespace texture
+} // namespace dank
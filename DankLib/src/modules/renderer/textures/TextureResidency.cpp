@@ -0,0 +1,173 @@
+#include "modules/renderer/textures/TextureResidency.hpp"
+#include <algorithm>
+
+using namespace dank;
+
+uint64_t texture::TextureResidency::Entry::getBytes() const {
+  uint64_t bytes = 0;
+  for (uint32_t i = firstLevel; i < levelCount; i++) {
+    bytes += levelBytes[i];
+  }
+  return bytes;
+}
+
+texture::TextureResidency::Entry *
+texture::TextureResidency::find(const TextureHandle handle, bool create) {
+  if (handle.index >= entries.size()) {
+    if (!create)
+      return nullptr;
+    entries.resize(handle.index + 1);
+  }
+  Entry &entry = entries[handle.index];
+  if (entry.generation != handle.generation) {
+    if (!create)
+      return nullptr;
+    if (entry.tracked && entry.resident) {
+      residentBytes -= entry.getBytes();
+    }
+    entry = Entry{};
+    entry.generation = handle.generation;
+  }
+  return &entry;
+}
+
+void texture::TextureResidency::markUsed(const TextureHandle handle,
+                                         uint32_t frame) {
+  Entry *entry = find(handle, false);
+  if (entry != nullptr) {
+    entry->lastUsed = frame;
+  }
+}
+
+void texture::TextureResidency::setResident(const TextureHandle handle,
+                                            const TextureData &data,
+                                            bool reloadable) {
+  Entry *entry = find(handle, true);
+  if (entry->tracked && entry->resident) {
+    residentBytes -= entry->getBytes();
+  }
+  entry->tracked = true;
+  entry->resident = true;
+  entry->reloadable = reloadable;
+  entry->restoring = false;
+  entry->firstLevel = 0;
+  if (data.levelCount > 0) {
+    entry->levelCount = data.levelCount;
+    for (uint32_t i = 0; i < data.levelCount; i++) {
+      entry->levelBytes[i] = data.levels[i].size;
+    }
+  } else {
+    entry->levelCount = 1;
+    entry->levelBytes[0] = uint64_t(data.width) * data.height *
+                           std::max(data.channels, 1u);
+  }
+  entry->levelWidth = data.width;
+  entry->levelHeight = data.height;
+  entry->lastUsed = frame;
+  residentBytes += entry->getBytes();
+}
+
+void texture::TextureResidency::forget(const TextureHandle handle) {
+  Entry *entry = find(handle, false);
+  if (entry == nullptr)
+    return;
+  if (entry->tracked && entry->resident) {
+    residentBytes -= entry->getBytes();
+  }
+  *entry = Entry{};
+  entry->generation = handle.generation;
+}
+
+void texture::TextureResidency::update(uint32_t frame,
+                                       std::vector<ResidencyRequest> &output) {
+  this->frame = frame;
+
+  // Drawn last frame: evicted textures come back no matter what, the
+  // budget is made up by others below. Dropped mips only when they fit.
+  uint64_t restoring = 0;
+  for (uint32_t i = 0; i < entries.size(); i++) {
+    Entry &entry = entries[i];
+    if (entry.restoring && frame - entry.restoreFrame > restoreRetryFrames) {
+      entry.restoring = false;
+    }
+    if (!entry.tracked || !entry.reloadable || entry.restoring ||
+        frame - entry.lastUsed > 1)
+      continue;
+    TextureHandle handle{i, entry.generation};
+    if (!entry.resident) {
+      output.push_back(ResidencyRequest{handle, ResidencyAction::Restore});
+      entry.restoring = true;
+      entry.restoreFrame = frame;
+      restored++;
+    } else if (entry.firstLevel > 0) {
+      uint64_t missing = 0;
+      for (uint32_t level = 0; level < entry.firstLevel; level++) {
+        missing += entry.levelBytes[level];
+      }
+      if (residentBytes + restoring + missing <= budget) {
+        output.push_back(ResidencyRequest{handle, ResidencyAction::Restore});
+        entry.restoring = true;
+        entry.restoreFrame = frame;
+        restoring += missing;
+        restored++;
+      }
+    }
+  }
+
+  if (residentBytes <= budget)
+    return;
+
+  candidates.clear();
+  for (uint32_t i = 0; i < entries.size(); i++) {
+    const Entry &entry = entries[i];
+    if (entry.tracked && entry.resident && entry.reloadable &&
+        !entry.restoring && frame - entry.lastUsed > minUnusedFrames) {
+      candidates.push_back(i);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [this](uint32_t a, uint32_t b) {
+              return entries[a].lastUsed < entries[b].lastUsed;
+            });
+
+  // One level per texture and frame, textures shrink gradually for as long
+  // as they stay undrawn and the budget is exceeded
+  size_t firstUntouched = 0;
+  for (size_t i = 0; i < candidates.size() && residentBytes > budget; i++) {
+    Entry &entry = entries[candidates[i]];
+    uint32_t next = entry.firstLevel + 1;
+    uint32_t nextWidth = std::max(entry.levelWidth >> next, 1u);
+    uint32_t nextHeight = std::max(entry.levelHeight >> next, 1u);
+    if (next < entry.levelCount &&
+        std::max(nextWidth, nextHeight) >= minLevelSize) {
+      residentBytes -= entry.levelBytes[entry.firstLevel];
+      entry.firstLevel = next;
+      output.push_back(ResidencyRequest{{candidates[i], entry.generation},
+                                        ResidencyAction::DropTopLevel});
+      dropped++;
+      // Keeps the textures shrunk this frame out of the eviction below
+      std::swap(candidates[i], candidates[firstUntouched++]);
+    }
+  }
+
+  std::sort(candidates.begin() + firstUntouched, candidates.end(),
+            [this](uint32_t a, uint32_t b) {
+              return entries[a].lastUsed < entries[b].lastUsed;
+            });
+  for (size_t i = firstUntouched;
+       i < candidates.size() && residentBytes > budget; i++) {
+    Entry &entry = entries[candidates[i]];
+    residentBytes -= entry.getBytes();
+    entry.resident = false;
+    entry.firstLevel = 0;
+    output.push_back(ResidencyRequest{{candidates[i], entry.generation},
+                                      ResidencyAction::Evict});
+    evicted++;
+  }
+}
+
+void texture::TextureResidency::clear() {
+  entries.clear();
+  candidates.clear();
+  residentBytes = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "modules/renderer/textures/Texture.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+enum class ResidencyAction {
+  // Replace the texture by its mips from the second level on
+  DropTopLevel,
+  // Release the texture, it is reloaded once drawn again
+  Evict,
+  // Reload the full texture, see Texture::reload
+  Restore
+};
+
+struct ResidencyRequest {
+  TextureHandle texture{};
+  ResidencyAction action = ResidencyAction::Evict;
+};
+
+// Keeps the GPU memory of the textures of a TextureLibrary under a budget.
+// The renderer reports every upload with setResident and DrawLists every
+// texture it draws with markUsed; update() then picks what to give up when
+// over budget, least recently drawn first, and what to bring back:
+//
+//   1. textures not drawn for minUnusedFrames lose their top mip, which
+//      frees three quarters of them and keeps them drawable
+//   2. if that is not enough they are evicted, once drawn again they are
+//      reloaded like any other texture
+//   3. textures drawn again with their top mips dropped are restored when
+//      the budget has room for all of them
+//
+// Bookkeeping assumes the renderer applies every request right away.
+// Textures that cannot reload their data, e.g. render targets, are counted
+// but never touched. Keyed by handle like the renderer's own texture
+// state, clear it with the TextureLibrary.
+class TextureResidency {
+private:
+  struct Entry {
+    uint32_t generation = 0;
+    bool tracked = false;
+    bool resident = false;
+    bool reloadable = false;
+    // Restore or reload asked for and not uploaded yet, since restoreFrame
+    bool restoring = false;
+    uint32_t restoreFrame = 0;
+    uint32_t levelCount = 0;
+    uint32_t firstLevel = 0;
+    uint64_t levelBytes[MAX_TEXTURE_LEVELS] = {};
+    // Size of the first level
+    uint32_t levelWidth = 0;
+    uint32_t levelHeight = 0;
+    uint32_t lastUsed = 0;
+
+    uint64_t getBytes() const;
+  };
+
+  std::vector<Entry> entries{};
+  std::vector<uint32_t> candidates{};
+  uint64_t residentBytes = 0;
+  // Of the last update, new textures count as drawn then
+  uint32_t frame = 0;
+
+  Entry *find(const TextureHandle handle, bool create);
+
+public:
+  // Bytes of GPU memory textures may take
+  uint64_t budget = uint64_t(512) << 20;
+  // Frames a texture has to go undrawn before it loses anything
+  uint32_t minUnusedFrames = 120;
+  // Top mips are only dropped while the next level is at least this wide
+  // or high, smaller textures are evicted whole
+  uint32_t minLevelSize = 64;
+  // Frames a restore may take before it is asked for again, e.g. when the
+  // texture could not read its file
+  uint32_t restoreRetryFrames = 120;
+
+  // What update() asked for, summed until the engine logs and resets them
+  uint32_t dropped = 0;
+  uint32_t evicted = 0;
+  uint32_t restored = 0;
+
+  void markUsed(const TextureHandle handle, uint32_t frame);
+
+  // The renderer uploaded data into a new texture with all its levels
+  void setResident(const TextureHandle handle, const TextureData &data,
+                   bool reloadable);
+
+  // The renderer released the texture, e.g. its handle went stale
+  void forget(const TextureHandle handle);
+
+  void update(uint32_t frame, std::vector<ResidencyRequest> &output);
+
+  void clear();
+
+  uint64_t getResidentBytes() const { return residentBytes; }
+};
+
+} // namespace texture
+} // namespace dank
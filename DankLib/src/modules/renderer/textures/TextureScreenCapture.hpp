@@ -22,13 +22,16 @@ public:
       return;
     }
 
-    output.lastModified = captureConfig->screenOutput.frame;
+    // The frame is shared, the capture thread writes the next one elsewhere
+    CaptureScreenOutput &screen = captureConfig->screenOutput;
+    std::lock_guard<std::mutex> lock(screen.mutex);
+    output.lastModified = screen.frame;
     output.state = ResourceState::Ready;
-    output.channels = captureConfig->screenOutput.channels;
-    output.width = captureConfig->screenOutput.width;
-    output.height = captureConfig->screenOutput.height;
-    output.data = captureConfig->screenOutput.data;
-    output.format = captureConfig->screenOutput.format;
+    output.channels = screen.channels;
+    output.width = screen.width;
+    output.height = screen.height;
+    output.pixels = screen.pixels;
+    output.format = screen.format;
   }
 };
 } // namespace texture
@@ -0,0 +1,534 @@
+#include "modules/renderer/textures/VirtualTexture.hpp"
+#include "modules/engine/Console.hpp"
+#include "modules/os/OS.hpp"
+#include "modules/renderer/textures/QoiImage.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dank;
+
+// Virtual texture file kept open for page reads, shared with the jobs
+// reading it so the image can go away while they run
+struct texture::VirtualTextures::Source {
+  std::string path{};
+  std::string cacheDirectory{};
+  // Where a plain image is cut into tiles, named after its path and
+  // modification time
+  std::string convertedPath{};
+  int file = -1;
+  VirtualTextureHeader header{};
+  std::vector<VirtualTile> tiles{};
+  // Written by the jobs, then published by storing state with release
+  std::atomic<ResourceState> state{ResourceState::Loading};
+  // Set with Invalid when path is a plain image that has to be converted
+  bool convert = false;
+
+  ~Source() {
+    if (file >= 0) {
+      close(file);
+    }
+  }
+};
+
+struct texture::VirtualTextures::PageRead {
+  std::shared_ptr<Source> source{};
+  VirtualImageHandle image{};
+  uint32_t page = 0;
+  uint32_t level = 0;
+  PixelBuffer texels{};
+  std::atomic<bool> cancelled{false};
+  std::atomic<ResourceState> state{ResourceState::Loading};
+};
+
+namespace {
+
+// Largest QOI image of a tile, every texel an RGBA chunk
+const uint32_t MAX_TILE_BYTES = texture::QOI_HEADER_SIZE +
+                                texture::VIRTUAL_TILE_SIZE *
+                                    texture::VIRTUAL_TILE_SIZE * 5 +
+                                8;
+// Slot + 1 has to fit in the page tables
+const uint32_t MAX_SLOTS_PER_ROW = 128;
+
+bool readAt(int file, void *output, size_t size, uint64_t offset) {
+  uint8_t *bytes = static_cast<uint8_t *>(output);
+  while (size > 0) {
+    ssize_t count = pread(file, bytes, size, off_t(offset));
+    if (count <= 0)
+      return false;
+    bytes += count;
+    size -= count;
+    offset += count;
+  }
+  return true;
+}
+
+bool openFile(const std::string &path, int &file,
+              texture::VirtualTextureHeader &header,
+              std::vector<texture::VirtualTile> &tiles) {
+  int opened = open(path.c_str(), O_RDONLY);
+  if (opened < 0)
+    return false;
+  uint8_t bytes[sizeof(texture::VirtualTextureHeader)];
+  texture::VirtualTextureHeader read{};
+  bool valid = readAt(opened, bytes, sizeof(bytes), 0) &&
+               texture::readVirtualTextureHeader(bytes, sizeof(bytes), read);
+  std::vector<texture::VirtualTile> table{};
+  if (valid) {
+    table.resize(read.tileCount);
+    valid = readAt(opened, table.data(),
+                   table.size() * sizeof(texture::VirtualTile), sizeof(bytes));
+  }
+  if (!valid) {
+    close(opened);
+    return false;
+  }
+  if (file >= 0) {
+    close(file);
+  }
+  file = opened;
+  header = read;
+  tiles.swap(table);
+  return true;
+}
+
+// FNV-1a of the path, size and modification time, an image edited in place
+// is converted again
+std::string getConvertedPath(const std::string &directory,
+                             const std::string &path) {
+  struct stat info {};
+  if (directory.empty() || stat(path.c_str(), &info) != 0)
+    return "";
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&](const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  };
+  int64_t size = info.st_size;
+  int64_t modified = info.st_mtime;
+  add(path.data(), path.size());
+  add(&size, sizeof(size));
+  add(&modified, sizeof(modified));
+  char name[64];
+  snprintf(name, sizeof(name), "/virtual-%016llx.dvt",
+           static_cast<unsigned long long>(hash));
+  return directory + name;
+}
+
+} // namespace
+
+texture::VirtualImageHandle
+texture::VirtualTextures::add(const URI &uri) {
+  if (cacheDirectory.empty() && dank::os != nullptr) {
+    cacheDirectory = dank::os->getCacheDirectory();
+  }
+  Entry entry{};
+  entry.uri = uri;
+  return images.insert(entry);
+}
+
+void texture::VirtualTextures::update(TextureLibrary &library,
+                                      JobSystem &jobs, uint32_t frame) {
+  // The cache went away with a TextureLibrary::clear
+  auto *cache = static_cast<VirtualPageCache *>(library.get(cacheTexture));
+  if (cache == nullptr) {
+    slotsPerRow = std::min(std::max(cacheSize / VIRTUAL_TILE_SIZE, 1u),
+                           MAX_SLOTS_PER_ROW);
+    cache = new VirtualPageCache(slotsPerRow * VIRTUAL_TILE_SIZE);
+    cacheTexture = library.add(cache);
+    slots.clear();
+  }
+  if (slots.empty()) {
+    resetSlots();
+  }
+
+  updateSources(library, jobs);
+  applyReads(*cache, frame);
+
+  // Coarsest first, the pages everything else falls back to. Pages left
+  // out are asked for again by the next frames still missing them.
+  std::stable_sort(
+      wanted.begin(), wanted.end(),
+      [](const Want &a, const Want &b) { return a.level > b.level; });
+  for (const Want &want : wanted) {
+    Entry *entry = images.get(want.image);
+    if (entry == nullptr)
+      continue;
+    if (reads.size() >= maxReadsInFlight) {
+      entry->requested[want.page] = 0;
+      continue;
+    }
+    auto read = std::make_shared<PageRead>();
+    read->source = entry->source;
+    read->image = want.image;
+    read->page = want.page;
+    read->level = want.level;
+    reads.push_back(read);
+    pagePool.capacity = maxReadsInFlight;
+    jobs.submit([read, pool = pagePool]() mutable {
+      if (read->cancelled) {
+        read->state.store(ResourceState::Invalid, std::memory_order_release);
+        return;
+      }
+      const VirtualTile &tile = read->source->tiles[read->page];
+      std::vector<uint8_t> bytes(std::min(tile.size, MAX_TILE_BYTES));
+      QoiHeader header{};
+      bool valid =
+          tile.size <= MAX_TILE_BYTES &&
+          readAt(read->source->file, bytes.data(), bytes.size(),
+                 tile.offset) &&
+          readQoiHeader(bytes.data(), bytes.size(), header) &&
+          header.width == VIRTUAL_TILE_SIZE &&
+          header.height == VIRTUAL_TILE_SIZE;
+      if (valid) {
+        read->texels =
+            pool.acquire(VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * 4);
+        valid = read->texels &&
+                decodeQoi(bytes.data(), bytes.size(), header,
+                          read->texels.data());
+      }
+      read->state.store(valid ? ResourceState::Ready : ResourceState::Invalid,
+                        std::memory_order_release);
+    });
+  }
+  wanted.clear();
+}
+
+void texture::VirtualTextures::updateSources(TextureLibrary &library,
+                                             JobSystem &jobs) {
+  for (uint32_t i = 0; i < images.size(); i++) {
+    Entry &entry = images.valueAt(i);
+    if (entry.state != ResourceState::Loading)
+      continue;
+
+    if (entry.source == nullptr) {
+      auto source = std::make_shared<Source>();
+      source->path =
+          dank::os != nullptr ? dank::os->getFilePath(entry.uri) : "";
+      source->cacheDirectory = cacheDirectory;
+      if (source->path.empty()) {
+        console::warn("[VirtualTextures] %s is not a file",
+                      entry.uri.path.c_str());
+        entry.state = ResourceState::Invalid;
+        continue;
+      }
+      entry.source = source;
+      jobs.submit([source]() {
+        source->convertedPath =
+            getConvertedPath(source->cacheDirectory, source->path);
+        bool opened =
+            openFile(source->path, source->file, source->header,
+                     source->tiles) ||
+            (!source->convertedPath.empty() &&
+             openFile(source->convertedPath, source->file, source->header,
+                      source->tiles));
+        source->convert = !opened && !source->convertedPath.empty();
+        source->state.store(opened ? ResourceState::Ready
+                                   : ResourceState::Invalid,
+                            std::memory_order_release);
+      });
+      continue;
+    }
+
+    Source &source = *entry.source;
+    ResourceState state = source.state.load(std::memory_order_acquire);
+    if (state == ResourceState::Loading)
+      continue;
+
+    if (state == ResourceState::Invalid && source.convert) {
+      // Decoded with every level, the tiles of each are cut from the chain
+      if (entry.request == nullptr) {
+        entry.request =
+            library.loader.load(entry.uri, LoadPriority::Normal, true);
+        continue;
+      }
+      ResourceState loaded =
+          entry.request->state.load(std::memory_order_acquire);
+      if (loaded == ResourceState::Loading)
+        continue;
+      if (loaded == ResourceState::Ready &&
+          entry.request->format == PixelFormat::RGBA8Unorm &&
+          entry.request->levelCount > 0) {
+        source.state.store(ResourceState::Loading, std::memory_order_relaxed);
+        auto shared = entry.source;
+        auto request = entry.request;
+        entry.request = nullptr;
+        jobs.submit([shared, request]() {
+          bool opened =
+              writeVirtualTextureFile(shared->convertedPath,
+                                      request->pixels.data(),
+                                      request->levels, request->levelCount) &&
+              openFile(shared->convertedPath, shared->file, shared->header,
+                       shared->tiles);
+          shared->convert = false;
+          shared->state.store(opened ? ResourceState::Ready
+                                     : ResourceState::Invalid,
+                              std::memory_order_release);
+        });
+        continue;
+      }
+      entry.request = nullptr;
+    }
+
+    if (state == ResourceState::Invalid) {
+      console::warn("[VirtualTextures] could not open %s",
+                    source.path.c_str());
+      entry.state = ResourceState::Invalid;
+      continue;
+    }
+
+    const VirtualTextureHeader &header = source.header;
+    entry.width = header.width;
+    entry.height = header.height;
+    entry.levelCount = header.levelCount;
+    uint32_t total = 0;
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+      entry.levelStart[level] = total;
+      total += getVirtualTileCount(header.width, level) *
+               getVirtualTileCount(header.height, level);
+    }
+    entry.pages.assign(total, 0);
+    entry.requested.assign(total, 0);
+    entry.state = ResourceState::Ready;
+    // The coarsest level is a single page
+    request(entry, images.handleAt(i), total - 1, header.levelCount - 1);
+    console::log("[VirtualTextures] %s: %dx%d, %d levels, %d pages",
+                 source.path.c_str(), header.width, header.height,
+                 header.levelCount, total);
+  }
+}
+
+void texture::VirtualTextures::applyReads(VirtualPageCache &cache,
+                                          uint32_t frame) {
+  bool modified = false;
+  for (size_t i = 0; i < reads.size();) {
+    PageRead &read = *reads[i];
+    ResourceState state = read.state.load(std::memory_order_acquire);
+    if (state == ResourceState::Loading) {
+      i++;
+      continue;
+    }
+
+    Entry *entry = images.get(read.image);
+    if (entry != nullptr) {
+      entry->requested[read.page] = 0;
+    }
+    if (entry != nullptr && state == ResourceState::Ready &&
+        entry->pages[read.page] == 0) {
+      // A free slot, otherwise the least recently used one no frame in
+      // flight samples. With none the page is dropped and asked for again.
+      uint32_t chosen = UINT32_MAX;
+      uint32_t oldest = UINT32_MAX;
+      for (uint32_t s = 0; s < slots.size(); s++) {
+        const Slot &slot = slots[s];
+        if (!slot.image.isValid()) {
+          chosen = s;
+          break;
+        }
+        if (!slot.pinned && slot.lastUsed + FRAMES_IN_FLIGHT < frame &&
+            slot.lastUsed < oldest) {
+          chosen = s;
+          oldest = slot.lastUsed;
+        }
+      }
+
+      if (chosen != UINT32_MAX) {
+        Slot &slot = slots[chosen];
+        if (slot.image.isValid()) {
+          Entry *previous = images.get(slot.image);
+          if (previous != nullptr) {
+            previous->pages[slot.page] = 0;
+          }
+          evictions++;
+        } else {
+          residentPages++;
+        }
+        slot = Slot{read.image, read.page, frame,
+                    read.level + 1 == entry->levelCount};
+        entry->pages[read.page] = chosen + 1;
+
+        uint32_t x = chosen % slotsPerRow * VIRTUAL_TILE_SIZE;
+        uint32_t y = chosen / slotsPerRow * VIRTUAL_TILE_SIZE;
+        for (uint32_t row = 0; row < VIRTUAL_TILE_SIZE; row++) {
+          memcpy(cache.pixels.data() + (size_t(y + row) * cache.size + x) * 4,
+                 read.texels.data() + row * VIRTUAL_TILE_SIZE * 4,
+                 VIRTUAL_TILE_SIZE * 4);
+        }
+        cache.updates.push_back(
+            TextureUpdate{x, y, VIRTUAL_TILE_SIZE, VIRTUAL_TILE_SIZE});
+        modified = true;
+        pagesRead++;
+      }
+    }
+    reads[i] = std::move(reads.back());
+    reads.pop_back();
+  }
+  if (modified) {
+    cache.lastModified++;
+  }
+}
+
+bool texture::VirtualTextures::resolve(VirtualImageHandle handle,
+                                       uint32_t level, uint32_t x, uint32_t y,
+                                       uint32_t frame, VirtualPage &output) {
+  Entry *entry = images.get(handle);
+  if (entry == nullptr || entry->state != ResourceState::Ready ||
+      slots.empty() || level >= entry->levelCount ||
+      x >= getVirtualTileCount(entry->width, level) ||
+      y >= getVirtualTileCount(entry->height, level))
+    return false;
+
+  output.imageRect =
+      getVirtualPageRect(entry->width, entry->height, level, x, y);
+  glm::vec2 offset = glm::vec2(output.imageRect);
+  glm::vec2 extent = glm::vec2(output.imageRect.z, output.imageRect.w);
+
+  // Each coarser page covers the 2x2 pages under it
+  for (; level < entry->levelCount; level++, x >>= 1, y >>= 1) {
+    uint32_t page = entry->levelStart[level] +
+                    y * getVirtualTileCount(entry->width, level) + x;
+    uint16_t slot = entry->pages[page];
+    if (slot == 0) {
+      request(*entry, handle, page, level);
+      continue;
+    }
+    slots[slot - 1].lastUsed = frame;
+
+    glm::vec2 size = glm::vec2(std::max(entry->width >> level, 1u),
+                               std::max(entry->height >> level, 1u));
+    glm::vec2 origin =
+        glm::vec2((slot - 1) % slotsPerRow, (slot - 1) / slotsPerRow) *
+            float(VIRTUAL_TILE_SIZE) +
+        float(VIRTUAL_TILE_BORDER) -
+        glm::vec2(x, y) * float(VIRTUAL_TILE_CONTENT);
+    float cacheSize = float(slotsPerRow * VIRTUAL_TILE_SIZE);
+    output.cacheRect =
+        glm::vec4(origin + offset * size, extent * size) / cacheSize;
+    return true;
+  }
+  return false;
+}
+
+uint32_t texture::VirtualTextures::selectPages(
+    VirtualImageHandle handle, const glm::mat4 &transform,
+    glm::vec2 visibleMin, glm::vec2 visibleMax,
+    const std::vector<VirtualView> &views, uint32_t budget, uint32_t frame,
+    std::vector<VirtualPage> &output) {
+  const Entry *entry = images.get(handle);
+  if (entry == nullptr || entry->state != ResourceState::Ready ||
+      views.empty())
+    return 0;
+  glm::vec2 size = glm::vec2(entry->width, entry->height);
+
+  // Pages fine enough for every view are kept, the others are split into
+  // the visible pages under them, a level at a time while they fit
+  selectedPages.clear();
+  candidatePages.assign(1, PageRef{entry->levelCount - 1, 0, 0});
+  while (!candidatePages.empty()) {
+    size_t kept = selectedPages.size();
+    splitPages.clear();
+    for (const auto &page : candidatePages) {
+      glm::vec4 rect = getVirtualPageRect(entry->width, entry->height,
+                                          page.level, page.x, page.y);
+      if (page.level == 0 ||
+          selectLevel(transform, size, rect, views) >= page.level) {
+        selectedPages.push_back(page);
+        continue;
+      }
+      uint32_t level = page.level - 1;
+      uint32_t columns = getVirtualTileCount(entry->width, level);
+      uint32_t rows = getVirtualTileCount(entry->height, level);
+      for (uint32_t y = page.y * 2; y < std::min(page.y * 2 + 2, rows); y++) {
+        for (uint32_t x = page.x * 2; x < std::min(page.x * 2 + 2, columns);
+             x++) {
+          glm::vec4 child =
+              getVirtualPageRect(entry->width, entry->height, level, x, y);
+          if (child.x <= visibleMax.x && child.x + child.z >= visibleMin.x &&
+              child.y <= visibleMax.y && child.y + child.w >= visibleMin.y) {
+            splitPages.push_back(PageRef{level, x, y});
+          }
+        }
+      }
+    }
+    if (selectedPages.size() + splitPages.size() > budget) {
+      // Out of room in the cache, this level is as fine as it gets
+      selectedPages.resize(kept);
+      selectedPages.insert(selectedPages.end(), candidatePages.begin(),
+                           candidatePages.end());
+      break;
+    }
+    candidatePages.swap(splitPages);
+  }
+
+  for (const auto &ref : selectedPages) {
+    VirtualPage page{};
+    if (resolve(handle, ref.level, ref.x, ref.y, frame, page)) {
+      output.push_back(page);
+    }
+  }
+  return selectedPages.size();
+}
+
+// Finest level any view needs for the part of the image in imageRect,
+// measured where it is closest to the eye
+uint32_t texture::VirtualTextures::selectLevel(
+    const glm::mat4 &transform, glm::vec2 size, const glm::vec4 &imageRect,
+    const std::vector<VirtualView> &views) const {
+  glm::vec2 localMin = glm::vec2(imageRect.x - 0.5f,
+                                 0.5f - imageRect.y - imageRect.w) *
+                       size;
+  glm::vec2 localMax =
+      glm::vec2(imageRect.x + imageRect.z - 0.5f, 0.5f - imageRect.y) * size;
+  float texelsPerPixel = std::numeric_limits<float>::max();
+  for (const auto &view : views) {
+    float distance = 1.0f;
+    if (view.perspective) {
+      glm::vec2 closest =
+          glm::clamp(glm::vec2(view.localEye), localMin, localMax);
+      glm::vec3 point = glm::vec3(transform * glm::vec4(closest, 0, 1));
+      distance = glm::max(glm::distance(point, view.eye), 1e-4f);
+    }
+    texelsPerPixel = glm::min(texelsPerPixel, distance / view.pixelsPerTexel);
+  }
+  float level = glm::floor(glm::log2(texelsPerPixel) + lodBias);
+  return uint32_t(glm::clamp(level, 0.0f, float(MAX_TEXTURE_LEVELS)));
+}
+
+void texture::VirtualTextures::request(Entry &entry, VirtualImageHandle handle,
+                                       uint32_t page, uint32_t level) {
+  if (entry.requested[page] != 0)
+    return;
+  entry.requested[page] = 1;
+  wanted.push_back(Want{handle, page, level});
+}
+
+void texture::VirtualTextures::resetSlots() {
+  slots.assign(slotsPerRow * slotsPerRow, Slot{});
+  residentPages = 0;
+  for (auto &entry : images) {
+    std::fill(entry.pages.begin(), entry.pages.end(), 0);
+  }
+}
+
+void texture::VirtualTextures::clear() {
+  for (auto &read : reads) {
+    read->cancelled = true;
+  }
+  for (auto &entry : images) {
+    if (entry.request != nullptr) {
+      entry.request->cancelled = true;
+    }
+  }
+  reads.clear();
+  wanted.clear();
+  images.clear();
+  slots.clear();
+  residentPages = 0;
+}
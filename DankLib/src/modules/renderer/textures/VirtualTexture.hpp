@@ -0,0 +1,230 @@
+#pragma once
+#include "modules/Foundation.hpp"
+#include "modules/SlotMap.hpp"
+#include "modules/os/JobSystem.hpp"
+#include "modules/os/URI.hpp"
+#include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureLoader.hpp"
+#include "modules/renderer/textures/VirtualTextureFile.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dank {
+namespace texture {
+
+// RGBA8 texture holding the resident pages of every virtual image, a grid
+// of VIRTUAL_TILE_SIZE slots. Pages are copied into the CPU pixels as they
+// are read, and only the slots written since the last upload are listed
+// for the renderer.
+class VirtualPageCache : public Texture {
+public:
+  uint32_t size;
+  PixelBuffer pixels;
+  std::vector<TextureUpdate> updates{};
+  uint32_t lastModified = 1;
+
+  explicit VirtualPageCache(uint32_t size)
+      : size(size),
+        pixels(PixelBuffer::allocate(size_t(size) * size * 4, true)) {}
+
+  TextureType getType() override { return TextureType::Color; }
+
+  // A new texture is always uploaded whole, so nothing is lost with it
+  bool isReloadable() override { return true; }
+  void reload() override { lastModified++; }
+
+  void fetchData(TextureData &output) override {
+    output.state = ResourceState::Ready;
+    output.lastModified = lastModified;
+    output.width = size;
+    output.height = size;
+    output.channels = 4;
+    output.format = PixelFormat::RGBA8Unorm;
+    output.pixels = pixels;
+    output.updates = updates.data();
+    output.updateCount = updates.size();
+  }
+
+  void releaseData(TextureData &output) override { updates.clear(); }
+};
+
+struct VirtualImageTag;
+typedef Handle<VirtualImageTag> VirtualImageHandle;
+
+// Size of a virtual image in texels of its largest level, Loading until its
+// file is open
+struct VirtualImage {
+  ResourceState state = ResourceState::Loading;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t levelCount = 0;
+};
+
+// Where a page is drawn from: its part of the image and the matching part
+// of the page cache, normalized with y down, as offset (xy) and size (zw)
+struct VirtualPage {
+  glm::vec4 imageRect{0.0f};
+  glm::vec4 cacheRect{0.0f};
+};
+
+// A view a virtual image is visible in, what the texel size of its pages
+// on screen is measured with
+struct VirtualView {
+  glm::vec3 eye;
+  // Eye in the image's space, texels from its center
+  glm::vec3 localEye;
+  // Pixels per texel at unit distance (perspective) or any distance
+  float pixelsPerTexel;
+  bool perspective;
+};
+
+// Part of a virtual image covered by page x, y of a level, normalized with
+// y down, as offset (xy) and size (zw)
+inline glm::vec4 getVirtualPageRect(uint32_t width, uint32_t height,
+                                    uint32_t level, uint32_t x, uint32_t y) {
+  glm::vec2 levelSize = glm::vec2(std::max(width >> level, 1u),
+                                  std::max(height >> level, 1u));
+  glm::vec2 start = glm::vec2(x, y) * float(VIRTUAL_TILE_CONTENT);
+  glm::vec2 end = glm::min(start + float(VIRTUAL_TILE_CONTENT), levelSize);
+  return glm::vec4(start / levelSize, (end - start) / levelSize);
+}
+
+// Sparse virtual texturing, images of any size drawn through a page cache
+// of constant size. Images are virtual texture files (VirtualTextureFile.hpp)
+// read a tile at a time; any other image is decoded with the
+// TextureLoader once, cut into tiles and written to the OS cache directory
+// first.
+//
+// The indirection happens on the CPU: DrawLists clips a draw::VirtualSprite
+// against the views, selectPages() picks the pages it needs and each is
+// drawn as a quad of the cache. resolve() falls back to the finest resident
+// ancestor of a missing page and asks for it. update() reads the asked
+// pages on the JobSystem, coarsest first, into the least recently used
+// slots no frame in flight samples anymore. The coarsest level of every
+// image fits a single page, it is read first and never evicted, so
+// something is always there to fall back to.
+//
+// The cache texture is owned by the TextureLibrary, clear both together
+// like the TextureAtlas.
+class VirtualTextures {
+private:
+  struct Source;
+  struct PageRead;
+
+  struct Entry : VirtualImage {
+    URI uri{};
+    std::shared_ptr<Source> source{};
+    // Decoded image being cut into tiles, see Source::convert
+    std::shared_ptr<LoadRequest> request{};
+    uint32_t levelStart[MAX_TEXTURE_LEVELS];
+    // Slot + 1 of every page of every level, 0 when not resident
+    std::vector<uint16_t> pages{};
+    // Asked for this frame or being read
+    std::vector<uint8_t> requested{};
+  };
+
+  struct Slot {
+    VirtualImageHandle image{};
+    uint32_t page = 0;
+    uint32_t lastUsed = 0;
+    bool pinned = false;
+  };
+
+  struct Want {
+    VirtualImageHandle image{};
+    uint32_t page = 0;
+    uint32_t level = 0;
+  };
+
+  struct PageRef {
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+  };
+
+  SlotMap<Entry, VirtualImageTag> images{};
+  TextureHandle cacheTexture{};
+  std::vector<Slot> slots{};
+  uint32_t slotsPerRow = 0;
+  std::vector<Want> wanted{};
+  std::vector<std::shared_ptr<PageRead>> reads{};
+  // Texels of the pages being read, back in the pool once copied
+  PixelPool pagePool{};
+  uint32_t residentPages = 0;
+  // Pages being refined by selectPages(), kept for their capacity
+  std::vector<PageRef> candidatePages{};
+  std::vector<PageRef> splitPages{};
+  std::vector<PageRef> selectedPages{};
+
+  uint32_t selectLevel(const glm::mat4 &transform, glm::vec2 size,
+                       const glm::vec4 &imageRect,
+                       const std::vector<VirtualView> &views) const;
+  void updateSources(TextureLibrary &library, JobSystem &jobs);
+  void applyReads(VirtualPageCache &cache, uint32_t frame);
+  void request(Entry &entry, VirtualImageHandle handle, uint32_t page,
+               uint32_t level);
+  void resetSlots();
+
+public:
+  // Texels across the cache texture, a multiple of VIRTUAL_TILE_SIZE applied
+  // when the cache is created. Enough for a few screens of pages at most one
+  // level too fine.
+  uint32_t cacheSize = 4096;
+  // Pages read and decoded on the JobSystem at the same time
+  uint32_t maxReadsInFlight = 16;
+  // Added to log2 of the texels per pixel before picking the level of a
+  // page, 0.5 takes the nearest level and 0 never magnifies
+  float lodBias = 0.5f;
+  // Where plain images are cut into tiles, taken from the OS on the first
+  // add, empty leaves them Invalid
+  std::string cacheDirectory{};
+
+  // Pages read and slots taken from other pages, summed until the engine
+  // logs and resets them
+  uint32_t pagesRead = 0;
+  uint32_t evictions = 0;
+
+  ~VirtualTextures() { clear(); }
+
+  // The image is Loading until update() opened its file on the JobSystem
+  VirtualImageHandle add(const URI &uri);
+
+  // Applies the pages read and the images opened since the last call, then
+  // reads the pages resolve() asked for. Once per update.
+  void update(TextureLibrary &library, JobSystem &jobs, uint32_t frame);
+
+  // Page x, y of a level of the image. Missing pages are asked for and
+  // drawn from their finest resident ancestor; false when nothing of the
+  // image is resident yet or the page is out of range.
+  bool resolve(VirtualImageHandle handle, uint32_t level, uint32_t x,
+               uint32_t y, uint32_t frame, VirtualPage &output);
+
+  // Pages for the part of the image between the uvs visibleMin and
+  // visibleMax, each at the level matching its texel size on screen in the
+  // view where it is largest. transform places the image in the space of
+  // the views. Levels are refined from the coarsest one down while at most
+  // budget pages are picked. The pages are resolved into output, returns
+  // how many were picked, resident or not.
+  uint32_t selectPages(VirtualImageHandle handle, const glm::mat4 &transform,
+                       glm::vec2 visibleMin, glm::vec2 visibleMax,
+                       const std::vector<VirtualView> &views, uint32_t budget,
+                       uint32_t frame, std::vector<VirtualPage> &output);
+
+  // nullptr when the handle is stale
+  const VirtualImage *get(VirtualImageHandle handle) const {
+    return images.get(handle);
+  }
+
+  TextureHandle getCacheTexture() const { return cacheTexture; }
+  uint32_t getSlotCount() const { return slots.size(); }
+  uint32_t getResidentPages() const { return residentPages; }
+  uint32_t getReadsInFlight() const { return reads.size(); }
+
+  // Does not touch the TextureLibrary, meant to be called with its clear()
+  void clear();
+};
+
+} // namespace texture
+} // namespace dank
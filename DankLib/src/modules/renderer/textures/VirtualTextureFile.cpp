@@ -0,0 +1,81 @@
+#include "modules/renderer/textures/VirtualTextureFile.hpp"
+#include "modules/renderer/textures/QoiImage.hpp"
+#include <cstdio>
+#include <vector>
+
+using namespace dank;
+
+namespace {
+
+// One tile and its border out of a level, edges clamped
+void cutTile(const uint8_t *level, uint32_t width, uint32_t height,
+             uint32_t column, uint32_t row, uint8_t *tile) {
+  int32_t left = int32_t(column * texture::VIRTUAL_TILE_CONTENT) -
+                 int32_t(texture::VIRTUAL_TILE_BORDER);
+  int32_t top = int32_t(row * texture::VIRTUAL_TILE_CONTENT) -
+                int32_t(texture::VIRTUAL_TILE_BORDER);
+  for (uint32_t y = 0; y < texture::VIRTUAL_TILE_SIZE; y++) {
+    int32_t sy = std::min(std::max(top + int32_t(y), 0), int32_t(height) - 1);
+    const uint8_t *source = level + size_t(sy) * width * 4;
+    uint8_t *target = tile + y * texture::VIRTUAL_TILE_SIZE * 4;
+    for (uint32_t x = 0; x < texture::VIRTUAL_TILE_SIZE; x++) {
+      int32_t sx =
+          std::min(std::max(left + int32_t(x), 0), int32_t(width) - 1);
+      memcpy(target + x * 4, source + sx * 4, 4);
+    }
+  }
+}
+
+} // namespace
+
+bool texture::writeVirtualTextureFile(const std::string &path,
+                                      const uint8_t *chain,
+                                      const TextureLevel *levels,
+                                      uint32_t levelCount) {
+  VirtualTextureHeader header{};
+  header.width = levels[0].width;
+  header.height = levels[0].height;
+  header.levelCount =
+      getVirtualLevelCount(header.width, header.height, levelCount);
+  header.tileCount =
+      getVirtualTileTotal(header.width, header.height, header.levelCount);
+
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  // The table is written once the tiles are and their sizes known
+  std::vector<VirtualTile> tiles(header.tileCount);
+  uint64_t offset = sizeof(header) + tiles.size() * sizeof(VirtualTile);
+  bool written = fseek(file, long(offset), SEEK_SET) == 0;
+  std::vector<uint8_t> texels(VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * 4);
+  std::vector<uint8_t> bytes{};
+  uint32_t index = 0;
+  for (uint32_t level = 0; level < header.levelCount && written; level++) {
+    const TextureLevel &source = levels[level];
+    uint32_t columns = getVirtualTileCount(header.width, level);
+    uint32_t rows = getVirtualTileCount(header.height, level);
+    for (uint32_t row = 0; row < rows && written; row++) {
+      for (uint32_t column = 0; column < columns && written; column++) {
+        cutTile(chain + source.offset, source.width, source.height, column,
+                row, texels.data());
+        encodeQoi(texels.data(), VIRTUAL_TILE_SIZE, VIRTUAL_TILE_SIZE, 4,
+                  bytes);
+        tiles[index++] = VirtualTile{offset, uint32_t(bytes.size()), 0};
+        offset += bytes.size();
+        written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+      }
+    }
+  }
+  written = written && fseek(file, 0, SEEK_SET) == 0 &&
+            fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(tiles.data(), sizeof(VirtualTile), tiles.size(), file) ==
+                tiles.size();
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+    remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace dank {
+namespace texture {
+
+// Mip chain of an image cut into tiles, read a tile at a time by
+// VirtualTextures so images of any size stream through a fixed page cache:
+//
+//   VirtualTextureHeader
+//   VirtualTile[tileCount], the rows of tiles of every level, largest first
+//   tiles, each a QOI image (QoiImage.hpp) of VIRTUAL_TILE_SIZE squared
+//   premultiplied RGBA8 texels
+//
+// A tile holds VIRTUAL_TILE_CONTENT texels of its level and
+// VIRTUAL_TILE_BORDER more on every side copied from its neighbours,
+// clamped at the edges of the image, so tiles filter seamlessly next to
+// each other wherever they sit in the cache. Everything is little endian.
+// Written by tools/vtbuild and by VirtualTextures for plain images.
+const uint32_t VIRTUAL_TEXTURE_MAGIC = 0x58545644; // "DVTX"
+const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+const uint32_t VIRTUAL_TILE_SIZE = 128;
+const uint32_t VIRTUAL_TILE_BORDER = 4;
+const uint32_t VIRTUAL_TILE_CONTENT =
+    VIRTUAL_TILE_SIZE - VIRTUAL_TILE_BORDER * 2;
+
+struct VirtualTextureHeader {
+  uint32_t magic = VIRTUAL_TEXTURE_MAGIC;
+  uint32_t version = VIRTUAL_TEXTURE_VERSION;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t levelCount = 0;
+  uint32_t tileCount = 0;
+  uint32_t reserved[2] = {0, 0};
+};
+
+// Bytes of a tile's QOI image from the start of the file
+struct VirtualTile {
+  uint64_t offset = 0;
+  uint32_t size = 0;
+  uint32_t reserved = 0;
+};
+
+static_assert(sizeof(VirtualTextureHeader) == 32,
+              "VirtualTextureHeader layout changed");
+static_assert(sizeof(VirtualTile) == 16, "VirtualTile layout changed");
+
+// Tiles across or down a level of an image size texels wide or high
+inline uint32_t getVirtualTileCount(uint32_t size, uint32_t level) {
+  uint32_t levelSize = std::max(size >> level, 1u);
+  return (levelSize + VIRTUAL_TILE_CONTENT - 1) / VIRTUAL_TILE_CONTENT;
+}
+
+// Levels down to the first one fitting in a single tile, at most
+// levelCount of a mip chain
+inline uint32_t getVirtualLevelCount(uint32_t width, uint32_t height,
+                                     uint32_t levelCount) {
+  uint32_t count = 1;
+  while (count < levelCount && (getVirtualTileCount(width, count - 1) > 1 ||
+                                getVirtualTileCount(height, count - 1) > 1)) {
+    count++;
+  }
+  return count;
+}
+
+inline uint32_t getVirtualTileTotal(uint32_t width, uint32_t height,
+                                    uint32_t levelCount) {
+  uint32_t total = 0;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    total += getVirtualTileCount(width, level) *
+             getVirtualTileCount(height, level);
+  }
+  return total;
+}
+
+inline bool readVirtualTextureHeader(const void *data, size_t size,
+                                     VirtualTextureHeader &header) {
+  if (data == nullptr || size < sizeof(VirtualTextureHeader))
+    return false;
+  memcpy(&header, data, sizeof(VirtualTextureHeader));
+  return header.magic == VIRTUAL_TEXTURE_MAGIC &&
+         header.version == VIRTUAL_TEXTURE_VERSION && header.width > 0 &&
+         header.height > 0 && header.levelCount > 0 &&
+         header.levelCount <= MAX_TEXTURE_LEVELS &&
+         header.tileCount == getVirtualTileTotal(header.width, header.height,
+                                                 header.levelCount);
+}
+
+// Cuts the levels of a premultiplied RGBA8 mip chain (MipChain.hpp) into
+// tiles and writes them to path, going through a temporary file so readers
+// never see it half written. Levels past the first one fitting a single
+// tile are left out.
+bool writeVirtualTextureFile(const std::string &path, const uint8_t *chain,
+                             const TextureLevel *levels,
+                             uint32_t levelCount);
+
+} // namespace texture
+} // namespace dank
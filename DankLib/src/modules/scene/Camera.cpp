@@ -1,13 +1,30 @@
 #include "modules/scene/Camera.hpp"
 #include "modules/FrameContext.hpp"
 #include <cassert>
+#include <limits>
 
 using namespace dank;
 
 void Camera::onViewResize(float viewWidth, float viewHeight) {
   assert(viewWidth > 0);
   assert(viewHeight > 0);
-  viewport = glm::vec4(0, 0, viewWidth, viewHeight);
+  viewport = viewportRect * glm::vec4(viewWidth, viewHeight, viewWidth,
+                                     viewHeight);
+}
+
+void Camera::getFrustumBounds(glm::vec3 &min, glm::vec3 &max) const {
+  const glm::mat4 inverseViewProj = glm::inverse(proj * view);
+  min = glm::vec3(std::numeric_limits<float>::max());
+  max = glm::vec3(std::numeric_limits<float>::lowest());
+  // NDC depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+  for (int i = 0; i < 8; i++) {
+    glm::vec4 corner = inverseViewProj * glm::vec4((i & 1) ? 1.0f : -1.0f,
+                                                   (i & 2) ? 1.0f : -1.0f,
+                                                   (i & 4) ? 1.0f : 0.0f, 1.0f);
+    glm::vec3 p = glm::vec3(corner) / corner.w;
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
 }
 
 const glm::vec3 Camera::screenToWorld(float screenX, float screenY,
@@ -21,6 +38,20 @@ const glm::vec2 Camera::worldToScreen(glm::vec3 &offset, glm::mat4 &model) {
 }
 
 void Camera::update(FrameContext &ctx) {
+  // Cameras rendering into a texture take their viewport from its size,
+  // screen cameras get theirs in onViewResize
+  if (renderTarget.isValid()) {
+    auto *target = ctx.textureLibrary.get(renderTarget);
+    viewport = glm::vec4(0.0f);
+    if (target != nullptr &&
+        target->getType() == texture::TextureType::RenderTarget) {
+      texture::TextureData data{};
+      target->fetchData(data);
+      viewport = viewportRect * glm::vec4(data.width, data.height, data.width,
+                                          data.height);
+    }
+  }
+
   float width = viewport[2];
   float height = viewport[3];
   if (mode == ProjectionMode::Perspective) {
@@ -35,11 +66,11 @@ void Camera::update(FrameContext &ctx) {
   time += ctx.deltaTime;
 }
 
-void Camera::getCameraUBO(CameraUBO *output) {
-  output->view = view;
+void Camera::getCameraUBO(CameraUBO *output, const glm::vec3 &originOffset) {
+  output->view = view * glm::translate(glm::mat4(1.0f), originOffset);
   output->proj = proj;
-  output->viewProj = proj * view;
-  output->position = glm::vec4(pos, 0.0f);
+  output->viewProj = proj * output->view;
+  output->position = glm::vec4(pos - originOffset, 0.0f);
   output->lightViewPos = output->position * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
   output->nearPlane = znear;
   output->farPlane = zfar;
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "modules/Foundation.hpp"
 #include "modules/FrameContext.hpp"
 #include "modules/scene/Frustrum.h"
@@ -29,21 +31,35 @@ public:
 
   ProjectionMode mode = ProjectionMode::Orthographic;
 
+  bool enabled = true;
+  // Normalized area of the render target covered by this camera (x, y,
+  // width, height), used for split-screen, minimaps and picture-in-picture
+  glm::vec4 viewportRect{0.0f, 0.0f, 1.0f, 1.0f};
+  // Handle of a texture::RenderTarget, an invalid handle renders to the
+  // screen. The viewport then follows the target's size, see update().
+  texture::TextureHandle renderTarget{};
+
+  // Double precision world origin, pos and target are relative to it
+  glm::dvec3 origin{0.0};
   glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
   glm::vec3 pos;
   glm::vec3 target;
-  glm::vec4 viewport;
+  glm::vec4 viewport{0.0f};
   glm::mat4 view;
   glm::mat4 proj;
   Frustum frustrum{};
 
   void onViewResize(float viewWidth, float viewHeight);
+  void getFrustumBounds(glm::vec3 &min, glm::vec3 &max) const;
 
   const glm::vec3 screenToWorld(float screenX, float screenY, float depth);
   const glm::vec2 worldToScreen(glm::vec3 &offset, glm::mat4 &model);
 
   void update(FrameContext &ctx);
-  void getCameraUBO(CameraUBO *output);
+  // originOffset moves the camera into a render space centered on another
+  // origin, see draw::DrawLists
+  void getCameraUBO(CameraUBO *output,
+                    const glm::vec3 &originOffset = glm::vec3(0.0f));
 };
 
 } // namespace dank
\ No newline at end of file
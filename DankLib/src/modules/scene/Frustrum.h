@@ -1,3 +1,5 @@
+#pragma once
+
 #include "modules/Foundation.hpp"
 
 namespace dank {
@@ -46,7 +48,7 @@ public:
     }
   }
 
-  bool checkSphere(glm::vec3 pos, float radius) {
+  bool checkSphere(glm::vec3 pos, float radius) const {
     for (auto i = 0; i < planes.size(); i++) {
       if ((planes[i].x * pos.x) + (planes[i].y * pos.y) +
               (planes[i].z * pos.z) + planes[i].w <=
@@ -1,45 +1,85 @@
 #include "Scene.hpp"
+#include "modules/animation/Skeleton.hpp"
 #include "libs/glm/fwd.hpp"
 #include "modules/engine/Console.hpp"
 #include "modules/input/Controller.hpp"
 #include "modules/input/Input.hpp"
 #include "modules/input/InputEvent.hpp"
 #include "modules/os/Capture.hpp"
+#include "modules/os/OS.hpp"
 #include "modules/renderer/Renderer.hpp"
 #include "modules/renderer/meshes/Mesh.hpp"
 #include "modules/renderer/meshes/RectangleMesh.hpp"
+#include "modules/renderer/meshes/SphereMesh.hpp"
 #include "modules/renderer/meshes/SpriteMesh.hpp"
+#include "modules/renderer/meshes/SpriteTable.hpp"
 #include "modules/renderer/meshes/TriangleMesh.hpp"
 #include "modules/renderer/textures/DebugTexture.hpp"
+#include "modules/renderer/textures/RenderTarget.hpp"
 #include "modules/renderer/textures/Texture.hpp"
 #include "modules/renderer/textures/Texture2D.hpp"
 #include "modules/renderer/textures/TextureScreenCapture.hpp"
 #include <cstdint>
+#include <cstdio>
 
 using namespace dank;
 
 struct TextureIDs {
-  uint32_t sprites;
-  uint32_t starfield;
-  uint32_t screen;
+  texture::TextureHandle sprites;
+  // 256x256 copy of the backdrop for the trail, badge and spheres, the
+  // full image is only streamed as the virtual Starfield
+  texture::TextureHandle starfield;
+  texture::TextureHandle screen;
 };
 
+// The backdrop, streamed a page at a time
 struct Starfield {
-  uint32_t meshId;
-  uint32_t textureId;
+  texture::VirtualImageHandle imageId;
 };
 
 struct Spaceship {
   glm::vec3 pos;
   glm::vec3 scale{1, 1, 1};
-  uint32_t meshId;
-  uint32_t textureId;
+  mesh::SpriteHandle spriteId;
+  texture::TextureHandle textureId;
+};
+
+// Ribbon through the recent positions of a spaceship, drifting backwards
+// as if it was flying forward, rebuilt every frame as transient geometry
+struct Trail {
+  std::vector<glm::vec3> points{};
+  uint32_t length = 48;
+  float width = 40.0f;
+  // Units per millisecond
+  float speed = 0.3f;
+};
+
+// Score counter and debug overlay in the top left corner of the 2D view.
+// The score is the distance flown, in the trail's units.
+struct Hud {
+  text::FontHandle fontId;
+  float score = 0.0f;
+  float margin = 24.0f;
+  float scoreSize = 40.0f;
+  float debugSize = 16.0f;
+};
+
+// Top down view around the spaceship rendered into a texture by a camera
+// of its own, shown in the bottom right corner
+struct Minimap {
+  texture::TextureHandle target;
+  mesh::SpriteHandle spriteId;
+  uint32_t size = 256;
+  // Of the minimap camera, below 1 it sees more than the main one
+  float scale = 0.2f;
+  float displayScale = 1.5f;
+  float margin = 24.0f;
 };
 
 struct ScreenView {
   bool initialized{false};
-  uint32_t meshId;
-  uint32_t textureId;
+  mesh::SpriteHandle spriteId;
+  texture::TextureHandle textureId;
 };
 
 struct PlayerController {
@@ -47,6 +87,65 @@ struct PlayerController {
                            {InputKey::KEY_W, InputKey::KEY_UP}};
   ControllerAction backward{ControllerActionOn::Hold,
                             {InputKey::KEY_S, InputKey::KEY_DOWN}};
+  ControllerAction cycleViews{ControllerActionOn::Press, {InputKey::KEY_V}};
+  ControllerAction toggleBenchmark{ControllerActionOn::Press,
+                                   {InputKey::KEY_B}};
+  ControllerAction toggleLodBenchmark{ControllerActionOn::Press,
+                                      {InputKey::KEY_L}};
+  ControllerAction toggleSkinningBenchmark{ControllerActionOn::Press,
+                                           {InputKey::KEY_K}};
+  ControllerAction runViewBenchmark{ControllerActionOn::Press,
+                                    {InputKey::KEY_C}};
+};
+
+// Grid of sprites used to measure culling cost with 1, 2 and 4 views. The
+// sprites are generated images packed into the atlas, a few textures for
+// all of them.
+struct Benchmark {
+  bool enabled{false};
+  uint32_t columns = 20;
+  uint32_t rows = 12;
+  float spacing = 120.0f;
+  uint32_t imageCount = 256;
+  struct Image {
+    mesh::SpriteHandle spriteId;
+    texture::TextureHandle textureId;
+  };
+  std::vector<Image> images{};
+};
+
+// Culling cost with 1, 2 and 4 views over the sprite grid, measured for
+// framesPerStep frames each after warmupFrames and logged at the end
+struct ViewBenchmark {
+  bool running{false};
+  uint32_t step = 0;
+  uint32_t frame = 0;
+  uint32_t warmupFrames = 10;
+  uint32_t framesPerStep = 120;
+  double cullTime = 0;
+  double results[3]{};
+  // Restored when done
+  uint32_t viewCount = 1;
+  bool gridEnabled = false;
+};
+
+// Field of spheres going into the distance under a perspective camera, the
+// far ones are drawn with their simplified levels
+struct LodBenchmark {
+  bool enabled{false};
+  uint32_t columns = 16;
+  uint32_t rows = 48;
+  float spacing = 3.0f;
+  mesh::MeshHandle sphere;
+};
+
+// Grid of waving tentacles, each a bone chain skinned on the CPU
+struct SkinningBenchmark {
+  bool enabled{false};
+  uint32_t columns = 24;
+  uint32_t rows = 16;
+  float spacing = 60.0f;
+  animation::SkeletonHandle tentacle;
 };
 
 struct SceneDescriptor {
@@ -56,6 +155,14 @@ struct SceneDescriptor {
   Starfield starfield;
   Spaceship spaceship1;
   Spaceship spaceship2;
+  Trail trail;
+  Hud hud;
+  Minimap minimap;
+  Benchmark benchmark;
+  ViewBenchmark viewBenchmark;
+  LodBenchmark lodBenchmark;
+  SkinningBenchmark skinningBenchmark;
+  uint32_t viewCount = 1;
   uint32_t lastCaptureFrame = 0;
   uint32_t lastCaptureMicFrame = 0;
 };
@@ -68,15 +175,196 @@ CaptureSharableContent sharableContent;
 // kHz)
 const int samplesToAnalyze = 2205;
 
+// Round gem with a soft edge and a highlight, size x size RGBA8 with
+// straight alpha, TextureAtlas::add premultiplies it
+static std::vector<uint8_t> createGem(uint32_t size, glm::vec3 color) {
+  std::vector<uint8_t> pixels(size * size * 4);
+  float radius = size * 0.5f;
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      glm::vec2 p = (glm::vec2(x, y) + 0.5f - radius) / radius;
+      float alpha = glm::clamp((1.0f - glm::length(p)) * radius, 0.0f, 1.0f);
+      float light = 1.0f - glm::length(p - glm::vec2(-0.35f)) * 0.6f;
+      glm::vec3 c = glm::clamp(color * light, 0.0f, 1.0f);
+      uint8_t *pixel = pixels.data() + (y * size + x) * 4;
+      pixel[0] = uint8_t(c.r * 255);
+      pixel[1] = uint8_t(c.g * 255);
+      pixel[2] = uint8_t(c.b * 255);
+      pixel[3] = uint8_t(alpha * 255);
+    }
+  }
+  return pixels;
+}
+
+// Rounded panel with a star, outlined. The paths are rebuilt every frame
+// but only tessellated once, the cache hands back the same meshes and the
+// spin is a transform.
+static void drawBadge(FrameContext &ctx, glm::vec3 position,
+                      texture::TextureHandle textureId) {
+  path::Path panel{};
+  panel.roundedRect(-60, -60, 120, 120, 24);
+  path::Path star{};
+  for (uint32_t i = 0; i < 5; i++) {
+    // Every second point of a pentagon, so the outline crosses itself
+    float angle = glm::half_pi<float>() + i * 2 * glm::two_pi<float>() / 5;
+    glm::vec2 point = glm::vec2(std::cos(angle), std::sin(angle)) * 45.0f;
+    i == 0 ? star.moveTo(point.x, point.y) : star.lineTo(point.x, point.y);
+  }
+  star.close();
+  path::StrokeStyle outline{};
+  outline.width = 4;
+  outline.join = path::LineJoin::Round;
+
+  glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), position),
+                                    ctx.absoluteTime * 0.0005f,
+                                    glm::vec3(0.0f, 0.0f, 1.0f));
+  struct Layer {
+    mesh::MeshHandle mesh;
+    glm::vec4 color;
+  };
+  Layer layers[] = {
+      {ctx.paths.fill(panel, ctx.jobs), glm::vec4(0.1f, 0.1f, 0.2f, 0.8f)},
+      {ctx.paths.stroke(panel, outline, ctx.jobs), glm::vec4(1.0f)},
+      // The pentagon in the middle stays filled with the non-zero rule
+      {ctx.paths.fill(star, ctx.jobs), glm::vec4(1.0f, 0.8f, 0.2f, 1.0f)},
+      {ctx.paths.stroke(star, outline, ctx.jobs), glm::vec4(1.0f)},
+  };
+  for (const auto &layer : layers) {
+    if (!layer.mesh.isValid())
+      continue;
+    auto entity = ctx.draw.create();
+    ctx.draw.emplace<draw::Mesh>(
+        entity, draw::Mesh{transform, layer.color, layer.mesh, textureId});
+  }
+}
+
+// Chain of bones along x with a strip of quads around it, each vertex
+// blended between the two nearest bones, and a clip waving the chain
+static animation::SkeletonData createTentacle() {
+  const uint32_t boneCount = 8;
+  const uint32_t columns = 32;
+  const uint32_t rows = 4;
+  const float boneLength = 16.0f;
+  const float width = 12.0f;
+  const float length = boneCount * boneLength;
+
+  animation::SkeletonData data{};
+  for (uint32_t i = 0; i < boneCount; i++) {
+    animation::Bone bone{};
+    bone.name = "bone" + std::to_string(i);
+    bone.parent = static_cast<int32_t>(i) - 1;
+    bone.setup.translation =
+        glm::vec2(i == 0 ? -length * 0.5f : boneLength, 0.0f);
+    data.bones.push_back(bone);
+  }
+
+  for (uint32_t x = 0; x <= columns; x++) {
+    float u = x / (float)columns;
+    // Bones start at their joint, the blend goes to the next one half way
+    float along = u * length / boneLength - 0.5f;
+    uint32_t bone = glm::clamp<int32_t>(static_cast<int32_t>(floorf(along)),
+                                        0, boneCount - 1);
+    float blend = glm::clamp(along - bone, 0.0f, 1.0f);
+    uint32_t next = glm::min(bone + 1, boneCount - 1);
+    float taper = 1.0f - u * 0.7f;
+    for (uint32_t y = 0; y <= rows; y++) {
+      float v = y / (float)rows;
+      animation::SkinVertex vertex{};
+      vertex.position =
+          glm::vec2(u * length - length * 0.5f, (v - 0.5f) * width * taper);
+      vertex.uv = glm::vec2(0.2f + u * 0.2f, 0.5f + v * 0.2f);
+      vertex.bones[0] = bone;
+      vertex.bones[1] = next;
+      vertex.weights[0] = 1.0f - blend;
+      vertex.weights[1] = blend;
+      data.vertices.push_back(vertex);
+    }
+  }
+  for (uint32_t x = 0; x < columns; x++) {
+    for (uint32_t y = 0; y < rows; y++) {
+      uint32_t a = x * (rows + 1) + y;
+      uint32_t b = a + rows + 1;
+      data.indices.insert(data.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+    }
+  }
+
+  animation::AnimationClip wave{};
+  wave.name = "wave";
+  wave.duration = 1.0f;
+  for (uint32_t i = 1; i < boneCount; i++) {
+    animation::BoneTrack track{};
+    track.bone = i;
+    for (uint32_t k = 0; k <= 8; k++) {
+      float t = k / 8.0f;
+      track.rotations.push_back(
+          {t, 0.35f * sinf(glm::two_pi<float>() * (t + i * 0.12f))});
+    }
+    wave.tracks.push_back(track);
+  }
+  data.clips.push_back(wave);
+  return data;
+}
+
+static bool rendersToTexture(const Camera &camera) {
+  return camera.renderTarget.isValid();
+}
+
+// Cameras rendering into a texture size their viewport after it in
+// Camera::update
+void Scene::onViewResize(float viewWidth, float viewHeight) {
+  viewSize = glm::vec2(viewWidth, viewHeight);
+  for (auto &camera : cameras) {
+    if (!rendersToTexture(camera)) {
+      camera.onViewResize(viewWidth, viewHeight);
+    }
+  }
+}
+
+void Scene::setViewCount(uint32_t count) {
+  // Cameras rendering into textures are kept after the screen views
+  std::vector<Camera> targetCameras{};
+  std::copy_if(cameras.begin(), cameras.end(),
+               std::back_inserter(targetCameras), rendersToTexture);
+  cameras.erase(
+      std::remove_if(cameras.begin(), cameras.end(), rendersToTexture),
+      cameras.end());
+
+  // 1: fullscreen, 2: side by side, 4: quadrants
+  cameras.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    auto &camera = cameras[i];
+    if (count == 1) {
+      camera.viewportRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    } else if (count == 2) {
+      camera.viewportRect = glm::vec4(i * 0.5f, 0.0f, 0.5f, 1.0f);
+    } else {
+      camera.viewportRect =
+          glm::vec4((i % 2) * 0.5f, (i / 2) * 0.5f, 0.5f, 0.5f);
+    }
+  }
+  cameras.insert(cameras.end(), targetCameras.begin(), targetCameras.end());
+  if (viewSize.x > 0 && viewSize.y > 0) {
+    onViewResize(viewSize.x, viewSize.y);
+  }
+  dank::console::log("Scene views: %d", count);
+}
+
 void Scene::init(FrameContext &ctx) {
   ctx.textureLibrary.clear();
   ctx.meshLibrary.clear();
+  ctx.spriteTable.clear();
+  ctx.skeletons.clear();
+  ctx.paths.clear();
+  ctx.atlas.clear();
+  ctx.residency.clear();
+  ctx.virtualTextures.clear();
+  ctx.glyphs.clear();
 
   // Add textures
   myScene.textures.sprites = ctx.textureLibrary.add(
       new texture::Texture2D(URI{"file://Demo/Sprites.png"}));
   myScene.textures.starfield = ctx.textureLibrary.add(
-      new texture::Texture2D(URI{"file://Demo/Starfield.png"}));
+      new texture::Texture2D(URI{"file://Demo/StarfieldSmall.png"}));
   myScene.textures.screen =
       ctx.textureLibrary.add(new texture::TextureScreenCapture(&capture));
 
@@ -84,21 +372,56 @@ void Scene::init(FrameContext &ctx) {
   myScene.spaceship1 = {
       {0, 0, 0},
       {1, 1, 1},
-      ctx.meshLibrary.add(new mesh::Sprite(
-          {1024, 1024}, mesh::TextureRegion{200, 500, 200, 200})),
+      ctx.spriteTable.add({1024, 1024},
+                          mesh::TextureRegion{200, 500, 200, 200}),
       myScene.textures.sprites};
 
   myScene.spaceship2 = {
       {0, 0, 0},
       {1, 1, 1},
-      ctx.meshLibrary.add(new mesh::Sprite(
-          {1024, 1024}, mesh::TextureRegion{400, 500, 200, 200})),
+      ctx.spriteTable.add({1024, 1024},
+                          mesh::TextureRegion{400, 500, 200, 200}),
       myScene.textures.sprites};
 
+  auto &minimap = myScene.minimap;
+  minimap.target = ctx.textureLibrary.add(
+      new texture::RenderTarget(minimap.size, minimap.size));
+  minimap.spriteId = ctx.spriteTable.add(
+      {minimap.size, minimap.size},
+      mesh::TextureRegion{0, 0, float(minimap.size), float(minimap.size)});
+  cameras.erase(
+      std::remove_if(cameras.begin(), cameras.end(), rendersToTexture),
+      cameras.end());
+  Camera minimapCamera{};
+  minimapCamera.renderTarget = minimap.target;
+  cameras.push_back(minimapCamera);
+
   myScene.starfield = {
-      ctx.meshLibrary.add(new mesh::Sprite(
-          {2048, 2048}, mesh::TextureRegion{0, 0, 2048, 2048})),
-      myScene.textures.starfield};
+      ctx.virtualTextures.add(URI{"file://Demo/Starfield.png"})};
+
+  // A system font, the first of the collection
+  myScene.hud.fontId =
+      ctx.glyphs.add(URI{"file:///System/Library/Fonts/Menlo.ttc"});
+
+  myScene.skinningBenchmark.tentacle =
+      ctx.skeletons.add(createTentacle(), ctx.meshLibrary);
+
+  myScene.lodBenchmark.sphere = ctx.meshLibrary.add(new mesh::Sphere());
+
+  auto &benchmark = myScene.benchmark;
+  benchmark.images.clear();
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (uint32_t i = 0; i < benchmark.imageCount; i++) {
+    uint32_t size = 16 + random() % 49;
+    glm::vec3 color{unit(random), unit(random), unit(random)};
+    auto image = ctx.atlas.add(createGem(size, color).data(), size, size,
+                               ctx.textureLibrary);
+    const auto *entry = ctx.atlas.get(image);
+    benchmark.images.push_back(
+        {ctx.spriteTable.add(entry->pageSize, entry->region), entry->texture});
+  }
+  ctx.meshLibrary.generateLods(myScene.lodBenchmark.sphere, ctx.jobs);
 
   initialized = true;
   dank::console::log("Scene initialized");
@@ -117,6 +440,62 @@ void Scene::update(FrameContext &ctx) {
     myScene.spaceship1.pos.y -= 10;
   }
 
+  if (myScene.playerController.cycleViews.isTriggered()) {
+    myScene.viewCount = myScene.viewCount >= 4 ? 1 : myScene.viewCount * 2;
+    setViewCount(myScene.viewCount);
+  }
+
+  if (myScene.playerController.toggleBenchmark.isTriggered()) {
+    myScene.benchmark.enabled = !myScene.benchmark.enabled;
+  }
+
+  if (myScene.playerController.toggleLodBenchmark.isTriggered()) {
+    myScene.lodBenchmark.enabled = !myScene.lodBenchmark.enabled;
+  }
+
+  if (myScene.playerController.toggleSkinningBenchmark.isTriggered()) {
+    myScene.skinningBenchmark.enabled = !myScene.skinningBenchmark.enabled;
+  }
+
+  auto &viewBenchmark = myScene.viewBenchmark;
+  if (myScene.playerController.runViewBenchmark.isTriggered() &&
+      !viewBenchmark.running) {
+    viewBenchmark = ViewBenchmark{};
+    viewBenchmark.running = true;
+    viewBenchmark.viewCount = myScene.viewCount;
+    viewBenchmark.gridEnabled = myScene.benchmark.enabled;
+    myScene.benchmark.enabled = true;
+    setViewCount(1);
+  }
+  if (viewBenchmark.running) {
+    // Cull time of the last frame's draw lists, built with this step's
+    // views once the warmup is over
+    if (viewBenchmark.frame >= viewBenchmark.warmupFrames) {
+      viewBenchmark.cullTime += ctx.stats.cullTime;
+    }
+    viewBenchmark.frame++;
+    if (viewBenchmark.frame ==
+        viewBenchmark.warmupFrames + viewBenchmark.framesPerStep) {
+      viewBenchmark.results[viewBenchmark.step] =
+          viewBenchmark.cullTime / viewBenchmark.framesPerStep;
+      viewBenchmark.cullTime = 0;
+      viewBenchmark.frame = 0;
+      viewBenchmark.step++;
+      if (viewBenchmark.step < 3) {
+        setViewCount(1 << viewBenchmark.step);
+      } else {
+        viewBenchmark.running = false;
+        myScene.benchmark.enabled = viewBenchmark.gridEnabled;
+        setViewCount(myScene.viewCount);
+        dank::console::log(
+            "[Scene] cull time per frame: 1 view %.3fms | 2 views %.3fms | "
+            "4 views %.3fms",
+            viewBenchmark.results[0], viewBenchmark.results[1],
+            viewBenchmark.results[2]);
+      }
+    }
+  }
+
   TouchState ts1, ts2;
   dank::input.getTouchState(ts1, TouchButton::TB_LEFT);
   if (ts1.hasAction(TouchActions::TA_TOUCH)) {
@@ -139,10 +518,10 @@ void Scene::update(FrameContext &ctx) {
     if (!myScene.screenView.initialized) {
       myScene.screenView = {
           true,
-          ctx.meshLibrary.add(new mesh::Sprite(
+          ctx.spriteTable.add(
               {capture.screenOutput.width, capture.screenOutput.height},
               mesh::TextureRegion{0, 0, (float)capture.screenOutput.width,
-                                  (float)capture.screenOutput.height})),
+                                  (float)capture.screenOutput.height}),
           myScene.textures.screen};
     }
 
@@ -187,42 +566,220 @@ void Scene::update(FrameContext &ctx) {
     // dank::console::log("TA_HOVER");
   }
 
-  camera.mode = ProjectionMode::Orthographic;
-  camera.pos = glm::vec3(0.0f, 0.0f, 10.0f);
-  // camera.scale = 200.0f;
-  camera.target = glm::vec3(0.0f, 0.0f, 0.0f);
-  camera.update(ctx);
+  for (uint32_t i = 0; i < cameras.size(); i++) {
+    auto &camera = cameras[i];
+    if (camera.renderTarget == myScene.minimap.target) {
+      // Follows the spaceship from further away, left out of benchmarks
+      camera.enabled =
+          !myScene.lodBenchmark.enabled && !viewBenchmark.running;
+      camera.mode = ProjectionMode::Orthographic;
+      camera.scale = myScene.minimap.scale;
+      camera.pos = glm::vec3(myScene.spaceship1.pos.x,
+                             myScene.spaceship1.pos.y, 10.0f);
+      camera.target = camera.pos - glm::vec3(0.0f, 0.0f, 10.0f);
+      camera.update(ctx);
+      continue;
+    }
+    // Each extra view looks at a different part of the benchmark grid
+    glm::vec3 offset = glm::vec3(i % 2, i / 2, 0.0f) * 400.0f;
+    if (myScene.lodBenchmark.enabled) {
+      // Slowly flying into the sphere field
+      float z = 10.0f - glm::mod(ctx.absoluteTime * 0.002f, 60.0f);
+      camera.mode = ProjectionMode::Perspective;
+      camera.zfar = 500.0f;
+      camera.pos = glm::vec3(0.0f, 3.0f, z) + offset * 0.01f;
+      camera.target = glm::vec3(0.0f, 0.0f, z - 20.0f) + offset * 0.01f;
+    } else {
+      camera.mode = ProjectionMode::Orthographic;
+      camera.zfar = 100.0f;
+      camera.pos = glm::vec3(0.0f, 0.0f, 10.0f) + offset;
+      // camera.scale = 200.0f;
+      camera.target = glm::vec3(0.0f, 0.0f, 0.0f) + offset;
+    }
+    camera.update(ctx);
+  }
 
   ctx.draw.clear();
 
   auto spaceship1 = ctx.draw.create();
-  ctx.draw.emplace<draw::Mesh>(
-      spaceship1, draw::Mesh{glm::scale(glm::translate(glm::mat4(1.0f),
-                                                       myScene.spaceship1.pos),
-                                        myScene.spaceship1.scale),
-                             glm::vec4(1, 1, 1, 1), myScene.spaceship1.meshId,
-                             myScene.spaceship1.textureId});
+  ctx.draw.emplace<draw::Sprite>(
+      spaceship1,
+      draw::Sprite{glm::scale(glm::translate(glm::mat4(1.0f),
+                                             myScene.spaceship1.pos),
+                              myScene.spaceship1.scale),
+                   glm::vec4(1, 1, 1, 1), myScene.spaceship1.spriteId,
+                   myScene.spaceship1.textureId});
+
+  auto &trail = myScene.trail;
+  for (auto &point : trail.points) {
+    point.x -= trail.speed * ctx.deltaTime;
+  }
+  trail.points.insert(trail.points.begin(), myScene.spaceship1.pos);
+  if (trail.points.size() > trail.length) {
+    trail.points.pop_back();
+  }
+  if (trail.points.size() >= 2) {
+    uint32_t count = trail.points.size();
+    auto &transient = ctx.transientGeometry;
+    mesh::TransientSpan vertices = transient.allocateVertices(count * 2);
+    mesh::TransientSpan indices = transient.allocateIndices((count - 1) * 6);
+    mesh::VertexData *vertex = transient.vertexAt(vertices.first);
+    uint32_t *index = transient.indexAt(indices.first);
+
+    // Narrowing towards the end, indices relative to the ribbon's vertices
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (uint32_t i = 0; i < count; i++) {
+      float t = i / float(count - 1);
+      glm::vec3 side{0.0f, trail.width * 0.5f * (1.0f - t), 0.0f};
+      glm::vec3 normal{0.0f, 0.0f, 1.0f};
+      vertex[i * 2] = mesh::VertexData{trail.points[i] + side, normal, {t, 0}};
+      vertex[i * 2 + 1] =
+          mesh::VertexData{trail.points[i] - side, normal, {t, 1}};
+      min = glm::min(min, trail.points[i] - side);
+      max = glm::max(max, trail.points[i] + side);
+    }
+    for (uint32_t i = 0; i + 1 < count; i++) {
+      uint32_t a = i * 2;
+      uint32_t quad[6] = {a, a + 1, a + 2, a + 2, a + 1, a + 3};
+      std::copy(quad, quad + 6, index + i * 6);
+    }
+
+    auto ribbon = ctx.draw.create();
+    ctx.draw.emplace<draw::Mesh>(
+        ribbon, draw::Mesh{glm::mat4(1.0f), glm::vec4(0.4f, 0.7f, 1.0f, 0.5f),
+                           mesh::MeshHandle{}, myScene.textures.starfield});
+    ctx.draw.emplace<draw::TransientGeometry>(
+        ribbon, draw::TransientGeometry{vertices, indices, (min + max) * 0.5f,
+                                        glm::length(max - min) * 0.5f});
+  }
+
+  drawBadge(ctx, glm::vec3(200, 120, 0), myScene.textures.starfield);
+
+  auto &hud = myScene.hud;
+  hud.score += trail.speed * ctx.deltaTime;
+  if (!myScene.lodBenchmark.enabled) {
+    // The orthographic view spans twice its size in units
+    glm::vec3 corner{-viewSize.x + hud.margin, viewSize.y - hud.margin, 1.0f};
+    char line[128];
+    snprintf(line, sizeof(line), "SCORE %06u", uint32_t(hud.score));
+    glm::vec3 pen = corner - glm::vec3(0.0f, hud.scoreSize, 0.0f);
+    auto score = ctx.draw.create();
+    ctx.draw.emplace<draw::Text>(
+        score, draw::Text{glm::translate(glm::mat4(1.0f), pen),
+                          glm::vec4(1.0f, 0.85f, 0.3f, 1.0f), hud.fontId,
+                          line, hud.scoreSize});
+
+    snprintf(line, sizeof(line),
+             "%u fps | %u instances | %u draws\n%u glyphs | %u / %u cells",
+             ctx.framesPerSecond, ctx.stats.visibleInstances,
+             ctx.stats.drawCommands, ctx.stats.textGlyphs,
+             ctx.glyphs.getResidentGlyphs(), ctx.glyphs.getCellCount());
+    pen.y -= hud.scoreSize * 0.5f + hud.debugSize;
+    auto debug = ctx.draw.create();
+    ctx.draw.emplace<draw::Text>(
+        debug, draw::Text{glm::translate(glm::mat4(1.0f), pen),
+                          glm::vec4(0.8f, 0.9f, 1.0f, 0.9f), hud.fontId,
+                          line, hud.debugSize});
+  }
+
+  const auto &minimap = myScene.minimap;
+  if (!myScene.lodBenchmark.enabled && !viewBenchmark.running) {
+    float half = minimap.size * minimap.displayScale * 0.5f;
+    glm::vec3 center{viewSize.x - minimap.margin - half,
+                     -viewSize.y + minimap.margin + half, 1.0f};
+    auto display = ctx.draw.create();
+    ctx.draw.emplace<draw::Sprite>(
+        display,
+        draw::Sprite{glm::scale(glm::translate(glm::mat4(1.0f), center),
+                                glm::vec3(minimap.displayScale)),
+                     glm::vec4(1, 1, 1, 1), minimap.spriteId,
+                     minimap.target});
+  }
 
   myScene.spaceship2.pos = glm::vec3(-100, -100, 0);
   auto spaceship2 = ctx.draw.create();
-  ctx.draw.emplace<draw::Mesh>(
-      spaceship2, draw::Mesh{glm::scale(glm::translate(glm::mat4(1.0f),
-                                                       myScene.spaceship2.pos),
-                                        myScene.spaceship2.scale),
-                             glm::vec4(1, 1, 1, 1), myScene.spaceship2.meshId,
-                             myScene.spaceship2.textureId});
+  ctx.draw.emplace<draw::Sprite>(
+      spaceship2,
+      draw::Sprite{glm::scale(glm::translate(glm::mat4(1.0f),
+                                             myScene.spaceship2.pos),
+                              myScene.spaceship2.scale),
+                   glm::vec4(1, 1, 1, 1), myScene.spaceship2.spriteId,
+                   myScene.spaceship2.textureId});
+
+  if (myScene.benchmark.enabled) {
+    const auto &benchmark = myScene.benchmark;
+    for (uint32_t y = 0; y < benchmark.rows; y++) {
+      for (uint32_t x = 0; x < benchmark.columns; x++) {
+        glm::vec3 pos = glm::vec3(x * benchmark.spacing, y * benchmark.spacing,
+                                  0.0f) -
+                        glm::vec3(benchmark.columns * benchmark.spacing,
+                                  benchmark.rows * benchmark.spacing, 0.0f) *
+                            0.25f;
+        const auto &image =
+            benchmark.images[(y * benchmark.columns + x) %
+                             benchmark.images.size()];
+        auto sprite = ctx.draw.create();
+        ctx.draw.emplace<draw::Sprite>(
+            sprite, draw::Sprite{glm::translate(glm::mat4(1.0f), pos),
+                                 glm::vec4(1, 1, 1, 1), image.spriteId,
+                                 image.textureId});
+      }
+    }
+  }
+
+  if (myScene.skinningBenchmark.enabled) {
+    const auto &benchmark = myScene.skinningBenchmark;
+    for (uint32_t y = 0; y < benchmark.rows; y++) {
+      for (uint32_t x = 0; x < benchmark.columns; x++) {
+        glm::vec3 pos = glm::vec3((x - benchmark.columns * 0.5f) *
+                                      benchmark.spacing * 1.5f,
+                                  (y - benchmark.rows * 0.5f) *
+                                      benchmark.spacing,
+                                  0.0f);
+        auto tentacle = ctx.draw.create();
+        ctx.draw.emplace<draw::SkinnedMesh>(
+            tentacle,
+            draw::SkinnedMesh{glm::translate(glm::mat4(1.0f), pos),
+                              glm::vec4(1, 1, 1, 1), benchmark.tentacle,
+                              myScene.textures.sprites, 0,
+                              ctx.absoluteTime * 0.001f + (x + y) * 0.05f});
+      }
+    }
+  }
+
+  if (myScene.lodBenchmark.enabled) {
+    const auto &benchmark = myScene.lodBenchmark;
+    for (uint32_t z = 0; z < benchmark.rows; z++) {
+      for (uint32_t x = 0; x < benchmark.columns; x++) {
+        glm::vec3 pos =
+            glm::vec3((x - benchmark.columns * 0.5f) * benchmark.spacing, 0.0f,
+                      -(float)z * benchmark.spacing);
+        auto sphere = ctx.draw.create();
+        ctx.draw.emplace<draw::Mesh>(
+            sphere,
+            draw::Mesh{glm::translate(glm::mat4(1.0f), pos),
+                       glm::vec4(x / (float)benchmark.columns,
+                                 z / (float)benchmark.rows, 1, 1),
+                       benchmark.sphere, myScene.textures.starfield,
+                       z * benchmark.columns + x + 1});
+      }
+    }
+    // The starfield backdrop is made for the 2D camera
+    return;
+  }
 
   if (capture.captureScreen && myScene.screenView.initialized) {
     auto screenView = ctx.draw.create();
-    ctx.draw.emplace<draw::Mesh>(
+    ctx.draw.emplace<draw::Sprite>(
         screenView,
-        draw::Mesh{glm::mat4(1.0f), glm::vec4(1, 1, 1, 1),
-                   myScene.screenView.meshId, myScene.screenView.textureId});
+        draw::Sprite{glm::mat4(1.0f), glm::vec4(1, 1, 1, 1),
+                     myScene.screenView.spriteId,
+                     myScene.screenView.textureId});
   } else {
     auto starfield = ctx.draw.create();
-    ctx.draw.emplace<draw::Mesh>(
-        starfield,
-        draw::Mesh{glm::mat4(1.0f), glm::vec4(1, 1, 1, 1),
-                   myScene.starfield.meshId, myScene.starfield.textureId});
+    ctx.draw.emplace<draw::VirtualSprite>(
+        starfield, draw::VirtualSprite{glm::mat4(1.0f), glm::vec4(1, 1, 1, 1),
+                                       myScene.starfield.imageId});
   }
 }
@@ -8,10 +8,15 @@ namespace dank {
 class Scene {
   private:
   bool initialized = false;
+  glm::vec2 viewSize{0.0f};
   void init(FrameContext &ctx);
 public:
-  Camera camera{};
+  // cameras[0] is the main camera, additional cameras render split-screen
+  // views, minimaps or picture-in-picture into their own viewport or target
+  std::vector<Camera> cameras = std::vector<Camera>(1);
   entt::registry entities{};
+  void onViewResize(float viewWidth, float viewHeight);
+  void setViewCount(uint32_t count);
   void update(FrameContext &ctx);
 };
 } // namespace dank
@@ -29,6 +29,30 @@ public:
     [[CaptureEngine sharedInstance] updateConfig:&config];
   }
 
+  std::string getCacheDirectory() override {
+    NSArray *paths = NSSearchPathForDirectoriesInDomains(
+        NSCachesDirectory, NSUserDomainMask, YES);
+    if ([paths count] == 0) {
+      return "";
+    }
+    NSString *path =
+        [[paths firstObject] stringByAppendingPathComponent:@"dank"];
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:path
+                                   withIntermediateDirectories:YES
+                                                    attributes:nil
+                                                         error:nil]) {
+      return "";
+    }
+    return std::string([path UTF8String]);
+  }
+
+  std::string getFilePath(const URI &uri) override {
+    if (uri.protocol != "file") {
+      return "";
+    }
+    return uri.host + "/" + uri.path;
+  }
+
   void getDataFromURI(URI &uri, ResourceData &output) override {
     NSString *protocol = [NSString stringWithCString:uri.protocol.c_str()
                                             encoding:NSUTF8StringEncoding];
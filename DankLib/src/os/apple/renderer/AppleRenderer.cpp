@@ -6,6 +6,7 @@
 #include "modules/renderer/textures/Texture.hpp"
 #include "modules/scene/Scene.hpp"
 #include "os/apple/Metal.hpp"
+#include <algorithm>
 #include <cstddef>
 
 using namespace dank;
@@ -30,7 +31,7 @@ void apple::AppleRenderer::init() {
     icbDescriptor->setInheritBuffers(true);
     icbDescriptor->setInheritPipelineState(true);
     indirectCommandBuffer = this->view->device->newIndirectCommandBuffer(
-        icbDescriptor, instancePageSize, 0);
+        icbDescriptor, instancePageSize * FRAMES_IN_FLIGHT, 0);
     indirectCommandBuffer->setLabel(NS::String::string(
         "IndirectDrawCommands", NS::StringEncoding::UTF8StringEncoding));
     icbDescriptor->release();
@@ -39,7 +40,7 @@ void apple::AppleRenderer::init() {
   // Mesh Instances Buffer
   {
     meshInstanceBuffer = view->device->newBuffer(
-        sizeof(instance::InstanceData) * instancePageSize,
+        sizeof(instance::InstanceData) * instancePageSize * FRAMES_IN_FLIGHT,
         MTL::ResourceStorageModeShared);
     meshInstanceBuffer->setLabel(NS::String::string(
         "MeshInstanceBuffer", NS::StringEncoding::UTF8StringEncoding));
@@ -61,14 +62,15 @@ void apple::AppleRenderer::init() {
     pipelineDescriptor->colorAttachments()->object(0)->setPixelFormat(
         MTL::PixelFormat::PixelFormatRGBA8Unorm);
 
-    // Enable blending
+    // Enable blending, textures and the fragment shader's output are
+    // premultiplied so filtering never bleeds transparent texels' color
     MTL::RenderPipelineColorAttachmentDescriptor *colorAttachment =
         pipelineDescriptor->colorAttachments()->object(0);
     colorAttachment->setBlendingEnabled(true);
     colorAttachment->setRgbBlendOperation(MTL::BlendOperationAdd);
     colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
-    colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
-    colorAttachment->setSourceAlphaBlendFactor(MTL::BlendFactorSourceAlpha);
+    colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorOne);
+    colorAttachment->setSourceAlphaBlendFactor(MTL::BlendFactorOne);
     colorAttachment->setDestinationRGBBlendFactor(
         MTL::BlendFactorOneMinusSourceAlpha);
     colorAttachment->setDestinationAlphaBlendFactor(
@@ -91,74 +93,229 @@ void apple::AppleRenderer::init() {
     pipelineDescriptor->release();
 
     // Camera Buffer
-    cameraUBOBuffer = view->device->newBuffer(sizeof(dank::CameraUBO),
-                                              MTL::ResourceStorageModeShared);
+    cameraUBOBuffer = view->device->newBuffer(
+        cameraUBOStride * draw::MAX_VIEWS * FRAMES_IN_FLIGHT,
+        MTL::ResourceStorageModeShared);
     cameraUBOBuffer->setLabel(NS::String::string(
         "CameraUBO", NS::StringEncoding::UTF8StringEncoding));
   }
 
-  {
-    // Create a buffer to hold the encoded arguments
-    fragmentArgBuffer = view->device->newBuffer(
-        fragmentArgEncoder->encodedLength(), MTL::ResourceStorageModeShared);
-    fragmentArgBuffer->setLabel(NS::String::string(
+  // Buffers to hold the encoded arguments, see encodeTextureArguments
+  for (auto *&buffer : fragmentArgBuffers) {
+    buffer = view->device->newBuffer(fragmentArgEncoder->encodedLength(),
+                                     MTL::ResourceStorageModeShared);
+    buffer->setLabel(NS::String::string(
         "TextureArgBuffer", NS::StringEncoding::UTF8StringEncoding));
-    // Encode the arguments into the buffer
-    fragmentArgEncoder->setArgumentBuffer(fragmentArgBuffer, 0);
   }
 }
 
-void apple::AppleRenderer::prepareMeshes(dank::FrameContext &ctx) {
-  if (meshLibraryLastModified == ctx.meshLibrary.lastModified)
+template <typename T>
+static void uploadArena(MTL::Device *device, MTL::Buffer *&buffer,
+                        const mesh::BufferArena<T> &arena, const char *label) {
+  size_t capacity = std::max<size_t>(arena.getCapacity(), 1) * sizeof(T);
+
+  // Growing reallocates and uploads the used range once, otherwise only the
+  // dirty ranges are copied
+  if (buffer == nullptr || buffer->length() < capacity) {
+    if (buffer != nullptr) {
+      buffer->release();
+    }
+    buffer = device->newBuffer(capacity, MTL::ResourceStorageModeShared);
+    buffer->setLabel(
+        NS::String::string(label, NS::StringEncoding::UTF8StringEncoding));
+    memcpy(buffer->contents(), arena.getData(), arena.getSize() * sizeof(T));
     return;
-  meshLibraryLastModified = ctx.meshLibrary.lastModified;
+  }
 
-  if (meshVertexBuffer != nullptr) {
-    meshVertexBuffer->release();
+  uint8_t *contents = static_cast<uint8_t *>(buffer->contents());
+  for (const auto &range : arena.getDirtyRanges()) {
+    memcpy(contents + range.offset * sizeof(T), arena.getData() + range.offset,
+           range.count * sizeof(T));
   }
-  if (meshIndexBuffer != nullptr) {
-    meshIndexBuffer->release();
+}
+
+void apple::AppleRenderer::waitForFrames(uint32_t maxInFlight) {
+  std::unique_lock<std::mutex> lock(frameMutex);
+  frameCompleted.wait(lock, [&]() { return framesInFlight <= maxInFlight; });
+}
+
+// Grows a buffer holding FRAMES_IN_FLIGHT regions of capacity elements each
+// to fit count, false when it already did
+static bool growRegions(MTL::Device *device, MTL::Buffer *&buffer,
+                        uint32_t &capacity, uint32_t count, size_t stride,
+                        const char *label) {
+  if (buffer != nullptr && count <= capacity)
+    return false;
+  capacity = std::max<uint32_t>(capacity, 1024);
+  while (capacity < count) {
+    capacity *= 2;
   }
+  if (buffer != nullptr) {
+    buffer->release();
+  }
+  buffer = device->newBuffer(capacity * stride * FRAMES_IN_FLIGHT,
+                             MTL::ResourceStorageModeShared);
+  buffer->setLabel(
+      NS::String::string(label, NS::StringEncoding::UTF8StringEncoding));
+  return true;
+}
 
-  mesh::MeshLibraryData mld{};
-  ctx.meshLibrary.getData(mld);
+void apple::AppleRenderer::prepareTransientGeometry(dank::FrameContext &ctx) {
+  const auto &transient = ctx.transientGeometry;
+  uint32_t vertexCount = transient.getVertexCount();
+  uint32_t indexCount = transient.getIndexCount();
+  ctx.stats.transientVertices = vertexCount;
+  ctx.stats.transientIndices = indexCount;
+  if (vertexArgBuffer == nullptr)
+    return;
 
-  meshVertexBuffer = view->device->newBuffer(mld.vertexDataSize,
-                                             MTL::ResourceStorageModeShared);
-  meshVertexBuffer->setLabel(NS::String::string(
-      "MeshVertexBuffer", NS::StringEncoding::UTF8StringEncoding));
+  // Growing replaces buffers older frames still read, so those have to
+  // finish first. Capacities double, this stops happening after warm up.
+  if (transientVertexBuffer == nullptr ||
+      vertexCount > transientVertexCapacity ||
+      indexCount > transientIndexCapacity) {
+    waitForFrames(0);
+    if (growRegions(view->device, transientVertexBuffer,
+                    transientVertexCapacity, vertexCount,
+                    sizeof(mesh::VertexData), "TransientVertexBuffer")) {
+      vertexArgEncoder->setArgumentBuffer(vertexArgBuffer, 0);
+      vertexArgEncoder->setBuffer(transientVertexBuffer, 0,
+                                  mesh::TRANSIENT_VERTEX_SLOT);
+    }
+    growRegions(view->device, transientIndexBuffer, transientIndexCapacity,
+                indexCount, sizeof(uint32_t), "TransientIndexBuffer");
+  }
 
-  meshIndexBuffer = view->device->newBuffer(mld.indexDataSize,
-                                            MTL::ResourceStorageModeShared);
-  meshIndexBuffer->setLabel(NS::String::string(
-      "MeshIndexBuffer", NS::StringEncoding::UTF8StringEncoding));
+  // One copy per buffer into the region no frame in flight reads
+  auto *vertices =
+      static_cast<mesh::VertexData *>(transientVertexBuffer->contents());
+  memcpy(vertices + size_t(frameRegion) * transientVertexCapacity,
+         transient.getVertexData(), vertexCount * sizeof(mesh::VertexData));
+  auto *indices = static_cast<uint32_t *>(transientIndexBuffer->contents());
+  memcpy(indices + size_t(frameRegion) * transientIndexCapacity,
+         transient.getIndexData(), indexCount * sizeof(uint32_t));
+}
 
-  memcpy(meshVertexBuffer->contents(), mld.vbo.data(), mld.vertexDataSize);
-  memcpy(meshIndexBuffer->contents(), mld.ibo.data(), mld.indexDataSize);
+void apple::AppleRenderer::prepareMeshes(dank::FrameContext &ctx) {
+  if (meshLibraryLastModified == ctx.meshLibrary.lastModified)
+    return;
+  meshLibraryLastModified = ctx.meshLibrary.lastModified;
+
+  // A cleared library rewrites its pages and the argument buffer from the
+  // start, which the frames in flight still draw from
+  if (meshLibraryClearCount != ctx.meshLibrary.clearCount) {
+    meshLibraryClearCount = ctx.meshLibrary.clearCount;
+    waitForFrames(0);
+  }
+
+  uint32_t pageCount = ctx.meshLibrary.getPageCount();
+  bool pagesChanged = vertexPages.size() != pageCount;
+
+  // Pages dropped by MeshLibrary::clear
+  while (vertexPages.size() > pageCount) {
+    vertexPages.back()->release();
+    vertexPages.pop_back();
+    indexPages.back()->release();
+    indexPages.pop_back();
+  }
+  vertexPages.resize(pageCount, nullptr);
+  indexPages.resize(pageCount, nullptr);
+
+  // Pages have a fixed capacity: a buffer is only created for a new page,
+  // after that only dirty ranges are copied
+  for (uint32_t p = 0; p < pageCount; p++) {
+    const auto &page = ctx.meshLibrary.getPage(p);
+    MTL::Buffer *previousVertexPage = vertexPages[p];
+    uploadArena(view->device, vertexPages[p], page.vertices,
+                "MeshVertexPage");
+    uploadArena(view->device, indexPages[p], page.indices, "MeshIndexPage");
+    pagesChanged = pagesChanged || previousVertexPage != vertexPages[p];
+  }
+  ctx.meshLibrary.clearDirty();
 
   if (vertexArgBuffer == nullptr) {
     vertexArgBuffer = view->device->newBuffer(vertexArgEncoder->encodedLength(),
                                               MTL::ResourceStorageModeShared);
     vertexArgBuffer->setLabel(NS::String::string(
         "VertexArgBuffer", NS::StringEncoding::UTF8StringEncoding));
+  } else if (!pagesChanged) {
+    return;
   }
 
-  // Encode the vertex buffers into the argument buffer
+  // Encode the vertex pages into the argument buffer, slot = page index
   vertexArgEncoder->setArgumentBuffer(vertexArgBuffer, 0);
+  for (uint32_t p = 0; p < pageCount; p++) {
+    vertexArgEncoder->setBuffer(vertexPages[p], 0, p);
+  }
+
+  dank::console::log("[AppleRenderer] mesh pages: %d", pageCount);
+}
+
+const apple::TextureState *
+apple::AppleRenderer::findTextureState(texture::TextureHandle handle) const {
+  if (handle.index >= textureState.size())
+    return nullptr;
+  const TextureState &state = textureState[handle.index];
+  return state.generation == handle.generation ? &state : nullptr;
+}
+
+void apple::AppleRenderer::retireTexture(MTL::Texture *texture,
+                                         uint32_t frame) {
+  retiredTextures.push_back(RetiredTexture{texture, frame});
+}
 
-  // TODO: support multiple vertex buffers
-  vertexArgEncoder->setBuffer(meshVertexBuffer, 0, 0);
+void apple::AppleRenderer::releaseRetiredTextures(uint32_t frame) {
+  size_t kept = 0;
+  for (const auto &retired : retiredTextures) {
+    if (retired.frame + FRAMES_IN_FLIGHT > frame) {
+      retiredTextures[kept++] = retired;
+      continue;
+    }
+    retired.texture->release();
+  }
+  retiredTextures.resize(kept);
+}
 
-  dank::console::log("[AppleRenderer] vertex buffer updated");
+// Every slot of this frame's argument buffer, the others still belong to
+// frames in flight
+void apple::AppleRenderer::encodeTextureArguments() {
+  fragmentArgEncoder->setArgumentBuffer(fragmentArgBuffers[frameRegion], 0);
+  for (const auto &state : textureState) {
+    if (state.mtlTexture != nullptr) {
+      fragmentArgEncoder->setTexture(state.mtlTexture, state.index);
+    }
+  }
 }
 
 void apple::AppleRenderer::prepareTextures(dank::FrameContext &ctx) {
-  uint32_t activeTextureCount = 0;
+  // Release textures whose handle went stale (removed or library cleared)
+  for (uint32_t i = 0; i < textureState.size(); i++) {
+    auto &state = textureState[i];
+    if (state.mtlTexture != nullptr &&
+        ctx.textureLibrary.get({i, state.generation}) == nullptr) {
+      retireTexture(state.mtlTexture, ctx.absoluteFrame);
+      ctx.residency.forget({i, state.generation});
+      state = TextureState{};
+    }
+  }
 
-  for (const auto &entry : ctx.textureLibrary.textures) {
-    auto *texture = entry.second;
+  for (uint32_t i = 0; i < ctx.textureLibrary.size(); i++) {
+    auto *texture = ctx.textureLibrary.textureAt(i);
+    auto handle = ctx.textureLibrary.handleAt(i);
 
-    auto &state = textureState[entry.first];
+    // The argument buffer slot is the handle's slot index, add() warned
+    // about the ones past the last slot
+    if (handle.index >= texture::MAX_TEXTURES) {
+      continue;
+    }
+    if (handle.index >= textureState.size()) {
+      textureState.resize(handle.index + 1);
+    }
+    auto &state = textureState[handle.index];
+    if (state.generation != handle.generation) {
+      state = TextureState{};
+      state.generation = handle.generation;
+    }
 
     texture::TextureData td{};
     texture->fetchData(td);
@@ -167,8 +324,9 @@ void apple::AppleRenderer::prepareTextures(dank::FrameContext &ctx) {
 
       state.active = false;
       if (state.mtlTexture != nullptr) {
-        state.mtlTexture->release();
+        retireTexture(state.mtlTexture, ctx.absoluteFrame);
         state.mtlTexture = nullptr;
+        ctx.residency.forget(handle);
       }
 
       texture->releaseData(td);
@@ -181,13 +339,22 @@ void apple::AppleRenderer::prepareTextures(dank::FrameContext &ctx) {
     }
 
     if (state.lastModified == td.lastModified) {
-      activeTextureCount++;
       continue;
     }
 
     state.lastModified = td.lastModified;
 
-    if (state.mtlTexture == nullptr) {
+    // Reloaded at a different size, e.g. after its top mips were dropped
+    if (state.mtlTexture != nullptr &&
+        (state.mtlTexture->width() != td.width ||
+         state.mtlTexture->height() != td.height ||
+         state.mtlTexture->mipmapLevelCount() != std::max(td.levelCount, 1u))) {
+      retireTexture(state.mtlTexture, ctx.absoluteFrame);
+      state.mtlTexture = nullptr;
+    }
+
+    bool created = state.mtlTexture == nullptr;
+    if (created) {
 
       MTL::TextureDescriptor *textureDesc =
           MTL::TextureDescriptor::alloc()->init();
@@ -197,128 +364,437 @@ void apple::AppleRenderer::prepareTextures(dank::FrameContext &ctx) {
       // Set pixel format
       switch (td.format) {
       case dank::PixelFormat::BGRA32:
-        textureDesc->setPixelFormat(MTL::PixelFormatBGRA8Unorm_sRGB);
+        textureDesc->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
         break;
       case dank::PixelFormat::RGBA8Unorm:
         textureDesc->setPixelFormat(MTL::PixelFormatRGBA8Unorm);
         break;
+      case dank::PixelFormat::BC1_RGBA:
+        textureDesc->setPixelFormat(MTL::PixelFormatBC1_RGBA);
+        break;
+      case dank::PixelFormat::BC3_RGBA:
+        textureDesc->setPixelFormat(MTL::PixelFormatBC3_RGBA);
+        break;
+      case dank::PixelFormat::BC7_RGBA:
+        textureDesc->setPixelFormat(MTL::PixelFormatBC7_RGBAUnorm);
+        break;
+      case dank::PixelFormat::ASTC_4x4:
+        textureDesc->setPixelFormat(MTL::PixelFormatASTC_4x4_LDR);
+        break;
+      case dank::PixelFormat::R8Unorm:
+        textureDesc->setPixelFormat(MTL::PixelFormatR8Unorm);
+        break;
       }
-      textureDesc->setPixelFormat(MTL::PixelFormatRGBA8Unorm);
+      textureDesc->setMipmapLevelCount(std::max(td.levelCount, 1u));
 
       if (texture->getType() == texture::TextureType::Color) {
         textureDesc->setTextureType(MTL::TextureType2D);
+        textureDesc->setStorageMode(MTL::StorageModeShared);
+        textureDesc->setUsage(MTL::ResourceUsageSample |
+                              MTL::ResourceUsageRead);
+      } else if (texture->getType() == texture::TextureType::RenderTarget) {
+        textureDesc->setTextureType(MTL::TextureType2D);
+        textureDesc->setStorageMode(MTL::StorageModePrivate);
+        textureDesc->setUsage(MTL::TextureUsageRenderTarget |
+                              MTL::TextureUsageShaderRead);
       } else {
         throw std::runtime_error("Unsupported texture type");
       }
-      textureDesc->setStorageMode(MTL::StorageModeShared);
-      textureDesc->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead);
 
       state.mtlTexture = view->device->newTexture(textureDesc);
-      state.index = activeTextureCount;
+      state.index = handle.index;
       textureDesc->release();
 
-      fragmentArgEncoder->setTexture(state.mtlTexture, state.index);
-
       dank::console::log("[AppleRenderer] added new texture: %d",
-                         activeTextureCount);
+                         state.index);
     }
 
-    NS::UInteger bytesPerRow = td.width * td.channels;
-    state.mtlTexture->replaceRegion(
-        MTL::Region(0, 0, 0, td.width, td.height, 1), 0, td.data, bytesPerRow);
+    // Uploads read views of td.pixels, the texture may drop its own copy in
+    // releaseData while td keeps them alive
+    if (td.pixels && td.levelCount > 0) {
+      // Block compressed rows are rows of 4x4 blocks
+      for (uint32_t level = 0; level < td.levelCount; level++) {
+        const auto &mip = td.levels[level];
+        texture::PixelBuffer texels = td.getLevel(level);
+        if (texels.size() < mip.size)
+          break;
+        state.mtlTexture->replaceRegion(
+            MTL::Region(0, 0, 0, mip.width, mip.height, 1), level,
+            texels.data(), texture::getRowBytes(td.format, mip.width));
+      }
+    } else if (td.pixels && td.updateCount > 0 && !created) {
+      // Only the regions that changed, e.g. pages of the virtual textures
+      NS::UInteger bytesPerRow = td.width * td.channels;
+      for (uint32_t i = 0; i < td.updateCount; i++) {
+        const auto &update = td.updates[i];
+        texture::PixelBuffer texels = td.getRegion(update);
+        if (!texels)
+          continue;
+        state.mtlTexture->replaceRegion(
+            MTL::Region(update.x, update.y, 0, update.width, update.height, 1),
+            0, texels.data(), bytesPerRow);
+      }
+    } else if (td.pixels) {
+      NS::UInteger bytesPerRow = td.width * td.channels;
+      state.mtlTexture->replaceRegion(
+          MTL::Region(0, 0, 0, td.width, td.height, 1), 0, td.pixels.data(),
+          bytesPerRow);
+    }
     texture->releaseData(td);
+    ctx.residency.setResident(handle, td, texture->isReloadable());
 
     state.active = true;
-    activeTextureCount++;
   }
+
+  applyResidency(ctx);
 }
 
-void apple::AppleRenderer::render(FrameContext &ctx, Scene *scene) {
-  prepareMeshes(ctx);
-  prepareTextures(ctx);
+void apple::AppleRenderer::applyResidency(dank::FrameContext &ctx) {
+  residencyRequests.clear();
+  ctx.residency.update(ctx.absoluteFrame, residencyRequests);
+
+  // Dropping a top mip copies the other levels into a smaller texture on
+  // the GPU, queued ahead of the frame's command buffer. Replaced and
+  // evicted textures are retired, frames in flight may still sample them.
+  MTL::CommandBuffer *blitBuffer = nullptr;
+  MTL::BlitCommandEncoder *blitEncoder = nullptr;
+  for (const auto &request : residencyRequests) {
+    auto *texture = ctx.textureLibrary.get(request.texture);
+    if (texture == nullptr || request.texture.index >= textureState.size())
+      continue;
+    auto &state = textureState[request.texture.index];
 
-  MTL::RenderPassDescriptor *renderPassDescriptor =
-      this->view->currentRenderPassDescriptor;
-  if (renderPassDescriptor == nullptr)
-    return;
+    switch (request.action) {
+    case texture::ResidencyAction::Restore:
+      texture->reload();
+      break;
+    case texture::ResidencyAction::Evict:
+      if (state.mtlTexture != nullptr) {
+        retireTexture(state.mtlTexture, ctx.absoluteFrame);
+        state.mtlTexture = nullptr;
+      }
+      state.active = false;
+      break;
+    case texture::ResidencyAction::DropTopLevel: {
+      MTL::Texture *source = state.mtlTexture;
+      if (source == nullptr || source->mipmapLevelCount() < 2)
+        break;
+      uint32_t levels = source->mipmapLevelCount() - 1;
 
-  NS::AutoreleasePool *pool = NS::AutoreleasePool::alloc()->init();
+      MTL::TextureDescriptor *textureDesc =
+          MTL::TextureDescriptor::alloc()->init();
+      textureDesc->setTextureType(MTL::TextureType2D);
+      textureDesc->setPixelFormat(source->pixelFormat());
+      textureDesc->setWidth(std::max<NS::UInteger>(source->width() / 2, 1));
+      textureDesc->setHeight(std::max<NS::UInteger>(source->height() / 2, 1));
+      textureDesc->setMipmapLevelCount(levels);
+      textureDesc->setStorageMode(MTL::StorageModeShared);
+      textureDesc->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead);
+      MTL::Texture *smaller = view->device->newTexture(textureDesc);
+      textureDesc->release();
 
-  MTL::CommandBuffer *commandBuffer = this->commandQueue->commandBuffer();
+      if (blitEncoder == nullptr) {
+        blitBuffer = commandQueue->commandBuffer();
+        blitEncoder = blitBuffer->blitCommandEncoder();
+      }
+      blitEncoder->copyFromTexture(source, 0, 1, smaller, 0, 0, 1, levels);
+
+      // Queued frames keep sampling the source from their own argument
+      // buffers, later ones get smaller once the blit ran
+      retireTexture(source, ctx.absoluteFrame);
+      state.mtlTexture = smaller;
+      break;
+    }
+    }
+  }
+
+  if (blitEncoder != nullptr) {
+    blitEncoder->endEncoding();
+    blitBuffer->commit();
+  }
+}
+
+void apple::AppleRenderer::prepareInstances(FrameContext &ctx, Scene *scene) {
+  drawLists.build(ctx, scene->cameras);
+  viewCommands.clear();
+
+  // Everything below goes to this frame's region of the buffers
+  instance::InstanceData *bufferData =
+      reinterpret_cast<instance::InstanceData *>(
+          meshInstanceBuffer->contents()) +
+      size_t(frameRegion) * instancePageSize;
+  uint32_t commandBase = frameRegion * instancePageSize;
+
+  // Instances are written once and shared by every view, views only differ
+  // by the range of indirect commands they execute
+  uint32_t instanceCount = 0;
+  std::vector<uint32_t> instanceSlots(drawLists.instances.size(), UINT32_MAX);
+  uint32_t commandCount = 0;
+
+  for (uint32_t v = 0; v < drawLists.views.size(); v++) {
+    const auto &list = drawLists.views[v];
+
+    auto cameraUBO = reinterpret_cast<dank::CameraUBO *>(
+        static_cast<uint8_t *>(cameraUBOBuffer->contents()) +
+        getCameraUBOOffset(v));
+    scene->cameras[list.camera].getCameraUBO(cameraUBO, list.originOffset);
+
+    ViewCommands commands{commandBase + commandCount, 0,
+                          scene->cameras[list.camera].viewport};
+
+    // Consecutive instances drawing the same indices with the same base
+    // vertex from consecutive slots share one instanced draw, which batches
+    // every sprite in a row. Instances with transient vertices each have
+    // their own base vertex.
+    DrawCall batch{};
+    uint32_t batchStart = 0;
+    uint32_t batchCount = 0;
+    auto flushBatch = [&]() {
+      if (batchCount == 0)
+        return;
+      MTL::IndirectRenderCommand *command =
+          indirectCommandBuffer->indirectRenderCommand(commandBase +
+                                                       commandCount);
+      command->drawIndexedPrimitives(
+          MTL::PrimitiveType::PrimitiveTypeTriangle,
+          NS::UInteger(batch.indexCount), batch.indexType, batch.indexBuffer,
+          NS::UInteger(batch.indexOffset), batchCount,
+          NS::Integer(batch.baseVertex), batchStart);
+      commandCount++;
+      commands.count++;
+      batchCount = 0;
+    };
+
+    for (const auto index : list.instances) {
+      if (commandCount >= instancePageSize)
+        break;
+
+      const auto &instance = drawLists.instances[index];
+      const auto textureDescriptor = findTextureState(instance.textureId);
+      if (textureDescriptor == nullptr || !textureDescriptor->active)
+        continue;
+
+      // Transient vertices and indices live in this frame's region
+      const auto meshDescriptor = ctx.meshLibrary.get(instance.meshId);
+      bool transient =
+          instance.transientVertices != draw::NO_TRANSIENT_VERTICES;
+      bool transientIndices = instance.transientIndices.count > 0;
+      if (transient && transientVertexBuffer == nullptr)
+        continue;
+      DrawCall call{};
+      if (transientIndices) {
+        call.indexBuffer = transientIndexBuffer;
+        call.indexType = MTL::IndexTypeUInt32;
+        call.indexOffset =
+            (frameRegion * transientIndexCapacity +
+             instance.transientIndices.first) *
+            sizeof(uint32_t);
+        call.indexCount = instance.transientIndices.count;
+      } else if (meshDescriptor != nullptr) {
+        call.indexBuffer = indexPages[meshDescriptor->bufferIndex];
+        call.indexType = meshDescriptor->indexType == mesh::IndexType::UInt16
+                             ? MTL::IndexTypeUInt16
+                             : MTL::IndexTypeUInt32;
+        call.indexOffset = meshDescriptor->indexOffset;
+        call.indexCount = meshDescriptor->indexCount;
+      } else {
+        continue;
+      }
+      if (transient) {
+        call.baseVertex = frameRegion * transientVertexCapacity +
+                          instance.transientVertices;
+      } else {
+        call.baseVertex =
+            meshDescriptor->vertexOffset / meshDescriptor->vertexStride;
+      }
+
+      if (instanceSlots[index] == UINT32_MAX) {
+        if (instanceCount >= instancePageSize)
+          break;
+        instanceSlots[index] = instanceCount;
+        auto &data = bufferData[instanceCount];
+        data.transform = drawLists.transforms[index];
+        data.color = instance.color;
+        data.textureIndex = textureDescriptor->index;
+        if (transient) {
+          data.bufferIndex = mesh::TRANSIENT_VERTEX_SLOT;
+          data.vertexFormat =
+              static_cast<uint32_t>(mesh::VertexFormat::Standard);
+          data.positionScale = 1.0f;
+        } else {
+          data.bufferIndex = meshDescriptor->bufferIndex;
+          data.vertexFormat =
+              static_cast<uint32_t>(meshDescriptor->vertexFormat);
+          data.positionScale = meshDescriptor->positionScale;
+        }
+        data.uvRect = instance.uvRect;
+        data.size = instance.size;
+        data.distanceField = instance.distanceField ? 1.0f : 0.0f;
+        instanceCount++;
+      }
+
+      uint32_t slot = instanceSlots[index];
+      if (batchCount > 0 && batch == call && batchStart + batchCount == slot) {
+        batchCount++;
+        continue;
+      }
+
+      flushBatch();
+      if (commandCount >= instancePageSize)
+        break;
+      batch = call;
+      batchStart = slot;
+      batchCount = 1;
+    }
+    flushBatch();
+    viewCommands.push_back(commands);
+  }
+
+  ctx.stats.drawCommands = commandCount;
+}
+
+void apple::AppleRenderer::encodeViews(
+    MTL::CommandBuffer *commandBuffer,
+    MTL::RenderPassDescriptor *renderPassDescriptor,
+    texture::TextureHandle renderTarget, double targetHeight) {
   MTL::RenderCommandEncoder *renderEncoder =
       commandBuffer->renderCommandEncoder(renderPassDescriptor);
 
   renderEncoder->setRenderPipelineState(this->pipelineState);
   renderEncoder->setVertexBuffer(vertexArgBuffer, 0, 0);
-
-  // Camera
-  auto cameraUBO =
-      reinterpret_cast<dank::CameraUBO *>(cameraUBOBuffer->contents());
-  scene->camera.getCameraUBO(cameraUBO);
-
   renderEncoder->setVertexBuffer(cameraUBOBuffer, 0, 1);
+  renderEncoder->setVertexBuffer(meshInstanceBuffer,
+                                 size_t(frameRegion) * instancePageSize *
+                                     sizeof(instance::InstanceData),
+                                 2);
+  renderEncoder->useResource(meshInstanceBuffer, MTL::ResourceUsageRead);
+  for (uint32_t p = 0; p < vertexPages.size(); p++) {
+    renderEncoder->useResource(vertexPages[p], MTL::ResourceUsageRead);
+    renderEncoder->useResource(indexPages[p], MTL::ResourceUsageRead);
+  }
+  if (transientVertexBuffer != nullptr) {
+    renderEncoder->useResource(transientVertexBuffer, MTL::ResourceUsageRead);
+    renderEncoder->useResource(transientIndexBuffer, MTL::ResourceUsageRead);
+  }
 
   // Set the argument buffer in the render command encoder
-  renderEncoder->setFragmentBuffer(fragmentArgBuffer, 0, 0);
+  renderEncoder->setFragmentBuffer(fragmentArgBuffers[frameRegion], 0, 0);
 
-  for (const auto &entry : textureState) {
-    if (entry.second.active) {
-      renderEncoder->useResource(entry.second.mtlTexture,
-                                 MTL::ResourceUsageSample);
+  const TextureState *targetState = findTextureState(renderTarget);
+  for (const auto &state : textureState) {
+    if (state.active && &state != targetState) {
+      renderEncoder->useResource(state.mtlTexture, MTL::ResourceUsageSample);
     }
   }
 
-  uint32_t meshInstanceCount = 0;
-  auto view = ctx.draw.view<draw::Mesh>();
-  for (auto [entity, mesh] : view.each()) {
-    const auto textureDescriptor = textureState[mesh.textureId];
-    if (!textureDescriptor.active)
+  for (uint32_t v = 0; v < drawLists.views.size(); v++) {
+    if (drawLists.views[v].renderTarget != renderTarget ||
+        viewCommands[v].count == 0)
       continue;
 
-    const auto meshDescriptor = ctx.meshLibrary.get(mesh.meshId);
+    // Camera viewports use a bottom-left origin, Metal a top-left one
+    const glm::vec4 &rect = viewCommands[v].viewport;
+    MTL::Viewport viewport{rect[0], targetHeight - rect[1] - rect[3],
+                           rect[2], rect[3], 0.0, 1.0};
+    renderEncoder->setViewport(viewport);
+    renderEncoder->setVertexBufferOffset(getCameraUBOOffset(v), 1);
+
+    renderEncoder->executeCommandsInBuffer(
+        indirectCommandBuffer,
+        NS::Range(viewCommands[v].start, viewCommands[v].count));
+  }
+
+  renderEncoder->endEncoding();
+}
+
+void apple::AppleRenderer::render(FrameContext &ctx, Scene *scene) {
+  prepareMeshes(ctx);
+  prepareTextures(ctx);
+
+  MTL::RenderPassDescriptor *renderPassDescriptor =
+      this->view->currentRenderPassDescriptor;
+  if (renderPassDescriptor == nullptr)
+    return;
+
+  NS::AutoreleasePool *pool = NS::AutoreleasePool::alloc()->init();
 
-    instance::InstanceData *bufferData =
-        reinterpret_cast<instance::InstanceData *>(
-            meshInstanceBuffer->contents());
-    bufferData[meshInstanceCount].transform = mesh.transform;
-    bufferData[meshInstanceCount].color = mesh.color;
-    bufferData[meshInstanceCount].bufferIndex = meshDescriptor->bufferIndex;
-    bufferData[meshInstanceCount].textureIndex = textureDescriptor.index;
+  // The regions about to be written were last read FRAMES_IN_FLIGHT frames
+  // ago: transient geometry, instances, indirect commands, camera UBOs and
+  // texture arguments
+  waitForFrames(FRAMES_IN_FLIGHT - 1);
+  frameRegion = (frameRegion + 1) % FRAMES_IN_FLIGHT;
+  releaseRetiredTextures(ctx.absoluteFrame);
+  encodeTextureArguments();
+  prepareTransientGeometry(ctx);
+  prepareInstances(ctx, scene);
 
-    MTL::IndirectRenderCommand *command =
-        indirectCommandBuffer->indirectRenderCommand(meshInstanceCount);
+  MTL::CommandBuffer *commandBuffer = this->commandQueue->commandBuffer();
+
+  // Offscreen views first, so the screen pass can sample their targets
+  std::vector<texture::TextureHandle> renderTargets{};
+  for (const auto &list : drawLists.views) {
+    if (!list.renderTarget.isValid() ||
+        std::find(renderTargets.begin(), renderTargets.end(),
+                  list.renderTarget) != renderTargets.end())
+      continue;
+    renderTargets.push_back(list.renderTarget);
+
+    const auto *state = findTextureState(list.renderTarget);
+    if (state == nullptr || !state->active || state->mtlTexture == nullptr)
+      continue;
 
-    command->drawIndexedPrimitives(
-        MTL::PrimitiveType::PrimitiveTypeTriangle,
-        NS::UInteger(meshDescriptor->indexCount), MTL::IndexTypeUInt32,
-        meshIndexBuffer,
-        NS::UInteger(meshDescriptor->indexOffset * sizeof(uint32_t)), 1, 0,
-        meshInstanceCount);
+    MTL::RenderPassDescriptor *targetPassDescriptor =
+        MTL::RenderPassDescriptor::renderPassDescriptor();
+    auto *colorAttachment = targetPassDescriptor->colorAttachments()->object(0);
+    colorAttachment->setTexture(state->mtlTexture);
+    colorAttachment->setLoadAction(MTL::LoadActionClear);
+    colorAttachment->setStoreAction(MTL::StoreActionStore);
+    colorAttachment->setClearColor(MTL::ClearColor::Make(0, 0, 0, 1));
 
-    meshInstanceCount++;
+    encodeViews(commandBuffer, targetPassDescriptor, list.renderTarget,
+                state->mtlTexture->height());
   }
 
-  renderEncoder->setVertexBuffer(meshInstanceBuffer, 0, 2);
-  renderEncoder->useResource(meshInstanceBuffer, MTL::ResourceUsageRead);
+  encodeViews(commandBuffer, renderPassDescriptor, texture::TextureHandle{},
+              view->viewHeight);
 
-  renderEncoder->executeCommandsInBuffer(indirectCommandBuffer,
-                                         NS::Range(0, meshInstanceCount));
-  renderEncoder->endEncoding();
   commandBuffer->presentDrawable(this->view->currentDrawable);
+  {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    framesInFlight++;
+  }
+  commandBuffer->addCompletedHandler([this](MTL::CommandBuffer *) {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    framesInFlight--;
+    frameCompleted.notify_all();
+  });
   commandBuffer->commit();
 
   pool->release();
 }
 
 void apple::AppleRenderer::release() {
-  if (meshVertexBuffer != nullptr) {
-    meshVertexBuffer->release();
-    meshVertexBuffer = nullptr;
+  // Completed handlers still refer to this renderer
+  waitForFrames(0);
+
+  for (auto *buffer : vertexPages) {
+    buffer->release();
   }
-  if (meshIndexBuffer != nullptr) {
-    meshIndexBuffer->release();
-    meshIndexBuffer = nullptr;
+  vertexPages.clear();
+  for (auto *buffer : indexPages) {
+    buffer->release();
   }
+  indexPages.clear();
+  if (transientVertexBuffer != nullptr) {
+    transientVertexBuffer->release();
+    transientVertexBuffer = nullptr;
+  }
+  if (transientIndexBuffer != nullptr) {
+    transientIndexBuffer->release();
+    transientIndexBuffer = nullptr;
+  }
+  transientVertexCapacity = 0;
+  transientIndexCapacity = 0;
 
   if (cameraUBOBuffer != nullptr) {
     cameraUBOBuffer->release();
@@ -328,9 +804,11 @@ void apple::AppleRenderer::release() {
     vertexArgBuffer->release();
     vertexArgBuffer = nullptr;
   }
-  if (fragmentArgBuffer != nullptr) {
-    fragmentArgBuffer->release();
-    fragmentArgBuffer = nullptr;
+  for (auto *&buffer : fragmentArgBuffers) {
+    if (buffer != nullptr) {
+      buffer->release();
+      buffer = nullptr;
+    }
   }
   if (meshInstanceBuffer != nullptr) {
     meshInstanceBuffer->release();
@@ -350,10 +828,13 @@ void apple::AppleRenderer::release() {
     indirectCommandBuffer = nullptr;
   }
 
-  for (auto &entry : textureState) {
-    entry.second.mtlTexture->release();
+  for (auto &state : textureState) {
+    if (state.mtlTexture != nullptr) {
+      state.mtlTexture->release();
+    }
   }
   textureState.clear();
+  releaseRetiredTextures(UINT32_MAX);
 
   if (pipelineState != nullptr) {
     pipelineState->release();
@@ -1,43 +1,124 @@
 #pragma once
 
+#include "modules/renderer/DrawLists.hpp"
 #include "modules/renderer/Renderer.hpp"
 #include "modules/renderer/textures/Texture.hpp"
+#include "modules/renderer/textures/TextureResidency.hpp"
 #include "os/apple/AppleOS.hpp"
 #include "os/apple/Metal.hpp"
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 
 namespace dank {
 namespace apple {
 
   struct TextureState {
+    uint32_t generation{0};
     uint32_t lastModified{0};
     uint32_t index;
     MTL::Texture* mtlTexture{nullptr};
     bool active;
   };
 
+// Arguments of one indexed draw, instances with equal ones can be batched
+struct DrawCall {
+  MTL::Buffer *indexBuffer = nullptr;
+  MTL::IndexType indexType = MTL::IndexTypeUInt32;
+  uint32_t indexOffset = 0;
+  uint32_t indexCount = 0;
+  uint32_t baseVertex = 0;
+
+  bool operator==(const DrawCall &other) const {
+    return indexBuffer == other.indexBuffer && indexType == other.indexType &&
+           indexOffset == other.indexOffset &&
+           indexCount == other.indexCount && baseVertex == other.baseVertex;
+  }
+};
+
 class AppleRenderer : public dank::Renderer {
 private:
   MTL::CommandQueue *commandQueue;
   MTL::IndirectCommandBuffer *indirectCommandBuffer = nullptr;
   MTL::RenderPipelineState *pipelineState = nullptr;
   
-  MTL::Buffer *meshVertexBuffer = nullptr;
-  MTL::Buffer *meshIndexBuffer = nullptr;
+  // One buffer per mesh::MeshPage, vertex pages are bound through the
+  // argument buffer at their page index
+  std::vector<MTL::Buffer *> vertexPages{};
+  std::vector<MTL::Buffer *> indexPages{};
   uint32_t meshLibraryLastModified = 0;
+  uint32_t meshLibraryClearCount = 0;
+  // mesh::TransientGeometry, one region per frame in flight in a single
+  // buffer each, so the argument buffer slot (mesh::TRANSIENT_VERTEX_SLOT)
+  // only changes when they grow. Frames address their region through the
+  // base vertex and the index buffer offset.
+  MTL::Buffer *transientVertexBuffer = nullptr;
+  MTL::Buffer *transientIndexBuffer = nullptr;
+  // Per region, in vertices and indices
+  uint32_t transientVertexCapacity = 0;
+  uint32_t transientIndexCapacity = 0;
+
+  // Command buffers committed and not completed yet, decremented by their
+  // completed handlers
+  std::mutex frameMutex{};
+  std::condition_variable frameCompleted{};
+  uint32_t framesInFlight = 0;
+  void waitForFrames(uint32_t maxInFlight);
 
-  std::map<uint32_t, TextureState> textureState{};
+  // Indexed by TextureHandle::index, the generation detects reused slots
+  std::vector<TextureState> textureState{};
+  const TextureState *findTextureState(texture::TextureHandle handle) const;
+
+  // Textures replaced or released while frames in flight may still sample
+  // them, released FRAMES_IN_FLIGHT frames later
+  struct RetiredTexture {
+    MTL::Texture *texture;
+    uint32_t frame;
+  };
+  std::vector<RetiredTexture> retiredTextures{};
+  void retireTexture(MTL::Texture *texture, uint32_t frame);
+  void releaseRetiredTextures(uint32_t frame);
   void init();
   void prepareMeshes(dank::FrameContext &ctx);
+  void prepareTransientGeometry(dank::FrameContext &ctx);
   void prepareTextures(dank::FrameContext &ctx);
+  // Drops, evicts and restores what the TextureResidency asks for
+  void applyResidency(dank::FrameContext &ctx);
+  std::vector<texture::ResidencyRequest> residencyRequests{};
+  void prepareInstances(dank::FrameContext &ctx, Scene *scene);
+  void encodeViews(MTL::CommandBuffer *commandBuffer,
+                   MTL::RenderPassDescriptor *renderPassDescriptor,
+                   texture::TextureHandle renderTarget, double targetHeight);
 
   MTL::ArgumentEncoder *vertexArgEncoder;
   MTL::Buffer *vertexArgBuffer;
   MTL::ArgumentEncoder *fragmentArgEncoder;
-  MTL::Buffer *fragmentArgBuffer;
+  // Texture slots, one buffer per frame in flight so changing a slot never
+  // touches what queued frames sample. Encoded every frame.
+  MTL::Buffer *fragmentArgBuffers[FRAMES_IN_FLIGHT]{};
+  // Region of the per frame buffers this frame writes, the others belong
+  // to the frames in flight
+  uint32_t frameRegion = 0;
+  void encodeTextureArguments();
   MTL::Buffer *cameraUBOBuffer;
+  // One CameraUBO per view and frame in flight, offsets aligned for
+  // setVertexBufferOffset
+  const uint32_t cameraUBOStride = 256;
+  size_t getCameraUBOOffset(uint32_t view) const {
+    return (size_t(frameRegion) * draw::MAX_VIEWS + view) * cameraUBOStride;
+  }
+
+  struct ViewCommands {
+    uint32_t start;
+    uint32_t count;
+    glm::vec4 viewport;
+  };
+  draw::DrawLists drawLists{};
+  std::vector<ViewCommands> viewCommands{};
 
+  // Instances and indirect commands a frame can have, the buffers hold one
+  // region of that many per frame in flight
   uint32_t instancePageSize = 1024;
   MTL::Buffer *meshInstanceBuffer = nullptr;
   MetalView *view;
@@ -1,14 +1,40 @@
 #include <metal_stdlib>
 using namespace metal;
 
+// Must match mesh::VertexFormat
+constant uint32_t VERTEX_FORMAT_STANDARD = 0;
+constant uint32_t VERTEX_FORMAT_SPRITE = 1;
+constant uint32_t VERTEX_FORMAT_QUANTIZED = 2;
+
+// Must match text::GLYPH_EDGE_VALUE
+constant float GLYPH_EDGE = 128.0 / 255.0;
+
 struct VertexData {
   packed_float3 position;
   packed_float3 normal;
   packed_float2 uv;
 };
 
+struct SpriteVertex {
+  packed_half2 position;
+  uint32_t uv;
+};
+
+struct QuantizedVertex {
+  uint32_t positionXY;
+  uint32_t positionZ;
+  uint32_t normal;
+  uint32_t uv;
+};
+
+struct VertexAttributes {
+  float3 position;
+  float3 normal;
+  float2 uv;
+};
+
 typedef struct VertexShaderArguments {
-    array<const device VertexData *, 16> buffers [[id(0)]];
+    array<const device uchar *, 16> buffers [[id(0)]];
 } VertexShaderArguments;
 
 typedef struct FragmentShaderArguments {
@@ -32,7 +58,12 @@ struct InstanceData {
   packed_float4 color;
   uint32_t bufferIndex;
   uint32_t textureIndex;
-  packed_float2 _pad;
+  uint32_t vertexFormat;
+  float positionScale;
+  float4 uvRect;
+  packed_float2 size;
+  float distanceField;
+  float _pad;
 };
 
 struct v2f
@@ -41,8 +72,43 @@ struct v2f
     float4 color;
     float2 uv;
     uint32_t textureIndex;
+    float distanceField [[flat]];
 };
 
+float3 decodeOctahedral(float2 e)
+{
+    float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+VertexAttributes decodeVertex(const device uchar *buffer, uint vertexId,
+                              uint32_t format, float positionScale)
+{
+    VertexAttributes va;
+    if (format == VERTEX_FORMAT_SPRITE) {
+        const device SpriteVertex &sv = ((const device SpriteVertex *)buffer)[vertexId];
+        va.position = float3(float2(sv.position), 0.0);
+        va.normal = float3(0.0, 0.0, 1.0);
+        va.uv = unpack_unorm2x16_to_float(sv.uv);
+    } else if (format == VERTEX_FORMAT_QUANTIZED) {
+        const device QuantizedVertex &qv = ((const device QuantizedVertex *)buffer)[vertexId];
+        float2 xy = unpack_snorm2x16_to_float(qv.positionXY);
+        float z = unpack_snorm2x16_to_float(qv.positionZ).x;
+        va.position = float3(xy, z) * positionScale;
+        va.normal = decodeOctahedral(unpack_snorm2x16_to_float(qv.normal));
+        va.uv = unpack_unorm2x16_to_float(qv.uv);
+    } else {
+        const device VertexData &vd = ((const device VertexData *)buffer)[vertexId];
+        va.position = float3(vd.position);
+        va.normal = float3(vd.normal);
+        va.uv = float2(vd.uv);
+    }
+    return va;
+}
+
 v2f vertex vertexMain(
     device const VertexShaderArguments& vertexArgs [[buffer(0)]],
     device const CameraUBO& camera [[buffer(1)]],
@@ -51,22 +117,37 @@ v2f vertex vertexMain(
     uint instanceId [[instance_id]]) 
 {
     const device InstanceData &id = instanceData[ instanceId ];
-    const device VertexData &vd = vertexArgs.buffers[id.bufferIndex][vertexId];
+    VertexAttributes va = decodeVertex(vertexArgs.buffers[id.bufferIndex],
+                                       vertexId, id.vertexFormat,
+                                       id.positionScale);
+    float3 position = va.position * float3(id.size, 1.0);
 
     v2f o;
-    o.position = camera.viewProj * id.transform * float4( vd.position, 1.0 );
+    o.position = camera.viewProj * id.transform * float4( position, 1.0 );
     o.color = id.color;
-    o.uv = float2(vd.uv);
+    o.uv = id.uvRect.xy + va.uv * id.uvRect.zw;
     o.textureIndex = id.textureIndex;
+    o.distanceField = id.distanceField;
     return o;
 }
 
 half4 fragment fragmentMain( v2f in [[stage_in]], 
     device FragmentShaderArguments & fragmentShaderArgs [[ buffer(0) ]] )
 {
-    constexpr sampler s( address::repeat, filter::linear );
+    constexpr sampler s( address::repeat, filter::linear,
+                         mip_filter::linear );
     
-    float4 color = fragmentShaderArgs.textures[in.textureIndex].sample(s, in.uv) * in.color;
+    // Textures are premultiplied, the instance color is straight
+    float4 tint = float4(in.color.rgb * in.color.a, in.color.a);
+    float4 texel = fragmentShaderArgs.textures[in.textureIndex].sample(s, in.uv);
+
+    // Distance fields store the distance to the edge in red, 0.5 on it.
+    // The edge is smoothed over about a pixel at any size on screen.
+    if (in.distanceField > 0.0) {
+        float distance = texel.r - GLYPH_EDGE;
+        float width = max(fwidth(distance), 1e-4) * 0.5;
+        return half4(tint * smoothstep(-width, width, distance));
+    }
 
-    return half4(color);
+    return half4(texel * tint);
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #import "CaptureStreamOutput.h"
 #include "modules/Foundation.hpp"
 #include "modules/os/Capture.hpp"
+#include "modules/renderer/textures/PixelConversion.hpp"
 #include <CoreFoundation/CoreFoundation.h>
 #include <CoreMedia/CoreMedia.h>
 #include <ScreenCaptureKit/SCStream.h>
 #include <ScreenCaptureKit/ScreenCaptureKit.h>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
@@ -105,9 +107,7 @@
 
   // Check for supported pixel format
   OSType pixelFormat = CVPixelBufferGetPixelFormatType(imageBuffer);
-  if (pixelFormat == kCVPixelFormatType_32BGRA) {
-    config->screenOutput.format = dank::PixelFormat::BGRA32;
-  } else {
+  if (pixelFormat != kCVPixelFormatType_32BGRA) {
     // Unsupported
     return;
   }
@@ -115,28 +115,45 @@
   // Lock the base address of the image buffer
   CVPixelBufferLockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
 
-  config->screenOutput.width = CVPixelBufferGetWidth(imageBuffer);
-  config->screenOutput.height = CVPixelBufferGetHeight(imageBuffer);
-  config->screenOutput.channels = 4;
+  uint32_t width = CVPixelBufferGetWidth(imageBuffer);
+  uint32_t height = CVPixelBufferGetHeight(imageBuffer);
+  size_t outputDataSize = size_t(width) * height * 4;
 
-  size_t outputDataSize = config->screenOutput.width *
-                          config->screenOutput.height *
-                          config->screenOutput.channels;
+  // A new buffer every frame, the previous one may still be uploading.
+  // The pool hands back the ones the renderer is done with.
+  dank::texture::PixelBuffer pixels =
+      config->screenOutput.pool.acquire(outputDataSize);
+  if (!pixels) {
+    CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
+    return;
+  }
 
-  if (config->screenOutput.size != outputDataSize) {
-    config->screenOutput.size = outputDataSize;
-    if (config->screenOutput.data != nullptr) {
-      free(config->screenOutput.data);
-    }
-    config->screenOutput.data = (uint8_t *)malloc(outputDataSize);
+  // Swizzled to RGBA while copied, row by row as the buffer's rows may be
+  // padded. Screens are opaque so the frame is premultiplied as it is.
+  auto start = std::chrono::steady_clock::now();
+  const uint8_t *source =
+      (const uint8_t *)CVPixelBufferGetBaseAddress(imageBuffer);
+  size_t sourceBytesPerRow = CVPixelBufferGetBytesPerRow(imageBuffer);
+  size_t bytesPerRow = size_t(width) * 4;
+  for (uint32_t y = 0; y < height; y++) {
+    dank::texture::swizzleRedBlue(source + y * sourceBytesPerRow, width,
+                                  pixels.data() + y * bytesPerRow);
   }
+  dank::texture::conversionStats.bytes += outputDataSize;
+  dank::texture::conversionStats.microseconds +=
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
 
-  memcpy(config->screenOutput.data,
-         (uint8_t *)CVPixelBufferGetBaseAddress(imageBuffer), outputDataSize);
+  CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
 
+  std::lock_guard<std::mutex> lock(config->screenOutput.mutex);
+  config->screenOutput.format = dank::PixelFormat::RGBA8Unorm;
+  config->screenOutput.width = width;
+  config->screenOutput.height = height;
+  config->screenOutput.channels = 4;
+  config->screenOutput.pixels = std::move(pixels);
   config->screenOutput.frame++;
-
-  CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
 }
 
 - (void)stream:(SCStream *)stream didStopWithError:(NSError *)error {
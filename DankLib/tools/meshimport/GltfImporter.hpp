@@ -0,0 +1,398 @@
+#pragma once
+#include "Json.hpp"
+#include "ObjImporter.hpp"
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace meshimport {
+
+// glTF 2.0, .gltf with external or data: buffers and binary .glb. Every
+// triangle primitive reachable from the default scene is merged into one
+// mesh with its node transform applied. POSITION, NORMAL and TEXCOORD_0
+// are read, sparse accessors are not supported.
+class GltfImporter {
+private:
+  Json document{};
+  std::vector<std::vector<uint8_t>> buffers{};
+  std::string directory{};
+
+  static bool readFile(const std::string &path, std::vector<uint8_t> &output) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+      return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    output.resize(size > 0 ? size : 0);
+    size_t read = fread(output.data(), 1, output.size(), file);
+    fclose(file);
+    return read == output.size();
+  }
+
+  static bool decodeBase64(const std::string &input, size_t start,
+                           std::vector<uint8_t> &output) {
+    auto value = [](char c) -> int {
+      if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+      if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+      if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+      if (c == '+')
+        return 62;
+      if (c == '/')
+        return 63;
+      return -1;
+    };
+
+    uint32_t bits = 0;
+    int count = 0;
+    for (size_t i = start; i < input.size(); i++) {
+      if (input[i] == '=')
+        break;
+      int v = value(input[i]);
+      if (v < 0)
+        return false;
+      bits = (bits << 6) | v;
+      count += 6;
+      if (count >= 8) {
+        count -= 8;
+        output.push_back(static_cast<uint8_t>((bits >> count) & 0xFF));
+      }
+    }
+    return true;
+  }
+
+  bool loadBuffers(const std::vector<uint8_t> *glbChunk) {
+    const Json &list = document["buffers"];
+    buffers.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) {
+      const Json &buffer = list[i];
+      if (!buffer.has("uri")) {
+        // The first buffer of a .glb lives in its BIN chunk
+        if (i != 0 || glbChunk == nullptr)
+          return false;
+        buffers[i] = *glbChunk;
+        continue;
+      }
+
+      const std::string &uri = buffer["uri"].string;
+      if (uri.compare(0, 5, "data:") == 0) {
+        size_t comma = uri.find(',');
+        if (comma == std::string::npos ||
+            !decodeBase64(uri, comma + 1, buffers[i]))
+          return false;
+      } else if (!readFile(directory + uri, buffers[i])) {
+        fprintf(stderr, "could not read buffer %s\n", uri.c_str());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Reads component c of element i as float, normalizing integers if asked
+  static float readComponent(const uint8_t *data, uint32_t componentType,
+                             bool normalized, size_t i) {
+    switch (componentType) {
+    case 5120: { // BYTE
+      int8_t v;
+      memcpy(&v, data + i, 1);
+      return normalized ? glm::max(v / 127.0f, -1.0f) : v;
+    }
+    case 5121: { // UNSIGNED_BYTE
+      uint8_t v = data[i];
+      return normalized ? v / 255.0f : v;
+    }
+    case 5122: { // SHORT
+      int16_t v;
+      memcpy(&v, data + i * 2, 2);
+      return normalized ? glm::max(v / 32767.0f, -1.0f) : v;
+    }
+    case 5123: { // UNSIGNED_SHORT
+      uint16_t v;
+      memcpy(&v, data + i * 2, 2);
+      return normalized ? v / 65535.0f : v;
+    }
+    case 5125: { // UNSIGNED_INT
+      uint32_t v;
+      memcpy(&v, data + i * 4, 4);
+      return static_cast<float>(v);
+    }
+    case 5126: { // FLOAT
+      float v;
+      memcpy(&v, data + i * 4, 4);
+      return v;
+    }
+    }
+    return 0;
+  }
+
+  static uint32_t componentSize(uint32_t componentType) {
+    switch (componentType) {
+    case 5120:
+    case 5121:
+      return 1;
+    case 5122:
+    case 5123:
+      return 2;
+    default:
+      return 4;
+    }
+  }
+
+  static uint32_t componentCount(const std::string &type) {
+    if (type == "SCALAR")
+      return 1;
+    if (type == "VEC2")
+      return 2;
+    if (type == "VEC3")
+      return 3;
+    if (type == "VEC4" || type == "MAT2")
+      return 4;
+    if (type == "MAT3")
+      return 9;
+    if (type == "MAT4")
+      return 16;
+    return 0;
+  }
+
+  // Reads an accessor as floats, components per element in output
+  bool readAccessor(uint32_t index, uint32_t components,
+                    std::vector<float> &output) {
+    const Json &accessor = document["accessors"][index];
+    if (accessor.has("sparse")) {
+      fprintf(stderr, "sparse accessors are not supported\n");
+      return false;
+    }
+
+    uint32_t count = accessor["count"].asNumber();
+    uint32_t componentType = accessor["componentType"].asNumber();
+    bool normalized = accessor["normalized"].boolean;
+    uint32_t available = componentCount(accessor["type"].string);
+    output.assign(static_cast<size_t>(count) * components, 0.0f);
+    if (!accessor.has("bufferView"))
+      return true;
+
+    const Json &view = document["bufferViews"][accessor["bufferView"].asNumber()];
+    uint32_t bufferIndex = view["buffer"].asNumber();
+    if (bufferIndex >= buffers.size())
+      return false;
+    const std::vector<uint8_t> &buffer = buffers[bufferIndex];
+
+    size_t elementSize = componentSize(componentType) * available;
+    size_t stride = view["byteStride"].asNumber(elementSize);
+    size_t offset = static_cast<size_t>(view["byteOffset"].asNumber()) +
+                    static_cast<size_t>(accessor["byteOffset"].asNumber());
+    if (count > 0 &&
+        offset + stride * (count - 1) + elementSize > buffer.size())
+      return false;
+
+    for (size_t e = 0; e < count; e++) {
+      const uint8_t *element = buffer.data() + offset + stride * e;
+      for (uint32_t c = 0; c < components && c < available; c++) {
+        output[e * components + c] =
+            readComponent(element, componentType, normalized, c);
+      }
+    }
+    return true;
+  }
+
+  static glm::mat4 getNodeTransform(const Json &node) {
+    if (node.has("matrix")) {
+      glm::mat4 m(1.0f);
+      for (int i = 0; i < 16; i++) {
+        m[i / 4][i % 4] = node["matrix"][i].asNumber();
+      }
+      return m;
+    }
+
+    glm::vec3 t(0.0f), s(1.0f);
+    glm::quat r(1.0f, 0.0f, 0.0f, 0.0f);
+    if (node.has("translation")) {
+      t = glm::vec3(node["translation"][0].asNumber(),
+                    node["translation"][1].asNumber(),
+                    node["translation"][2].asNumber());
+    }
+    if (node.has("rotation")) {
+      // glTF stores x, y, z, w
+      r = glm::quat(node["rotation"][3].asNumber(),
+                    node["rotation"][0].asNumber(),
+                    node["rotation"][1].asNumber(),
+                    node["rotation"][2].asNumber());
+    }
+    if (node.has("scale")) {
+      s = glm::vec3(node["scale"][0].asNumber(1), node["scale"][1].asNumber(1),
+                    node["scale"][2].asNumber(1));
+    }
+    return glm::translate(glm::mat4(1.0f), t) * glm::toMat4(r) *
+           glm::scale(glm::mat4(1.0f), s);
+  }
+
+  bool importMesh(uint32_t meshIndex, const glm::mat4 &transform,
+                  MeshData &output) {
+    const Json &primitives = document["meshes"][meshIndex]["primitives"];
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+    for (size_t p = 0; p < primitives.size(); p++) {
+      const Json &primitive = primitives[p];
+      // Only triangle lists
+      if (primitive["mode"].asNumber(4) != 4)
+        continue;
+      const Json &attributes = primitive["attributes"];
+      if (!attributes.has("POSITION"))
+        continue;
+
+      std::vector<float> positions, normals, uvs, indices;
+      if (!readAccessor(attributes["POSITION"].asNumber(), 3, positions))
+        return false;
+      if (attributes.has("NORMAL") &&
+          !readAccessor(attributes["NORMAL"].asNumber(), 3, normals))
+        return false;
+      if (attributes.has("TEXCOORD_0") &&
+          !readAccessor(attributes["TEXCOORD_0"].asNumber(), 2, uvs))
+        return false;
+      if (primitive.has("indices") &&
+          !readAccessor(primitive["indices"].asNumber(), 1, indices))
+        return false;
+
+      uint32_t base = output.vertices.size();
+      size_t vertexCount = positions.size() / 3;
+      for (size_t v = 0; v < vertexCount; v++) {
+        VertexData vertex{};
+        vertex.position = glm::vec3(
+            transform * glm::vec4(positions[v * 3], positions[v * 3 + 1],
+                                  positions[v * 3 + 2], 1.0f));
+        vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        if (!normals.empty()) {
+          vertex.normal = glm::normalize(
+              normalMatrix * glm::vec3(normals[v * 3], normals[v * 3 + 1],
+                                       normals[v * 3 + 2]));
+        }
+        if (!uvs.empty()) {
+          vertex.uv = glm::vec2(uvs[v * 2], uvs[v * 2 + 1]);
+        }
+        output.vertices.push_back(vertex);
+      }
+
+      size_t first = output.indices.size();
+      if (indices.empty()) {
+        for (uint32_t i = 0; i + 2 < vertexCount; i += 3) {
+          output.indices.insert(output.indices.end(),
+                                {base + i, base + i + 1, base + i + 2});
+        }
+      } else {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+          output.indices.insert(
+              output.indices.end(),
+              {base + static_cast<uint32_t>(indices[i]),
+               base + static_cast<uint32_t>(indices[i + 1]),
+               base + static_cast<uint32_t>(indices[i + 2])});
+        }
+      }
+
+      // Mirroring transforms flip the winding
+      if (glm::determinant(glm::mat3(transform)) < 0) {
+        for (size_t i = first; i < output.indices.size(); i += 3) {
+          std::swap(output.indices[i + 1], output.indices[i + 2]);
+        }
+      }
+
+      if (normals.empty()) {
+        MeshData primitiveData{};
+        primitiveData.vertices.assign(output.vertices.begin() + base,
+                                      output.vertices.end());
+        for (size_t i = first; i < output.indices.size(); i++) {
+          primitiveData.indices.push_back(output.indices[i] - base);
+        }
+        ObjImporter::computeNormals(primitiveData);
+        std::copy(primitiveData.vertices.begin(), primitiveData.vertices.end(),
+                  output.vertices.begin() + base);
+      }
+    }
+    return true;
+  }
+
+  bool importNode(uint32_t nodeIndex, const glm::mat4 &parent,
+                  MeshData &output, uint32_t depth) {
+    // Guards against cycles in broken files
+    if (depth > 64)
+      return false;
+    const Json &node = document["nodes"][nodeIndex];
+    glm::mat4 transform = parent * getNodeTransform(node);
+    if (node.has("mesh") &&
+        !importMesh(node["mesh"].asNumber(), transform, output))
+      return false;
+    const Json &children = node["children"];
+    for (size_t i = 0; i < children.size(); i++) {
+      if (!importNode(children[i].asNumber(), transform, output, depth + 1))
+        return false;
+    }
+    return true;
+  }
+
+public:
+  bool import(const std::string &path, MeshData &output) {
+    size_t slash = path.find_last_of("/\\");
+    directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    std::vector<uint8_t> file{};
+    if (!readFile(path, file))
+      return false;
+
+    std::vector<uint8_t> binChunk{};
+    const char *jsonBegin = reinterpret_cast<const char *>(file.data());
+    const char *jsonEnd = jsonBegin + file.size();
+
+    // .glb: 12 byte header, JSON chunk, optional BIN chunk
+    if (file.size() >= 20 && memcmp(file.data(), "glTF", 4) == 0) {
+      uint32_t jsonLength, jsonType;
+      memcpy(&jsonLength, file.data() + 12, 4);
+      memcpy(&jsonType, file.data() + 16, 4);
+      if (jsonType != 0x4E4F534A || 20 + jsonLength > file.size())
+        return false;
+      jsonBegin = reinterpret_cast<const char *>(file.data() + 20);
+      jsonEnd = jsonBegin + jsonLength;
+
+      size_t binOffset = 20 + ((jsonLength + 3) & ~3u);
+      if (binOffset + 8 <= file.size()) {
+        uint32_t binLength, binType;
+        memcpy(&binLength, file.data() + binOffset, 4);
+        memcpy(&binType, file.data() + binOffset + 4, 4);
+        if (binType == 0x004E4942 && binOffset + 8 + binLength <= file.size()) {
+          binChunk.assign(file.begin() + binOffset + 8,
+                          file.begin() + binOffset + 8 + binLength);
+        }
+      }
+    }
+
+    // Trailing padding in .glb JSON chunks is spaces, also valid JSON space
+    if (!Json::parse(jsonBegin, jsonEnd, document)) {
+      fprintf(stderr, "invalid glTF JSON\n");
+      return false;
+    }
+    if (!loadBuffers(binChunk.empty() ? nullptr : &binChunk))
+      return false;
+
+    const Json &scenes = document["scenes"];
+    if (scenes.size() > 0) {
+      const Json &scene = scenes[document["scene"].asNumber()];
+      const Json &nodes = scene["nodes"];
+      for (size_t i = 0; i < nodes.size(); i++) {
+        if (!importNode(nodes[i].asNumber(), glm::mat4(1.0f), output, 0))
+          return false;
+      }
+    } else {
+      // No scene, take the meshes as they are
+      for (size_t i = 0; i < document["meshes"].size(); i++) {
+        if (!importMesh(i, glm::mat4(1.0f), output))
+          return false;
+      }
+    }
+    return !output.indices.empty();
+  }
+};
+
+} // namespace meshimport
@@ -0,0 +1,235 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace meshimport {
+
+// Just enough JSON to read glTF documents
+struct Json {
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0;
+  std::string string{};
+  std::vector<Json> array{};
+  std::map<std::string, Json> object{};
+
+  bool has(const std::string &key) const {
+    return type == Type::Object && object.count(key) > 0;
+  }
+
+  // Null value when missing, so lookups can be chained
+  const Json &operator[](const std::string &key) const {
+    static const Json null{};
+    if (type != Type::Object)
+      return null;
+    auto it = object.find(key);
+    return it != object.end() ? it->second : null;
+  }
+
+  const Json &operator[](size_t index) const {
+    static const Json null{};
+    return type == Type::Array && index < array.size() ? array[index] : null;
+  }
+
+  size_t size() const {
+    return type == Type::Array ? array.size() : object.size();
+  }
+
+  double asNumber(double fallback = 0) const {
+    return type == Type::Number ? number : fallback;
+  }
+
+  static bool parse(const char *begin, const char *end, Json &output) {
+    Parser parser{begin, end};
+    if (!parser.parseValue(output))
+      return false;
+    parser.skipSpace();
+    return parser.cursor == parser.end;
+  }
+
+private:
+  struct Parser {
+    const char *cursor;
+    const char *end;
+
+    void skipSpace() {
+      while (cursor < end && (*cursor == ' ' || *cursor == '\n' ||
+                              *cursor == '\r' || *cursor == '\t')) {
+        cursor++;
+      }
+    }
+
+    bool match(const char *literal) {
+      const char *c = cursor;
+      for (; *literal != 0; literal++, c++) {
+        if (c >= end || *c != *literal)
+          return false;
+      }
+      cursor = c;
+      return true;
+    }
+
+    bool parseString(std::string &output) {
+      if (cursor >= end || *cursor != '"')
+        return false;
+      cursor++;
+      while (cursor < end && *cursor != '"') {
+        char c = *cursor++;
+        if (c != '\\') {
+          output.push_back(c);
+          continue;
+        }
+        if (cursor >= end)
+          return false;
+        char escaped = *cursor++;
+        switch (escaped) {
+        case 'n':
+          output.push_back('\n');
+          break;
+        case 't':
+          output.push_back('\t');
+          break;
+        case 'r':
+          output.push_back('\r');
+          break;
+        case 'b':
+          output.push_back('\b');
+          break;
+        case 'f':
+          output.push_back('\f');
+          break;
+        case 'u': {
+          if (end - cursor < 4)
+            return false;
+          uint32_t code = std::strtoul(std::string(cursor, 4).c_str(),
+                                       nullptr, 16);
+          cursor += 4;
+          // UTF-8 encode, surrogate pairs are kept as is
+          if (code < 0x80) {
+            output.push_back(static_cast<char>(code));
+          } else if (code < 0x800) {
+            output.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+          } else {
+            output.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+          }
+        } break;
+        default:
+          output.push_back(escaped);
+          break;
+        }
+      }
+      if (cursor >= end)
+        return false;
+      cursor++;
+      return true;
+    }
+
+    bool parseValue(Json &output) {
+      skipSpace();
+      if (cursor >= end)
+        return false;
+
+      char c = *cursor;
+      if (c == '{') {
+        cursor++;
+        output.type = Type::Object;
+        skipSpace();
+        if (cursor < end && *cursor == '}') {
+          cursor++;
+          return true;
+        }
+        while (true) {
+          skipSpace();
+          std::string key;
+          if (!parseString(key))
+            return false;
+          skipSpace();
+          if (cursor >= end || *cursor != ':')
+            return false;
+          cursor++;
+          if (!parseValue(output.object[key]))
+            return false;
+          skipSpace();
+          if (cursor < end && *cursor == ',') {
+            cursor++;
+            continue;
+          }
+          if (cursor < end && *cursor == '}') {
+            cursor++;
+            return true;
+          }
+          return false;
+        }
+      }
+
+      if (c == '[') {
+        cursor++;
+        output.type = Type::Array;
+        skipSpace();
+        if (cursor < end && *cursor == ']') {
+          cursor++;
+          return true;
+        }
+        while (true) {
+          output.array.emplace_back();
+          if (!parseValue(output.array.back()))
+            return false;
+          skipSpace();
+          if (cursor < end && *cursor == ',') {
+            cursor++;
+            continue;
+          }
+          if (cursor < end && *cursor == ']') {
+            cursor++;
+            return true;
+          }
+          return false;
+        }
+      }
+
+      if (c == '"') {
+        output.type = Type::String;
+        return parseString(output.string);
+      }
+
+      if (match("true")) {
+        output.type = Type::Bool;
+        output.boolean = true;
+        return true;
+      }
+      if (match("false")) {
+        output.type = Type::Bool;
+        return true;
+      }
+      if (match("null")) {
+        return true;
+      }
+
+      // strtod needs a terminated string, numbers are short
+      const char *start = cursor;
+      while (cursor < end &&
+             (std::isdigit(static_cast<unsigned char>(*cursor)) ||
+              *cursor == '-' || *cursor == '+' || *cursor == '.' ||
+              *cursor == 'e' || *cursor == 'E')) {
+        cursor++;
+      }
+      if (cursor == start)
+        return false;
+      output.type = Type::Number;
+      output.number = std::strtod(std::string(start, cursor).c_str(), nullptr);
+      return true;
+    }
+  };
+};
+
+} // namespace meshimport
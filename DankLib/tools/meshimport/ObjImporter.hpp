@@ -0,0 +1,187 @@
+#pragma once
+#include "modules/renderer/meshes/Mesh.hpp"
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace meshimport {
+
+using dank::mesh::MeshData;
+using dank::mesh::VertexData;
+
+// Wavefront OBJ: v, vt, vn and f with any polygon size, triangulated as a
+// fan. Vertices are deduplicated by their position/uv/normal triple.
+class ObjImporter {
+private:
+  struct Corner {
+    int32_t position;
+    int32_t uv;
+    int32_t normal;
+
+    bool operator==(const Corner &other) const {
+      return position == other.position && uv == other.uv &&
+             normal == other.normal;
+    }
+  };
+
+  struct CornerHash {
+    size_t operator()(const Corner &c) const {
+      return (static_cast<size_t>(c.position) * 73856093u) ^
+             (static_cast<size_t>(c.uv) * 19349663u) ^
+             (static_cast<size_t>(c.normal) * 83492791u);
+    }
+  };
+
+  std::vector<glm::vec3> positions{};
+  std::vector<glm::vec2> uvs{};
+  std::vector<glm::vec3> normals{};
+  std::unordered_map<Corner, uint32_t, CornerHash> corners{};
+  bool hasNormals = true;
+
+  static const char *skipSpace(const char *c, const char *end) {
+    while (c < end && (*c == ' ' || *c == '\t')) {
+      c++;
+    }
+    return c;
+  }
+
+  static const char *nextLine(const char *c, const char *end) {
+    while (c < end && *c != '\n') {
+      c++;
+    }
+    return c < end ? c + 1 : end;
+  }
+
+  // Negative indices are relative to the end of the list
+  static int32_t resolve(long index, size_t count) {
+    if (index < 0)
+      return static_cast<int32_t>(count + index);
+    return static_cast<int32_t>(index - 1);
+  }
+
+  uint32_t addCorner(const Corner &corner, MeshData &output) {
+    auto found = corners.find(corner);
+    if (found != corners.end())
+      return found->second;
+
+    VertexData vertex{};
+    if (corner.position >= 0 && corner.position < (int32_t)positions.size()) {
+      vertex.position = positions[corner.position];
+    }
+    if (corner.uv >= 0 && corner.uv < (int32_t)uvs.size()) {
+      // OBJ uvs start at the bottom, Metal textures at the top
+      vertex.uv = glm::vec2(uvs[corner.uv].x, 1.0f - uvs[corner.uv].y);
+    }
+    if (corner.normal >= 0 && corner.normal < (int32_t)normals.size()) {
+      vertex.normal = normals[corner.normal];
+    } else {
+      hasNormals = false;
+    }
+
+    uint32_t index = output.vertices.size();
+    output.vertices.push_back(vertex);
+    corners.emplace(corner, index);
+    return index;
+  }
+
+public:
+  // The text must be followed by a 0 byte, numbers are read with strtof
+  bool import(const char *begin, const char *end, MeshData &output) {
+    std::vector<uint32_t> face{};
+    const char *c = begin;
+
+    while (c < end) {
+      c = skipSpace(c, end);
+      if (end - c < 2) {
+        break;
+      }
+
+      char *next = nullptr;
+      if (c[0] == 'v' && c[1] == ' ') {
+        glm::vec3 p;
+        p.x = std::strtof(c + 2, &next);
+        p.y = std::strtof(next, &next);
+        p.z = std::strtof(next, &next);
+        positions.push_back(p);
+      } else if (c[0] == 'v' && c[1] == 't') {
+        glm::vec2 uv;
+        uv.x = std::strtof(c + 2, &next);
+        uv.y = std::strtof(next, &next);
+        uvs.push_back(uv);
+      } else if (c[0] == 'v' && c[1] == 'n') {
+        glm::vec3 n;
+        n.x = std::strtof(c + 2, &next);
+        n.y = std::strtof(next, &next);
+        n.z = std::strtof(next, &next);
+        normals.push_back(n);
+      } else if (c[0] == 'f' && c[1] == ' ') {
+        face.clear();
+        const char *f = c + 2;
+        while (true) {
+          f = skipSpace(f, end);
+          if (f >= end || *f == '\n' || *f == '\r' || *f == '#')
+            break;
+
+          Corner corner{-1, -1, -1};
+          long value = std::strtol(f, &next, 10);
+          if (next == f)
+            break;
+          corner.position = resolve(value, positions.size());
+          f = next;
+          if (f < end && *f == '/') {
+            f++;
+            if (f < end && *f != '/') {
+              value = std::strtol(f, &next, 10);
+              corner.uv = resolve(value, uvs.size());
+              f = next;
+            }
+            if (f < end && *f == '/') {
+              f++;
+              value = std::strtol(f, &next, 10);
+              corner.normal = resolve(value, normals.size());
+              f = next;
+            }
+          }
+          face.push_back(addCorner(corner, output));
+        }
+
+        for (size_t i = 2; i < face.size(); i++) {
+          output.indices.push_back(face[0]);
+          output.indices.push_back(face[i - 1]);
+          output.indices.push_back(face[i]);
+        }
+      }
+
+      c = nextLine(c, end);
+    }
+
+    if (!hasNormals) {
+      computeNormals(output);
+    }
+    return !output.indices.empty();
+  }
+
+  // Area weighted face normals, used when the file has none
+  static void computeNormals(MeshData &output) {
+    for (auto &vertex : output.vertices) {
+      vertex.normal = glm::vec3(0.0f);
+    }
+    for (size_t i = 0; i + 2 < output.indices.size(); i += 3) {
+      VertexData &a = output.vertices[output.indices[i]];
+      VertexData &b = output.vertices[output.indices[i + 1]];
+      VertexData &c = output.vertices[output.indices[i + 2]];
+      glm::vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+      a.normal += n;
+      b.normal += n;
+      c.normal += n;
+    }
+    for (auto &vertex : output.vertices) {
+      float length = glm::length(vertex.normal);
+      vertex.normal =
+          length > 0 ? vertex.normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+  }
+};
+
+} // namespace meshimport
@@ -0,0 +1,122 @@
+// Converts OBJ and glTF models into the binary mesh format loaded by
+// mesh::FileMesh, see modules/renderer/meshes/MeshFile.hpp
+//
+//   meshimport [--no-optimize] [--no-overdraw] input.(obj|gltf|glb) output
+#include "GltfImporter.hpp"
+#include "ObjImporter.hpp"
+#include "modules/renderer/meshes/MeshFile.hpp"
+#include "modules/renderer/meshes/MeshOptimizer.hpp"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dank;
+
+static bool endsWith(const std::string &value, const std::string &suffix) {
+  if (suffix.size() > value.size())
+    return false;
+  for (size_t i = 0; i < suffix.size(); i++) {
+    if (tolower(value[value.size() - suffix.size() + i]) != suffix[i])
+      return false;
+  }
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: meshimport [--no-optimize] [--no-overdraw] "
+                  "input.(obj|gltf|glb) output\n");
+}
+
+int main(int argc, char **argv) {
+  bool optimize = true;
+  mesh::OptimizeOptions options{};
+  std::vector<std::string> paths{};
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--no-optimize") {
+      optimize = false;
+    } else if (arg == "--no-overdraw") {
+      options.overdraw = false;
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+  const std::string &input = paths[0];
+  const std::string &output = paths[1];
+
+  auto start = std::chrono::steady_clock::now();
+  mesh::MeshData data{};
+  bool imported = false;
+
+  if (endsWith(input, ".obj")) {
+    FILE *file = fopen(input.c_str(), "rb");
+    if (file != nullptr) {
+      fseek(file, 0, SEEK_END);
+      long size = ftell(file);
+      fseek(file, 0, SEEK_SET);
+      // Terminated so the number parsing can never run past the end
+      std::vector<char> text(size > 0 ? size + 1 : 1, 0);
+      size_t read = fread(text.data(), 1, text.size() - 1, file);
+      fclose(file);
+      meshimport::ObjImporter importer{};
+      imported = importer.import(text.data(), text.data() + read, data);
+    }
+  } else if (endsWith(input, ".gltf") || endsWith(input, ".glb")) {
+    meshimport::GltfImporter importer{};
+    imported = importer.import(input, data);
+  } else {
+    fprintf(stderr, "unknown input format %s\n", input.c_str());
+    return 1;
+  }
+
+  if (!imported) {
+    fprintf(stderr, "could not import %s\n", input.c_str());
+    return 1;
+  }
+
+  for (const auto index : data.indices) {
+    if (index >= data.vertices.size()) {
+      fprintf(stderr, "index %u out of range in %s\n", index, input.c_str());
+      return 1;
+    }
+  }
+
+  double importTime = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  printf("imported %zu vertices, %zu triangles in %.1fms\n",
+         data.vertices.size(), data.indices.size() / 3, importTime);
+
+  if (optimize) {
+    mesh::OptimizeReport report = mesh::optimizeMesh(data, options);
+    printf("optimized in %.1fms | ACMR %.3f -> %.3f | ATVR %.3f -> %.3f\n",
+           report.milliseconds, report.acmrBefore, report.acmrAfter,
+           report.atvrBefore, report.atvrAfter);
+  }
+
+  std::vector<uint8_t> bytes{};
+  mesh::writeMeshFile(data, bytes);
+
+  FILE *file = fopen(output.c_str(), "wb");
+  if (file == nullptr ||
+      fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+    fprintf(stderr, "could not write %s\n", output.c_str());
+    if (file != nullptr) {
+      fclose(file);
+    }
+    return 1;
+  }
+  fclose(file);
+  printf("wrote %s (%zu bytes)\n", output.c_str(), bytes.size());
+  return 0;
+}
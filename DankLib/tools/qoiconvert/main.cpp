@@ -0,0 +1,193 @@
+// Transcodes PNG, JPEG and the other stb_image formats into QOI images,
+// which the TextureLoader decodes several times faster, see
+// modules/renderer/textures/QoiImage.hpp
+//
+//   qoiconvert [--output directory] input...
+//
+// Inputs are images or directories searched recursively for PNGs. Each
+// image is written next to itself, or under the output directory keeping
+// its path relative to the input, with its extension replaced by .qoi.
+// Images are converted in parallel and decoded back to check them.
+#define STB_IMAGE_IMPLEMENTATION
+#include "libs/stb/stb_image.h"
+#include "modules/os/JobSystem.hpp"
+#include "modules/renderer/textures/QoiImage.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace dank;
+namespace fs = std::filesystem;
+
+struct Conversion {
+  fs::path input{};
+  fs::path output{};
+  bool converted = false;
+  std::string error{};
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t inputSize = 0;
+  size_t outputSize = 0;
+  double sourceDecodeTime = 0;
+  double qoiDecodeTime = 0;
+};
+
+static void usage() {
+  fprintf(stderr, "usage: qoiconvert [--output directory] input...\n");
+}
+
+static bool isPng(const fs::path &path) {
+  std::string extension = path.extension().string();
+  for (char &c : extension) {
+    c = char(tolower(static_cast<unsigned char>(c)));
+  }
+  return extension == ".png";
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static void convert(Conversion &conversion) {
+  std::string input = conversion.input.string();
+  auto start = std::chrono::steady_clock::now();
+  int width, height, channels;
+  uint8_t *pixels =
+      stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    conversion.error = stbi_failure_reason();
+    return;
+  }
+  conversion.sourceDecodeTime = millisecondsSince(start);
+  conversion.width = width;
+  conversion.height = height;
+
+  std::vector<uint8_t> bytes{};
+  texture::encodeQoi(pixels, width, height, channels == 3 ? 3 : 4, bytes);
+
+  // Decoded back both to check the encoder and to time what the loader
+  // will spend on it
+  texture::QoiHeader header{};
+  std::vector<uint8_t> decoded(size_t(width) * height * 4);
+  start = std::chrono::steady_clock::now();
+  bool valid = texture::readQoiHeader(bytes.data(), bytes.size(), header) &&
+               texture::decodeQoi(bytes.data(), bytes.size(), header,
+                                  decoded.data());
+  conversion.qoiDecodeTime = millisecondsSince(start);
+  valid = valid && memcmp(decoded.data(), pixels, decoded.size()) == 0;
+  stbi_image_free(pixels);
+  if (!valid) {
+    conversion.error = "decoded QOI differs from the source";
+    return;
+  }
+
+  std::error_code ignored;
+  fs::create_directories(conversion.output.parent_path(), ignored);
+  std::string output = conversion.output.string();
+  FILE *file = fopen(output.c_str(), "wb");
+  if (file == nullptr ||
+      fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+    conversion.error = "could not write " + output;
+    if (file != nullptr) {
+      fclose(file);
+    }
+    return;
+  }
+  fclose(file);
+  conversion.inputSize = fs::file_size(conversion.input, ignored);
+  conversion.outputSize = bytes.size();
+  conversion.converted = true;
+}
+
+int main(int argc, char **argv) {
+  fs::path outputDirectory{};
+  std::vector<fs::path> inputs{};
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--output" && i + 1 < argc) {
+      outputDirectory = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage();
+      return 1;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+  if (inputs.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::vector<Conversion> conversions{};
+  auto add = [&](const fs::path &input, const fs::path &relative) {
+    Conversion conversion{};
+    conversion.input = input;
+    conversion.output =
+        outputDirectory.empty() ? input : outputDirectory / relative;
+    conversion.output.replace_extension(".qoi");
+    conversions.push_back(conversion);
+  };
+  for (const fs::path &input : inputs) {
+    std::error_code error;
+    if (fs::is_directory(input, error)) {
+      for (const auto &entry :
+           fs::recursive_directory_iterator(input, error)) {
+        if (entry.is_regular_file() && isPng(entry.path())) {
+          add(entry.path(), fs::relative(entry.path(), input));
+        }
+      }
+    } else {
+      add(input, input.filename());
+    }
+  }
+  if (conversions.empty()) {
+    fprintf(stderr, "no images found\n");
+    return 1;
+  }
+
+  JobSystem jobs{};
+  jobs.start();
+  auto start = std::chrono::steady_clock::now();
+  jobs.parallelFor(conversions.size(), 1, [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+      convert(conversions[i]);
+    }
+  });
+  double totalTime = millisecondsSince(start);
+  jobs.stop();
+
+  uint32_t failed = 0;
+  size_t inputSize = 0, outputSize = 0;
+  double sourceDecodeTime = 0, qoiDecodeTime = 0;
+  for (const Conversion &conversion : conversions) {
+    if (!conversion.converted) {
+      fprintf(stderr, "could not convert %s: %s\n",
+              conversion.input.string().c_str(), conversion.error.c_str());
+      failed++;
+      continue;
+    }
+    printf("%s -> %s: %ux%u | %zu -> %zu bytes | decode %.1fms -> %.1fms\n",
+           conversion.input.string().c_str(),
+           conversion.output.string().c_str(), conversion.width,
+           conversion.height, conversion.inputSize, conversion.outputSize,
+           conversion.sourceDecodeTime, conversion.qoiDecodeTime);
+    inputSize += conversion.inputSize;
+    outputSize += conversion.outputSize;
+    sourceDecodeTime += conversion.sourceDecodeTime;
+    qoiDecodeTime += conversion.qoiDecodeTime;
+  }
+  printf("converted %zu of %zu images in %.1fms | %zu -> %zu bytes | "
+         "decode %.1fms -> %.1fms (%.1fx)\n",
+         conversions.size() - failed, conversions.size(), totalTime,
+         inputSize, outputSize, sourceDecodeTime, qoiDecodeTime,
+         sourceDecodeTime / std::max(qoiDecodeTime, 0.001));
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+// Converts PNG, JPEG and the other stb_image formats into the block
+// compressed texture file loaded by texture::Texture2D, see
+// modules/renderer/textures/TextureFile.hpp
+//
+//   texcompress [--format bc1|bc3|bc7|astc] [--no-mips] [--linear]
+//               [--straight] input output
+//
+// Color is premultiplied by alpha like the renderer blends it unless
+// --straight is given.
+#define STB_IMAGE_IMPLEMENTATION
+#include "libs/stb/stb_image.h"
+#include "modules/os/JobSystem.hpp"
+#include "modules/renderer/textures/MipChain.hpp"
+#include "modules/renderer/textures/TextureCompression.hpp"
+#include "modules/renderer/textures/TextureFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dank;
+
+static void usage() {
+  fprintf(stderr, "usage: texcompress [--format bc1|bc3|bc7|astc] "
+                  "[--no-mips] [--linear] [--straight] input output\n");
+}
+
+int main(int argc, char **argv) {
+  PixelFormat format = PixelFormat::BC7_RGBA;
+  bool mips = true;
+  texture::MipOptions options{};
+  std::vector<std::string> paths{};
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (name == "bc1") {
+        format = PixelFormat::BC1_RGBA;
+      } else if (name == "bc3") {
+        format = PixelFormat::BC3_RGBA;
+      } else if (name == "bc7") {
+        format = PixelFormat::BC7_RGBA;
+      } else if (name == "astc") {
+        format = PixelFormat::ASTC_4x4;
+      } else {
+        usage();
+        return 1;
+      }
+    } else if (arg == "--no-mips") {
+      mips = false;
+    } else if (arg == "--linear") {
+      options.srgb = false;
+    } else if (arg == "--straight") {
+      options.premultiplied = false;
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+  const std::string &input = paths[0];
+  const std::string &output = paths[1];
+
+  auto start = std::chrono::steady_clock::now();
+  int width, height, channels;
+  uint8_t *pixels =
+      stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    fprintf(stderr, "could not decode %s: %s\n", input.c_str(),
+            stbi_failure_reason());
+    return 1;
+  }
+  double decodeTime = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  printf("decoded %dx%d in %.1fms\n", width, height, decodeTime);
+
+  texture::TextureLevel levels[texture::MAX_TEXTURE_LEVELS];
+  levels[0] = texture::TextureLevel{0, uint32_t(width * height * 4),
+                                    uint32_t(width), uint32_t(height)};
+  uint32_t levelCount = 1;
+  uint8_t *chain = pixels;
+  if (mips || options.premultiplied) {
+    start = std::chrono::steady_clock::now();
+    chain = texture::generateMipChain(pixels, width, height, options, levels,
+                                      levelCount);
+    stbi_image_free(pixels);
+    if (chain == nullptr) {
+      fprintf(stderr, "out of memory for %s\n", input.c_str());
+      return 1;
+    }
+    double mipTime = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("mipmapped %u levels in %.1fms | %.1f MP/s\n", levelCount,
+           mipTime, double(width) * height / (mipTime * 1000.0));
+    if (!mips) {
+      levelCount = 1;
+    }
+  }
+
+  JobSystem jobs{};
+  jobs.start();
+
+  start = std::chrono::steady_clock::now();
+  std::vector<std::vector<uint8_t>> blocks(levelCount);
+  size_t rawSize = 0;
+  for (uint32_t i = 0; i < levelCount; i++) {
+    texture::compressImage(chain + levels[i].offset, levels[i].width,
+                           levels[i].height, format, blocks[i], jobs);
+    rawSize += levels[i].size;
+  }
+  double compressTime = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  jobs.stop();
+  free(chain);
+
+  std::vector<uint8_t> bytes{};
+  texture::writeTextureFile(format, width, height, blocks, bytes);
+  printf("compressed %zu levels in %.1fms | %.1f MP/s | RGBA8 %zu -> %zu "
+         "bytes (%.1fx)\n",
+         blocks.size(), compressTime,
+         double(rawSize / 4) / (compressTime * 1000.0), rawSize, bytes.size(),
+         double(rawSize) / double(bytes.size()));
+
+  FILE *file = fopen(output.c_str(), "wb");
+  if (file == nullptr ||
+      fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+    fprintf(stderr, "could not write %s\n", output.c_str());
+    if (file != nullptr) {
+      fclose(file);
+    }
+    return 1;
+  }
+  fclose(file);
+  printf("wrote %s (%zu bytes)\n", output.c_str(), bytes.size());
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Cuts an image into the tiled virtual texture file streamed by
+// texture::VirtualTextures, see
+// modules/renderer/textures/VirtualTextureFile.hpp
+//
+//   vtbuild [--linear] input output
+//
+// Inputs are QOI images or anything stb_image reads. Levels are filtered in
+// linear light from sRGB unless --linear is given and stored premultiplied.
+#define STB_IMAGE_IMPLEMENTATION
+#include "libs/stb/stb_image.h"
+#include "modules/renderer/textures/MipChain.hpp"
+#include "modules/renderer/textures/QoiImage.hpp"
+#include "modules/renderer/textures/VirtualTextureFile.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace dank;
+
+static void usage() {
+  fprintf(stderr, "usage: vtbuild [--linear] input output\n");
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Tightly packed RGBA8 rows, released with free
+static uint8_t *decode(const std::string &path, uint32_t &width,
+                       uint32_t &height) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return nullptr;
+  std::vector<uint8_t> bytes{};
+  uint8_t buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + count);
+  }
+  fclose(file);
+
+  texture::QoiHeader header{};
+  if (texture::readQoiHeader(bytes.data(), bytes.size(), header)) {
+    size_t size = size_t(header.width) * header.height * 4;
+    auto *pixels = static_cast<uint8_t *>(malloc(size));
+    if (pixels == nullptr ||
+        !texture::decodeQoi(bytes.data(), bytes.size(), header, pixels)) {
+      free(pixels);
+      return nullptr;
+    }
+    width = header.width;
+    height = header.height;
+    return pixels;
+  }
+
+  int w = 0, h = 0, channels;
+  uint8_t *pixels = stbi_load_from_memory(bytes.data(), int(bytes.size()), &w,
+                                          &h, &channels, STBI_rgb_alpha);
+  width = w;
+  height = h;
+  return pixels;
+}
+
+int main(int argc, char **argv) {
+  texture::MipOptions options{};
+  std::vector<std::string> paths{};
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--linear") {
+      options.srgb = false;
+    } else if (arg.compare(0, 2, "--") == 0) {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+  const std::string &input = paths[0];
+  const std::string &output = paths[1];
+
+  auto start = std::chrono::steady_clock::now();
+  uint32_t width = 0, height = 0;
+  uint8_t *pixels = decode(input, width, height);
+  if (pixels == nullptr) {
+    fprintf(stderr, "could not decode %s\n", input.c_str());
+    return 1;
+  }
+  printf("decoded %ux%u in %.1fms\n", width, height, millisecondsSince(start));
+
+  // Tiles are always premultiplied, that is how the page cache is blended
+  start = std::chrono::steady_clock::now();
+  texture::TextureLevel levels[texture::MAX_TEXTURE_LEVELS];
+  uint32_t levelCount = 0;
+  uint8_t *chain = texture::generateMipChain(pixels, width, height, options,
+                                             levels, levelCount);
+  free(pixels);
+  if (chain == nullptr) {
+    fprintf(stderr, "out of memory for %s\n", input.c_str());
+    return 1;
+  }
+  printf("mipmapped %u levels in %.1fms\n", levelCount,
+         millisecondsSince(start));
+
+  start = std::chrono::steady_clock::now();
+  bool written =
+      texture::writeVirtualTextureFile(output, chain, levels, levelCount);
+  free(chain);
+  if (!written) {
+    fprintf(stderr, "could not write %s\n", output.c_str());
+    return 1;
+  }
+
+  // Read back to check the header and report the size
+  FILE *file = fopen(output.c_str(), "rb");
+  uint8_t bytes[sizeof(texture::VirtualTextureHeader)];
+  texture::VirtualTextureHeader header{};
+  bool valid =
+      file != nullptr &&
+      fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes) &&
+      texture::readVirtualTextureHeader(bytes, sizeof(bytes), header);
+  long size = 0;
+  if (file != nullptr) {
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+  }
+  if (!valid) {
+    fprintf(stderr, "could not read back %s\n", output.c_str());
+    return 1;
+  }
+  printf("wrote %u levels, %u tiles of %u texels in %.1fms | RGBA8 %zu -> "
+         "%ld bytes\n",
+         header.levelCount, header.tileCount, texture::VIRTUAL_TILE_SIZE,
+         millisecondsSince(start),
+         size_t(header.tileCount) * texture::VIRTUAL_TILE_SIZE *
+             texture::VIRTUAL_TILE_SIZE * 4,
+         size);
+  return 0;
+}